@@ -1,42 +1,121 @@
-QT       += core gui
+QT       += core gui concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 CONFIG += c++17
 
+# 并发检查构建，配合 --stress 使用：qmake CONFIG+=tsan 或 qmake CONFIG+=asan
+tsan {
+    CONFIG += sanitizer sanitize_thread
+}
+asan {
+    CONFIG += sanitizer sanitize_address sanitize_undefined
+}
+
 # You can make your code fail to compile if it uses deprecated APIs.
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    aviwriter.cpp \
+    backgroundtask.cpp \
+    batchfilethread.cpp \
+    checksumindex.cpp \
     confirmpage.cpp \
+    contactsheetthread.cpp \
+    cpufeatures.cpp \
+    dateindex.cpp \
+    dateindexthread.cpp \
+    decodepool.cpp \
+    dirscanner.cpp \
+    foldersyncthread.cpp \
+    galleryexportthread.cpp \
+    imageadjuster.cpp \
+    imagecache.cpp \
+    imagescaler.cpp \
+    ioscheduler.cpp \
+    lazydirthread.cpp \
     main.cpp \
     mainwindow.cpp \
+    mappedfile.cpp \
+    memorybudget.cpp \
+    metrics.cpp \
     opentreethread.cpp \
+    packfile.cpp \
+    packthread.cpp \
+    picshow.cpp \
+    previewextractor.cpp \
+    promanifest.cpp \
     prosetpage.cpp \
     protree.cpp \
     protreeitem.cpp \
     protreethread.cpp \
     protreewidget.cpp \
+    recompressor.cpp \
     removeprodialog.cpp \
+    removeprothread.cpp \
+    scrubthread.cpp \
+    statspanel.cpp \
+    stressrunner.cpp \
+    thumbcache.cpp \
+    tiffwriter.cpp \
+    timelinedialog.cpp \
+    videoexportthread.cpp \
     wizard.cpp
 
 HEADERS += \
+    aviwriter.h \
+    backgroundtask.h \
+    batchfilethread.h \
+    boundedqueue.h \
+    checksumindex.h \
     confirmpage.h \
     const.h \
+    contactsheetthread.h \
+    cpufeatures.h \
+    dateindex.h \
+    dateindexthread.h \
+    decodepool.h \
+    dirscanner.h \
+    foldersyncthread.h \
+    galleryexportthread.h \
+    imageadjuster.h \
+    imagecache.h \
+    imagescaler.h \
+    ioscheduler.h \
+    lazydirthread.h \
     mainwindow.h \
+    mappedfile.h \
+    memorybudget.h \
+    metrics.h \
     opentreethread.h \
+    packfile.h \
+    packthread.h \
+    picshow.h \
+    previewextractor.h \
+    promanifest.h \
     prosetpage.h \
     protree.h \
     protreeitem.h \
     protreethread.h \
     protreewidget.h \
+    recompressor.h \
     removeprodialog.h \
+    removeprothread.h \
+    reorderbuffer.h \
+    scrubthread.h \
+    statspanel.h \
+    stressrunner.h \
+    thumbcache.h \
+    tiffwriter.h \
+    timelinedialog.h \
+    videoexportthread.h \
     wizard.h
 
 FORMS += \
     confirmpage.ui \
     mainwindow.ui \
+    picshow.ui \
     prosetpage.ui \
     protree.ui \
     removeprodialog.ui \
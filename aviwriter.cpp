@@ -0,0 +1,214 @@
+#include "aviwriter.h"
+
+namespace {
+// AVI 1.0 的长度字段是 32 位，很多播放器按有符号数处理，留出索引的空间
+const qint64 kMaxFileSize = (qint64(1) << 31) - 64 * 1024 * 1024;
+const quint32 kAvifHasIndex = 0x10;
+const quint32 kAviifKeyFrame = 0x10;
+}
+
+AviWriter::AviWriter()
+    :_width(0), _height(0), _fps(0), _max_frame_size(0), _full(false), _movi_pos(0),
+    _avih_frames_pos(0), _avih_buffer_pos(0), _strh_length_pos(0),
+    _strh_buffer_pos(0), _movi_size_pos(0)
+{
+
+}
+
+AviWriter::~AviWriter()
+{
+    if(_file.isOpen()){
+        Close();
+    }
+}
+
+bool AviWriter::Open(const QString &path, int width, int height, int fps)
+{
+    _width = width;
+    _height = height;
+    _fps = fps;
+    _max_frame_size = 0;
+    _full = false;
+    _index.clear();
+    _file.setFileName(path);
+    if(!_file.open(QIODevice::WriteOnly | QIODevice::Truncate)){
+        return false;
+    }
+    return WriteHeaders();
+}
+
+void AviWriter::PutU32(QByteArray &out, quint32 value)
+{
+    char bytes[4] = {char(value), char(value >> 8), char(value >> 16), char(value >> 24)};
+    out.append(bytes, 4);
+}
+
+void AviWriter::PutU16(QByteArray &out, quint16 value)
+{
+    char bytes[2] = {char(value), char(value >> 8)};
+    out.append(bytes, 2);
+}
+
+// 文件头：RIFF AVI / hdrl(avih, strl(strh, strf)) / movi 开头；长度和帧数先写 0，结束时回填
+bool AviWriter::WriteHeaders()
+{
+    QByteArray out;
+    out.append("RIFF");
+    PutU32(out, 0);
+    out.append("AVI ");
+
+    out.append("LIST");
+    PutU32(out, 192);           // hdrl 列表长度
+    out.append("hdrl");
+
+    out.append("avih");
+    PutU32(out, 56);
+    PutU32(out, quint32(1000000 / _fps));   // 每帧微秒数
+    PutU32(out, 0);             // 最大码率，不填
+    PutU32(out, 0);             // 对齐粒度
+    PutU32(out, kAvifHasIndex);
+    _avih_frames_pos = out.size();
+    PutU32(out, 0);             // 总帧数
+    PutU32(out, 0);             // 初始帧
+    PutU32(out, 1);             // 流数
+    _avih_buffer_pos = out.size();
+    PutU32(out, 0);             // 建议缓冲区大小
+    PutU32(out, quint32(_width));
+    PutU32(out, quint32(_height));
+    for(int i = 0; i < 4; ++i){
+        PutU32(out, 0);
+    }
+
+    out.append("LIST");
+    PutU32(out, 116);           // strl 列表长度
+    out.append("strl");
+
+    out.append("strh");
+    PutU32(out, 56);
+    out.append("vids");
+    out.append("MJPG");
+    PutU32(out, 0);             // 标志
+    PutU16(out, 0);             // 优先级
+    PutU16(out, 0);             // 语言
+    PutU32(out, 0);             // 初始帧
+    PutU32(out, 1);             // 时间单位 scale
+    PutU32(out, quint32(_fps)); // rate / scale 即帧率
+    PutU32(out, 0);             // 开始时间
+    _strh_length_pos = out.size();
+    PutU32(out, 0);             // 帧数
+    _strh_buffer_pos = out.size();
+    PutU32(out, 0);             // 建议缓冲区大小
+    PutU32(out, 0xFFFFFFFF);    // 质量，-1 表示默认
+    PutU32(out, 0);             // 样本大小，视频为 0
+    PutU16(out, 0);
+    PutU16(out, 0);
+    PutU16(out, quint16(_width));
+    PutU16(out, quint16(_height));
+
+    out.append("strf");
+    PutU32(out, 40);            // BITMAPINFOHEADER
+    PutU32(out, 40);
+    PutU32(out, quint32(_width));
+    PutU32(out, quint32(_height));
+    PutU16(out, 1);             // 平面数
+    PutU16(out, 24);            // 位深
+    out.append("MJPG");
+    PutU32(out, quint32(_width * _height * 3));
+    for(int i = 0; i < 4; ++i){
+        PutU32(out, 0);
+    }
+
+    out.append("LIST");
+    _movi_size_pos = out.size();
+    PutU32(out, 0);
+    _movi_pos = out.size();
+    out.append("movi");
+
+    return _file.write(out) == out.size();
+}
+
+bool AviWriter::AddFrame(const QByteArray &data)
+{
+    const quint32 size = quint32(data.size());
+    if(_file.pos() + 8 + size + 1 + 16 * (_index.size() + 1) > kMaxFileSize){
+        _full = true;
+        return false;
+    }
+    // 第一帧不能是空帧
+    if(size == 0 && _index.isEmpty()){
+        return false;
+    }
+
+    QByteArray header("00dc");
+    PutU32(header, size);
+    _index.append({quint32(_file.pos() - _movi_pos), size, size > 0});
+    if(_file.write(header) != header.size() || _file.write(data) != data.size()){
+        return false;
+    }
+    // 数据块按 2 字节对齐
+    if(size % 2 && _file.write("\0", 1) != 1){
+        return false;
+    }
+    _max_frame_size = qMax(_max_frame_size, size);
+    return true;
+}
+
+bool AviWriter::PatchU32(qint64 pos, quint32 value)
+{
+    QByteArray bytes;
+    PutU32(bytes, value);
+    return _file.seek(pos) && _file.write(bytes) == 4;
+}
+
+bool AviWriter::Close()
+{
+    if(!_file.isOpen()){
+        return false;
+    }
+    qint64 movi_end = _file.pos();
+
+    QByteArray index("idx1");
+    PutU32(index, quint32(_index.size() * 16));
+    for(const IndexEntry & entry : _index){
+        index.append("00dc");
+        PutU32(index, entry.key ? kAviifKeyFrame : 0);
+        PutU32(index, entry.offset);
+        PutU32(index, entry.size);
+    }
+    bool ok = _file.write(index) == index.size();
+    qint64 file_end = _file.pos();
+
+    const quint32 frames = quint32(_index.size());
+    const quint32 buffer_size = _max_frame_size + 8;
+    ok = ok && PatchU32(4, quint32(file_end - 8))
+         && PatchU32(_movi_size_pos, quint32(movi_end - _movi_pos))
+         && PatchU32(_avih_frames_pos, frames)
+         && PatchU32(_avih_buffer_pos, buffer_size)
+         && PatchU32(_strh_length_pos, frames)
+         && PatchU32(_strh_buffer_pos, buffer_size);
+    _file.close();
+    return ok;
+}
+
+void AviWriter::Abort()
+{
+    if(_file.isOpen()){
+        _file.close();
+    }
+    _file.remove();
+}
+
+int AviWriter::FrameCount() const
+{
+    return _index.size();
+}
+
+bool AviWriter::IsFull() const
+{
+    return _full;
+}
+
+qint64 AviWriter::MaxFileSize()
+{
+    return kMaxFileSize;
+}
@@ -0,0 +1,65 @@
+#ifndef AVIWRITER_H
+#define AVIWRITER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+/*
+ * MJPEG 编码的 AVI 文件写入器，只有一路视频流，不依赖外部编码库。
+ * 每帧是一张完整的 JPEG；空帧写成零长度的数据块，播放器按重复上一帧处理，
+ * 幻灯片停留期间的静止画面因此几乎不占空间。
+ * 只实现 AVI 1.0（RIFF 头中的 32 位长度），文件不能超过 2GB；写满时 AddFrame 失败、IsFull 为真，
+ * 调用方应在开始渲染前用 MaxFileSize 估算，不要等写到一半才失败。
+ */
+class AviWriter
+{
+public:
+    AviWriter();
+    ~AviWriter();
+
+    bool Open(const QString & path, int width, int height, int fps);
+    // 追加一帧 JPEG 数据；data 为空表示重复上一帧
+    bool AddFrame(const QByteArray & data);
+    // 写入索引并回填文件头中的长度和帧数
+    bool Close();
+    // 放弃写入并删除文件
+    void Abort();
+    int FrameCount() const;
+    // 上一次 AddFrame 是否因为超过文件大小上限而失败
+    bool IsFull() const;
+    // 文件大小上限，已扣除索引以外的余量
+    static qint64 MaxFileSize();
+    // 每帧在文件中除 JPEG 数据以外的开销：块头、对齐和索引项
+    static const int kFrameOverhead = 8 + 1 + 16;
+
+private:
+    struct IndexEntry {
+        quint32 offset;     // 相对 movi 标识的偏移
+        quint32 size;
+        bool key;
+    };
+
+    bool WriteHeaders();
+    void PutU32(QByteArray & out, quint32 value);
+    void PutU16(QByteArray & out, quint16 value);
+    bool PatchU32(qint64 pos, quint32 value);
+
+    QFile _file;
+    int _width;
+    int _height;
+    int _fps;
+    quint32 _max_frame_size;
+    bool _full;
+    qint64 _movi_pos;           // movi 列表标识 "movi" 所在位置
+    QVector<IndexEntry> _index;
+    // 需要在结束时回填的字段位置
+    qint64 _avih_frames_pos;
+    qint64 _avih_buffer_pos;
+    qint64 _strh_length_pos;
+    qint64 _strh_buffer_pos;
+    qint64 _movi_size_pos;
+};
+
+#endif // AVIWRITER_H
@@ -0,0 +1,135 @@
+#include "backgroundtask.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QMouseEvent>
+#include <QSettings>
+#ifdef Q_OS_LINUX
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// 单调时钟，进程内所有线程共用
+qint64 Now()
+{
+    static QElapsedTimer clock = [](){
+        QElapsedTimer timer;
+        timer.start();
+        return timer;
+    }();
+    return clock.elapsed();
+}
+
+// 前台状态只用原子变量，界面线程登记输入时不加锁
+std::atomic<int> g_foreground(0);           // 进行中的前台解码数
+std::atomic<qint64> g_last_activity(-1000000);    // 最近一次输入或前台解码结束的时间
+
+// 监视用户输入的事件过滤器；鼠标只在按下键拖动时才算输入，单纯移过窗口不算
+class InputMonitor : public QObject
+{
+public:
+    using QObject::QObject;
+
+protected:
+    bool eventFilter(QObject * watched, QEvent * event) override
+    {
+        switch(event->type()){
+        case QEvent::MouseMove:
+            if(static_cast<QMouseEvent*>(event)->buttons() == Qt::NoButton){
+                break;
+            }
+            Q_FALLTHROUGH();
+        case QEvent::MouseButtonPress:
+        case QEvent::MouseButtonRelease:
+        case QEvent::MouseButtonDblClick:
+        case QEvent::Wheel:
+        case QEvent::KeyPress:
+        case QEvent::KeyRelease:
+        case QEvent::TouchBegin:
+        case QEvent::TouchUpdate:
+            g_last_activity = Now();
+            break;
+        default:
+            break;
+        }
+        return QObject::eventFilter(watched, event);
+    }
+};
+
+} // namespace
+
+BackgroundTask::BackgroundTask(QObject *parent)
+    :QThread(parent), _bstop(false)
+{
+    QSettings settings;
+    _quiet_ms = qBound(50, settings.value("background/quiet_ms", 500).toInt(), 10000);
+}
+
+BackgroundTask::~BackgroundTask()
+{
+
+}
+
+BackgroundTask::ForegroundScope::ForegroundScope()
+{
+    ++g_foreground;
+}
+
+BackgroundTask::ForegroundScope::~ForegroundScope()
+{
+    g_last_activity = Now();
+    --g_foreground;
+}
+
+void BackgroundTask::InstallInputMonitor(QCoreApplication *app)
+{
+    app->installEventFilter(new InputMonitor(app));
+}
+
+void BackgroundTask::EnterIdle()
+{
+    QThread::currentThread()->setPriority(QThread::IdlePriority);
+#ifdef Q_OS_LINUX
+    pid_t tid = pid_t(syscall(SYS_gettid));
+    // Linux 上 nice 值按线程生效
+    setpriority(PRIO_PROCESS, id_t(tid), 19);
+    // ioprio_set(IOPRIO_WHO_PROCESS, 当前线程, IOPRIO_CLASS_IDLE)
+    syscall(SYS_ioprio_set, 1, 0, 3 << 13);
+#endif
+}
+
+// 前台忙时小步睡眠轮询，不需要界面线程唤醒，登记输入的开销只有一次原子写
+bool BackgroundTask::Yield() const
+{
+    while(!_bstop){
+        if(g_foreground > 0){
+            QThread::msleep(20);
+            continue;
+        }
+        qint64 wait = g_last_activity + _quiet_ms - Now();
+        if(wait <= 0){
+            return true;
+        }
+        QThread::msleep(qMin<qint64>(wait, 100));
+    }
+    return false;
+}
+
+bool BackgroundTask::IsStopped() const
+{
+    return _bstop;
+}
+
+void BackgroundTask::run()
+{
+    EnterIdle();
+    Work();
+}
+
+void BackgroundTask::SlotCancelProgress()
+{
+    _bstop = true;
+}
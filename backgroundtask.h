@@ -0,0 +1,54 @@
+#ifndef BACKGROUNDTASK_H
+#define BACKGROUNDTASK_H
+
+#include <QThread>
+#include <atomic>
+
+class QCoreApplication;
+
+/*
+ * 后台任务基类，缩略图、摘要、校验这类不急的工作从它派生。
+ * 任务线程以及它派出的工作线程（调用 EnterIdle）处于最低的 CPU（nice 19）和 I/O（IOPRIO_CLASS_IDLE）优先级。
+ * 工作循环在每一小块工作之间调用 Yield()：界面正在处理用户输入、或者前台有解码进行时阻塞，
+ * 前台安静一段时间（background/quiet_ms，默认 500 毫秒）后再继续，
+ * 这样不论后台排了多少工作，前台翻看图片的延迟都不受影响。
+ */
+class BackgroundTask : public QThread
+{
+    Q_OBJECT
+public:
+    explicit BackgroundTask(QObject * parent = nullptr);
+    ~BackgroundTask();
+
+    // 前台解码期间持有，后台任务在它释放并安静一段时间后才继续
+    class ForegroundScope
+    {
+    public:
+        ForegroundScope();
+        ~ForegroundScope();
+        Q_DISABLE_COPY(ForegroundScope)
+    };
+
+    // 在应用上安装输入监视，记录最近一次用户输入的时间
+    static void InstallInputMonitor(QCoreApplication * app);
+    // 当前线程降到最低的 CPU 和 I/O 优先级
+    static void EnterIdle();
+    // 等前台安静后返回 true；任务被取消时返回 false
+    bool Yield() const;
+    bool IsStopped() const;
+
+protected:
+    void run() override;
+    // 派生类在这里完成实际工作
+    virtual void Work() = 0;
+
+    std::atomic<bool> _bstop;
+
+private:
+    int _quiet_ms;
+
+public slots:
+    void SlotCancelProgress();
+};
+
+#endif // BACKGROUNDTASK_H
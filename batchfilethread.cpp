@@ -0,0 +1,147 @@
+#include "batchfilethread.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QThreadPool>
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <fcntl.h>
+#include <stdio.h>
+#endif
+
+namespace {
+// rename 只碰元数据，线程数多于核数也有收益
+const int kMaxThreads = 16;
+}
+
+BatchFileThread::BatchFileThread(Kind kind, const QVector<Op> &ops, QObject *parent)
+    :QThread(parent), _kind(kind), _ops(ops), _done(0), _bstop(false)
+{
+
+}
+
+BatchFileThread::~BatchFileThread()
+{
+
+}
+
+BatchFileThread::Kind BatchFileThread::GetKind() const
+{
+    return _kind;
+}
+
+const QVector<BatchFileThread::Op> &BatchFileThread::Ops() const
+{
+    return _ops;
+}
+
+bool BatchFileThread::MoveEntry(const QString &src, const QString &dst)
+{
+#ifdef Q_OS_LINUX
+    QByteArray src_name = QFile::encodeName(src);
+    QByteArray dst_name = QFile::encodeName(dst);
+    if(::renameat2(AT_FDCWD, src_name.constData(), AT_FDCWD, dst_name.constData(), RENAME_NOREPLACE) == 0){
+        return true;
+    }
+    // EXDEV 跨文件系统，EINVAL/ENOSYS 是文件系统或内核不支持 NOREPLACE，其余是真正的失败
+    if(errno != EXDEV && errno != EINVAL && errno != ENOSYS){
+        return false;
+    }
+#endif
+    if(QFileInfo::exists(dst)){
+        return false;
+    }
+    // QFile::rename 跨文件系统时复制后删除源文件；目录只能 rename
+    if(QFileInfo(src).isDir()){
+        return QDir().rename(src, dst);
+    }
+    return QFile::rename(src, dst);
+}
+
+void BatchFileThread::run()
+{
+    QStringList srcs, dsts;
+    for(const Op & op : _ops){
+        srcs.append(op.src);
+        dsts.append(op.dst);
+    }
+    QVector<bool> all(_ops.size(), true);
+
+    // 目标名和批内某个源名相同时，一步 rename 会因为目标已存在而失败，改为两步
+    QSet<QString> src_set(srcs.begin(), srcs.end());
+    bool collide = false;
+    for(const QString & dst : dsts){
+        if(src_set.contains(dst)){
+            collide = true;
+            break;
+        }
+    }
+
+    emit SigTotalCount(collide ? _ops.size() * 2 : _ops.size());
+
+    QVector<bool> results;
+    if(!collide){
+        results = RenameAll(srcs, dsts, all, true);
+    } else {
+        // 临时名放在源目录里，隐藏且带序号，不会和任何图片重名
+        QStringList temps;
+        for(int i = 0; i < srcs.size(); ++i){
+            QFileInfo info(srcs.at(i));
+            temps.append(info.dir().absoluteFilePath(QString(".%1.batch-%2").arg(info.fileName()).arg(i)));
+        }
+        QVector<bool> staged = RenameAll(srcs, temps, all, true);
+        results = RenameAll(temps, dsts, staged, true);
+        // 第二步失败或被取消的改回原名，不能留下临时名
+        QVector<bool> revert(srcs.size(), false);
+        for(int i = 0; i < srcs.size(); ++i){
+            revert[i] = staged.at(i) && !results.at(i);
+        }
+        RenameAll(temps, srcs, revert, false);
+    }
+
+    int failed = 0;
+    for(int i = 0; i < _ops.size(); ++i){
+        _ops[i].ok = results.at(i);
+        if(!_ops[i].ok){
+            ++failed;
+        }
+    }
+    emit SigFinishProgress(failed);
+}
+
+QVector<bool> BatchFileThread::RenameAll(const QStringList &from, const QStringList &to,
+                                         const QVector<bool> &mask, bool can_stop)
+{
+    QVector<bool> results(from.size(), false);
+    // 各线程写不同的元素，先取出裸指针，避免在线程里触发隐式共享的检查
+    bool * out = results.data();
+    std::atomic<int> next(0);
+    auto worker = [&](){
+        for(int i = next++; i < from.size(); i = next++){
+            if((can_stop && _bstop) || !mask.at(i)){
+                continue;
+            }
+            out[i] = MoveEntry(from.at(i), to.at(i));
+            // 进度每 256 项通知一次，避免信号过多
+            int done = ++_done;
+            if(done % 256 == 0){
+                emit SigUpdateProgress(done);
+            }
+        }
+    };
+
+    int threads = qBound(1, int(from.size() / 64), kMaxThreads);
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    for(int i = 0; i < threads; ++i){
+        pool.start(worker);
+    }
+    pool.waitForDone();
+    return results;
+}
+
+void BatchFileThread::SlotCancelProgress()
+{
+    _bstop = true;
+}
@@ -0,0 +1,60 @@
+#ifndef BATCHFILETHREAD_H
+#define BATCHFILETHREAD_H
+
+#include <QThread>
+#include <QVector>
+#include <atomic>
+
+/*
+ * 目录树中多选图片/目录的批量文件操作：移动、重命名、删除。
+ * 三种操作都归结为一组 rename：删除是移到项目旁边的回收目录，之后再由 RemoveProThread 在后台清空。
+ * 同一文件系统上的 rename 只改目录项，多个线程并行提交；目标已存在时不覆盖（RENAME_NOREPLACE），
+ * 跨文件系统时退回复制。批内的目标名和源名互相冲突（例如序号重排）时先改成临时名再改成目标名。
+ * 线程只操作文件，目录树在界面线程里按结果一次性更新。
+ */
+class BatchFileThread : public QThread
+{
+    Q_OBJECT
+public:
+    enum Kind {
+        BatchMove,
+        BatchRename,
+        BatchDelete
+    };
+
+    struct Op {
+        QString src;
+        QString dst;
+        bool ok = false;
+    };
+
+    BatchFileThread(Kind kind, const QVector<Op> & ops, QObject * parent = nullptr);
+    ~BatchFileThread();
+    Kind GetKind() const;
+    // 线程结束后读取每一项的结果
+    const QVector<Op> & Ops() const;
+
+    // 不覆盖已有文件的 rename，成功返回 true
+    static bool MoveEntry(const QString & src, const QString & dst);
+protected:
+    virtual void run();
+private:
+    // 并行执行 from[i] -> to[i]，只处理 mask 中为 true 的项，返回每项是否成功；
+    // can_stop 为 false 时不理会取消（撤回临时名必须做完）
+    QVector<bool> RenameAll(const QStringList & from, const QStringList & to,
+                            const QVector<bool> & mask, bool can_stop);
+
+    Kind _kind;
+    QVector<Op> _ops;
+    std::atomic<int> _done;
+    std::atomic<bool> _bstop;
+signals:
+    void SigTotalCount(int);
+    void SigUpdateProgress(int);
+    void SigFinishProgress(int failed);
+
+public slots:
+    void SlotCancelProgress();
+};
+
+#endif // BATCHFILETHREAD_H
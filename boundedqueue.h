@@ -0,0 +1,88 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <deque>
+
+/*
+ * 流水线各阶段之间的有界阻塞队列。
+ * 队列满时生产者阻塞，从而限制流水线中同时存在的数据量（峰值内存）；
+ * 所有生产者调用 ProducerDone 后队列关闭，消费者取空后 Pop 返回 false；
+ * Cancel 让两端立即返回，用于取消任务。
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(int capacity, int producers = 1)
+        : _capacity(capacity > 0 ? capacity : 1), _producers(producers), _cancelled(false)
+    {
+    }
+
+    // 放入一项，队列满时阻塞；已取消返回 false
+    bool Push(const T & item)
+    {
+        QMutexLocker locker(&_mutex);
+        while(int(_items.size()) >= _capacity && !_cancelled){
+            _not_full.wait(&_mutex);
+        }
+        if(_cancelled){
+            return false;
+        }
+        _items.push_back(item);
+        _not_empty.wakeOne();
+        return true;
+    }
+
+    // 取出一项，队列空时阻塞；队列关闭且为空或已取消返回 false
+    bool Pop(T & item)
+    {
+        QMutexLocker locker(&_mutex);
+        while(_items.empty() && _producers > 0 && !_cancelled){
+            _not_empty.wait(&_mutex);
+        }
+        if(_cancelled || _items.empty()){
+            return false;
+        }
+        item = _items.front();
+        _items.pop_front();
+        _not_full.wakeOne();
+        return true;
+    }
+
+    // 一个生产者结束，最后一个生产者结束时唤醒所有消费者
+    void ProducerDone()
+    {
+        QMutexLocker locker(&_mutex);
+        if(--_producers <= 0){
+            _not_empty.wakeAll();
+        }
+    }
+
+    void Cancel()
+    {
+        QMutexLocker locker(&_mutex);
+        _cancelled = true;
+        _items.clear();
+        _not_full.wakeAll();
+        _not_empty.wakeAll();
+    }
+
+    int Size()
+    {
+        QMutexLocker locker(&_mutex);
+        return int(_items.size());
+    }
+
+private:
+    QMutex _mutex;
+    QWaitCondition _not_full;
+    QWaitCondition _not_empty;
+    std::deque<T> _items;
+    int _capacity;
+    int _producers;
+    bool _cancelled;
+};
+
+#endif // BOUNDEDQUEUE_H
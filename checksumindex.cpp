@@ -0,0 +1,138 @@
+#include "checksumindex.h"
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+
+namespace {
+const char kHeader[] = "album-checksums 1";
+}
+
+ChecksumIndex::ChecksumIndex(const QString &pro_path)
+    :_pro_path(pro_path), _last_full_scrub(0)
+{
+
+}
+
+QString ChecksumIndex::IndexPath() const
+{
+    return QDir(_pro_path).absoluteFilePath(".album_checksums");
+}
+
+bool ChecksumIndex::Load()
+{
+    _records.clear();
+    _last_full_scrub = 0;
+
+    QFile file(IndexPath());
+    if(!file.exists()){
+        return true;
+    }
+    if(!file.open(QIODevice::ReadOnly)){
+        return false;
+    }
+
+    // 第一行：文件头 上次完整校验时间
+    QList<QByteArray> header = file.readLine().trimmed().split('\t');
+    if(header.isEmpty() || header.first() != kHeader){
+        return false;
+    }
+    if(header.size() > 1){
+        _last_full_scrub = header.at(1).toLongLong();
+    }
+
+    // 每行：大小 修改时间 摘要 校验时间 是否损坏 相对路径；路径放最后，可以包含制表符
+    while(!file.atEnd()){
+        QByteArray line = file.readLine();
+        if(line.endsWith('\n')){
+            line.chop(1);
+        }
+        QList<QByteArray> fields = line.split('\t');
+        if(fields.size() < 6){
+            continue;
+        }
+        Record record;
+        record.size = fields.at(0).toLongLong();
+        record.mtime = fields.at(1).toLongLong();
+        record.hash = fields.at(2);
+        record.verified = fields.at(3).toLongLong();
+        record.bad = fields.at(4) == "1";
+        QString rel_path = QString::fromUtf8(fields.mid(5).join('\t'));
+        _records.insert(rel_path, record);
+    }
+    return true;
+}
+
+bool ChecksumIndex::Save() const
+{
+    QSaveFile file(IndexPath());
+    if(!file.open(QIODevice::WriteOnly)){
+        return false;
+    }
+    QByteArray data(kHeader);
+    data += '\t' + QByteArray::number(_last_full_scrub) + '\n';
+    for(auto iter = _records.constBegin(); iter != _records.constEnd(); ++iter){
+        // 文件名里的换行会破坏一行一条的格式，这类文件不记录
+        if(iter.key().contains('\n')){
+            continue;
+        }
+        const Record & record = iter.value();
+        data += QByteArray::number(record.size) + '\t' + QByteArray::number(record.mtime) + '\t'
+                + record.hash + '\t' + QByteArray::number(record.verified) + '\t'
+                + (record.bad ? "1" : "0") + '\t' + iter.key().toUtf8() + '\n';
+    }
+    if(file.write(data) != data.size()){
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+QHash<QString, ChecksumIndex::Record> &ChecksumIndex::Records()
+{
+    return _records;
+}
+
+const QHash<QString, ChecksumIndex::Record> &ChecksumIndex::Records() const
+{
+    return _records;
+}
+
+qint64 ChecksumIndex::LastFullScrub() const
+{
+    return _last_full_scrub;
+}
+
+void ChecksumIndex::SetLastFullScrub(qint64 time)
+{
+    _last_full_scrub = time;
+}
+
+qint64 ChecksumIndex::ReadLastFullScrub(const QString &pro_path)
+{
+    QFile file(ChecksumIndex(pro_path).IndexPath());
+    if(!file.open(QIODevice::ReadOnly)){
+        return 0;
+    }
+    QList<QByteArray> header = file.readLine().trimmed().split('\t');
+    if(header.size() < 2 || header.first() != kHeader){
+        return 0;
+    }
+    return header.at(1).toLongLong();
+}
+
+QStringList ChecksumIndex::BadFiles() const
+{
+    QStringList files;
+    QDir dir(_pro_path);
+    for(auto iter = _records.constBegin(); iter != _records.constEnd(); ++iter){
+        if(iter.value().bad){
+            files.append(dir.absoluteFilePath(iter.key()));
+        }
+    }
+    return files;
+}
+
+const QString &ChecksumIndex::GetProPath() const
+{
+    return _pro_path;
+}
@@ -0,0 +1,50 @@
+#ifndef CHECKSUMINDEX_H
+#define CHECKSUMINDEX_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+/*
+ * 项目文件的校验和索引，保存在项目根目录的隐藏文件里。
+ * 每个文件记录大小、修改时间、内容摘要、上次校验时间和是否校验失败。
+ * 大小和修改时间没变而摘要变了，说明文件在磁盘上静默损坏；
+ * 修改时间变了则视为正常修改，重新记录摘要。
+ */
+class ChecksumIndex
+{
+public:
+    struct Record {
+        qint64 size;
+        qint64 mtime;
+        QByteArray hash;        // 十六进制摘要
+        qint64 verified;        // 上次校验时间（毫秒），0 表示从未校验
+        bool bad;               // 上次校验发现损坏
+    };
+
+    explicit ChecksumIndex(const QString & pro_path);
+
+    bool Load();
+    bool Save() const;
+
+    QHash<QString, Record> & Records();
+    const QHash<QString, Record> & Records() const;
+    // 上次完整校验结束的时间（毫秒）
+    qint64 LastFullScrub() const;
+    void SetLastFullScrub(qint64 time);
+    // 只读文件头取上次完整校验时间，用于判断是否该安排校验；没有索引返回 0
+    static qint64 ReadLastFullScrub(const QString & pro_path);
+    // 校验失败的文件的绝对路径
+    QStringList BadFiles() const;
+    const QString & GetProPath() const;
+
+private:
+    QString IndexPath() const;
+
+    QString _pro_path;
+    QHash<QString, Record> _records;    // 键为项目内相对路径
+    qint64 _last_full_scrub;
+};
+
+#endif // CHECKSUMINDEX_H
@@ -0,0 +1,155 @@
+#include "contactsheetthread.h"
+#include "decodepool.h"
+#include "thumbcache.h"
+#include "tiffwriter.h"
+#include <QFileInfo>
+#include <QFontMetrics>
+#include <QPainter>
+#include <QSettings>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <cmath>
+#include <cstring>
+
+ContactSheetThread::ContactSheetThread(const QStringList &pics, const QString &out_path, QObject *parent)
+    :QThread(parent), _pics(pics), _out_path(out_path), _bstop(false)
+{
+    QSettings settings;
+    _width = qBound(256, settings.value("contact/width", 20000).toInt(), 60000);
+    _dpi = qBound(72, settings.value("contact/dpi", 300).toInt(), 2400);
+    // 列数为 0 时自动选择，让整张画布接近 3:2 横幅
+    _columns = settings.value("contact/columns", 0).toInt();
+    if(_columns <= 0){
+        _columns = qMax(1, int(std::lround(std::sqrt(_pics.size() * 1.5))));
+    }
+    _columns = qBound(1, _columns, _width / 32);
+
+    // 格子：边距 + 正方形图片区 + 文件名
+    int cell_w = _width / _columns;
+    int pad = qMax(2, cell_w / 20);
+    int caption = qMax(12, cell_w / 10);
+    _cell = QSize(cell_w, cell_w - 2 * pad + caption + 2 * pad);
+}
+
+ContactSheetThread::~ContactSheetThread()
+{
+
+}
+
+void ContactSheetThread::run()
+{
+    const int count = _pics.size();
+    const int rows = (count + _columns - 1) / _columns;
+    emit SigTotalCount(rows);
+    if(count == 0){
+        emit SigFinishProgress(0);
+        return;
+    }
+
+    const int canvas_w = _cell.width() * _columns;
+    TiffWriter writer;
+    if(!writer.Open(_out_path, canvas_w, rows * _cell.height(), _cell.height(), _dpi)){
+        emit SigFinishProgress(0);
+        return;
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(2, QThread::idealThreadCount()));
+    QFuture<QByteArray> pending;    // 上一个条带的压缩任务
+    bool has_pending = false;
+    bool ok = true;
+
+    for(int row = 0; row < rows && ok; ++row){
+        if(_bstop){
+            ok = false;
+            break;
+        }
+
+        // 一个条带就是一行格子；各格子并行渲染后拷贝进条带中互不重叠的区域
+        QImage strip(canvas_w, _cell.height(), QImage::Format_RGB32);
+        strip.fill(Qt::white);
+        uchar * bits = strip.bits();
+        const int bpl = strip.bytesPerLine();
+        QList<QFuture<void>> cells;
+        for(int col = 0; col < _columns; ++col){
+            int index = row * _columns + col;
+            if(index >= count){
+                break;
+            }
+            cells << QtConcurrent::run(&pool, [this, index, col, bits, bpl](){
+                if(_bstop){
+                    return;
+                }
+                QImage cell = RenderCell(index);
+                for(int y = 0; y < cell.height(); ++y){
+                    std::memcpy(bits + y * bpl + col * _cell.width() * 4, cell.constScanLine(y), cell.width() * 4);
+                }
+            });
+        }
+        for(QFuture<void> & cell : cells){
+            cell.waitForFinished();
+        }
+
+        // 当前条带开始压缩前，写出上一个条带
+        if(has_pending){
+            ok = writer.WriteStrip(pending.result());
+            emit SigUpdateProgress(row);
+        }
+        pending = QtConcurrent::run(&pool, [strip](){
+            return TiffWriter::CompressStrip(strip);
+        });
+        has_pending = true;
+    }
+
+    if(has_pending){
+        QByteArray last = pending.result();
+        ok = ok && !_bstop && writer.WriteStrip(last);
+    }
+    if(!ok){
+        writer.Abort();
+        if(!_bstop){
+            emit SigFinishProgress(0);
+        }
+        return;
+    }
+    ok = writer.Close();
+    emit SigFinishProgress(ok ? rows : 0);
+}
+
+// 渲染一个格子：优先用缓存中同尺寸的缩略图，否则交给解码子进程按格子大小缩小解码
+QImage ContactSheetThread::RenderCell(int index) const
+{
+    const QString & path = _pics.at(index);
+    const int pad = qMax(2, _cell.width() / 20);
+    const int box = _cell.width() - 2 * pad;
+
+    QImage thumb = ThumbCache::Find(path, box);
+    if(thumb.isNull()){
+        thumb = DecodePool::Decode(path, box);
+    }
+
+    QImage cell(_cell, QImage::Format_RGB32);
+    cell.fill(Qt::white);
+    QPainter painter(&cell);
+    if(!thumb.isNull()){
+        painter.drawImage(pad + (box - thumb.width()) / 2, pad + (box - thumb.height()) / 2, thumb);
+    } else {
+        painter.fillRect(pad, pad, box, box, QColor(220, 220, 220));
+    }
+
+    // 文件名居中显示在图片下方，过长时省略中间部分
+    const int caption_top = pad + box;
+    const int caption_h = _cell.height() - caption_top - pad;
+    QFont font = painter.font();
+    font.setPixelSize(qMax(8, caption_h * 3 / 5));
+    painter.setFont(font);
+    painter.setPen(Qt::black);
+    QString name = QFontMetrics(font).elidedText(QFileInfo(path).fileName(), Qt::ElideMiddle, box);
+    painter.drawText(QRect(pad, caption_top, box, caption_h), Qt::AlignCenter, name);
+    return cell;
+}
+
+void ContactSheetThread::SlotCancelProgress()
+{
+    _bstop = true;
+}
@@ -0,0 +1,47 @@
+#ifndef CONTACTSHEETTHREAD_H
+#define CONTACTSHEETTHREAD_H
+
+#include <QImage>
+#include <QSize>
+#include <QStringList>
+#include <QThread>
+#include <atomic>
+
+/*
+ * 生成目录的联系表（小样），用于打印校样。
+ * 按设置的画布宽度和列数排版，每个格子是缩略图加文件名；
+ * 画布按格子行分成条带，一个条带内的格子并行取缩略图（先查缓存，否则按格子大小解码），
+ * 拼好的条带交给后台压缩，同时开始下一个条带，按顺序写入 TIFF。
+ * 内存中最多同时存在两个条带，与画布总大小无关。
+ */
+class ContactSheetThread : public QThread
+{
+    Q_OBJECT
+public:
+    ContactSheetThread(const QStringList & pics, const QString & out_path, QObject * parent = nullptr);
+    ~ContactSheetThread();
+
+protected:
+    virtual void run();
+
+private:
+    QImage RenderCell(int index) const;
+
+    QStringList _pics;
+    QString _out_path;
+    int _width;         // 画布宽度
+    int _columns;
+    int _dpi;
+    QSize _cell;        // 格子大小，含边距和文件名
+    std::atomic<bool> _bstop;
+
+signals:
+    void SigTotalCount(int);
+    void SigUpdateProgress(int);
+    void SigFinishProgress(int);
+
+public slots:
+    void SlotCancelProgress();
+};
+
+#endif // CONTACTSHEETTHREAD_H
@@ -0,0 +1,80 @@
+#include "cpufeatures.h"
+#include <QByteArray>
+#include <QtGlobal>
+
+#if defined(ALBUM_X86_SIMD) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+CpuFeatures::Isa CpuFeatures::BestIsa()
+{
+    // 局部静态变量保证只检测一次且线程安全
+    static const Isa isa = DetectIsa();
+    return isa;
+}
+
+bool CpuFeatures::HasSse41()
+{
+    return BestIsa() >= IsaSse41;
+}
+
+bool CpuFeatures::HasAvx2()
+{
+    return BestIsa() >= IsaAvx2;
+}
+
+const char *CpuFeatures::IsaName(Isa isa)
+{
+    switch(isa){
+    case IsaAvx2:
+        return "AVX2";
+    case IsaSse41:
+        return "SSE4.1";
+    default:
+        return "Scalar";
+    }
+}
+
+CpuFeatures::Isa CpuFeatures::DetectIsa()
+{
+    Isa isa = IsaScalar;
+#if defined(ALBUM_X86_SIMD)
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("sse4.1")){
+        isa = IsaSse41;
+    }
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")){
+        isa = IsaAvx2;
+    }
+#elif defined(_MSC_VER)
+    int info[4] = {0};
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+    __cpuid(info, 1);
+    bool sse41 = (info[2] & (1 << 19)) != 0;
+    bool fma = (info[2] & (1 << 12)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    if(sse41){
+        isa = IsaSse41;
+    }
+    // 还需确认操作系统保存了 YMM 寄存器状态
+    if(max_leaf >= 7 && fma && osxsave && (_xgetbv(0) & 0x6) == 0x6){
+        __cpuidex(info, 7, 0);
+        if(info[1] & (1 << 5)){
+            isa = IsaAvx2;
+        }
+    }
+#endif
+#endif
+
+    // 便于对比测试：允许通过环境变量把指令集降级
+    QByteArray force = qgetenv("ALBUM_FORCE_ISA").toLower();
+    if(force == "scalar"){
+        isa = IsaScalar;
+    } else if(force == "sse41" && isa > IsaSse41){
+        isa = IsaSse41;
+    }
+    return isa;
+}
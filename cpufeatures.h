@@ -0,0 +1,39 @@
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+// x86 平台上才编译 SSE/AVX 内核，其他平台只走标量实现
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ALBUM_X86_SIMD 1
+#endif
+
+// GCC/Clang 通过 target 属性为单个函数打开指令集，不需要全局编译选项；
+// MSVC 的 intrinsics 本身不依赖编译选项，宏展开为空即可
+#if defined(__GNUC__) || defined(__clang__)
+#define ALBUM_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define ALBUM_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define ALBUM_TARGET_SSE41
+#define ALBUM_TARGET_AVX2
+#endif
+
+// 运行时 CPU 指令集检测，结果只检测一次并缓存
+class CpuFeatures
+{
+public:
+    enum Isa {
+        IsaScalar = 0,
+        IsaSse41 = 1,
+        IsaAvx2 = 2,
+    };
+
+    // 当前机器可用的最高指令集（可用环境变量 ALBUM_FORCE_ISA=scalar/sse41/avx2 限制）
+    static Isa BestIsa();
+    static bool HasSse41();
+    static bool HasAvx2();
+    static const char * IsaName(Isa isa);
+
+private:
+    static Isa DetectIsa();
+};
+
+#endif // CPUFEATURES_H
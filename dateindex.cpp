@@ -0,0 +1,300 @@
+#include "dateindex.h"
+#include "dirscanner.h"
+#include "previewextractor.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QVector>
+#include <algorithm>
+#include <limits>
+
+namespace {
+const char kHeader[] = "album-dates 1";
+// 还没读取拍摄时间
+const qint64 kUnknown = std::numeric_limits<qint64>::min();
+}
+
+DateIndex::DateIndex(const QString &pro_path)
+    :_pro_path(pro_path)
+{
+
+}
+
+QString DateIndex::IndexPath() const
+{
+    return QDir(_pro_path).absoluteFilePath(".album_dates");
+}
+
+bool DateIndex::Exists() const
+{
+    return QFile::exists(IndexPath());
+}
+
+bool DateIndex::Load()
+{
+    _records.clear();
+    _days.clear();
+
+    QFile file(IndexPath());
+    if(!file.exists()){
+        return true;
+    }
+    if(!file.open(QIODevice::ReadOnly)){
+        return false;
+    }
+    if(file.readLine().trimmed() != kHeader){
+        return false;
+    }
+
+    // 每行：大小 修改时间 拍摄时间 相对路径；已按拍摄时间排好序，顺序追加到各天即可
+    int last_key = -1;
+    QStringList * day = nullptr;
+    while(!file.atEnd()){
+        QByteArray line = file.readLine();
+        if(line.endsWith('\n')){
+            line.chop(1);
+        }
+        QList<QByteArray> fields = line.split('\t');
+        if(fields.size() < 4){
+            continue;
+        }
+        Record record;
+        record.size = fields.at(0).toLongLong();
+        record.mtime = fields.at(1).toLongLong();
+        record.taken = fields.at(2).toLongLong();
+        QString rel_path = QString::fromUtf8(fields.mid(3).join('\t'));
+        _records.insert(rel_path, record);
+
+        int key = DayKey(record.taken);
+        if(key != last_key || !day){
+            day = &_days[key];
+            last_key = key;
+        }
+        day->append(rel_path);
+    }
+    return true;
+}
+
+bool DateIndex::Save() const
+{
+    QSaveFile file(IndexPath());
+    if(!file.open(QIODevice::WriteOnly)){
+        return false;
+    }
+    QByteArray data(kHeader);
+    data += '\n';
+    for(const QStringList & day : _days){
+        for(const QString & rel_path : day){
+            // 文件名里的换行会破坏一行一条的格式，这类文件不记录
+            if(rel_path.contains('\n')){
+                continue;
+            }
+            const Record & record = _records[rel_path];
+            data += QByteArray::number(record.size) + '\t' + QByteArray::number(record.mtime) + '\t'
+                    + QByteArray::number(record.taken) + '\t' + rel_path.toUtf8() + '\n';
+        }
+    }
+    if(file.write(data) != data.size()){
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+bool DateIndex::Update(const std::function<bool()> &keep_going)
+{
+    // 目录没有走完就无法判断哪些文件被删除了，放弃这次更新
+    QHash<QString, Record> present;
+    present.reserve(_records.size());
+    if(!Collect(_pro_path, present, keep_going)){
+        return false;
+    }
+
+    // 第一遍：大小和修改时间都没变的文件沿用原来的拍摄时间，不读文件，也不受取消影响
+    QStringList pending;
+    for(auto iter = present.begin(); iter != present.end(); ++iter){
+        auto old = _records.constFind(iter.key());
+        if(old != _records.constEnd() && old->size == iter->size && old->mtime == iter->mtime){
+            iter->taken = old->taken;
+        } else {
+            pending.append(iter.key());
+        }
+    }
+
+    // 第二遍：只为新增和改动的文件读 EXIF，这一步可以中途停止
+    QDir root(_pro_path);
+    bool changed = false;
+    int done = 0;
+    for(; done < pending.size() && keep_going(); ++done){
+        Record & record = present[pending.at(done)];
+        qint64 taken = PreviewExtractor::CaptureTime(root.absoluteFilePath(pending.at(done)));
+        record.taken = taken >= 0 ? taken : record.mtime;
+        changed = true;
+    }
+    // 中途停止时已经读到的结果照样保存；没读到的改动文件保留原来的记录，新文件留到下次
+    for(int i = done; i < pending.size(); ++i){
+        auto old = _records.constFind(pending.at(i));
+        if(old != _records.constEnd()){
+            present[pending.at(i)] = old.value();
+        } else {
+            present.remove(pending.at(i));
+        }
+    }
+
+    // 没有读过的文件都在原索引中，数量不同说明有文件被删除
+    changed = changed || present.size() != _records.size();
+    if(!changed){
+        return false;
+    }
+    _records = present;
+    Aggregate();
+    return true;
+}
+
+bool DateIndex::Collect(const QString &dir_path, QHash<QString, Record> &present,
+                        const std::function<bool()> &keep_going) const
+{
+    if(!keep_going()){
+        return false;
+    }
+    QVector<DirEntry> list;
+    DirScanner::List(dir_path, list, true);
+    QDir root(_pro_path);
+    for(const DirEntry & entry : list){
+        if(entry.is_dir){
+            if(!Collect(entry.path, present, keep_going)){
+                return false;
+            }
+        } else if(DirScanner::IsPicFile(entry.name)){
+            present.insert(root.relativeFilePath(entry.path), {entry.size, entry.mtime, kUnknown});
+        }
+    }
+    return true;
+}
+
+void DateIndex::Aggregate()
+{
+    QVector<QPair<qint64, QString>> order;
+    order.reserve(_records.size());
+    for(auto iter = _records.constBegin(); iter != _records.constEnd(); ++iter){
+        order.append({iter->taken, iter.key()});
+    }
+    // 同一时刻连拍的照片按文件名排
+    std::sort(order.begin(), order.end());
+
+    _days.clear();
+    int last_key = -1;
+    QStringList * day = nullptr;
+    for(const auto & pair : order){
+        int key = DayKey(pair.first);
+        if(key != last_key || !day){
+            day = &_days[key];
+            last_key = key;
+        }
+        day->append(pair.second);
+    }
+}
+
+const DateIndex::DayMap &DateIndex::Days() const
+{
+    return _days;
+}
+
+int DateIndex::Count() const
+{
+    return _records.size();
+}
+
+const QString &DateIndex::GetProPath() const
+{
+    return _pro_path;
+}
+
+QMutex &DateIndex::FileMutex()
+{
+    static QMutex mutex;
+    return mutex;
+}
+
+void DateIndex::Patch(const QString &pro_path, const QStringList &added, const QStringList &removed,
+                      const QHash<QString, QString> &moved)
+{
+    QMutexLocker locker(&FileMutex());
+    DateIndex index(pro_path);
+    // 没有索引的项目等第一次打开时间线时完整建立
+    if(!index.Exists() || !index.Load()){
+        return;
+    }
+    QDir root(pro_path);
+    // 相对路径就是 rel 本身，或者在 rel 目录下
+    auto covers = [](const QString & key, const QString & rel){
+        return key == rel || key.startsWith(rel + "/");
+    };
+
+    bool changed = false;
+    for(const QString & path : removed){
+        const QString rel = root.relativeFilePath(path);
+        for(auto iter = index._records.begin(); iter != index._records.end();){
+            if(covers(iter.key(), rel)){
+                iter = index._records.erase(iter);
+                changed = true;
+            } else {
+                ++iter;
+            }
+        }
+    }
+
+    // 重命名和移动不改变文件内容，记录换个键就行
+    for(auto move = moved.constBegin(); move != moved.constEnd(); ++move){
+        const QString from = root.relativeFilePath(move.key());
+        const QString to = root.relativeFilePath(move.value());
+        QHash<QString, Record> moving;
+        for(auto iter = index._records.begin(); iter != index._records.end();){
+            if(covers(iter.key(), from)){
+                moving.insert(to + iter.key().mid(from.size()), iter.value());
+                iter = index._records.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+        for(auto iter = moving.constBegin(); iter != moving.constEnd(); ++iter){
+            index._records.insert(iter.key(), iter.value());
+            changed = true;
+        }
+    }
+
+    // 新增的文件读拍摄时间；大小和修改时间都没变的已有记录不再读
+    QHash<QString, Record> present;
+    for(const QString & path : added){
+        QFileInfo info(path);
+        if(info.isDir()){
+            index.Collect(path, present, [](){ return true; });
+        } else if(info.isFile() && DirScanner::IsPicFile(info.fileName())){
+            present.insert(root.relativeFilePath(path),
+                           {info.size(), info.lastModified().toMSecsSinceEpoch(), kUnknown});
+        }
+    }
+    for(auto iter = present.begin(); iter != present.end(); ++iter){
+        auto old = index._records.constFind(iter.key());
+        if(old != index._records.constEnd() && old->size == iter->size && old->mtime == iter->mtime){
+            continue;
+        }
+        qint64 taken = PreviewExtractor::CaptureTime(root.absoluteFilePath(iter.key()));
+        iter->taken = taken >= 0 ? taken : iter->mtime;
+        index._records.insert(iter.key(), iter.value());
+        changed = true;
+    }
+
+    if(changed){
+        index.Aggregate();
+        index.Save();
+    }
+}
+
+int DateIndex::DayKey(qint64 taken)
+{
+    QDate date = QDateTime::fromMSecsSinceEpoch(taken).date();
+    return date.year() * 10000 + date.month() * 100 + date.day();
+}
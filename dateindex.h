@@ -0,0 +1,62 @@
+#ifndef DATEINDEX_H
+#define DATEINDEX_H
+
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <functional>
+
+/*
+ * 项目图片的日期索引，保存在项目根目录的隐藏文件里，供时间线浏览使用。
+ * 每个文件记录大小、修改时间和拍摄时间（EXIF DateTimeOriginal，没有则取修改时间）。
+ * 文件按拍摄时间顺序写出，载入时直接按顺序归入年/月/日，打开时间线不需要扫描或排序。
+ * 导入、同步和批量文件操作结束时由各自调用 Patch 就地更新，只为涉及的文件读取拍摄时间；
+ * 对照磁盘的完整核对（Update）只在项目还没有索引或者用户在时间线里点刷新时进行。
+ */
+class DateIndex
+{
+public:
+    struct Record {
+        qint64 size;
+        qint64 mtime;
+        qint64 taken;       // 拍摄时间（自 1970 年起的毫秒数）
+    };
+    // 键为 yyyymmdd，值为当天图片的相对路径，按拍摄时间排序
+    typedef QMap<int, QStringList> DayMap;
+
+    explicit DateIndex(const QString & pro_path);
+
+    // 索引文件是否已经建立过
+    bool Exists() const;
+    bool Load();
+    bool Save() const;
+    // 对照磁盘更新索引，keep_going 返回 false 时尽快停止；返回索引是否有变化
+    bool Update(const std::function<bool()> & keep_going);
+
+    const DayMap & Days() const;
+    int Count() const;
+    const QString & GetProPath() const;
+    static int DayKey(qint64 taken);
+
+    // 文件变动后就地更新已保存的索引，不扫描整个项目。路径都是绝对路径，目录表示其下全部图片；
+    // moved 的键为原路径、值为新路径，沿用原来的拍摄时间。项目还没有索引时什么都不做
+    static void Patch(const QString & pro_path, const QStringList & added, const QStringList & removed,
+                      const QHash<QString, QString> & moved = QHash<QString, QString>());
+    // 读写索引文件时持有，Patch 的读-改-写不会和时间线的保存交错
+    static QMutex & FileMutex();
+
+private:
+    QString IndexPath() const;
+    bool Collect(const QString & dir_path, QHash<QString, Record> & present,
+                 const std::function<bool()> & keep_going) const;
+    // 按拍摄时间重新归入各天，只在索引变化后调用
+    void Aggregate();
+
+    QString _pro_path;
+    QHash<QString, Record> _records;    // 键为项目内相对路径
+    DayMap _days;
+};
+
+#endif // DATEINDEX_H
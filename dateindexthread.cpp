@@ -0,0 +1,42 @@
+#include "dateindexthread.h"
+
+DateIndexThread::DateIndexThread(const QString &pro_path, bool refresh, QObject *parent)
+    :BackgroundTask(parent), _pro_path(pro_path), _refresh(refresh)
+{
+    qRegisterMetaType<DateIndex::DayMap>("DateIndex::DayMap");
+}
+
+void DateIndexThread::Work()
+{
+    DateIndex index(_pro_path);
+    bool exists = false;
+    {
+        QMutexLocker locker(&DateIndex::FileMutex());
+        exists = index.Exists();
+        index.Load();
+    }
+    // 已有的索引由导入、同步和文件操作就地维护，打开时间线不再扫描目录
+    if(exists && !_refresh){
+        emit SigIndexReady(index.Days(), index.Count(), true);
+        return;
+    }
+    emit SigIndexReady(index.Days(), index.Count(), false);
+
+    bool changed = index.Update([this](){
+        return Yield();
+    });
+    // 刷新中途取消时也保存已经读到的拍摄时间；第一次建立没有走完不保存，
+    // 否则残缺的索引会被当成完整的，下次打开不再扫描
+    if((changed && exists) || (!exists && !_bstop)){
+        QMutexLocker locker(&DateIndex::FileMutex());
+        index.Save();
+    }
+    if(_bstop){
+        return;
+    }
+    if(changed){
+        emit SigIndexReady(index.Days(), index.Count(), true);
+    } else {
+        emit SigUpToDate();
+    }
+}
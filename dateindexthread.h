@@ -0,0 +1,31 @@
+#ifndef DATEINDEXTHREAD_H
+#define DATEINDEXTHREAD_H
+
+#include "backgroundtask.h"
+#include "dateindex.h"
+
+/*
+ * 时间线的日期索引线程。
+ * 载入已保存的索引立即交给界面显示；索引由文件操作就地维护，通常到此为止。
+ * 项目还没有索引、或者用户要求刷新时，再在空闲时对照磁盘增量更新，
+ * 有变化时保存索引并把新的聚合结果再交一次。
+ */
+class DateIndexThread : public BackgroundTask
+{
+    Q_OBJECT
+public:
+    // refresh 为 true 时即使已有索引也对照磁盘核对一遍
+    DateIndexThread(const QString & pro_path, bool refresh, QObject * parent = nullptr);
+protected:
+    void Work() override;
+private:
+    QString _pro_path;
+    bool _refresh;
+signals:
+    // final 为 false 是载入的旧索引，为 true 是更新后的结果
+    void SigIndexReady(const DateIndex::DayMap & days, int count, bool final);
+    // 磁盘上没有变化，载入的索引就是最新的
+    void SigUpToDate();
+};
+
+#endif // DATEINDEXTHREAD_H
@@ -0,0 +1,463 @@
+#include "decodepool.h"
+#include "imagescaler.h"
+#include "metrics.h"
+#include "packfile.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QSettings>
+#include <QThread>
+#include <QThreadPool>
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char ** environ;
+#endif
+
+namespace {
+// 子进程启动后报告就绪的时限
+const int SPAWN_TIMEOUT_MS = 5000;
+
+#ifdef Q_OS_LINUX
+bool WriteAll(int fd, const QByteArray & data)
+{
+    qint64 done = 0;
+    while(done < data.size()){
+        ssize_t n = ::write(fd, data.constData() + done, size_t(data.size() - done));
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+        if(n <= 0){
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+// 读一行（不含换行）；timeout_ms 为负时一直等。返回 1 读到，0 对端已关闭，-1 超时
+int ReadLine(int fd, QByteArray & pending, int timeout_ms, QByteArray & line)
+{
+    QElapsedTimer timer;
+    timer.start();
+    char buf[512];
+    while(true){
+        int pos = pending.indexOf('\n');
+        if(pos >= 0){
+            line = pending.left(pos);
+            pending.remove(0, pos + 1);
+            return 1;
+        }
+        if(timeout_ms >= 0){
+            qint64 remaining = timeout_ms - timer.elapsed();
+            if(remaining <= 0){
+                return -1;
+            }
+            pollfd pfd = {fd, POLLIN, 0};
+            int ready = ::poll(&pfd, 1, int(remaining));
+            if(ready < 0 && errno != EINTR){
+                return 0;
+            }
+            if(ready <= 0){
+                continue;
+            }
+        }
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+        if(n <= 0){
+            return 0;
+        }
+        pending.append(buf, int(n));
+    }
+}
+
+struct Mapping {
+    void * addr;
+    size_t len;
+};
+
+void Unmap(void * info)
+{
+    auto * mapping = static_cast<Mapping*>(info);
+    ::munmap(mapping->addr, mapping->len);
+    delete mapping;
+}
+
+// 子进程：把结果写进一块新的 memfd 并封印，返回 fd
+int ToMemfd(const QImage & image)
+{
+    size_t len = size_t(image.sizeInBytes());
+    int fd = ::memfd_create("album-frame", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if(fd < 0){
+        return -1;
+    }
+    void * addr = MAP_FAILED;
+    if(::ftruncate(fd, off_t(len)) == 0){
+        addr = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if(addr == MAP_FAILED){
+        ::close(fd);
+        return -1;
+    }
+    memcpy(addr, image.constBits(), len);
+    ::munmap(addr, len);
+    // 封印后大小和内容都不能再改，应用端的映射不会因为截断而 SIGBUS
+    ::fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+    return fd;
+}
+
+// 应用端：通过 /proc 打开子进程的 memfd 只读映射，图片直接引用这块内存，释放时解除映射
+QImage MapFrame(qint64 pid, int fd, int width, int height, int bytes_per_line, QImage::Format format)
+{
+    if(width <= 0 || height <= 0 || bytes_per_line <= 0 || format <= QImage::Format_Invalid
+            || format >= QImage::NImageFormats){
+        return QImage();
+    }
+    QByteArray proc_path = "/proc/" + QByteArray::number(pid) + "/fd/" + QByteArray::number(fd);
+    int local = ::open(proc_path.constData(), O_RDONLY | O_CLOEXEC);
+    if(local < 0){
+        return QImage();
+    }
+    size_t len = size_t(bytes_per_line) * size_t(height);
+    void * addr = ::mmap(nullptr, len, PROT_READ, MAP_SHARED, local, 0);
+    ::close(local);
+    if(addr == MAP_FAILED){
+        return QImage();
+    }
+    return QImage(static_cast<const uchar*>(addr), width, height, bytes_per_line, format,
+                  Unmap, new Mapping{addr, len});
+}
+#endif
+}
+
+DecodePool::DecodePool()
+    :_limit(0), _timeout_ms(10000)
+{
+    // 先构造指标注册表，保证它比这里的静态实例晚析构，析构时回收子进程还要更新指标
+    Metrics::GetGauge("decode.workers");
+    QSettings settings;
+#ifdef Q_OS_LINUX
+    _limit = qBound(0, settings.value("decode/workers", qMin(QThread::idealThreadCount(), 8)).toInt(), 32);
+    // 子进程退出后再写请求不能让应用收到 SIGPIPE
+    ::signal(SIGPIPE, SIG_IGN);
+#endif
+    _timeout_ms = qMax(1000, settings.value("decode/timeout_ms", 10000).toInt());
+    const QStringList keys = settings.value("decode/quarantine").toStringList();
+    _quarantine = QSet<QString>(keys.begin(), keys.end());
+}
+
+DecodePool::~DecodePool()
+{
+    for(Worker * worker : _all){
+        Kill(*worker);
+        delete worker;
+    }
+}
+
+DecodePool &DecodePool::Instance()
+{
+    static DecodePool pool;
+    return pool;
+}
+
+QImage DecodePool::Decode(const QString &path, int max_side)
+{
+    if(IsQuarantined(path)){
+        return QImage();
+    }
+#ifdef Q_OS_LINUX
+    // 文件名里的换行会破坏一行一个请求的格式，这类文件在进程内解码
+    DecodePool & pool = Instance();
+    if(!path.contains('\n')){
+        Worker * worker = pool.Acquire();
+        if(worker){
+            QImage image;
+            Result result = pool.Run(*worker, path, max_side, image);
+            pool.Release(worker);
+            if(result == Done){
+                return image;
+            }
+            pool.Disable();
+        }
+    }
+#endif
+    return DecodeLocal(path, max_side);
+}
+
+// 和 ThumbCache 相同：先让解码器按比例缩小解码，再高质量缩放到目标尺寸
+QImage DecodePool::DecodeLocal(const QString &path, int max_side)
+{
+    QImage image = PackFile::ReadImage(path, max_side > 0 ? max_side * 2 : 0);
+    if(image.isNull() || max_side <= 0 || (image.width() <= max_side && image.height() <= max_side)){
+        return image;
+    }
+    return ImageScaler::Scale(image, QSize(max_side, max_side), Qt::KeepAspectRatio);
+}
+
+// 隔离按路径和修改时间记录，文件被替换或修复后会重新尝试
+QString DecodePool::QuarantineKey(const QString &path)
+{
+    qint64 mtime = PackFile::ModifiedTime(path);
+    if(mtime < 0){
+        return QString();
+    }
+    return QString("%1|%2").arg(mtime).arg(QFileInfo(path).absoluteFilePath());
+}
+
+bool DecodePool::IsQuarantined(const QString &path)
+{
+    QString key = QuarantineKey(path);
+    if(key.isEmpty()){
+        return false;
+    }
+    DecodePool & pool = Instance();
+    QMutexLocker locker(&pool._mutex);
+    return pool._quarantine.contains(key);
+}
+
+void DecodePool::Quarantine(const QString &path)
+{
+    static Metrics::Counter & quarantined = Metrics::GetCounter("decode.quarantined");
+    QString key = QuarantineKey(path);
+    if(key.isEmpty()){
+        return;
+    }
+    quarantined.Add();
+    QMutexLocker locker(&_mutex);
+    _quarantine.insert(key);
+    QSettings settings;
+    settings.setValue("decode/quarantine", QStringList(_quarantine.begin(), _quarantine.end()));
+}
+
+// 取一个空闲的子进程；都在忙且已到上限时等待。新建的 Worker 由 Run 在锁外启动
+DecodePool::Worker *DecodePool::Acquire()
+{
+    QMutexLocker locker(&_mutex);
+    while(_limit > 0 && _idle.isEmpty() && _all.size() >= _limit){
+        _idle_cond.wait(&_mutex);
+    }
+    if(_limit == 0){
+        return nullptr;
+    }
+    if(!_idle.isEmpty()){
+        return _idle.takeLast();
+    }
+    auto * worker = new Worker();
+    _all.append(worker);
+    return worker;
+}
+
+void DecodePool::Release(Worker *worker)
+{
+    QMutexLocker locker(&_mutex);
+    _idle.append(worker);
+    _idle_cond.wakeOne();
+}
+
+// 子进程无法启动或结果无法映射，之后全部进程内解码
+void DecodePool::Disable()
+{
+    QMutexLocker locker(&_mutex);
+    if(_limit > 0){
+        qDebug() << "decode workers unavailable, decoding in process";
+    }
+    _limit = 0;
+    _idle_cond.wakeAll();
+}
+
+bool DecodePool::Spawn(Worker &worker)
+{
+#ifdef Q_OS_LINUX
+    static Metrics::Gauge & workers = Metrics::GetGauge("decode.workers");
+    int to_child[2], from_child[2];
+    if(::pipe2(to_child, O_CLOEXEC) != 0){
+        return false;
+    }
+    if(::pipe2(from_child, O_CLOEXEC) != 0){
+        ::close(to_child[0]);
+        ::close(to_child[1]);
+        return false;
+    }
+
+    // 管道带 O_CLOEXEC，别的线程同时启动子进程也不会把它们漏过去；dup2 到 0/1 后标志自动清除
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, to_child[0], 0);
+    posix_spawn_file_actions_adddup2(&actions, from_child[1], 1);
+    QByteArray program = QCoreApplication::applicationFilePath().toLocal8Bit();
+    QByteArray flag("--decode-worker");
+    char * argv[] = {program.data(), flag.data(), nullptr};
+    pid_t pid = -1;
+    int rc = ::posix_spawn(&pid, program.constData(), &actions, nullptr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    ::close(to_child[0]);
+    ::close(from_child[1]);
+    if(rc != 0){
+        ::close(to_child[1]);
+        ::close(from_child[0]);
+        return false;
+    }
+    worker.pid = pid;
+    worker.in_fd = to_child[1];
+    worker.out_fd = from_child[0];
+    worker.pending.clear();
+    workers.Add(1);
+
+    // 等子进程报告就绪，确认可执行文件确实支持 --decode-worker
+    QByteArray line;
+    if(ReadLine(worker.out_fd, worker.pending, SPAWN_TIMEOUT_MS, line) <= 0 || line != "ready"){
+        Kill(worker);
+        return false;
+    }
+    return true;
+#else
+    Q_UNUSED(worker);
+    return false;
+#endif
+}
+
+void DecodePool::Kill(Worker &worker)
+{
+#ifdef Q_OS_LINUX
+    static Metrics::Gauge & workers = Metrics::GetGauge("decode.workers");
+    if(worker.pid <= 0){
+        return;
+    }
+    ::close(worker.in_fd);
+    ::close(worker.out_fd);
+    ::kill(pid_t(worker.pid), SIGKILL);
+    ::waitpid(pid_t(worker.pid), nullptr, 0);
+    worker.pid = -1;
+    worker.in_fd = worker.out_fd = -1;
+    worker.pending.clear();
+    workers.Add(-1);
+#else
+    Q_UNUSED(worker);
+#endif
+}
+
+DecodePool::Result DecodePool::Run(Worker &worker, const QString &path, int max_side, QImage &image)
+{
+#ifdef Q_OS_LINUX
+    static Metrics::Histogram & worker_time = Metrics::GetHistogram("decode.worker_us");
+    static Metrics::Counter & restarts = Metrics::GetCounter("decode.worker.restarts");
+    // fresh：处理这个请求的子进程是不是刚启动的，没有被之前的文件影响过
+    bool fresh = false;
+    if(worker.pid < 0){
+        if(!Spawn(worker)){
+            return Unavailable;
+        }
+        fresh = true;
+    }
+
+    QByteArray request = QByteArray::number(max_side) + '\t' + path.toUtf8() + '\n';
+    if(!WriteAll(worker.in_fd, request)){
+        // 子进程在空闲时退出了，和这个文件无关，重启后再发一次
+        Kill(worker);
+        if(!Spawn(worker) || !WriteAll(worker.in_fd, request)){
+            return Unavailable;
+        }
+        fresh = true;
+        restarts.Add();
+    }
+
+    Metrics::ScopedTimer timer(worker_time);
+    QByteArray line;
+    while(true){
+        int status = ReadLine(worker.out_fd, worker.pending, _timeout_ms, line);
+        if(status > 0){
+            break;
+        }
+        // 解码器崩溃或卡死：回收子进程，下次使用时重启
+        Kill(worker);
+        restarts.Add();
+        if(fresh){
+            // 新启动的子进程上同样失败，才认定是文件的问题，隔离
+            qDebug() << (status < 0 ? "decode worker timed out on" : "decode worker crashed on") << path;
+            Quarantine(path);
+            return Done;
+        }
+        // 可能是之前的文件把子进程拖坏了，换一个新的子进程再试一次
+        if(!Spawn(worker) || !WriteAll(worker.in_fd, request)){
+            return Unavailable;
+        }
+        fresh = true;
+    }
+
+    // 应答：ok fd 宽 高 每行字节数 格式，或者 err
+    QList<QByteArray> fields = line.split('\t');
+    if(fields.size() == 6 && fields.at(0) == "ok"){
+        image = MapFrame(worker.pid, fields.at(1).toInt(), fields.at(2).toInt(), fields.at(3).toInt(),
+                         fields.at(4).toInt(), QImage::Format(fields.at(5).toInt()));
+        if(image.isNull()){
+            // 通常是 ptrace 限制不允许访问子进程的 /proc/<pid>/fd
+            return Unavailable;
+        }
+    }
+    return Done;
+#else
+    Q_UNUSED(worker);
+    Q_UNUSED(path);
+    Q_UNUSED(max_side);
+    Q_UNUSED(image);
+    return Unavailable;
+#endif
+}
+
+int DecodePool::RunWorker()
+{
+#ifdef Q_OS_LINUX
+    // 应用退出或崩溃时请求管道的写端关闭，下面读到 EOF 就退出，不需要额外的生命周期绑定；
+    // PR_SET_PDEATHSIG 跟随的是启动它的线程而不是进程，解码线程退出时会误杀子进程，不能用
+    // 并行来自多个子进程，单个子进程里的缩放不再分线程
+    QThreadPool::globalInstance()->setMaxThreadCount(1);
+    if(!WriteAll(1, "ready\n")){
+        return 1;
+    }
+
+    QByteArray pending, line;
+    int last_fd = -1;
+    while(ReadLine(0, pending, -1, line) > 0){
+        // 应用收到上一个应答、映射完上一帧之后才会发下一个请求
+        if(last_fd >= 0){
+            ::close(last_fd);
+            last_fd = -1;
+        }
+        int tab = line.indexOf('\t');
+        QImage image;
+        if(tab > 0){
+            image = DecodeLocal(QString::fromUtf8(line.mid(tab + 1)), line.left(tab).toInt());
+        }
+        // 调色板图片的颜色表无法放进共享内存，转成直接颜色
+        if(!image.isNull() && image.colorCount() > 0){
+            image = image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied
+                                                                  : QImage::Format_RGB32);
+        }
+
+        QByteArray reply("err\n");
+        int fd = image.isNull() ? -1 : ToMemfd(image);
+        if(fd >= 0){
+            last_fd = fd;
+            reply = "ok\t" + QByteArray::number(fd) + '\t' + QByteArray::number(image.width()) + '\t'
+                    + QByteArray::number(image.height()) + '\t' + QByteArray::number(image.bytesPerLine()) + '\t'
+                    + QByteArray::number(int(image.format())) + '\n';
+        }
+        if(!WriteAll(1, reply)){
+            break;
+        }
+    }
+    return 0;
+#else
+    return 1;
+#endif
+}
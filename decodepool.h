@@ -0,0 +1,66 @@
+#ifndef DECODEPOOL_H
+#define DECODEPOOL_H
+
+#include <QImage>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QVector>
+#include <QWaitCondition>
+
+/*
+ * 进程外解码池，批量生成缩略图、联系表和网页相册导出时用。
+ * 解码和缩放在若干个 Album --decode-worker 子进程里进行，损坏的图片让解码器崩溃或卡死时
+ * 只影响一个子进程：超时（decode/timeout_ms，默认 10 秒）杀掉、崩溃回收，下次使用时重新启动。
+ * 出问题的文件在新启动的子进程上重试一次，仍然失败才记入隔离名单（按路径和修改时间，保存在设置里），
+ * 之后不再解码，浏览时也跳过。
+ * 子进程把结果写进 memfd 并封印，应用通过 /proc/<pid>/fd 映射同一块内存直接构造 QImage，不再复制像素。
+ * 进程数由 decode/workers 决定，为 0 或者子进程无法启动、共享内存无法映射时退回进程内解码。
+ */
+class DecodePool
+{
+public:
+    // 解码 path，缩放到长边不超过 max_side（0 表示原尺寸）；阻塞调用线程，可以从任意线程并发调用
+    static QImage Decode(const QString & path, int max_side);
+    // 文件是否因为让解码进程崩溃或超时而被隔离
+    static bool IsQuarantined(const QString & path);
+    // 解码子进程的入口：从标准输入读请求，结果通过 memfd 交回
+    static int RunWorker();
+
+private:
+    struct Worker {
+        qint64 pid = -1;        // -1 表示还没有启动或已经被回收
+        int in_fd = -1;         // 写请求
+        int out_fd = -1;        // 读应答
+        QByteArray pending;     // 已读到但还不成行的应答
+    };
+
+    enum Result {
+        Done,           // 得到结果（解码失败时为空图片）
+        Unavailable     // 子进程不可用，调用方改为进程内解码
+    };
+
+    DecodePool();
+    ~DecodePool();
+    static DecodePool & Instance();
+    static QImage DecodeLocal(const QString & path, int max_side);
+    static QString QuarantineKey(const QString & path);
+
+    Worker * Acquire();
+    void Release(Worker * worker);
+    void Disable();
+    bool Spawn(Worker & worker);
+    void Kill(Worker & worker);
+    Result Run(Worker & worker, const QString & path, int max_side, QImage & image);
+    void Quarantine(const QString & path);
+
+    QMutex _mutex;
+    QWaitCondition _idle_cond;
+    QVector<Worker*> _idle;
+    QVector<Worker*> _all;
+    int _limit;             // 最多几个子进程，0 表示停用
+    int _timeout_ms;
+    QSet<QString> _quarantine;
+};
+
+#endif // DECODEPOOL_H
@@ -0,0 +1,518 @@
+#include "dirscanner.h"
+#include "metrics.h"
+#include <QDir>
+#include <QDateTime>
+#include <QFile>
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+#endif
+
+#ifdef Q_OS_LINUX
+namespace {
+
+// getdents64 返回的目录项布局
+struct LinuxDirent64 {
+    quint64 d_ino;
+    qint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+enum RawType {
+    RawUnknown = 0,
+    RawFile = 1,
+    RawDir = 2,
+    RawSkip = 3,    // 设备、管道等非普通文件，或 stat 失败（如失效的符号链接）
+};
+
+struct RawEntry {
+    std::string name;
+    int type;
+    qint64 size;
+    qint64 mtime;
+};
+
+void ApplyStatx(RawEntry & entry, const struct statx & stx)
+{
+    if(S_ISDIR(stx.stx_mode)){
+        entry.type = RawDir;
+    } else if(S_ISREG(stx.stx_mode)){
+        entry.type = RawFile;
+    } else {
+        entry.type = RawSkip;
+    }
+    entry.size = qint64(stx.stx_size);
+    entry.mtime = qint64(stx.stx_mtime.tv_sec) * 1000 + stx.stx_mtime.tv_nsec / 1000000;
+}
+
+// 同步 stat，io_uring 不可用或单个请求失败时使用
+void StatSync(int dirfd, RawEntry & entry)
+{
+    struct stat st;
+    // 与 QFileInfo 一致，跟随符号链接
+    if(fstatat(dirfd, entry.name.c_str(), &st, 0) != 0){
+        entry.type = RawSkip;
+        return;
+    }
+    if(S_ISDIR(st.st_mode)){
+        entry.type = RawDir;
+    } else if(S_ISREG(st.st_mode)){
+        entry.type = RawFile;
+    } else {
+        entry.type = RawSkip;
+    }
+    entry.size = qint64(st.st_size);
+    entry.mtime = qint64(st.st_mtim.tv_sec) * 1000 + st.st_mtim.tv_nsec / 1000000;
+}
+
+/*
+ * 不依赖 liburing 的最小 io_uring 封装，只用来批量提交 statx。
+ * 每个扫描线程持有一个，按线程复用，避免每个目录重复 setup/mmap。
+ */
+class StatRing
+{
+public:
+    static const unsigned kDepth = 256;
+
+    StatRing()
+        : _fd(-1), _sq_ptr(MAP_FAILED), _cq_ptr(MAP_FAILED), _sqes(MAP_FAILED),
+        _sq_len(0), _cq_len(0), _sqes_len(0), _single_mmap(false), _entries(0)
+    {
+        Init();
+    }
+
+    ~StatRing()
+    {
+        if(_sqes != MAP_FAILED){
+            munmap(_sqes, _sqes_len);
+        }
+        if(_cq_ptr != MAP_FAILED && !_single_mmap){
+            munmap(_cq_ptr, _cq_len);
+        }
+        if(_sq_ptr != MAP_FAILED){
+            munmap(_sq_ptr, _sq_len);
+        }
+        if(_fd >= 0){
+            close(_fd);
+        }
+    }
+
+    bool IsValid() const
+    {
+        return _fd >= 0;
+    }
+
+    // 对 indexes 指定的条目批量 statx，失败的条目退回同步 stat
+    void StatBatch(int dirfd, std::vector<RawEntry> & entries, const std::vector<size_t> & indexes)
+    {
+        std::vector<struct statx> buffers(indexes.size());
+        std::vector<bool> done(indexes.size(), false);
+        size_t next = 0;
+        size_t inflight = 0;
+        while(next < indexes.size() || inflight > 0){
+            // 尽量填满提交队列，保持队列深度
+            unsigned tail = *_sq_tail;
+            while(next < indexes.size() && inflight < _entries){
+                unsigned slot = tail & *_sq_mask;
+                struct io_uring_sqe * sqe = &static_cast<struct io_uring_sqe *>(_sqes)[slot];
+                memset(sqe, 0, sizeof(*sqe));
+                sqe->opcode = IORING_OP_STATX;
+                sqe->fd = dirfd;
+                sqe->addr = reinterpret_cast<quint64>(entries[indexes[next]].name.c_str());
+                sqe->len = STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME;
+                sqe->off = reinterpret_cast<quint64>(&buffers[next]);
+                sqe->statx_flags = AT_STATX_SYNC_AS_STAT;
+                sqe->user_data = next;
+                _sq_array[slot] = slot;
+                ++tail;
+                ++next;
+                ++inflight;
+            }
+            __atomic_store_n(_sq_tail, tail, __ATOMIC_RELEASE);
+
+            // 提交所有尚未被内核取走的请求，并至少等待一个完成
+            unsigned to_submit = tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+            long ret = syscall(__NR_io_uring_enter, _fd, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if(ret < 0 && errno != EINTR){
+                // io_uring 出错：内核可能还在往 buffers 里写，先取消并收割完所有请求才能释放；
+                // 收割不完时宁可泄漏 buffers，也不能让内核写进已经释放的内存。剩余条目同步处理
+                if(!Drain(dirfd, entries, indexes, buffers, done, next, inflight)){
+                    new std::vector<struct statx>(std::move(buffers));
+                }
+                Reset();
+                for(size_t i = 0; i < indexes.size(); ++i){
+                    if(!done[i]){
+                        StatSync(dirfd, entries[indexes[i]]);
+                    }
+                }
+                return;
+            }
+
+            Reap(dirfd, entries, indexes, buffers, done, inflight, true);
+        }
+    }
+
+private:
+    // 取消请求的 user_data 带这个标记，和 statx 请求的序号区分
+    static const quint64 kCancelTag = quint64(1) << 63;
+
+    // 收割完成队列；sync_failed 为 false 时失败的条目留给调用方同步处理
+    void Reap(int dirfd, std::vector<RawEntry> & entries, const std::vector<size_t> & indexes,
+              const std::vector<struct statx> & buffers, std::vector<bool> & done, size_t & inflight,
+              bool sync_failed)
+    {
+        unsigned cq_head = *_cq_head;
+        unsigned cq_tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+        while(cq_head != cq_tail){
+            const struct io_uring_cqe & cqe = _cqes[cq_head & *_cq_mask];
+            ++cq_head;
+            if(cqe.user_data & kCancelTag){
+                continue;
+            }
+            size_t index = size_t(cqe.user_data);
+            RawEntry & entry = entries[indexes[index]];
+            --inflight;
+            if(cqe.res == 0){
+                ApplyStatx(entry, buffers[index]);
+            } else if(cqe.res == -ENOENT){
+                entry.type = RawSkip;
+            } else if(sync_failed){
+                StatSync(dirfd, entry);
+            } else {
+                continue;
+            }
+            done[index] = true;
+        }
+        __atomic_store_n(_cq_head, cq_head, __ATOMIC_RELEASE);
+    }
+
+    // io_uring_enter 出错后：撤回内核还没取走的请求，对已取走的逐个 IORING_OP_ASYNC_CANCEL，
+    // 然后等到全部完成。返回 false 表示 ring 已经无法使用，仍有请求可能在内核里
+    bool Drain(int dirfd, std::vector<RawEntry> & entries, const std::vector<size_t> & indexes,
+               const std::vector<struct statx> & buffers, std::vector<bool> & done, size_t next, size_t inflight)
+    {
+        struct io_uring_sqe * sqes = static_cast<struct io_uring_sqe *>(_sqes);
+        unsigned head = __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+        unsigned tail = *_sq_tail;
+        // 已经放进提交队列、还没有完成的请求
+        std::vector<bool> in_kernel(next, false);
+        for(size_t i = 0; i < next; ++i){
+            in_kernel[i] = !done[i];
+        }
+        // 还在提交队列里的请求内核没见过，直接撤回
+        for(unsigned pos = head; pos != tail; ++pos){
+            size_t index = size_t(sqes[_sq_array[pos & *_sq_mask]].user_data);
+            if(index < in_kernel.size() && in_kernel[index]){
+                in_kernel[index] = false;
+                --inflight;
+            }
+        }
+        tail = head;
+        Reap(dirfd, entries, indexes, buffers, done, inflight, false);
+        for(size_t i = 0; i < next; ++i){
+            if(!in_kernel[i] || done[i]){
+                continue;
+            }
+            if(tail - head >= _entries){
+                break;      // 最多 _entries 个在途请求，不会发生
+            }
+            unsigned slot = tail & *_sq_mask;
+            struct io_uring_sqe * sqe = &sqes[slot];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->addr = quint64(i);
+            sqe->user_data = kCancelTag | quint64(i);
+            _sq_array[slot] = slot;
+            ++tail;
+        }
+        __atomic_store_n(_sq_tail, tail, __ATOMIC_RELEASE);
+
+        // 取消不了的请求（已经在执行）也会很快完成；连续出错就放弃
+        int failures = 0;
+        while(inflight > 0){
+            unsigned to_submit = tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+            long ret = syscall(__NR_io_uring_enter, _fd, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if(ret >= 0){
+                failures = 0;
+            } else if(errno != EINTR && ++failures > 16){
+                return false;
+            }
+            Reap(dirfd, entries, indexes, buffers, done, inflight, false);
+        }
+        return true;
+    }
+
+    void Init()
+    {
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        _fd = int(syscall(__NR_io_uring_setup, kDepth, &params));
+        if(_fd < 0){
+            return;
+        }
+
+        _sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        _cq_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        _single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if(_single_mmap){
+            _sq_len = _cq_len = std::max(_sq_len, _cq_len);
+        }
+
+        _sq_ptr = mmap(nullptr, _sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       _fd, IORING_OFF_SQ_RING);
+        if(_sq_ptr == MAP_FAILED){
+            Reset();
+            return;
+        }
+        _cq_ptr = _single_mmap ? _sq_ptr
+                               : mmap(nullptr, _cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                      _fd, IORING_OFF_CQ_RING);
+        _sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+        _sqes = mmap(nullptr, _sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     _fd, IORING_OFF_SQES);
+        if(_cq_ptr == MAP_FAILED || _sqes == MAP_FAILED){
+            Reset();
+            return;
+        }
+
+        char * sq = static_cast<char *>(_sq_ptr);
+        _sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+        _sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        _sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        _sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        char * cq = static_cast<char *>(_cq_ptr);
+        _cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        _cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        _cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        _cqes = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+        _entries = params.sq_entries;
+    }
+
+    void Reset()
+    {
+        if(_sqes != MAP_FAILED){
+            munmap(_sqes, _sqes_len);
+            _sqes = MAP_FAILED;
+        }
+        if(_cq_ptr != MAP_FAILED && _cq_ptr != _sq_ptr){
+            munmap(_cq_ptr, _cq_len);
+        }
+        _cq_ptr = MAP_FAILED;
+        if(_sq_ptr != MAP_FAILED){
+            munmap(_sq_ptr, _sq_len);
+            _sq_ptr = MAP_FAILED;
+        }
+        close(_fd);
+        _fd = -1;
+    }
+
+    int _fd;
+    void * _sq_ptr;
+    void * _cq_ptr;
+    void * _sqes;
+    size_t _sq_len;
+    size_t _cq_len;
+    size_t _sqes_len;
+    bool _single_mmap;
+    unsigned _entries;
+    unsigned * _sq_head;
+    unsigned * _sq_tail;
+    unsigned * _sq_mask;
+    unsigned * _sq_array;
+    unsigned * _cq_head;
+    unsigned * _cq_tail;
+    unsigned * _cq_mask;
+    struct io_uring_cqe * _cqes;
+};
+
+// 少量条目直接同步 stat 更划算
+const size_t kMinRingBatch = 4;
+
+bool ListRaw(const char * path, std::vector<RawEntry> & entries, bool need_stat)
+{
+    int dirfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(dirfd < 0){
+        return false;
+    }
+
+    // 一次读出整块目录项，而不是每个条目一次系统调用
+    std::vector<char> buffer(64 * 1024);
+    while(true){
+        long nread = syscall(SYS_getdents64, dirfd, buffer.data(), buffer.size());
+        if(nread < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            close(dirfd);
+            return false;
+        }
+        if(nread == 0){
+            break;
+        }
+        for(long offset = 0; offset < nread;){
+            auto * dirent = reinterpret_cast<LinuxDirent64 *>(buffer.data() + offset);
+            offset += dirent->d_reclen;
+            const char * name = dirent->d_name;
+            // 与 QDir 默认过滤一致：跳过 . 和 .. 以及隐藏项
+            if(name[0] == '.'){
+                continue;
+            }
+            RawEntry entry;
+            entry.name = name;
+            entry.size = -1;
+            entry.mtime = -1;
+            switch(dirent->d_type){
+            case DT_DIR:
+                entry.type = RawDir;
+                break;
+            case DT_REG:
+                entry.type = RawFile;
+                break;
+            case DT_LNK:
+            case DT_UNKNOWN:
+                entry.type = RawUnknown;
+                break;
+            default:
+                continue;
+            }
+            entries.push_back(entry);
+        }
+    }
+
+    // 需要 stat 的条目：类型未知的，或者调用方需要大小/时间时的全部条目
+    std::vector<size_t> pending;
+    for(size_t i = 0; i < entries.size(); ++i){
+        if(need_stat || entries[i].type == RawUnknown){
+            pending.push_back(i);
+        }
+    }
+    if(!pending.empty()){
+        thread_local StatRing ring;
+        if(ring.IsValid() && pending.size() >= kMinRingBatch){
+            ring.StatBatch(dirfd, entries, pending);
+        } else {
+            for(size_t index : pending){
+                StatSync(dirfd, entries[index]);
+            }
+        }
+    }
+
+    close(dirfd);
+    return true;
+}
+
+} // namespace
+#endif // Q_OS_LINUX
+
+bool DirScanner::List(const QString &path, QVector<DirEntry> &entries, bool need_stat)
+{
+    static Metrics::Histogram & list_time = Metrics::GetHistogram("scan.list_us");
+    static Metrics::Counter & scanned = Metrics::GetCounter("scan.entries");
+    Metrics::ScopedTimer timer(list_time);
+
+    entries.clear();
+    bool ok = false;
+#ifdef Q_OS_LINUX
+    ok = ListLinux(path, entries, need_stat);
+    if(!ok){
+        entries.clear();
+    }
+#endif
+    if(!ok){
+        ok = ListQt(path, entries, need_stat);
+    }
+    scanned.Add(entries.size());
+    return ok;
+}
+
+bool DirScanner::IsPicFile(const QString &name)
+{
+    // 与 QFileInfo::completeSuffix 一致：取第一个 '.' 之后的部分；相机常用大写扩展名，不区分大小写
+    int dot = name.indexOf('.');
+    if(dot < 0){
+        return false;
+    }
+    const QString suffix = name.mid(dot + 1).toLower();
+    return suffix == "png" || suffix == "jpeg" || suffix == "jpg" || IsRawFile(name);
+}
+
+bool DirScanner::IsRawFile(const QString &name)
+{
+    // 也接受完整路径，只看最后一段
+    int dot = name.indexOf('.', name.lastIndexOf('/') + 1);
+    if(dot < 0){
+        return false;
+    }
+    const QString suffix = name.mid(dot + 1).toLower();
+    return suffix == "cr2" || suffix == "nef" || suffix == "arw" || suffix == "dng";
+}
+
+bool DirScanner::ListQt(const QString &path, QVector<DirEntry> &entries, bool need_stat)
+{
+    QDir src_dir(path);
+    if(!src_dir.exists()){
+        return false;
+    }
+    src_dir.setFilter(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot);
+    src_dir.setSorting(QDir::Name);
+    const QFileInfoList list = src_dir.entryInfoList();
+    entries.reserve(list.size());
+    for(const QFileInfo & fileInfo : list){
+        DirEntry entry;
+        entry.name = fileInfo.fileName();
+        entry.path = fileInfo.absoluteFilePath();
+        entry.is_dir = fileInfo.isDir();
+        entry.size = need_stat ? fileInfo.size() : -1;
+        entry.mtime = need_stat ? fileInfo.lastModified().toMSecsSinceEpoch() : -1;
+        entries.append(entry);
+    }
+    return true;
+}
+
+#ifdef Q_OS_LINUX
+bool DirScanner::ListLinux(const QString &path, QVector<DirEntry> &entries, bool need_stat)
+{
+    std::vector<RawEntry> raw;
+    if(!ListRaw(QFile::encodeName(path).constData(), raw, need_stat)){
+        return false;
+    }
+
+    QDir dir(path);
+    QString prefix = dir.absolutePath();
+    if(!prefix.endsWith('/')){
+        prefix += '/';
+    }
+    entries.reserve(int(raw.size()));
+    for(const RawEntry & item : raw){
+        if(item.type != RawDir && item.type != RawFile){
+            continue;
+        }
+        DirEntry entry;
+        entry.name = QFile::decodeName(item.name.c_str());
+        entry.path = prefix + entry.name;
+        entry.is_dir = item.type == RawDir;
+        entry.size = item.size;
+        entry.mtime = item.mtime;
+        entries.append(entry);
+    }
+
+    // 与 QDir::Name 排序一致
+    std::sort(entries.begin(), entries.end(), [](const DirEntry & a, const DirEntry & b){
+        return a.name < b.name;
+    });
+    return true;
+}
+#endif
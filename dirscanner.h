@@ -0,0 +1,40 @@
+#ifndef DIRSCANNER_H
+#define DIRSCANNER_H
+
+#include <QString>
+#include <QVector>
+
+// 目录中的一个条目
+struct DirEntry {
+    QString name;   // 文件名
+    QString path;   // 绝对路径
+    bool is_dir;
+    qint64 size;    // 字节数，未读取元数据时为 -1
+    qint64 mtime;   // 修改时间（自 1970 年起的毫秒数），未读取元数据时为 -1
+};
+
+/*
+ * 目录扫描器，替代 QDir::entryInfoList + QFileInfo 的逐条目系统调用。
+ * Linux 上用 getdents64 一次读出整块目录项，靠 d_type 判断类型，
+ * 只有类型未知（符号链接、部分网络文件系统）或需要大小/时间时才 statx，
+ * 这些 statx 通过 io_uring 批量提交；其他平台或 io_uring 不可用时退回 Qt 实现。
+ * 结果与原来的 QDir 过滤一致：排除 . 和 ..、隐藏项以及非普通文件，按名称排序。
+ */
+class DirScanner
+{
+public:
+    // need_stat 为 true 时填充 size 和 mtime
+    static bool List(const QString & path, QVector<DirEntry> & entries, bool need_stat = false);
+    // 是否是项目接受的图片文件（按完整后缀判断）
+    static bool IsPicFile(const QString & name);
+    // 是否是 RAW 文件（CR2/NEF/ARW/DNG），这类文件只显示内嵌预览
+    static bool IsRawFile(const QString & name);
+
+private:
+    static bool ListQt(const QString & path, QVector<DirEntry> & entries, bool need_stat);
+#ifdef Q_OS_LINUX
+    static bool ListLinux(const QString & path, QVector<DirEntry> & entries, bool need_stat);
+#endif
+};
+
+#endif // DIRSCANNER_H
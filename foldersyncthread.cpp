@@ -0,0 +1,287 @@
+#include "foldersyncthread.h"
+#include "dateindex.h"
+#include "dirscanner.h"
+#include "ioscheduler.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <algorithm>
+
+namespace {
+const char kManifestHeader[] = "album-sync 1";
+
+// 只关心目录和图片，按名称排序，保证两边的归并顺序一致
+QVector<DirEntry> ListForMerge(const QString & path)
+{
+    QVector<DirEntry> list;
+    QVector<DirEntry> result;
+    if(path.isEmpty() || !DirScanner::List(path, list, true)){
+        return result;
+    }
+    for(const DirEntry & entry : list){
+        if(entry.is_dir || DirScanner::IsPicFile(entry.name)){
+            result.append(entry);
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const DirEntry & a, const DirEntry & b){
+        return a.name < b.name;
+    });
+    return result;
+}
+
+} // namespace
+
+FolderSyncThread::FolderSyncThread(const QString &src_path, const QString &pro_path,
+                                   bool propagate_delete, QObject *parent)
+    :QThread(parent), _src_path(src_path), _pro_path(pro_path),
+    _propagate_delete(propagate_delete), _bstop(false), _done(0)
+{
+
+}
+
+FolderSyncThread::~FolderSyncThread()
+{
+
+}
+
+void FolderSyncThread::run()
+{
+    LoadManifest();
+    // 先只比较目录列表得出要做的操作，没变的文件不产生任何读写
+    QVector<Op> ops;
+    Merge(_src_path, _pro_path, ops);
+    emit SigTotalCount(ops.size());
+
+    IoScheduler io(_src_path, _pro_path);
+    QVector<char> ok(ops.size(), 0);
+    char * results = ok.data();
+    for(int i = 0; i < ops.size() && !_bstop; ++i){
+        const Op & op = ops.at(i);
+        switch(op.kind){
+        case OpMakeDir:
+            ok[i] = QDir().mkpath(op.dst);
+            emit SigUpdateProgress(++_done);
+            break;
+        case OpCopy:
+        case OpReplace:
+            io.Submit([this, op, i, results]() -> qint64 {
+                if(_bstop){
+                    return 0;
+                }
+                results[i] = CopyFile(op);
+                emit SigUpdateProgress(++_done);
+                return results[i] ? op.size : 0;
+            });
+            break;
+        case OpRemove:
+            ok[i] = QFile::remove(op.dst);
+            emit SigUpdateProgress(++_done);
+            break;
+        case OpRemoveDir:
+            // 目录中还有非图片文件时保留
+            ok[i] = QDir().rmdir(op.dst);
+            emit SigUpdateProgress(++_done);
+            break;
+        }
+    }
+    io.WaitForDone();
+
+    QStringList added_dirs;
+    QStringList added_pics;
+    QStringList removed;
+    QStringList replaced;
+    int changed = 0;
+    for(int i = 0; i < ops.size(); ++i){
+        if(!ok.at(i)){
+            continue;
+        }
+        const Op & op = ops.at(i);
+        switch(op.kind){
+        case OpMakeDir:
+            added_dirs << op.dst;
+            _owned.insert(RelPath(op.dst));
+            break;
+        case OpCopy:
+            added_pics << op.dst;
+            _owned.insert(RelPath(op.dst));
+            break;
+        case OpReplace:
+            ++changed;
+            replaced << op.dst;
+            _owned.insert(RelPath(op.dst));
+            break;
+        case OpRemove:
+        case OpRemoveDir:
+            removed << op.dst;
+            _owned.remove(RelPath(op.dst));
+            break;
+        }
+    }
+    // 中途取消也保存，已经复制进来的文件下次同步同样认得
+    SaveManifest();
+    // 时间线索引按实际的增删就地更新
+    DateIndex::Patch(_pro_path, added_pics + replaced, removed);
+    emit SigFinishSync(added_dirs, added_pics, removed, changed);
+}
+
+// 归并一层目录；src_dir 为空表示源中不存在这个目录（只在同步删除时出现）
+void FolderSyncThread::Merge(const QString &src_dir, const QString &dst_dir, QVector<Op> &ops)
+{
+    if(_bstop){
+        return;
+    }
+    QVector<DirEntry> src = ListForMerge(src_dir);
+    QVector<DirEntry> dst = ListForMerge(dst_dir);
+    QDir dst_root(dst_dir);
+
+    int i = 0;
+    int j = 0;
+    while(i < src.size() || j < dst.size()){
+        if(_bstop){
+            return;
+        }
+        int cmp = i >= src.size() ? 1 : j >= dst.size() ? -1 : src.at(i).name.compare(dst.at(j).name);
+
+        if(cmp < 0){
+            // 只在源中：新目录或新图片
+            const DirEntry & entry = src.at(i++);
+            QString dst_path = dst_root.absoluteFilePath(entry.name);
+            if(entry.is_dir){
+                // 项目目录本身在源目录下时不要递归进去
+                if(QDir(entry.path) == QDir(_pro_path)){
+                    continue;
+                }
+                ops.append({OpMakeDir, entry.path, dst_path, 0, 0});
+                Merge(entry.path, dst_path, ops);
+            } else {
+                ops.append({OpCopy, entry.path, dst_path, entry.size, entry.mtime});
+            }
+        } else if(cmp > 0){
+            // 只在项目中：源里已经删除，或者本来就不是从这个源目录同步来的；
+            // 只删除同步清单里有的，目录里可能有清单里的文件，总要进去看
+            const DirEntry & entry = dst.at(j++);
+            if(!_propagate_delete){
+                continue;
+            }
+            bool owned = _owned.contains(RelPath(entry.path));
+            if(entry.is_dir){
+                Merge(QString(), entry.path, ops);
+                if(owned){
+                    ops.append({OpRemoveDir, QString(), entry.path, 0, 0});
+                }
+            } else if(owned){
+                ops.append({OpRemove, QString(), entry.path, entry.size, entry.mtime});
+            }
+        } else {
+            const DirEntry & s = src.at(i++);
+            const DirEntry & d = dst.at(j++);
+            if(s.is_dir != d.is_dir){
+                continue;   // 同名的目录和文件，无法同步，保留项目中的
+            }
+            if(s.is_dir){
+                if(QDir(s.path) != QDir(_pro_path)){
+                    Merge(s.path, d.path, ops);
+                }
+                continue;
+            }
+            // 快速路径：大小相同且源文件不比项目中的新。
+            // 普通导入的副本修改时间是导入时刻，同样满足条件，不会被整体重新复制
+            if(s.size == d.size && s.mtime <= d.mtime){
+                continue;
+            }
+            ops.append({OpReplace, s.path, d.path, s.size, s.mtime});
+        }
+    }
+}
+
+// 先复制到同目录下的隐藏临时文件，写完再替换，中途失败不会留下半个文件
+bool FolderSyncThread::CopyFile(const Op &op)
+{
+    QFileInfo info(op.dst);
+    QString tmp = info.dir().absoluteFilePath("." + info.fileName() + ".sync");
+    QFile::remove(tmp);
+    if(!QFile::copy(op.src, tmp)){
+        return false;
+    }
+    QFile file(tmp);
+    if(file.open(QIODevice::ReadWrite)){
+        file.setFileTime(QDateTime::fromMSecsSinceEpoch(op.mtime), QFileDevice::FileModificationTime);
+        file.close();
+    }
+    if(QFileInfo::exists(op.dst) && !QFile::remove(op.dst)){
+        QFile::remove(tmp);
+        return false;
+    }
+    if(!QFile::rename(tmp, op.dst)){
+        QFile::remove(tmp);
+        return false;
+    }
+    return true;
+}
+
+// 清单按源目录的绝对路径区分，同一个项目可以从多张存储卡同步
+QString FolderSyncThread::ManifestPath() const
+{
+    QByteArray hash = QCryptographicHash::hash(QDir(_src_path).absolutePath().toUtf8(),
+                                               QCryptographicHash::Sha1).toHex().left(16);
+    return QDir(_pro_path).absoluteFilePath(".album_sync_" + QString::fromLatin1(hash));
+}
+
+QString FolderSyncThread::RelPath(const QString &path) const
+{
+    return QDir(_pro_path).relativeFilePath(path);
+}
+
+void FolderSyncThread::LoadManifest()
+{
+    _owned.clear();
+    QFile file(ManifestPath());
+    if(!file.open(QIODevice::ReadOnly)){
+        return;
+    }
+    // 第一行：文件头 源目录，源目录只用于辨认
+    if(!file.readLine().startsWith(kManifestHeader)){
+        return;
+    }
+    // 每行一个相对路径
+    while(!file.atEnd()){
+        QByteArray line = file.readLine();
+        if(line.endsWith('\n')){
+            line.chop(1);
+        }
+        if(!line.isEmpty()){
+            _owned.insert(QString::fromUtf8(line));
+        }
+    }
+}
+
+void FolderSyncThread::SaveManifest() const
+{
+    QSaveFile file(ManifestPath());
+    if(!file.open(QIODevice::WriteOnly)){
+        return;
+    }
+    QByteArray data(kManifestHeader);
+    data += '\t' + QDir(_src_path).absolutePath().toUtf8() + '\n';
+    QDir root(_pro_path);
+    for(const QString & rel_path : _owned){
+        // 用户已经自己删掉的不再记录；文件名里的换行会破坏一行一条的格式
+        if(rel_path.contains('\n') || !QFileInfo::exists(root.absoluteFilePath(rel_path))){
+            continue;
+        }
+        data += rel_path.toUtf8() + '\n';
+    }
+    if(file.write(data) != data.size()){
+        file.cancelWriting();
+        return;
+    }
+    file.commit();
+}
+
+void FolderSyncThread::SlotCancelProgress()
+{
+    _bstop = true;
+}
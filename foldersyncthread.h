@@ -0,0 +1,72 @@
+#ifndef FOLDERSYNCTHREAD_H
+#define FOLDERSYNCTHREAD_H
+
+#include <QSet>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+#include <atomic>
+
+/*
+ * 文件夹同步导入：反复导入同一张存储卡时只复制新增和改动的图片。
+ * 源目录和项目目录的列表各自按名称排序后做归并，按名称、大小、修改时间比较：
+ * 大小相同且源文件不比项目中的新就认为没变，不读文件内容。
+ * 新文件和改动的文件交给 IoScheduler 复制（改动的先写临时文件再替换），
+ * 复制后把修改时间设成源文件的，下次同步直接命中快速路径。
+ * 可选把源目录中已删除的图片也从项目中删除，但只删除以前从同一个源目录同步进来的：
+ * 每个源目录在项目根目录下有一份隐藏的同步清单，记录由它复制进项目的图片和新建的目录，
+ * 其他导入、链接导入和用户自己放进项目的文件不在清单里，不会被删除。
+ * 结束（包括中途取消）时报告实际新增和删除的路径，界面据此就地更新目录树。
+ */
+class FolderSyncThread : public QThread
+{
+    Q_OBJECT
+public:
+    FolderSyncThread(const QString & src_path, const QString & pro_path, bool propagate_delete,
+                     QObject * parent = nullptr);
+    ~FolderSyncThread();
+protected:
+    virtual void run();
+private:
+    enum OpKind {
+        OpMakeDir,      // 新建目录
+        OpCopy,         // 新图片
+        OpReplace,      // 改动过的图片
+        OpRemove,       // 源中已删除的图片
+        OpRemoveDir     // 源中已删除的目录，删完其中图片后为空才删
+    };
+    struct Op {
+        OpKind kind;
+        QString src;
+        QString dst;
+        qint64 size;
+        qint64 mtime;
+    };
+
+    void Merge(const QString & src_dir, const QString & dst_dir, QVector<Op> & ops);
+    static bool CopyFile(const Op & op);
+    // 同步清单：这个源目录同步进项目的文件和目录，项目内相对路径
+    QString ManifestPath() const;
+    void LoadManifest();
+    void SaveManifest() const;
+    QString RelPath(const QString & path) const;
+
+    QString _src_path;
+    QString _pro_path;
+    bool _propagate_delete;
+    QSet<QString> _owned;
+    std::atomic<bool> _bstop;
+    std::atomic<int> _done;
+
+signals:
+    void SigTotalCount(int);
+    void SigUpdateProgress(int);
+    // added_dirs 按先父后子的顺序排列；changed 为替换的图片数
+    void SigFinishSync(const QStringList & added_dirs, const QStringList & added_pics,
+                       const QStringList & removed, int changed);
+
+public slots:
+    void SlotCancelProgress();
+};
+
+#endif // FOLDERSYNCTHREAD_H
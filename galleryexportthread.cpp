@@ -0,0 +1,324 @@
+#include "galleryexportthread.h"
+#include "boundedqueue.h"
+#include "decodepool.h"
+#include "dirscanner.h"
+#include "mappedfile.h"
+#include "thumbcache.h"
+#include <QBuffer>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageWriter>
+#include <QPainter>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QUrl>
+#include <QtConcurrent>
+
+namespace {
+// 导出的 JPEG 质量，固定取值保证结果可复现
+const int kJpegQuality = 85;
+
+QString UrlPart(const QString & name)
+{
+    return QString::fromLatin1(QUrl::toPercentEncoding(name));
+}
+}
+
+GalleryExportThread::GalleryExportThread(const QString &src_path, const QString &out_path, QObject *parent)
+    :QThread(parent), _src_path(src_path), _out_path(out_path), _bstop(false)
+{
+    // 大图、中图、缩略图；缩略图尺寸与浏览时使用的缓存一致，导出时顺带填充缓存
+    _sizes << 2560 << 1280 << 320;
+    _size_names << "_large" << "_medium" << "_thumb";
+}
+
+GalleryExportThread::~GalleryExportThread()
+{
+
+}
+
+void GalleryExportThread::run()
+{
+    // 先按名称顺序收集所有图片，保证输出顺序确定
+    CollectEntries(_src_path, QString());
+    if(_bstop){
+        return;
+    }
+    emit SigTotalCount(_entries.size());
+
+    for(auto iter = _dirs.begin(); iter != _dirs.end(); ++iter){
+        for(const QString & size_name : _size_names){
+            QDir().mkpath(OutDir(iter.key()) + "/" + size_name);
+        }
+    }
+
+    RunPipeline();
+    if(_bstop){
+        return;
+    }
+
+    WriteIndexes();
+    emit SigFinishProgress(_entries.size());
+}
+
+void GalleryExportThread::CollectEntries(const QString &dir_path, const QString &rel_dir)
+{
+    if(_bstop){
+        return;
+    }
+
+    QVector<DirEntry> list;
+    DirScanner::List(dir_path, list);
+    DirNode & node = _dirs[rel_dir];
+    for(const DirEntry & entry : list){
+        if(entry.is_dir){
+            node.sub_dirs.append(entry.name);
+            continue;
+        }
+        if(!DirScanner::IsPicFile(entry.name)){
+            continue;
+        }
+        // a.png 与 a.jpg 导出后不能重名，扩展名并入文件名
+        QFileInfo info(entry.name);
+        ExportEntry export_entry;
+        export_entry.src_path = entry.path;
+        export_entry.rel_dir = rel_dir;
+        export_entry.out_name = info.completeBaseName() + "_" + info.suffix().toLower() + ".jpg";
+        node.entries.append(_entries.size());
+        _entries.append(export_entry);
+    }
+
+    // node 引用在递归插入新目录后可能失效，先复制子目录列表
+    const QStringList sub_dirs = node.sub_dirs;
+    for(const QString & sub : sub_dirs){
+        QString sub_rel = rel_dir.isEmpty() ? sub : rel_dir + "/" + sub;
+        CollectEntries(dir_path + "/" + sub, sub_rel);
+    }
+}
+
+QString GalleryExportThread::OutDir(const QString &rel_dir) const
+{
+    return rel_dir.isEmpty() ? _out_path : _out_path + "/" + rel_dir;
+}
+
+/*
+ * 流水线：读取(1) -> 解码(n/2) -> 缩放(n/2) -> 编码(n/2) -> 写盘(1)。
+ * 解码在 DecodePool 的子进程里进行，直接缩小到最大输出尺寸，损坏的图片不会拖垮导出。
+ * 解码后到缩放完成之间持有最大尺寸的图片，这一段的队列容量最小，
+ * 峰值内存大约是 1.5 倍核数张大图，与项目规模无关。
+ */
+void GalleryExportThread::RunPipeline()
+{
+    const int cores = qMax(2, QThread::idealThreadCount());
+    const int workers = qMax(1, cores / 2);
+    const int count = _entries.size();
+    _written = QVector<bool>(count, false);
+
+    BoundedQueue<ExportItem> read_queue(workers * 2, 1);
+    BoundedQueue<ExportItem> decode_queue(workers, workers);
+    BoundedQueue<ExportItem> resize_queue(workers * 2, workers);
+    BoundedQueue<ExportItem> encode_queue(workers * 2, workers);
+
+    auto cancel_all = [&](){
+        read_queue.Cancel();
+        decode_queue.Cancel();
+        resize_queue.Cancel();
+        encode_queue.Cancel();
+    };
+
+    // 专用线程池，避免占满全局线程池（缩放内核会在全局线程池上并行）
+    QThreadPool pool;
+    pool.setMaxThreadCount(2 + workers * 3);
+    QList<QFuture<void>> futures;
+
+    // 读取：单线程按顺序提示内核提前读入；队列有多长就预读多远，
+    // 解码子进程映射文件时页大多已在页缓存中
+    futures << QtConcurrent::run(&pool, [&](){
+        for(int i = 0; i < count; ++i){
+            if(_bstop){
+                cancel_all();
+                break;
+            }
+            ExportItem item;
+            item.index = i;
+            MappedFile::WillNeed(_entries.at(i).src_path);
+            if(!read_queue.Push(item)){
+                break;
+            }
+        }
+        read_queue.ProducerDone();
+    });
+
+    // 解码
+    for(int w = 0; w < workers; ++w){
+        futures << QtConcurrent::run(&pool, [&](){
+            ExportItem item;
+            while(read_queue.Pop(item)){
+                if(_bstop){
+                    cancel_all();
+                    break;
+                }
+                // 子进程按最大输出尺寸缩小解码，RAW 文件退回内嵌的最大预览
+                const QString & src_path = _entries.at(item.index).src_path;
+                item.image = DecodePool::Decode(src_path, _sizes.first());
+                // 每张图只读一遍，解码完就从页缓存丢弃
+                MappedFile::DontNeed(src_path);
+                if(!decode_queue.Push(item)){
+                    break;
+                }
+            }
+            decode_queue.ProducerDone();
+        });
+    }
+
+    // 缩放：从大到小逐级缩放，每一级以上一级的结果为源。
+    // 最小一级优先取缓存，缓存里按尺寸存放的都是真正缩放出来的缩略图；没有时缩放后存进去
+    for(int w = 0; w < workers; ++w){
+        futures << QtConcurrent::run(&pool, [&](){
+            ExportItem item;
+            while(decode_queue.Pop(item)){
+                if(_bstop){
+                    cancel_all();
+                    break;
+                }
+                const QString & src_path = _entries.at(item.index).src_path;
+                QImage source = item.image;
+                item.image = QImage();
+                item.scaled.clear();
+                const int last = _sizes.size() - 1;
+                for(int s = 0; s <= last && !source.isNull(); ++s){
+                    int size = _sizes.at(s);
+                    QImage scaled;
+                    if(s == last){
+                        scaled = ThumbCache::Find(src_path, size);
+                    }
+                    if(scaled.isNull()){
+                        scaled = ThumbCache::MakeThumb(source, size);
+                        if(s == last){
+                            ThumbCache::Store(src_path, size, scaled);
+                        }
+                    }
+                    item.scaled.append(scaled);
+                    source = scaled;
+                }
+                if(!resize_queue.Push(item)){
+                    break;
+                }
+            }
+            resize_queue.ProducerDone();
+        });
+    }
+
+    // 编码：透明区域铺白底后编码为 JPEG
+    for(int w = 0; w < workers; ++w){
+        futures << QtConcurrent::run(&pool, [&](){
+            ExportItem item;
+            while(resize_queue.Pop(item)){
+                if(_bstop){
+                    cancel_all();
+                    break;
+                }
+                item.encoded.clear();
+                for(const QImage & scaled : item.scaled){
+                    QImage opaque = scaled;
+                    if(scaled.hasAlphaChannel()){
+                        opaque = QImage(scaled.size(), QImage::Format_RGB32);
+                        opaque.fill(Qt::white);
+                        QPainter painter(&opaque);
+                        painter.drawImage(0, 0, scaled);
+                    }
+                    QByteArray bytes;
+                    QBuffer buffer(&bytes);
+                    buffer.open(QIODevice::WriteOnly);
+                    QImageWriter writer(&buffer, "jpg");
+                    writer.setQuality(kJpegQuality);
+                    writer.write(opaque);
+                    item.encoded.append(bytes);
+                }
+                item.scaled.clear();
+                if(!encode_queue.Push(item)){
+                    break;
+                }
+            }
+            encode_queue.ProducerDone();
+        });
+    }
+
+    // 写盘：单线程顺序写，避免机械硬盘上的随机写
+    futures << QtConcurrent::run(&pool, [&](){
+        ExportItem item;
+        int done = 0;
+        while(encode_queue.Pop(item)){
+            if(_bstop){
+                cancel_all();
+                break;
+            }
+            const ExportEntry & entry = _entries.at(item.index);
+            bool ok = item.encoded.size() == _sizes.size();
+            for(int s = 0; s < item.encoded.size() && ok; ++s){
+                QSaveFile file(OutDir(entry.rel_dir) + "/" + _size_names.at(s) + "/" + entry.out_name);
+                ok = file.open(QIODevice::WriteOnly) && file.write(item.encoded.at(s)) == item.encoded.at(s).size()
+                     && file.commit();
+            }
+            _written[item.index] = ok;
+            emit SigUpdateProgress(++done);
+        }
+    });
+
+    for(QFuture<void> & future : futures){
+        future.waitForFinished();
+    }
+}
+
+// 为每个目录生成 index.html：子目录链接 + 缩略图网格，缩略图链接到大图
+void GalleryExportThread::WriteIndexes()
+{
+    for(auto iter = _dirs.begin(); iter != _dirs.end(); ++iter){
+        const QString & rel_dir = iter.key();
+        const DirNode & node = iter.value();
+        QString title = rel_dir.isEmpty() ? QDir(_src_path).dirName() : rel_dir;
+
+        QString html;
+        html += "<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n";
+        html += "<title>" + title.toHtmlEscaped() + "</title>\n";
+        html += "<style>body{background:#2e2f30;color:#e7e7e7;font-family:sans-serif}"
+                "a{color:#8fc1f0}.grid{display:flex;flex-wrap:wrap;gap:8px}"
+                ".grid img{height:160px;object-fit:cover}</style>\n";
+        html += "</head>\n<body>\n<h1>" + title.toHtmlEscaped() + "</h1>\n";
+        if(!rel_dir.isEmpty()){
+            html += "<p><a href=\"../index.html\">..</a></p>\n";
+        }
+        if(!node.sub_dirs.isEmpty()){
+            html += "<ul>\n";
+            for(const QString & sub : node.sub_dirs){
+                html += "<li><a href=\"" + UrlPart(sub) + "/index.html\">" + sub.toHtmlEscaped() + "</a></li>\n";
+            }
+            html += "</ul>\n";
+        }
+        html += "<div class=\"grid\">\n";
+        for(int index : node.entries){
+            if(!_written.at(index)){
+                continue;
+            }
+            const QString & name = _entries.at(index).out_name;
+            QString alt = QFileInfo(_entries.at(index).src_path).fileName().toHtmlEscaped();
+            html += "<a href=\"" + _size_names.first() + "/" + UrlPart(name) + "\">"
+                    "<img src=\"" + _size_names.last() + "/" + UrlPart(name) + "\" alt=\"" + alt
+                    + "\" loading=\"lazy\"></a>\n";
+        }
+        html += "</div>\n</body>\n</html>\n";
+
+        QSaveFile file(OutDir(rel_dir) + "/index.html");
+        if(file.open(QIODevice::WriteOnly)){
+            file.write(html.toUtf8());
+            file.commit();
+        }
+    }
+}
+
+// 槽函数：外部调用时设置停止标记
+void GalleryExportThread::SlotCancelProgress()
+{
+    _bstop = true;
+}
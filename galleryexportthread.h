@@ -0,0 +1,72 @@
+#ifndef GALLERYEXPORTTHREAD_H
+#define GALLERYEXPORTTHREAD_H
+
+#include <QThread>
+#include <QImage>
+#include <QMap>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+
+/*
+ * 把项目导出为静态网页相册。
+ * 读取 -> 解码 -> 多尺寸缩放 -> JPEG 编码 -> 写盘 五个阶段组成流水线，
+ * 阶段之间用有界队列连接，各阶段并行运行；各尺寸从大到小逐级缩放，每级以上一级为源，
+ * 最小一级优先复用缩略图缓存，没有时生成后存入。
+ * 输出按项目目录结构组织，每个目录生成一个 index.html；
+ * 文件名、遍历顺序和编码参数都是确定的，同一项目重复导出结果一致。
+ */
+class GalleryExportThread : public QThread
+{
+    Q_OBJECT
+public:
+    GalleryExportThread(const QString & src_path, const QString & out_path, QObject * parent = nullptr);
+    ~GalleryExportThread();
+
+protected:
+    virtual void run();
+
+private:
+    // 流水线中传递的一张图片
+    struct ExportItem {
+        int index;
+        QImage image;                // 解码后的图片，长边不超过最大输出尺寸
+        QVector<QImage> scaled;      // 各输出尺寸的图片，与 _sizes 一一对应
+        QVector<QByteArray> encoded; // 编码后的 JPEG 数据
+    };
+    // 待导出的图片
+    struct ExportEntry {
+        QString src_path;
+        QString rel_dir;    // 相对项目根目录的目录，根目录为空
+        QString out_name;   // 输出文件名
+    };
+    // 目录结构，用于生成 index.html
+    struct DirNode {
+        QStringList sub_dirs;
+        QVector<int> entries;
+    };
+
+    void CollectEntries(const QString & dir_path, const QString & rel_dir);
+    void RunPipeline();
+    void WriteIndexes();
+    QString OutDir(const QString & rel_dir) const;
+
+    QString _src_path;
+    QString _out_path;
+    QVector<int> _sizes;           // 输出尺寸（长边像素），从大到小
+    QStringList _size_names;       // 输出尺寸对应的子目录名
+    QVector<ExportEntry> _entries;
+    QVector<bool> _written;        // 每张图片是否导出成功
+    QMap<QString, DirNode> _dirs;
+    std::atomic<bool> _bstop;
+
+signals:
+    void SigTotalCount(int);        // 收集完成后通知图片总数
+    void SigUpdateProgress(int);
+    void SigFinishProgress(int);
+
+public slots:
+    void SlotCancelProgress();
+};
+
+#endif // GALLERYEXPORTTHREAD_H
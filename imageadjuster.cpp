@@ -0,0 +1,316 @@
+#include "imageadjuster.h"
+#include "cpufeatures.h"
+#include <QPainter>
+#include <QPainterPath>
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrent>
+#include <cmath>
+
+#if defined(ALBUM_X86_SIMD)
+#include <immintrin.h>
+#endif
+
+namespace {
+const int kMatrixShift = 12;                    // 颜色矩阵的定点位数
+const int kMatrixOne = 1 << kMatrixShift;
+
+// 查找表和颜色矩阵；查找表用 32 位整数存放，AVX2 可以直接 gather
+struct Tables {
+    alignas(32) qint32 lut[3][256];
+    qint32 m[9];
+    bool identity_matrix;
+};
+
+struct Band {
+    int y0;
+    int y1;
+    ImageAdjuster::Histogram hist;
+};
+
+using RowFunc = void (*)(const quint32 * src, quint32 * dst, int n, const Tables & t);
+
+inline int ClampByte(int v)
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+void BuildTables(const ImageAdjuster::Params & params, Tables & t)
+{
+    const double black = qBound(0, params.black, 254) / 255.0;
+    const double white = qBound(params.black + 1, params.white, 255) / 255.0;
+    const double gain = std::pow(2.0, params.exposure);
+    const double inv_gamma = 1.0 / qBound(0.1, params.gamma, 10.0);
+    // 对比度映射为绕中灰的斜率，-1..1 对应 1/4..4 倍
+    const double slope = std::pow(4.0, qBound(-1.0, params.contrast, 1.0));
+
+    for(int v = 0; v < 256; ++v){
+        double x = (v / 255.0 - black) / (white - black);
+        x = qBound(0.0, x, 1.0);
+        // 曝光在近似线性光下计算
+        x = std::pow(qBound(0.0, std::pow(x, 2.2) * gain, 1.0), 1.0 / 2.2);
+        x = std::pow(x, inv_gamma);
+        x = (x - 0.5) * slope + 0.5;
+        const qint32 out = qint32(std::lround(qBound(0.0, x, 1.0) * 255.0));
+        // 三个通道目前使用同一条曲线，结构上允许各自不同
+        t.lut[0][v] = out;
+        t.lut[1][v] = out;
+        t.lut[2][v] = out;
+    }
+
+    // 饱和度矩阵：在亮度（Rec.709 权重）和原色之间插值
+    const double s = qMax(0.0, params.saturation);
+    const double w[3] = {0.2126, 0.7152, 0.0722};
+    for(int row = 0; row < 3; ++row){
+        for(int col = 0; col < 3; ++col){
+            double value = (1.0 - s) * w[col] + (row == col ? s : 0.0);
+            t.m[row * 3 + col] = qint32(std::lround(value * kMatrixOne));
+        }
+    }
+    t.identity_matrix = std::abs(s - 1.0) < 1e-6;
+}
+
+void RowScalar(const quint32 * src, quint32 * dst, int n, const Tables & t)
+{
+    const qint32 round = kMatrixOne / 2;
+    for(int i = 0; i < n; ++i){
+        const quint32 p = src[i];
+        int r = t.lut[0][(p >> 16) & 0xFF];
+        int g = t.lut[1][(p >> 8) & 0xFF];
+        int b = t.lut[2][p & 0xFF];
+        if(!t.identity_matrix){
+            int nr = (t.m[0] * r + t.m[1] * g + t.m[2] * b + round) >> kMatrixShift;
+            int ng = (t.m[3] * r + t.m[4] * g + t.m[5] * b + round) >> kMatrixShift;
+            int nb = (t.m[6] * r + t.m[7] * g + t.m[8] * b + round) >> kMatrixShift;
+            r = ClampByte(nr);
+            g = ClampByte(ng);
+            b = ClampByte(nb);
+        }
+        dst[i] = 0xFF000000u | quint32(r) << 16 | quint32(g) << 8 | quint32(b);
+    }
+}
+
+#if defined(ALBUM_X86_SIMD)
+
+ALBUM_TARGET_SSE41
+void RowSse41(const quint32 * src, quint32 * dst, int n, const Tables & t)
+{
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(kMatrixOne / 2);
+    const __m128i alpha = _mm_set1_epi32(int(0xFF000000u));
+    __m128i m[9];
+    for(int k = 0; k < 9; ++k){
+        m[k] = _mm_set1_epi32(t.m[k]);
+    }
+
+    int i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i ri = _mm_and_si128(_mm_srli_epi32(px, 16), mask);
+        __m128i gi = _mm_and_si128(_mm_srli_epi32(px, 8), mask);
+        __m128i bi = _mm_and_si128(px, mask);
+        // SSE 没有 gather，逐个取表
+        __m128i r = _mm_setr_epi32(t.lut[0][_mm_extract_epi32(ri, 0)], t.lut[0][_mm_extract_epi32(ri, 1)],
+                                   t.lut[0][_mm_extract_epi32(ri, 2)], t.lut[0][_mm_extract_epi32(ri, 3)]);
+        __m128i g = _mm_setr_epi32(t.lut[1][_mm_extract_epi32(gi, 0)], t.lut[1][_mm_extract_epi32(gi, 1)],
+                                   t.lut[1][_mm_extract_epi32(gi, 2)], t.lut[1][_mm_extract_epi32(gi, 3)]);
+        __m128i b = _mm_setr_epi32(t.lut[2][_mm_extract_epi32(bi, 0)], t.lut[2][_mm_extract_epi32(bi, 1)],
+                                   t.lut[2][_mm_extract_epi32(bi, 2)], t.lut[2][_mm_extract_epi32(bi, 3)]);
+        if(!t.identity_matrix){
+            __m128i nr = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi32(r, m[0]), _mm_mullo_epi32(g, m[1])),
+                                       _mm_add_epi32(_mm_mullo_epi32(b, m[2]), round));
+            __m128i ng = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi32(r, m[3]), _mm_mullo_epi32(g, m[4])),
+                                       _mm_add_epi32(_mm_mullo_epi32(b, m[5]), round));
+            __m128i nb = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi32(r, m[6]), _mm_mullo_epi32(g, m[7])),
+                                       _mm_add_epi32(_mm_mullo_epi32(b, m[8]), round));
+            r = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(nr, kMatrixShift), zero), mask);
+            g = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(ng, kMatrixShift), zero), mask);
+            b = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(nb, kMatrixShift), zero), mask);
+        }
+        __m128i out = _mm_or_si128(_mm_or_si128(alpha, _mm_slli_epi32(r, 16)),
+                                   _mm_or_si128(_mm_slli_epi32(g, 8), b));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), out);
+    }
+    RowScalar(src + i, dst + i, n - i, t);
+}
+
+ALBUM_TARGET_AVX2
+void RowAvx2(const quint32 * src, quint32 * dst, int n, const Tables & t)
+{
+    const __m256i mask = _mm256_set1_epi32(0xFF);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i round = _mm256_set1_epi32(kMatrixOne / 2);
+    const __m256i alpha = _mm256_set1_epi32(int(0xFF000000u));
+    __m256i m[9];
+    for(int k = 0; k < 9; ++k){
+        m[k] = _mm256_set1_epi32(t.m[k]);
+    }
+
+    int i = 0;
+    for(; i + 8 <= n; i += 8){
+        __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        __m256i r = _mm256_i32gather_epi32(t.lut[0], _mm256_and_si256(_mm256_srli_epi32(px, 16), mask), 4);
+        __m256i g = _mm256_i32gather_epi32(t.lut[1], _mm256_and_si256(_mm256_srli_epi32(px, 8), mask), 4);
+        __m256i b = _mm256_i32gather_epi32(t.lut[2], _mm256_and_si256(px, mask), 4);
+        if(!t.identity_matrix){
+            __m256i nr = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(r, m[0]), _mm256_mullo_epi32(g, m[1])),
+                                          _mm256_add_epi32(_mm256_mullo_epi32(b, m[2]), round));
+            __m256i ng = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(r, m[3]), _mm256_mullo_epi32(g, m[4])),
+                                          _mm256_add_epi32(_mm256_mullo_epi32(b, m[5]), round));
+            __m256i nb = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(r, m[6]), _mm256_mullo_epi32(g, m[7])),
+                                          _mm256_add_epi32(_mm256_mullo_epi32(b, m[8]), round));
+            r = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(nr, kMatrixShift), zero), mask);
+            g = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(ng, kMatrixShift), zero), mask);
+            b = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(nb, kMatrixShift), zero), mask);
+        }
+        __m256i out = _mm256_or_si256(_mm256_or_si256(alpha, _mm256_slli_epi32(r, 16)),
+                                      _mm256_or_si256(_mm256_slli_epi32(g, 8), b));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), out);
+    }
+    RowScalar(src + i, dst + i, n - i, t);
+}
+
+#endif // ALBUM_X86_SIMD
+
+RowFunc SelectKernel()
+{
+#if defined(ALBUM_X86_SIMD)
+    switch(CpuFeatures::BestIsa()){
+    case CpuFeatures::IsaAvx2:
+        return RowAvx2;
+    case CpuFeatures::IsaSse41:
+        return RowSse41;
+    default:
+        break;
+    }
+#endif
+    return RowScalar;
+}
+
+// 刚写出的一行还在 L1 缓存中，顺带统计直方图
+void Accumulate(const quint32 * row, int n, ImageAdjuster::Histogram & hist)
+{
+    for(int i = 0; i < n; ++i){
+        const quint32 p = row[i];
+        const quint32 r = (p >> 16) & 0xFF;
+        const quint32 g = (p >> 8) & 0xFF;
+        const quint32 b = p & 0xFF;
+        ++hist.red[r];
+        ++hist.green[g];
+        ++hist.blue[b];
+        ++hist.luma[(r * 54 + g * 183 + b * 19) >> 8];
+    }
+}
+}
+
+bool ImageAdjuster::Params::IsIdentity() const
+{
+    return exposure == 0.0 && contrast == 0.0 && black == 0 && white == 255
+           && gamma == 1.0 && saturation == 1.0;
+}
+
+QImage ImageAdjuster::Apply(const QImage &src, const Params &params, Histogram *hist)
+{
+    if(src.isNull()){
+        return QImage();
+    }
+    QImage input = src.format() == QImage::Format_RGB32 ? src : src.convertToFormat(QImage::Format_RGB32);
+    QImage output(input.size(), QImage::Format_RGB32);
+    if(output.isNull()){
+        return QImage();
+    }
+
+    Tables tables;
+    BuildTables(params, tables);
+    const RowFunc func = SelectKernel();
+
+    // 先取裸指针，工作线程中不再调用 scanLine()
+    const uchar * src_bits = input.constBits();
+    const qsizetype src_bpl = input.bytesPerLine();
+    uchar * dst_bits = output.bits();
+    const qsizetype dst_bpl = output.bytesPerLine();
+    const int width = input.width();
+    const int height = input.height();
+
+    const int threads = qMax(1, QThreadPool::globalInstance()->maxThreadCount());
+    const int band_rows = qMax(16, (height + threads * 2 - 1) / (threads * 2));
+    QVector<Band> bands;
+    for(int y = 0; y < height; y += band_rows){
+        bands.append(Band{y, qMin(y + band_rows, height), Histogram()});
+    }
+
+    auto process_band = [&](Band & band){
+        for(int y = band.y0; y < band.y1; ++y){
+            const quint32 * in = reinterpret_cast<const quint32 *>(src_bits + y * src_bpl);
+            quint32 * out = reinterpret_cast<quint32 *>(dst_bits + y * dst_bpl);
+            func(in, out, width, tables);
+            if(hist){
+                Accumulate(out, width, band.hist);
+            }
+        }
+    };
+
+    if(bands.size() == 1){
+        process_band(bands.first());
+    } else {
+        QtConcurrent::blockingMap(bands, process_band);
+    }
+
+    // 各条带的直方图单独统计，最后合并，避免线程间争用
+    if(hist){
+        *hist = Histogram();
+        for(const Band & band : bands){
+            for(int i = 0; i < 256; ++i){
+                hist->red[i] += band.hist.red[i];
+                hist->green[i] += band.hist.green[i];
+                hist->blue[i] += band.hist.blue[i];
+                hist->luma[i] += band.hist.luma[i];
+            }
+        }
+    }
+    return output;
+}
+
+QImage ImageAdjuster::RenderHistogram(const Histogram &hist, int width, int height)
+{
+    QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
+    image.fill(QColor(32, 32, 32));
+
+    // 纯黑、纯白两端常有尖峰，按中间部分的最大值归一化
+    quint32 peak = 1;
+    for(int i = 1; i < 255; ++i){
+        peak = qMax(peak, qMax(hist.luma[i], qMax(hist.red[i], qMax(hist.green[i], hist.blue[i]))));
+    }
+    auto y_of = [&](quint32 count){
+        return height - qMin(1.0, double(count) / peak) * (height - 1);
+    };
+    auto x_of = [&](int bin){
+        return bin * (width - 1) / 255.0;
+    };
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    QPainterPath luma;
+    luma.moveTo(0, height);
+    for(int i = 0; i < 256; ++i){
+        luma.lineTo(x_of(i), y_of(hist.luma[i]));
+    }
+    luma.lineTo(width - 1, height);
+    luma.closeSubpath();
+    painter.fillPath(luma, QColor(160, 160, 160, 160));
+
+    const std::array<quint32, 256> * channels[3] = {&hist.red, &hist.green, &hist.blue};
+    const QColor colors[3] = {QColor(255, 80, 80), QColor(80, 220, 80), QColor(90, 140, 255)};
+    for(int c = 0; c < 3; ++c){
+        QPainterPath line;
+        line.moveTo(x_of(0), y_of((*channels[c])[0]));
+        for(int i = 1; i < 256; ++i){
+            line.lineTo(x_of(i), y_of((*channels[c])[i]));
+        }
+        painter.setPen(QPen(colors[c], 1));
+        painter.drawPath(line);
+    }
+    return image;
+}
@@ -0,0 +1,41 @@
+#ifndef IMAGEADJUSTER_H
+#define IMAGEADJUSTER_H
+
+#include <QImage>
+#include <array>
+
+/*
+ * 显示用的实时调整：曝光、对比度、色阶、饱和度，不修改原图。
+ * 前几项合成为每个通道一张 256 项的查找表，饱和度是一个 3x3 颜色矩阵（12 位定点）；
+ * 一遍扫描完成查表、矩阵乘法，同时统计输出的直方图。
+ * 内核按运行时指令集选择 AVX2（查表用 gather）/ SSE4.1 / 标量实现，
+ * 按行分条带交给全局线程池并行处理，面向显示分辨率的缓冲区。
+ */
+class ImageAdjuster
+{
+public:
+    struct Params {
+        double exposure = 0.0;      // 曝光补偿（EV）
+        double contrast = 0.0;      // 对比度，-1 到 1
+        int black = 0;              // 输入黑场，0 到 254
+        int white = 255;            // 输入白场，black+1 到 255
+        double gamma = 1.0;         // 中间调
+        double saturation = 1.0;    // 饱和度，0 为灰度
+
+        bool IsIdentity() const;
+    };
+
+    struct Histogram {
+        std::array<quint32, 256> red{};
+        std::array<quint32, 256> green{};
+        std::array<quint32, 256> blue{};
+        std::array<quint32, 256> luma{};
+    };
+
+    // 对 src 应用调整，返回 Format_RGB32 图片；hist 不为空时同时统计输出直方图
+    static QImage Apply(const QImage & src, const Params & params, Histogram * hist = nullptr);
+    // 把直方图画成 width x height 的图片，亮度为灰色填充，三个通道为彩色折线
+    static QImage RenderHistogram(const Histogram & hist, int width, int height);
+};
+
+#endif // IMAGEADJUSTER_H
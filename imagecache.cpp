@@ -0,0 +1,137 @@
+#include "imagecache.h"
+
+ImageCache::ImageCache(const QString &name, qint64 limit)
+    : _name(name),
+    _hits(Metrics::GetCounter("cache." + name + ".hit")),
+    _misses(Metrics::GetCounter("cache." + name + ".miss")),
+    _bytes(0)
+{
+    MemoryBudget::GetInst().Register(this, limit);
+}
+
+ImageCache::~ImageCache()
+{
+    MemoryBudget::GetInst().Unregister(this);
+}
+
+void ImageCache::Insert(const QString &key, const QImage &image, double cost)
+{
+    if(image.isNull()){
+        return;
+    }
+
+    qint64 bytes = image.sizeInBytes();
+    qint64 released = 0;
+    {
+        QMutexLocker locker(&_mutex);
+        auto iter = _index.find(key);
+        if(iter != _index.end()){
+            released = iter.value()->bytes;
+            _lru.erase(iter.value());
+            _index.erase(iter);
+        }
+        _lru.push_front(Node{key, image, bytes, cost, MemoryBudget::Now()});
+        _index.insert(key, _lru.begin());
+        _bytes += bytes - released;
+    }
+
+    // 释放锁之后再记账，超出预算时 Charge 会回调 EvictVictim
+    if(released > 0){
+        MemoryBudget::GetInst().Release(this, released);
+    }
+    MemoryBudget::GetInst().Charge(this, bytes);
+}
+
+QImage ImageCache::Find(const QString &key)
+{
+    QMutexLocker locker(&_mutex);
+    auto iter = _index.find(key);
+    if(iter == _index.end()){
+        _misses.Add();
+        return QImage();
+    }
+    _hits.Add();
+    NodeIter node = iter.value();
+    node->last_access = MemoryBudget::Now();
+    // splice 只调整链表指针，原有迭代器保持有效
+    _lru.splice(_lru.begin(), _lru, node);
+    return node->image;
+}
+
+bool ImageCache::Contains(const QString &key)
+{
+    QMutexLocker locker(&_mutex);
+    return _index.contains(key);
+}
+
+void ImageCache::Remove(const QString &key)
+{
+    qint64 released = 0;
+    {
+        QMutexLocker locker(&_mutex);
+        auto iter = _index.find(key);
+        if(iter == _index.end()){
+            return;
+        }
+        released = iter.value()->bytes;
+        _lru.erase(iter.value());
+        _index.erase(iter);
+        _bytes -= released;
+    }
+    MemoryBudget::GetInst().Release(this, released);
+}
+
+void ImageCache::Clear()
+{
+    qint64 released = 0;
+    {
+        QMutexLocker locker(&_mutex);
+        released = _bytes;
+        _lru.clear();
+        _index.clear();
+        _bytes = 0;
+    }
+    MemoryBudget::GetInst().Release(this, released);
+}
+
+qint64 ImageCache::Bytes()
+{
+    QMutexLocker locker(&_mutex);
+    return _bytes;
+}
+
+QString ImageCache::CacheName() const
+{
+    return _name;
+}
+
+bool ImageCache::PeekVictim(qint64 &last_access, qint64 &bytes, double &cost)
+{
+    QMutexLocker locker(&_mutex);
+    if(_lru.empty()){
+        return false;
+    }
+    const Node & node = _lru.back();
+    last_access = node.last_access;
+    bytes = node.bytes;
+    cost = node.cost;
+    return true;
+}
+
+qint64 ImageCache::EvictVictim()
+{
+    qint64 released = 0;
+    {
+        QMutexLocker locker(&_mutex);
+        if(_lru.empty()){
+            return 0;
+        }
+        const Node & node = _lru.back();
+        released = node.bytes;
+        _index.remove(node.key);
+        _lru.pop_back();
+        _bytes -= released;
+    }
+    MemoryBudget::GetInst().Release(this, released);
+    return released;
+}
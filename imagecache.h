@@ -0,0 +1,55 @@
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+#include <list>
+#include "memorybudget.h"
+#include "metrics.h"
+
+/*
+ * 线程安全的 LRU 图片缓存，按 QImage::sizeInBytes 精确记账，
+ * 构造时注册到 MemoryBudget，由全局预算统一决定淘汰哪个缓存的条目。
+ * 解码缓存、缩略图缓存、幻灯片缓冲等都直接使用这个类。
+ */
+class ImageCache : public PixelCache
+{
+public:
+    explicit ImageCache(const QString & name, qint64 limit = 0);
+    ~ImageCache() override;
+
+    // cost 为重新生成该图片的代价（毫秒），越大越不容易被淘汰
+    void Insert(const QString & key, const QImage & image, double cost = 1.0);
+    // 命中时把条目移到 LRU 头部，未命中返回空图片
+    QImage Find(const QString & key);
+    bool Contains(const QString & key);
+    void Remove(const QString & key);
+    void Clear();
+    qint64 Bytes();
+
+    QString CacheName() const override;
+    bool PeekVictim(qint64 & last_access, qint64 & bytes, double & cost) override;
+    qint64 EvictVictim() override;
+
+private:
+    struct Node {
+        QString key;
+        QImage image;
+        qint64 bytes;
+        double cost;
+        qint64 last_access;
+    };
+    typedef std::list<Node>::iterator NodeIter;
+
+    QString _name;
+    Metrics::Counter & _hits;       // 性能统计：cache.<名称>.hit / miss
+    Metrics::Counter & _misses;
+    QMutex _mutex;
+    std::list<Node> _lru;          // 头部最近使用，尾部最久未使用
+    QHash<QString, NodeIter> _index;
+    qint64 _bytes;
+};
+
+#endif // IMAGECACHE_H
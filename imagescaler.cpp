@@ -0,0 +1,439 @@
+#include "imagescaler.h"
+#include "cpufeatures.h"
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrent>
+#include <cmath>
+
+#if defined(ALBUM_X86_SIMD)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// 每个像素 4 个通道，内存中的字节顺序由 ARGB32 格式和字节序决定
+const int kChannels = 4;
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+const int kAlphaLane = 3;
+#else
+const int kAlphaLane = 0;
+#endif
+
+// 一维滤波表：每个输出像素固定 taps 个抽头，权重已归一化
+struct FilterTable {
+    int taps = 0;
+    QVector<int> start;      // 每个输出像素对应的第一个源像素下标
+    QVector<float> weights;  // 按输出像素分组，每组 taps 个权重
+};
+
+// 输出行条带
+struct Band {
+    int y0;
+    int y1;
+};
+
+double LanczosKernel(double x)
+{
+    x = std::fabs(x);
+    if(x < 1e-8){
+        return 1.0;
+    }
+    if(x >= 3.0){
+        return 0.0;
+    }
+    double pix = M_PI * x;
+    return 3.0 * std::sin(pix) * std::sin(pix / 3.0) / (pix * pix);
+}
+
+// Keys 三次卷积（a = -0.5，即 Catmull-Rom）
+double CubicKernel(double x)
+{
+    x = std::fabs(x);
+    if(x < 1.0){
+        return (1.5 * x - 2.5) * x * x + 1.0;
+    }
+    if(x < 2.0){
+        return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+    }
+    return 0.0;
+}
+
+FilterTable BuildTable(int src_len, int dst_len, ImageScaler::Filter filter)
+{
+    FilterTable table;
+    double scale = double(dst_len) / src_len;
+    double radius = filter == ImageScaler::Lanczos3 ? 3.0 : 2.0;
+    // 缩小时把滤波核按比例拉宽，起到低通抗锯齿的作用
+    double fscale = qMin(scale, 1.0);
+    double support = radius / fscale;
+
+    table.taps = qMin(int(std::ceil(support * 2.0)) + 1, src_len);
+    table.start.resize(dst_len);
+    table.weights.resize(dst_len * table.taps);
+
+    for(int i = 0; i < dst_len; ++i){
+        double center = (i + 0.5) / scale;
+        // 窗口整体平移到图像内部，超出支撑范围的抽头权重自然为 0
+        int left = int(std::ceil(center - support - 0.5));
+        left = qBound(0, left, src_len - table.taps);
+        table.start[i] = left;
+
+        float * w = table.weights.data() + i * table.taps;
+        double sum = 0.0;
+        for(int k = 0; k < table.taps; ++k){
+            double x = (left + k + 0.5 - center) * fscale;
+            double v = filter == ImageScaler::Lanczos3 ? LanczosKernel(x) : CubicKernel(x);
+            w[k] = float(v);
+            sum += v;
+        }
+
+        if(std::fabs(sum) < 1e-12){
+            // 理论上不会出现，兜底取最近邻
+            for(int k = 0; k < table.taps; ++k){
+                w[k] = 0.0f;
+            }
+            w[qBound(0, int(center) - left, table.taps - 1)] = 1.0f;
+            continue;
+        }
+        for(int k = 0; k < table.taps; ++k){
+            w[k] = float(w[k] / sum);
+        }
+    }
+    return table;
+}
+
+// 水平滤波：一行源像素 -> 一行浮点中间结果（每像素 4 个 float）
+typedef void (*HorizontalFunc)(const quint32 * src, float * dst, int dst_w, const FilterTable & table);
+// 垂直滤波：taps 行中间结果加权累加到 acc，再饱和打包成一行输出像素
+typedef void (*VerticalFunc)(const float * const * rows, const float * w, int taps,
+                             float * acc, quint32 * dst, int dst_w);
+
+void HorizontalScalar(const quint32 * src, float * dst, int dst_w, const FilterTable & table)
+{
+    const int taps = table.taps;
+    for(int x = 0; x < dst_w; ++x){
+        const float * w = table.weights.constData() + x * taps;
+        const uchar * p = reinterpret_cast<const uchar *>(src + table.start[x]);
+        float a0 = 0.0f, a1 = 0.0f, a2 = 0.0f, a3 = 0.0f;
+        for(int k = 0; k < taps; ++k){
+            a0 += w[k] * p[0];
+            a1 += w[k] * p[1];
+            a2 += w[k] * p[2];
+            a3 += w[k] * p[3];
+            p += kChannels;
+        }
+        dst[0] = a0;
+        dst[1] = a1;
+        dst[2] = a2;
+        dst[3] = a3;
+        dst += kChannels;
+    }
+}
+
+inline int ClampByte(float v)
+{
+    int i = int(std::lround(v));
+    return i < 0 ? 0 : (i > 255 ? 255 : i);
+}
+
+void VerticalScalar(const float * const * rows, const float * w, int taps,
+                    float * acc, quint32 * dst, int dst_w)
+{
+    const int n = dst_w * kChannels;
+    for(int i = 0; i < n; ++i){
+        acc[i] = rows[0][i] * w[0];
+    }
+    for(int k = 1; k < taps; ++k){
+        const float * row = rows[k];
+        const float wk = w[k];
+        for(int i = 0; i < n; ++i){
+            acc[i] += row[i] * wk;
+        }
+    }
+
+    uchar * out = reinterpret_cast<uchar *>(dst);
+    for(int x = 0; x < dst_w; ++x){
+        const float * a = acc + x * kChannels;
+        int alpha = ClampByte(a[kAlphaLane]);
+        for(int c = 0; c < kChannels; ++c){
+            // 预乘格式要求颜色分量不超过 alpha，Lanczos 振铃可能越界
+            out[c] = uchar(c == kAlphaLane ? alpha : qMin(ClampByte(a[c]), alpha));
+        }
+        out += kChannels;
+    }
+}
+
+#if defined(ALBUM_X86_SIMD)
+
+ALBUM_TARGET_SSE41
+void HorizontalSse41(const quint32 * src, float * dst, int dst_w, const FilterTable & table)
+{
+    const int taps = table.taps;
+    for(int x = 0; x < dst_w; ++x){
+        const float * w = table.weights.constData() + x * taps;
+        const quint32 * p = src + table.start[x];
+        __m128 acc = _mm_setzero_ps();
+        for(int k = 0; k < taps; ++k){
+            __m128i px = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(int(p[k])));
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_cvtepi32_ps(px), _mm_set1_ps(w[k])));
+        }
+        _mm_storeu_ps(dst + x * kChannels, acc);
+    }
+}
+
+ALBUM_TARGET_SSE41
+void VerticalSse41(const float * const * rows, const float * w, int taps,
+                   float * acc, quint32 * dst, int dst_w)
+{
+    const int n = dst_w * kChannels;
+    __m128 w0 = _mm_set1_ps(w[0]);
+    for(int i = 0; i < n; i += 4){
+        _mm_storeu_ps(acc + i, _mm_mul_ps(_mm_loadu_ps(rows[0] + i), w0));
+    }
+    for(int k = 1; k < taps; ++k){
+        const float * row = rows[k];
+        __m128 wk = _mm_set1_ps(w[k]);
+        for(int i = 0; i < n; i += 4){
+            __m128 a = _mm_loadu_ps(acc + i);
+            _mm_storeu_ps(acc + i, _mm_add_ps(a, _mm_mul_ps(_mm_loadu_ps(row + i), wk)));
+        }
+    }
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i max = _mm_set1_epi32(255);
+    for(int x = 0; x < dst_w; ++x){
+        __m128i v = _mm_cvtps_epi32(_mm_loadu_ps(acc + x * kChannels));
+        v = _mm_min_epi32(_mm_max_epi32(v, zero), max);
+        v = _mm_min_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3)));
+        v = _mm_packus_epi32(v, v);
+        v = _mm_packus_epi16(v, v);
+        dst[x] = quint32(_mm_cvtsi128_si32(v));
+    }
+}
+
+ALBUM_TARGET_AVX2
+void HorizontalAvx2(const quint32 * src, float * dst, int dst_w, const FilterTable & table)
+{
+    const int taps = table.taps;
+    for(int x = 0; x < dst_w; ++x){
+        const float * w = table.weights.constData() + x * taps;
+        const quint32 * p = src + table.start[x];
+        // 一次处理两个抽头：低 128 位对应 k，高 128 位对应 k + 1
+        __m256 acc = _mm256_setzero_ps();
+        int k = 0;
+        for(; k + 1 < taps; k += 2){
+            __m128i two = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p + k));
+            __m256 px = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(two));
+            __m256 wv = _mm256_set_m128(_mm_set1_ps(w[k + 1]), _mm_set1_ps(w[k]));
+            acc = _mm256_fmadd_ps(px, wv, acc);
+        }
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+        if(k < taps){
+            __m128i px = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(int(p[k])));
+            sum = _mm_fmadd_ps(_mm_cvtepi32_ps(px), _mm_set1_ps(w[k]), sum);
+        }
+        _mm_storeu_ps(dst + x * kChannels, sum);
+    }
+}
+
+ALBUM_TARGET_AVX2
+void VerticalAvx2(const float * const * rows, const float * w, int taps,
+                  float * acc, quint32 * dst, int dst_w)
+{
+    const int n = dst_w * kChannels;
+    // n 是 4 的倍数，尾部不足 8 个的部分用 128 位处理
+    const int n8 = n & ~7;
+    __m256 w0 = _mm256_set1_ps(w[0]);
+    for(int i = 0; i < n8; i += 8){
+        _mm256_storeu_ps(acc + i, _mm256_mul_ps(_mm256_loadu_ps(rows[0] + i), w0));
+    }
+    if(n8 < n){
+        _mm_storeu_ps(acc + n8, _mm_mul_ps(_mm_loadu_ps(rows[0] + n8), _mm256_castps256_ps128(w0)));
+    }
+    for(int k = 1; k < taps; ++k){
+        const float * row = rows[k];
+        __m256 wk = _mm256_set1_ps(w[k]);
+        for(int i = 0; i < n8; i += 8){
+            _mm256_storeu_ps(acc + i, _mm256_fmadd_ps(_mm256_loadu_ps(row + i), wk,
+                                                      _mm256_loadu_ps(acc + i)));
+        }
+        if(n8 < n){
+            _mm_storeu_ps(acc + n8, _mm_fmadd_ps(_mm_loadu_ps(row + n8), _mm256_castps256_ps128(wk),
+                                                 _mm_loadu_ps(acc + n8)));
+        }
+    }
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i max = _mm256_set1_epi32(255);
+    int x = 0;
+    for(; x + 1 < dst_w; x += 2){
+        __m256i v = _mm256_cvtps_epi32(_mm256_loadu_ps(acc + x * kChannels));
+        v = _mm256_min_epi32(_mm256_max_epi32(v, zero), max);
+        v = _mm256_min_epi32(v, _mm256_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3)));
+        // pack 在每个 128 位通道内进行，两个像素分别落在两个通道的最低 4 字节
+        v = _mm256_packus_epi32(v, v);
+        v = _mm256_packus_epi16(v, v);
+        dst[x] = quint32(_mm_cvtsi128_si32(_mm256_castsi256_si128(v)));
+        dst[x + 1] = quint32(_mm_cvtsi128_si32(_mm256_extracti128_si256(v, 1)));
+    }
+    if(x < dst_w){
+        __m128i v = _mm_cvtps_epi32(_mm_loadu_ps(acc + x * kChannels));
+        v = _mm_min_epi32(_mm_max_epi32(v, _mm256_castsi256_si128(zero)), _mm256_castsi256_si128(max));
+        v = _mm_min_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3)));
+        v = _mm_packus_epi32(v, v);
+        v = _mm_packus_epi16(v, v);
+        dst[x] = quint32(_mm_cvtsi128_si32(v));
+    }
+}
+
+#endif // ALBUM_X86_SIMD
+
+void SelectKernels(HorizontalFunc & hfunc, VerticalFunc & vfunc)
+{
+    hfunc = HorizontalScalar;
+    vfunc = VerticalScalar;
+#if defined(ALBUM_X86_SIMD)
+    switch(CpuFeatures::BestIsa()){
+    case CpuFeatures::IsaAvx2:
+        hfunc = HorizontalAvx2;
+        vfunc = VerticalAvx2;
+        break;
+    case CpuFeatures::IsaSse41:
+        hfunc = HorizontalSse41;
+        vfunc = VerticalSse41;
+        break;
+    default:
+        break;
+    }
+#endif
+}
+
+} // namespace
+
+QImage ImageScaler::Scale(const QImage &src, const QSize &size, Filter filter)
+{
+    if(src.isNull() || size.isEmpty()){
+        return QImage();
+    }
+
+    // 内核只处理每像素 4 字节的格式，其余格式先统一转换
+    QImage::Format format = src.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied
+                                                  : QImage::Format_RGB32;
+    QImage input = src.format() == format ? src : src.convertToFormat(format);
+    if(input.size() == size){
+        return input;
+    }
+
+    const int dst_w = size.width();
+    const int dst_h = size.height();
+    QImage output(size, format);
+    if(output.isNull()){
+        return QImage();
+    }
+
+    const FilterTable xtable = BuildTable(input.width(), dst_w, filter);
+    const FilterTable ytable = BuildTable(input.height(), dst_h, filter);
+
+    HorizontalFunc hfunc;
+    VerticalFunc vfunc;
+    SelectKernels(hfunc, vfunc);
+
+    // 先取裸指针，避免在工作线程中调用 scanLine() 引发隐式共享的 detach
+    const uchar * src_bits = input.constBits();
+    const qsizetype src_bpl = input.bytesPerLine();
+    uchar * dst_bits = output.bits();
+    const qsizetype dst_bpl = output.bytesPerLine();
+
+    // 条带至少覆盖 4 倍垂直抽头数的源行，保证条带边界重复计算的水平滤波不超过约 25%
+    int threads = qMax(1, QThreadPool::globalInstance()->maxThreadCount());
+    double scale_y = double(dst_h) / input.height();
+    int min_rows = qMax(8, int(std::ceil(4.0 * ytable.taps * scale_y)));
+    int band_rows = qMax(min_rows, (dst_h + threads * 4 - 1) / (threads * 4));
+
+    QVector<Band> bands;
+    for(int y = 0; y < dst_h; y += band_rows){
+        bands.append(Band{y, qMin(y + band_rows, dst_h)});
+    }
+
+    auto process_band = [&](const Band & band){
+        const int row_floats = dst_w * kChannels;
+        const int s0 = ytable.start[band.y0];
+        const int s1 = ytable.start[band.y1 - 1] + ytable.taps;
+
+        // 条带内需要的源行先做水平滤波，结果放在条带私有的中间缓冲区
+        QVector<float> tmp((s1 - s0) * row_floats);
+        for(int sy = s0; sy < s1; ++sy){
+            const quint32 * line = reinterpret_cast<const quint32 *>(src_bits + sy * src_bpl);
+            hfunc(line, tmp.data() + (sy - s0) * row_floats, dst_w, xtable);
+        }
+
+        QVector<float> acc(row_floats);
+        QVector<const float *> rows(ytable.taps);
+        for(int y = band.y0; y < band.y1; ++y){
+            const int first = ytable.start[y] - s0;
+            for(int k = 0; k < ytable.taps; ++k){
+                rows[k] = tmp.constData() + (first + k) * row_floats;
+            }
+            quint32 * out = reinterpret_cast<quint32 *>(dst_bits + y * dst_bpl);
+            vfunc(rows.constData(), ytable.weights.constData() + y * ytable.taps, ytable.taps,
+                  acc.data(), out, dst_w);
+        }
+    };
+
+    if(bands.size() == 1){
+        process_band(bands.first());
+    } else {
+        QtConcurrent::blockingMap(bands, process_band);
+    }
+    return output;
+}
+
+QImage ImageScaler::Scale(const QImage &src, const QSize &size, Qt::AspectRatioMode mode, Filter filter)
+{
+    if(src.isNull()){
+        return QImage();
+    }
+    return Scale(src, src.size().scaled(size, mode), filter);
+}
+
+QString ImageScaler::Benchmark(const QImage &src, const QSize &size, int rounds)
+{
+    rounds = qMax(1, rounds);
+    QImage::Format format = src.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied
+                                                  : QImage::Format_RGB32;
+    QImage input = src.convertToFormat(format);
+
+    // 先各跑一次预热，排除首次分配和线程池启动的开销
+    input.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    Scale(input, size);
+
+    QElapsedTimer timer;
+    timer.start();
+    for(int i = 0; i < rounds; ++i){
+        input.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+    double qt_ms = timer.nsecsElapsed() / 1e6 / rounds;
+
+    QString report = QString("source %1x%2 -> %3x%4, %5 rounds\n")
+                         .arg(input.width()).arg(input.height())
+                         .arg(size.width()).arg(size.height()).arg(rounds);
+    report += QString("QImage::scaled(Smooth): %1 ms\n").arg(qt_ms, 0, 'f', 2);
+
+    const Filter filters[] = {Bicubic, Lanczos3};
+    const char * names[] = {"Bicubic", "Lanczos3"};
+    for(int f = 0; f < 2; ++f){
+        timer.restart();
+        for(int i = 0; i < rounds; ++i){
+            Scale(input, size, filters[f]);
+        }
+        double ms = timer.nsecsElapsed() / 1e6 / rounds;
+        report += QString("ImageScaler %1 (%2, %3 threads): %4 ms, %5x\n")
+                      .arg(names[f])
+                      .arg(CpuFeatures::IsaName(CpuFeatures::BestIsa()))
+                      .arg(QThreadPool::globalInstance()->maxThreadCount())
+                      .arg(ms, 0, 'f', 2)
+                      .arg(ms > 0 ? qt_ms / ms : 0.0, 0, 'f', 2);
+    }
+    return report;
+}
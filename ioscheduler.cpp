@@ -0,0 +1,217 @@
+#include "ioscheduler.h"
+#include "metrics.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <algorithm>
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// 一个统计窗口至少持续这么久、完成这么多任务才调整一次，避免单个大文件造成抖动
+const qint64 WINDOW_MS = 500;
+const int WINDOW_TASKS = 8;
+// 吞吐量变化超过 5% 才认为有差别
+const double RATE_TOLERANCE = 0.05;
+
+#ifdef Q_OS_LINUX
+int ReadSysInt(const QString & path, int fallback)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)){
+        return fallback;
+    }
+    bool ok = false;
+    int value = file.readAll().trimmed().toInt(&ok);
+    return ok ? value : fallback;
+}
+#endif
+
+} // namespace
+
+IoScheduler::IoScheduler(const QString &src_path, const QString &dst_path)
+    :_src(Probe(src_path)), _dst(Probe(dst_path)),
+    _window_bytes(0), _window_tasks(0), _last_rate(0), _step(1)
+{
+    const int cores = qMax(2, QThread::idealThreadCount());
+    if(_src.type == DeviceRotational || _dst.type == DeviceRotational){
+        // 两端任何一端是机械盘，并发读写都会让磁头来回寻道
+        _min_workers = 1;
+        _max_workers = 2;
+        _pool.setMaxThreadCount(1);
+    } else if(_src.type == DeviceSolid && _dst.type == DeviceSolid){
+        int depth = qMin(_src.queue_depth > 0 ? _src.queue_depth : 32,
+                         _dst.queue_depth > 0 ? _dst.queue_depth : 32);
+        _min_workers = 2;
+        _max_workers = qBound(_min_workers, depth, 64);
+        _pool.setMaxThreadCount(qBound(_min_workers, cores, _max_workers));
+    } else {
+        _min_workers = 1;
+        _max_workers = qMax(2, cores);
+        _pool.setMaxThreadCount(2);
+    }
+    _window.start();
+}
+
+IoScheduler::~IoScheduler()
+{
+    _pool.waitForDone();
+}
+
+IoScheduler::Device IoScheduler::Probe(const QString &path)
+{
+    Device device;
+#ifdef Q_OS_LINUX
+    struct stat st;
+    if(::stat(QFile::encodeName(path).constData(), &st) != 0 || major(st.st_dev) == 0){
+        // 匿名设备号：网络文件系统、btrfs 子卷、tmpfs，没有对应的块设备
+        return device;
+    }
+    QString sys = QFileInfo(QString("/sys/dev/block/%1:%2")
+                                .arg(major(st.st_dev)).arg(minor(st.st_dev))).canonicalFilePath();
+    if(sys.isEmpty()){
+        return device;
+    }
+    // 分区本身没有 queue 目录，要看所属的整块磁盘
+    if(QFileInfo::exists(sys + "/partition")){
+        sys = QFileInfo(sys).path();
+    }
+    int rotational = ReadSysInt(sys + "/queue/rotational", -1);
+    if(rotational < 0){
+        // device mapper、loop 等虚拟设备的 rotational 不可靠
+        return device;
+    }
+    device.name = QFileInfo(sys).fileName();
+    device.type = rotational ? DeviceRotational : DeviceSolid;
+    device.queue_depth = ReadSysInt(sys + "/queue/nr_requests", 0);
+#else
+    Q_UNUSED(path);
+#endif
+    return device;
+}
+
+quint64 IoScheduler::PhysicalOffset(const QString &path)
+{
+#ifdef Q_OS_LINUX
+    int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        return 0;
+    }
+    // 只要第一个区段；不带 FIEMAP_FLAG_SYNC，不强制刷写脏页
+    struct {
+        struct fiemap map;
+        struct fiemap_extent extent;
+    } request = {};
+    request.map.fm_start = 0;
+    request.map.fm_length = FIEMAP_MAX_OFFSET;
+    request.map.fm_extent_count = 1;
+    quint64 offset = 0;
+    if(ioctl(fd, FS_IOC_FIEMAP, &request.map) == 0 && request.map.fm_mapped_extents > 0){
+        offset = request.map.fm_extents[0].fe_physical;
+    } else {
+        struct stat st;
+        if(fstat(fd, &st) == 0){
+            offset = st.st_ino;
+        }
+    }
+    ::close(fd);
+    return offset;
+#else
+    Q_UNUSED(path);
+    return 0;
+#endif
+}
+
+void IoScheduler::Order(QVector<DirEntry> &files) const
+{
+    if(_src.type != DeviceRotational || files.size() < 2){
+        return;
+    }
+    QVector<QPair<quint64, int>> keys;
+    keys.reserve(files.size());
+    for(int i = 0; i < files.size(); ++i){
+        keys.append(qMakePair(PhysicalOffset(files.at(i).path), i));
+    }
+    std::sort(keys.begin(), keys.end());
+    QVector<DirEntry> sorted;
+    sorted.reserve(files.size());
+    for(const auto & key : keys){
+        sorted.append(files.at(key.second));
+    }
+    files.swap(sorted);
+}
+
+void IoScheduler::Submit(std::function<qint64()> task)
+{
+    static Metrics::Gauge & queued = Metrics::GetGauge("io.queue");
+    queued.Add(1);
+    _pool.start([this, task](){
+        qint64 bytes = task();
+        queued.Add(-1);
+        Record(bytes);
+    });
+}
+
+void IoScheduler::WaitForDone()
+{
+    _pool.waitForDone();
+}
+
+const IoScheduler::Device &IoScheduler::Source() const
+{
+    return _src;
+}
+
+int IoScheduler::Workers() const
+{
+    return _pool.maxThreadCount();
+}
+
+// 一个窗口结束时比较吞吐量，决定线程数加一还是减一
+void IoScheduler::Record(qint64 bytes)
+{
+    static Metrics::Counter & copied_bytes = Metrics::GetCounter("io.bytes");
+    static Metrics::Counter & copied_files = Metrics::GetCounter("io.files");
+    static Metrics::Gauge & worker_gauge = Metrics::GetGauge("io.workers");
+    copied_bytes.Add(qMax<qint64>(0, bytes));
+    copied_files.Add();
+
+    QMutexLocker locker(&_mutex);
+    worker_gauge.Set(_pool.maxThreadCount());
+    _window_bytes += qMax<qint64>(0, bytes);
+    ++_window_tasks;
+    qint64 elapsed = _window.elapsed();
+    if(elapsed < WINDOW_MS || _window_tasks < WINDOW_TASKS || _min_workers == _max_workers){
+        return;
+    }
+
+    double rate = double(_window_bytes) / elapsed;
+    if(_last_rate > 0){
+        if(rate < _last_rate * (1.0 - RATE_TOLERANCE)){
+            _step = _step ? -_step : -1;    // 上次调整让吞吐变差就换个方向，平台期变差则先减少
+        } else if(rate < _last_rate * (1.0 + RATE_TOLERANCE)){
+            _step = 0;          // 已经到平台期，保持不变
+        } else if(_step == 0){
+            _step = 1;          // 平台期之后吞吐又上升（例如缓存变热），继续试探
+        }
+    }
+    int workers = qBound(_min_workers, _pool.maxThreadCount() + _step, _max_workers);
+    if(workers != _pool.maxThreadCount()){
+        _pool.setMaxThreadCount(workers);
+    } else {
+        _step = 0;              // 已到上下限，等吞吐量变化再动
+    }
+    _last_rate = rate;
+    _window_bytes = 0;
+    _window_tasks = 0;
+    _window.restart();
+}
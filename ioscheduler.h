@@ -0,0 +1,72 @@
+#ifndef IOSCHEDULER_H
+#define IOSCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+#include <functional>
+#include "dirscanner.h"
+
+/*
+ * 按存储设备调整的 I/O 调度器，导入时复制文件用。
+ * 从 /sys/dev/block 读出源目录和目标目录所在设备是否是机械盘（queue/rotational）
+ * 以及设备队列深度（queue/nr_requests），据此决定初始并发数和上限：
+ *   机械盘：一个线程开始，最多两个，同一目录的文件按磁盘上的物理位置（FIEMAP）排序读，减少寻道；
+ *   固态盘：从 CPU 核数开始，上限取队列深度；
+ *   无法识别（网络文件系统、btrfs 等）：保守地从两个线程开始。
+ * 运行中按完成的字节数统计吞吐量，用爬山法增减并发数：吞吐上升就沿同方向继续，下降就反向。
+ */
+class IoScheduler
+{
+public:
+    enum DeviceClass {
+        DeviceUnknown,
+        DeviceRotational,   // 机械盘
+        DeviceSolid         // SSD、NVMe、闪存卡
+    };
+
+    struct Device {
+        DeviceClass type = DeviceUnknown;
+        int queue_depth = 0;    // 0 表示未知
+        QString name;           // 块设备名，例如 sda、nvme0n1
+    };
+
+    IoScheduler(const QString & src_path, const QString & dst_path);
+    ~IoScheduler();
+
+    // 识别 path 所在的块设备
+    static Device Probe(const QString & path);
+    // 文件第一个区段在设备上的物理偏移；FIEMAP 不可用时退回 inode 号，同样大致反映分配顺序
+    static quint64 PhysicalOffset(const QString & path);
+
+    // 机械盘上把文件按物理位置排序，其他设备保持原顺序
+    void Order(QVector<DirEntry> & files) const;
+    // 提交一个任务，返回值是任务读写的字节数，用于统计吞吐量
+    void Submit(std::function<qint64()> task);
+    void WaitForDone();
+
+    const Device & Source() const;
+    int Workers() const;
+
+private:
+    void Record(qint64 bytes);
+
+    Device _src;
+    Device _dst;
+    QThreadPool _pool;
+    int _min_workers;
+    int _max_workers;
+
+    QMutex _mutex;              // 保护下面的吞吐量统计
+    QElapsedTimer _window;      // 当前统计窗口
+    qint64 _window_bytes;
+    int _window_tasks;
+    double _last_rate;          // 上一个窗口的吞吐量（字节/毫秒）
+    int _step;                  // 上次调整的方向，+1 或 -1
+
+    Q_DISABLE_COPY(IoScheduler)
+};
+
+#endif // IOSCHEDULER_H
@@ -0,0 +1,68 @@
+#include "lazydirthread.h"
+#include "dirscanner.h"
+
+LazyDirThread::LazyDirThread(QObject *parent)
+    :QThread(parent), _bstop(false)
+{
+
+}
+
+LazyDirThread::~LazyDirThread()
+{
+    Stop();
+    wait();
+}
+
+// 提交一个待加载的目录，重复提交的目录提到队首
+void LazyDirThread::RequestDir(const QString &path)
+{
+    QMutexLocker locker(&_mutex);
+    _queue.removeAll(path);
+    _queue.prepend(path);
+    _cond.wakeOne();
+}
+
+void LazyDirThread::Stop()
+{
+    QMutexLocker locker(&_mutex);
+    _bstop = true;
+    _queue.clear();
+    _cond.wakeOne();
+}
+
+void LazyDirThread::run()
+{
+    while(true){
+        QString path;
+        {
+            QMutexLocker locker(&_mutex);
+            while(_queue.isEmpty() && !_bstop){
+                _cond.wait(&_mutex);
+            }
+            if(_bstop){
+                return;
+            }
+            path = _queue.takeFirst();
+        }
+
+        // 只列出第一层，子目录等展开时再加载
+        QVector<DirEntry> list;
+        DirScanner::List(path, list);
+
+        QStringList dirs;
+        QStringList pics;
+        for(int i = 0; i < list.size(); ++i){
+            const DirEntry & entry = list.at(i);
+            if(entry.is_dir){
+                dirs.append(entry.name);
+                continue;
+            }
+            if(!DirScanner::IsPicFile(entry.name)){
+                continue;   // 只处理图片文件，其他文件忽略
+            }
+            pics.append(entry.name);
+        }
+
+        emit SigDirLoaded(path, dirs, pics);
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef LAZYDIRTHREAD_H
+#define LAZYDIRTHREAD_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QStringList>
+
+/*
+ * 按需加载目录的后台线程。界面线程在节点展开时提交目录路径，
+ * 线程只列出该目录的第一层，把子目录和图片文件名通过信号交回界面线程创建节点。
+ * 后提交的请求先处理，用户最新展开的目录最先出现。
+ */
+class LazyDirThread : public QThread
+{
+    Q_OBJECT
+public:
+    explicit LazyDirThread(QObject * parent = nullptr);
+    ~LazyDirThread();
+    void RequestDir(const QString & path);
+    void Stop();
+protected:
+    virtual void run();
+private:
+    QMutex _mutex;
+    QWaitCondition _cond;
+    QStringList _queue;
+    bool _bstop;
+signals:
+    void SigDirLoaded(const QString & path, const QStringList & dirs, const QStringList & pics);
+};
+
+#endif // LAZYDIRTHREAD_H
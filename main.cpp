@@ -2,10 +2,51 @@
 
 #include <QApplication>
 #include <QFile>
+#include <QImage>
+#include "backgroundtask.h"
+#include "decodepool.h"
+#include "imagescaler.h"
+#include "memorybudget.h"
+#include "stressrunner.h"
 
 int main(int argc, char *argv[])
 {
+    // 解码子进程：Album --decode-worker，由 DecodePool 启动，不需要图形界面
+    if(argc >= 2 && qstrcmp(argv[1], "--decode-worker") == 0){
+        QCoreApplication worker(argc, argv);
+        return DecodePool::RunWorker();
+    }
     QApplication a(argc, argv);
+    // QSettings 默认构造使用组织名和应用名定位配置文件
+    QCoreApplication::setOrganizationName("Album");
+    QCoreApplication::setApplicationName("Album");
+    // 内存预算在主线程创建，压力通知和定时检查才能跑在主线程的事件循环里
+    MemoryBudget::GetInst();
+    // 缩放微基准：Album --bench-scale <图片> <目标宽度> [轮数]
+    QStringList args = a.arguments();
+    if(args.size() >= 4 && args.at(1) == "--bench-scale"){
+        QImage src(args.at(2));
+        if(src.isNull()){
+            qDebug() << "load image failed" << args.at(2) << Qt::endl;
+            return 1;
+        }
+        bool width_ok = false;
+        bool rounds_ok = true;
+        int width = args.at(3).toInt(&width_ok);
+        int rounds = args.size() >= 5 ? args.at(4).toInt(&rounds_ok) : 5;
+        if(!width_ok || !rounds_ok || width <= 0 || rounds <= 0){
+            qDebug() << "usage: Album --bench-scale <image> <width> [rounds], width and rounds must be positive"
+                     << Qt::endl;
+            return 1;
+        }
+        QSize size = src.size().scaled(width, src.height(), Qt::KeepAspectRatio);
+        qDebug().noquote() << ImageScaler::Benchmark(src, size, rounds);
+        return 0;
+    }
+    // 扫描和导入的并发压力测试：Album --stress <工作目录> [--entries N] [--threads N] [--cycles N]
+    if(args.size() >= 3 && args.at(1) == "--stress"){
+        return StressRunner::Run(args.mid(2));
+    }
     // 创建QFile对象读取QSS样式表文件（使用Qt资源系统）
     QFile qss(":/style/style.qss");
     // 尝试以只读方式打开QSS文件
@@ -21,6 +62,8 @@ int main(int argc, char *argv[])
         qDebug() << "open qss filed" << Qt::endl;
         return 0;
     }
+    // 用户操作时后台任务让路
+    BackgroundTask::InstallInputMonitor(&a);
     MainWindow w;
     // 设置窗口标题
     w.setWindowTitle("Album");
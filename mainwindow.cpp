@@ -5,8 +5,14 @@
 #include <QDebug>
 #include "wizard.h"
 #include "protree.h"
+#include "picshow.h"
 #include <QFileDialog>
 #include "protreewidget.h"
+#include <QMessageBox>
+#include <QTimer>
+#include "memorybudget.h"
+#include "packfile.h"
+#include "statspanel.h"
 
 /*
  * 这是主窗口的构造函数，负责初始化用户界面。它创建了文件菜单和设置菜单，
@@ -31,12 +37,29 @@ MainWindow::MainWindow(QWidget *parent)
     act_open_pro->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_O));
     menu_file->addAction(act_open_pro);
 
+    // 按需打开项目动作：只加载展开过的目录，适合层级很深的大项目
+    QAction * act_open_lazy = new QAction(QIcon(":/icon/openpro.png"), tr("按需打开项目"), this);
+    act_open_lazy->setShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_O));
+    menu_file->addAction(act_open_lazy);
+
+    // 打开单文件打包项目（*.album）
+    QAction * act_open_pack = new QAction(QIcon(":/icon/openpro.png"), tr("打开打包项目"), this);
+    menu_file->addAction(act_open_pack);
+
     // 创建设置菜单
     QMenu * menu_set = menuBar()->addMenu(tr("设置(&S)"));
     // 设置背景音乐
     QAction * act_music = new QAction(QIcon(":/icon/music.png"), tr("背景音乐"), this);
     act_music->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_M));
     menu_set->addAction(act_music);
+    // 查看各图片缓存的内存占用
+    QAction * act_memory = new QAction(tr("内存使用"), this);
+    menu_set->addAction(act_memory);
+    // 性能统计面板，默认隐藏，菜单项切换显示
+    auto * stats_panel = new StatsPanel(this);
+    addDockWidget(Qt::RightDockWidgetArea, stats_panel);
+    stats_panel->hide();
+    menu_set->addAction(stats_panel->toggleViewAction());
 
     // 连接信号和槽
 
@@ -44,6 +67,10 @@ MainWindow::MainWindow(QWidget *parent)
     connect(act_create_pro, &QAction::triggered, this, &MainWindow::SlotCreatePro);
     // 打开项目
     connect(act_open_pro, &QAction::triggered, this, &MainWindow::SlotOpenPro);
+    connect(act_open_lazy, &QAction::triggered, this, &MainWindow::SlotOpenProLazy);
+    connect(act_open_pack, &QAction::triggered, this, &MainWindow::SlotOpenPack);
+    // 内存使用
+    connect(act_memory, &QAction::triggered, this, &MainWindow::SlotShowMemory);
 
     // 创建项目树
     _protree = new ProTree();
@@ -55,6 +82,19 @@ MainWindow::MainWindow(QWidget *parent)
     auto * pro_tree_widget = dynamic_cast<ProTreeWidget*>(tree_widget);
 
     connect(this, &MainWindow::SigOpenPro, pro_tree_widget, &ProTreeWidget::SlotOpenPro);
+    connect(this, &MainWindow::SigOpenProLazy, pro_tree_widget, &ProTreeWidget::SlotOpenProLazy);
+    connect(this, &MainWindow::SigOpenPack, pro_tree_widget, &ProTreeWidget::SlotOpenPack);
+
+    // 创建图片显示区域
+    _picshow = new PicShow();
+    ui->picLayout->addWidget(_picshow);
+    auto * pro_pic_show = dynamic_cast<PicShow*>(_picshow);
+    connect(pro_tree_widget, &ProTreeWidget::SigUpdateSelected, pro_pic_show, &PicShow::SlotSelectItem);
+    connect(pro_pic_show, &PicShow::SigPreClicked, pro_tree_widget, &ProTreeWidget::SlotPreShow);
+    connect(pro_pic_show, &PicShow::SigNextClicked, pro_tree_widget, &ProTreeWidget::SlotNextShow);
+
+    // 窗口显示之后再恢复上次打开的项目
+    QTimer::singleShot(0, pro_tree_widget, &ProTreeWidget::RestoreSession);
 }
 
 MainWindow::~MainWindow()
@@ -88,6 +128,38 @@ void MainWindow::SlotCreatePro(bool)
 
 // MainWindow 类的槽函数，用于打开一个项目目录
 void MainWindow::SlotOpenPro(bool)
+{
+    QString import_path = SelectProDir();
+    if(import_path.isEmpty()){
+        return;
+    }
+    // 发出信号，将选择的目录路径传递出去
+    emit SigOpenPro(import_path);
+}
+
+// 按需打开项目
+void MainWindow::SlotOpenProLazy(bool)
+{
+    QString import_path = SelectProDir();
+    if(import_path.isEmpty()){
+        return;
+    }
+    emit SigOpenProLazy(import_path);
+}
+
+// 打开打包项目
+void MainWindow::SlotOpenPack(bool)
+{
+    QString pack_path = QFileDialog::getOpenFileName(this, tr("选择打包项目"), QDir::currentPath(),
+                                                     tr("打包项目 (*%1)").arg(PackFile::Suffix()));
+    if(pack_path.isEmpty()){
+        return;
+    }
+    emit SigOpenPack(pack_path);
+}
+
+// 弹出目录选择对话框，用户取消时返回空字符串
+QString MainWindow::SelectProDir()
 {
     // 创建一个文件对话框对象
     QFileDialog file_dialog;
@@ -109,15 +181,15 @@ void MainWindow::SlotOpenPro(bool)
 
     // 如果用户没有选择任何目录，则直接返回
     if(fileNames.length() <= 0){
-        return;
+        return QString();
     }
 
     // 获取第一个用户选择的路径
-    QString import_path = fileNames.at(0);
-    // 发出信号，将选择的目录路径传递出去
-    emit SigOpenPro(import_path);
+    return fileNames.at(0);
 }
 
-
-
-
+// 显示全局内存预算下各缓存的当前占用
+void MainWindow::SlotShowMemory(bool)
+{
+    QMessageBox::information(this, tr("内存使用"), MemoryBudget::GetInst().UsageReport());
+}
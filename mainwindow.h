@@ -20,11 +20,18 @@ public:
 private:
     Ui::MainWindow *ui;
     QWidget * _protree;
+    QWidget * _picshow;
+    QString SelectProDir();
 
 private slots:
     void SlotCreatePro(bool);
     void SlotOpenPro(bool);
+    void SlotShowMemory(bool);
+    void SlotOpenProLazy(bool);
+    void SlotOpenPack(bool);
 signals:
     void SigOpenPro(const QString &path);
+    void SigOpenProLazy(const QString &path);
+    void SigOpenPack(const QString &path);
 };
 #endif // MAINWINDOW_H
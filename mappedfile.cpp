@@ -0,0 +1,94 @@
+#include "mappedfile.h"
+#include "packfile.h"
+#include <limits>
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const QString &path)
+    :_map(nullptr)
+{
+    int index = -1;
+    _pack = PackFile::Resolve(path, index);
+    if(_pack){
+        _data = _pack->Data(index);
+        return;
+    }
+
+    _file.setFileName(path);
+    if(!_file.open(QIODevice::ReadOnly)){
+        return;
+    }
+    qint64 size = _file.size();
+    if(size > 0 && size <= std::numeric_limits<int>::max()){
+        _map = _file.map(0, size);
+    }
+    if(_map){
+#ifdef Q_OS_LINUX
+        // 解码器从头到尾顺序读，让内核按顺序读的方式加大预读
+        madvise(_map, size_t(size), MADV_SEQUENTIAL);
+#endif
+        _data = QByteArray::fromRawData(reinterpret_cast<const char*>(_map), int(size));
+    } else {
+        _data = _file.readAll();
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    // 先释放对映射区的引用，再解除映射
+    _data.clear();
+    if(_map){
+        _file.unmap(_map);
+    }
+}
+
+bool MappedFile::IsValid() const
+{
+    return !_data.isEmpty();
+}
+
+const QByteArray &MappedFile::Data() const
+{
+    return _data;
+}
+
+void MappedFile::WillNeed(const QString &path)
+{
+    int index = -1;
+    std::shared_ptr<PackFile> pack = PackFile::Resolve(path, index);
+    if(pack){
+        pack->Advise(index, true);
+        return;
+    }
+#ifdef Q_OS_LINUX
+    int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        return;
+    }
+    // 只是发起读入，内核在后台完成；关闭文件后读入的页仍留在页缓存中
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    ::close(fd);
+#endif
+}
+
+void MappedFile::DontNeed(const QString &path)
+{
+    int index = -1;
+    std::shared_ptr<PackFile> pack = PackFile::Resolve(path, index);
+    if(pack){
+        pack->Advise(index, false);
+        return;
+    }
+#ifdef Q_OS_LINUX
+    int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        return;
+    }
+    // 仍被映射的页不会被丢弃，所以要在 MappedFile 释放之后调用
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+#endif
+}
@@ -0,0 +1,43 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <memory>
+
+class PackFile;
+
+/*
+ * 图片数据源：把文件映射到内存，解码器直接读映射区，
+ * 不再先把整个压缩文件读进堆内存。虚拟路径直接引用包文件的映射区。
+ * 映射失败（空文件、不支持映射的文件系统）时退回一次性读取。
+ *
+ * 另外提供预读提示：顺序浏览、导出时提前让内核读入后面的图片（WILLNEED），
+ * 用完的图片从页缓存丢弃（DONTNEED），长时间顺序浏览不挤占页缓存。
+ */
+class MappedFile
+{
+public:
+    explicit MappedFile(const QString & path);
+    ~MappedFile();
+
+    bool IsValid() const;
+    // 文件内容；映射时不拷贝，MappedFile 释放前有效
+    const QByteArray & Data() const;
+
+    // 提示内核异步读入文件，不等待
+    static void WillNeed(const QString & path);
+    // 提示内核文件暂时不再需要，可以从页缓存丢弃
+    static void DontNeed(const QString & path);
+
+private:
+    QFile _file;
+    uchar * _map;
+    std::shared_ptr<PackFile> _pack;    // 虚拟路径：保持包文件的映射
+    QByteArray _data;
+
+    Q_DISABLE_COPY(MappedFile)
+};
+
+#endif // MAPPEDFILE_H
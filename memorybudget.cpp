@@ -0,0 +1,415 @@
+#include "memorybudget.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSettings>
+#include <QSocketNotifier>
+#include <QTimer>
+#include <QDebug>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <cstring>
+#endif
+
+namespace {
+const qint64 MB = 1024 * 1024;
+
+// 读取 cgroup/proc 下只有一个数字的文件，读不到或者是 "max" 时返回 -1
+qint64 ReadNumberFile(const QString & path)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)){
+        return -1;
+    }
+    QByteArray text = file.readAll().trimmed();
+    bool ok = false;
+    qint64 value = text.toLongLong(&ok);
+    return ok ? value : -1;
+}
+}
+
+MemoryBudget &MemoryBudget::GetInst()
+{
+    static MemoryBudget inst;
+    return inst;
+}
+
+qint64 MemoryBudget::Now()
+{
+    // 局部静态变量的初始化是线程安全的，之后只读
+    static const QElapsedTimer timer = [](){
+        QElapsedTimer t;
+        t.start();
+        return t;
+    }();
+    return timer.elapsed();
+}
+
+MemoryBudget::MemoryBudget(QObject *parent)
+    : QObject(parent), _pending_caches(false), _pending_target(kNoTarget),
+    _total(0), _limit(DefaultLimit()), _psi_fd(-1),
+    _psi_notifier(nullptr), _cgroup_timer(nullptr)
+{
+    // 通知器和定时器只在所属线程的事件循环里工作。单例第一次可能在工作线程里被访问，
+    // 那个线程没有事件循环或很快退出，所以对象归主线程所有，监控也排到主线程里建立
+    QCoreApplication * app = QCoreApplication::instance();
+    if(app && thread() != app->thread()){
+        moveToThread(app->thread());
+        QMetaObject::invokeMethod(this, [this](){
+            SetupPressureMonitor();
+        }, Qt::QueuedConnection);
+        return;
+    }
+    SetupPressureMonitor();
+}
+
+MemoryBudget::~MemoryBudget()
+{
+#ifdef Q_OS_LINUX
+    if(_psi_fd >= 0){
+        ::close(_psi_fd);
+    }
+#endif
+}
+
+qint64 MemoryBudget::DefaultLimit()
+{
+    // 优先使用配置的总预算
+    QSettings settings;
+    qint64 configured = settings.value("memory/budget_mb", 0).toLongLong();
+    if(configured > 0){
+        return configured * MB;
+    }
+
+    // 默认取物理内存的四分之一，最多 2GB
+    qint64 physical = 4096 * MB;
+#if defined(Q_OS_UNIX) && defined(_SC_PHYS_PAGES)
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page_size = sysconf(_SC_PAGE_SIZE);
+    if(pages > 0 && page_size > 0){
+        physical = qint64(pages) * page_size;
+    }
+#endif
+    return qMin(physical / 4, 2048 * MB);
+}
+
+void MemoryBudget::Register(PixelCache *cache, qint64 limit)
+{
+    if(limit <= 0){
+        QSettings settings;
+        limit = settings.value(QString("memory/%1_mb").arg(cache->CacheName()), 0).toLongLong() * MB;
+    }
+    QMutexLocker locker(&_mutex);
+    _caches.insert(cache, Entry{0, limit, 0});
+}
+
+void MemoryBudget::Unregister(PixelCache *cache)
+{
+    // 等待正在进行的淘汰结束，避免淘汰过程访问已析构的缓存
+    QMutexLocker enforce_locker(&_enforce_mutex);
+    QMutexLocker locker(&_mutex);
+    auto iter = _caches.find(cache);
+    if(iter == _caches.end()){
+        return;
+    }
+    _total -= iter->bytes;
+    _caches.erase(iter);
+}
+
+void MemoryBudget::Charge(PixelCache *cache, qint64 bytes)
+{
+    bool over_cache = false;
+    bool over_total = false;
+    {
+        QMutexLocker locker(&_mutex);
+        auto iter = _caches.find(cache);
+        if(iter == _caches.end()){
+            return;
+        }
+        iter->bytes += bytes;
+        _total += bytes;
+        over_cache = iter->limit > 0 && iter->bytes > iter->limit;
+        over_total = _total > _limit;
+    }
+
+    // 先让超出自身上限的缓存自己腾空间，再在所有缓存之间平衡总预算
+    if(over_cache){
+        Enforce(0, cache);
+    }
+    if(over_total){
+        Enforce(Limit());
+    }
+    emit SigUsageChanged();
+}
+
+void MemoryBudget::Release(PixelCache *cache, qint64 bytes)
+{
+    QMutexLocker locker(&_mutex);
+    auto iter = _caches.find(cache);
+    if(iter == _caches.end()){
+        return;
+    }
+    iter->bytes -= bytes;
+    _total -= bytes;
+}
+
+qint64 MemoryBudget::TotalBytes()
+{
+    QMutexLocker locker(&_mutex);
+    return _total;
+}
+
+qint64 MemoryBudget::Limit()
+{
+    QMutexLocker locker(&_mutex);
+    return _limit;
+}
+
+void MemoryBudget::SetLimit(qint64 bytes)
+{
+    {
+        QMutexLocker locker(&_mutex);
+        _limit = bytes;
+    }
+    Enforce(bytes);
+}
+
+void MemoryBudget::SetCacheLimit(PixelCache *cache, qint64 bytes)
+{
+    {
+        QMutexLocker locker(&_mutex);
+        auto iter = _caches.find(cache);
+        if(iter == _caches.end()){
+            return;
+        }
+        iter->limit = bytes;
+    }
+    if(bytes > 0){
+        Enforce(0, cache);
+    }
+}
+
+QList<MemoryBudget::CacheUsage> MemoryBudget::Usage()
+{
+    QMutexLocker locker(&_mutex);
+    QList<CacheUsage> list;
+    for(auto iter = _caches.begin(); iter != _caches.end(); ++iter){
+        list.append(CacheUsage{iter.key()->CacheName(), iter->bytes, iter->limit, iter->evictions});
+    }
+    return list;
+}
+
+QString MemoryBudget::UsageReport()
+{
+    QString report;
+    const QList<CacheUsage> list = Usage();
+    for(const CacheUsage & usage : list){
+        report += QString("%1: %2 MB").arg(usage.name).arg(double(usage.bytes) / MB, 0, 'f', 1);
+        if(usage.limit > 0){
+            report += QString(" / %1 MB").arg(usage.limit / MB);
+        }
+        report += QString(", evictions %1\n").arg(usage.evictions);
+    }
+    report += QString("total: %1 MB / %2 MB")
+                  .arg(double(TotalBytes()) / MB, 0, 'f', 1).arg(Limit() / MB);
+    return report;
+}
+
+void MemoryBudget::Shrink(double ratio)
+{
+    Enforce(qint64(TotalBytes() * ratio));
+}
+
+// 淘汰直到总用量（或 only 指定的缓存用量）不超过目标值。
+// 请求先登记再抢淘汰锁；已有线程在淘汰时直接返回，不阻塞解码线程，
+// 持锁的线程释放锁后发现还有登记的请求会再抢一次锁补做，请求不会丢失
+void MemoryBudget::Enforce(qint64 target, PixelCache *only)
+{
+    if(only){
+        _pending_caches = true;
+    } else {
+        // 多个请求合并为最低的目标值
+        qint64 current = _pending_target.load();
+        while(target < current && !_pending_target.compare_exchange_weak(current, target)){
+        }
+    }
+
+    while(_enforce_mutex.tryLock()){
+        if(_pending_caches.exchange(false)){
+            QList<PixelCache *> over;
+            {
+                QMutexLocker locker(&_mutex);
+                for(auto iter = _caches.constBegin(); iter != _caches.constEnd(); ++iter){
+                    if(iter->limit > 0 && iter->bytes > iter->limit){
+                        over.append(iter.key());
+                    }
+                }
+            }
+            for(PixelCache * cache : over){
+                Evict(0, cache);
+            }
+        }
+        qint64 pending = _pending_target.exchange(kNoTarget);
+        if(pending != kNoTarget){
+            Evict(pending, nullptr);
+        }
+        _enforce_mutex.unlock();
+
+        if(!_pending_caches && _pending_target.load() == kNoTarget){
+            break;
+        }
+    }
+}
+
+// 持有淘汰锁时调用
+void MemoryBudget::Evict(qint64 target, PixelCache *only)
+{
+    // 最多淘汰这么多次，防止缓存实现有误时死循环
+    for(int round = 0; round < 1000000; ++round){
+        QList<PixelCache *> candidates;
+        {
+            QMutexLocker locker(&_mutex);
+            if(only){
+                auto iter = _caches.find(only);
+                if(iter == _caches.end() || iter->bytes <= iter->limit){
+                    break;
+                }
+                candidates.append(only);
+            } else {
+                if(_total <= target){
+                    break;
+                }
+                candidates = _caches.keys();
+            }
+        }
+
+        // 不持有记账锁调用缓存接口，缓存在 EvictVictim 里会回调 Release
+        PixelCache * victim = nullptr;
+        double best_score = -1.0;
+        qint64 now = Now();
+        for(PixelCache * cache : candidates){
+            qint64 last_access = 0;
+            qint64 bytes = 0;
+            double cost = 0.0;
+            if(!cache->PeekVictim(last_access, bytes, cost)){
+                continue;
+            }
+            double score = double(now - last_access + 1) * double(bytes) / qMax(cost, 0.001);
+            if(score > best_score){
+                best_score = score;
+                victim = cache;
+            }
+        }
+        if(!victim){
+            break;
+        }
+
+        qint64 freed = victim->EvictVictim();
+        {
+            QMutexLocker locker(&_mutex);
+            auto iter = _caches.find(victim);
+            if(iter != _caches.end()){
+                iter->evictions++;
+            }
+        }
+        if(freed <= 0){
+            break;
+        }
+    }
+}
+
+void MemoryBudget::SetupPressureMonitor()
+{
+#ifdef Q_OS_LINUX
+    // cgroup v2：/proc/self/cgroup 中 "0::<路径>" 一行给出当前进程所在的 cgroup
+    QFile cgroup_file("/proc/self/cgroup");
+    if(cgroup_file.open(QIODevice::ReadOnly)){
+        const QList<QByteArray> lines = cgroup_file.readAll().split('\n');
+        for(const QByteArray & line : lines){
+            if(line.startsWith("0::")){
+                _cgroup_dir = "/sys/fs/cgroup" + QString::fromLocal8Bit(line.mid(3)).trimmed();
+                break;
+            }
+        }
+    }
+    if(!_cgroup_dir.isEmpty() && !QFile::exists(_cgroup_dir + "/memory.current")){
+        _cgroup_dir.clear();
+    }
+
+    // PSI 触发器：2 秒窗口内内存停顿超过 150ms 时内核发出 POLLPRI 事件
+    QString psi_path = "/proc/pressure/memory";
+    if(!_cgroup_dir.isEmpty() && QFile::exists(_cgroup_dir + "/memory.pressure")){
+        psi_path = _cgroup_dir + "/memory.pressure";
+    }
+    _psi_fd = ::open(QFile::encodeName(psi_path).constData(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if(_psi_fd >= 0){
+        const char trigger[] = "some 150000 2000000";
+        if(::write(_psi_fd, trigger, strlen(trigger) + 1) < 0){
+            qDebug() << "psi trigger unavailable" << psi_path << Qt::endl;
+            ::close(_psi_fd);
+            _psi_fd = -1;
+        }
+    }
+    if(_psi_fd >= 0){
+        _psi_notifier = new QSocketNotifier(_psi_fd, QSocketNotifier::Exception, this);
+        connect(_psi_notifier, &QSocketNotifier::activated, this, [this](){
+            SlotPressureEvent();
+        });
+    }
+
+    // 定时检查 cgroup 上限和系统可用内存，作为 PSI 不可用时的补充
+    _cgroup_timer = new QTimer(this);
+    connect(_cgroup_timer, &QTimer::timeout, this, &MemoryBudget::SlotPollCgroup);
+    _cgroup_timer->start(2000);
+#endif
+}
+
+void MemoryBudget::SlotPressureEvent()
+{
+    qDebug() << "memory pressure, shrink caches" << Qt::endl;
+    Shrink(0.5);
+    emit SigMemoryPressure();
+    emit SigUsageChanged();
+}
+
+void MemoryBudget::SlotPollCgroup()
+{
+    bool pressure = false;
+    if(!_cgroup_dir.isEmpty()){
+        qint64 max = ReadNumberFile(_cgroup_dir + "/memory.max");
+        qint64 current = ReadNumberFile(_cgroup_dir + "/memory.current");
+        // 超过 cgroup 上限的 90% 时即将触发 OOM
+        if(max > 0 && current > max / 10 * 9){
+            pressure = true;
+        }
+    }
+
+    QFile meminfo("/proc/meminfo");
+    if(meminfo.open(QIODevice::ReadOnly)){
+        qint64 total = -1;
+        qint64 available = -1;
+        const QList<QByteArray> lines = meminfo.readAll().split('\n');
+        for(const QByteArray & line : lines){
+            QList<QByteArray> fields = line.simplified().split(' ');
+            if(fields.size() < 2){
+                continue;
+            }
+            if(fields.at(0) == "MemTotal:"){
+                total = fields.at(1).toLongLong();
+            } else if(fields.at(0) == "MemAvailable:"){
+                available = fields.at(1).toLongLong();
+            }
+        }
+        if(total > 0 && available >= 0 && available < total / 20){
+            pressure = true;
+        }
+    }
+
+    if(pressure && TotalBytes() > 0){
+        SlotPressureEvent();
+    }
+}
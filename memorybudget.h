@@ -0,0 +1,103 @@
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+#include <QObject>
+#include <QMutex>
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <atomic>
+#include <limits>
+
+class QSocketNotifier;
+class QTimer;
+
+/*
+ * 参与全局内存预算的像素缓存需要实现的接口。
+ * 注意：缓存调用 MemoryBudget::Charge/Release 时不能持有自己的锁，
+ * 因为超出预算时 Charge 会回调 PeekVictim/EvictVictim。
+ */
+class PixelCache
+{
+public:
+    virtual ~PixelCache() {}
+    virtual QString CacheName() const = 0;
+    // 取最久未使用条目的信息：最后访问时间(ms)、字节数、重新生成代价(ms)，没有条目返回 false
+    virtual bool PeekVictim(qint64 & last_access, qint64 & bytes, double & cost) = 0;
+    // 淘汰最久未使用的条目，返回释放的字节数
+    virtual qint64 EvictVictim() = 0;
+};
+
+/*
+ * 全局内存预算服务，所有像素缓存注册到这里统一记账。
+ * 超出总预算或单个缓存的上限时，在各缓存的 LRU 尾部之间按
+ * “闲置时间 × 字节数 / 重建代价” 选出得分最高的条目淘汰；
+ * Linux 上还会监听 cgroup 内存上限和 PSI 内存压力，压力出现时主动收缩。
+ */
+class MemoryBudget : public QObject
+{
+    Q_OBJECT
+public:
+    struct CacheUsage {
+        QString name;
+        qint64 bytes;
+        qint64 limit;
+        qint64 evictions;
+    };
+
+    static MemoryBudget & GetInst();
+    // 单调时钟，缓存用它记录条目的最后访问时间
+    static qint64 Now();
+
+    // limit 为 0 时使用配置 memory/<name>_mb，仍为 0 则只受总预算约束
+    void Register(PixelCache * cache, qint64 limit = 0);
+    void Unregister(PixelCache * cache);
+    void Charge(PixelCache * cache, qint64 bytes);
+    void Release(PixelCache * cache, qint64 bytes);
+
+    qint64 TotalBytes();
+    qint64 Limit();
+    void SetLimit(qint64 bytes);
+    void SetCacheLimit(PixelCache * cache, qint64 bytes);
+    QList<CacheUsage> Usage();
+    QString UsageReport();
+    // 收缩到当前总用量的 ratio 倍以下
+    void Shrink(double ratio);
+
+signals:
+    void SigUsageChanged();
+    void SigMemoryPressure();
+
+private slots:
+    void SlotPressureEvent();
+    void SlotPollCgroup();
+
+private:
+    explicit MemoryBudget(QObject * parent = nullptr);
+    ~MemoryBudget();
+    void Enforce(qint64 target, PixelCache * only = nullptr);
+    void Evict(qint64 target, PixelCache * only);
+    void SetupPressureMonitor();
+    static qint64 DefaultLimit();
+
+    struct Entry {
+        qint64 bytes;
+        qint64 limit;
+        qint64 evictions;
+    };
+
+    QMutex _mutex;            // 保护记账数据
+    QMutex _enforce_mutex;    // 串行化淘汰过程，并防止淘汰期间缓存被注销
+    static constexpr qint64 kNoTarget = std::numeric_limits<qint64>::max();
+    std::atomic<bool> _pending_caches;      // 有缓存超出自身上限，等待淘汰
+    std::atomic<qint64> _pending_target;    // 等待淘汰到的总用量目标，kNoTarget 表示没有
+    QMap<PixelCache *, Entry> _caches;
+    qint64 _total;
+    qint64 _limit;
+    int _psi_fd;
+    QSocketNotifier * _psi_notifier;
+    QTimer * _cgroup_timer;
+    QString _cgroup_dir;
+};
+
+#endif // MEMORYBUDGET_H
@@ -0,0 +1,207 @@
+#include "metrics.h"
+#include <QDateTime>
+#include <QFile>
+#include <QJsonDocument>
+#include <QMutex>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QtAlgorithms>
+#include <map>
+#include <memory>
+
+namespace {
+
+// 注册表只在第一次取某个名称时加锁，之后调用方持有引用
+struct Registry {
+    QMutex mutex;
+    std::map<QString, std::unique_ptr<Metrics::Counter>> counters;
+    std::map<QString, std::unique_ptr<Metrics::Gauge>> gauges;
+    std::map<QString, std::unique_ptr<Metrics::Histogram>> histograms;
+};
+
+Registry & GetRegistry()
+{
+    static Registry registry;
+    return registry;
+}
+
+template <typename T>
+T & GetOrCreate(std::map<QString, std::unique_ptr<T>> & map, const QString & name)
+{
+    QMutexLocker locker(&GetRegistry().mutex);
+    std::unique_ptr<T> & slot = map[name];
+    if(!slot){
+        slot.reset(new T);
+    }
+    return *slot;
+}
+
+} // namespace
+
+int Metrics::Histogram::BucketOf(qint64 value)
+{
+    if(value < SUB_COUNT){
+        return int(qMax<qint64>(0, value));
+    }
+    // value 的最高位在 msb，取最高位下面的 SUB_BITS 位作为桶内序号
+    int msb = 63 - int(qCountLeadingZeroBits(quint64(value)));
+    int shift = msb - SUB_BITS;
+    int sub = int(value >> shift) - SUB_COUNT;
+    return qMin(BUCKETS - 1, SUB_COUNT + shift * SUB_COUNT + sub);
+}
+
+qint64 Metrics::Histogram::BucketUpper(int index)
+{
+    if(index < SUB_COUNT){
+        return index;
+    }
+    int shift = index / SUB_COUNT - 1;
+    int sub = index % SUB_COUNT;
+    return (qint64(SUB_COUNT + sub + 1) << shift) - 1;
+}
+
+void Metrics::Histogram::Record(qint64 micros)
+{
+    _buckets[BucketOf(micros)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(micros, std::memory_order_relaxed);
+    qint64 max = _max.load(std::memory_order_relaxed);
+    while(micros > max && !_max.compare_exchange_weak(max, micros, std::memory_order_relaxed)){
+    }
+}
+
+qint64 Metrics::Histogram::Count() const
+{
+    return _count.load(std::memory_order_relaxed);
+}
+
+qint64 Metrics::Histogram::Max() const
+{
+    return _max.load(std::memory_order_relaxed);
+}
+
+double Metrics::Histogram::Mean() const
+{
+    qint64 count = Count();
+    return count > 0 ? double(_sum.load(std::memory_order_relaxed)) / count : 0.0;
+}
+
+// 各桶计数是分别读的，并发记录时结果近似，对观察趋势足够
+qint64 Metrics::Histogram::Percentile(double q) const
+{
+    qint64 total = 0;
+    std::array<quint32, BUCKETS> counts;
+    for(int i = 0; i < BUCKETS; ++i){
+        counts[i] = _buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if(total == 0){
+        return 0;
+    }
+    qint64 target = qMax<qint64>(1, qint64(q * total + 0.5));
+    qint64 seen = 0;
+    for(int i = 0; i < BUCKETS; ++i){
+        seen += counts[i];
+        if(seen >= target){
+            return qMin(BucketUpper(i), Max());
+        }
+    }
+    return Max();
+}
+
+Metrics::ScopedTimer::ScopedTimer(Histogram &histogram)
+    :_histogram(histogram)
+{
+    _timer.start();
+}
+
+Metrics::ScopedTimer::~ScopedTimer()
+{
+    _histogram.Record(_timer.nsecsElapsed() / 1000);
+}
+
+Metrics::Counter &Metrics::GetCounter(const QString &name)
+{
+    return GetOrCreate(GetRegistry().counters, name);
+}
+
+Metrics::Gauge &Metrics::GetGauge(const QString &name)
+{
+    return GetOrCreate(GetRegistry().gauges, name);
+}
+
+Metrics::Histogram &Metrics::GetHistogram(const QString &name)
+{
+    return GetOrCreate(GetRegistry().histograms, name);
+}
+
+QJsonObject Metrics::Snapshot()
+{
+    // 全局线程池的利用率在取快照时采样，不需要埋点
+    QThreadPool * pool = QThreadPool::globalInstance();
+    GetGauge("pool.global.active").Set(pool->activeThreadCount());
+    GetGauge("pool.global.max").Set(pool->maxThreadCount());
+
+    Registry & registry = GetRegistry();
+    QMutexLocker locker(&registry.mutex);
+    QJsonObject counters;
+    for(const auto & item : registry.counters){
+        counters.insert(item.first, item.second->Value());
+    }
+    QJsonObject gauges;
+    for(const auto & item : registry.gauges){
+        gauges.insert(item.first, item.second->Value());
+    }
+    QJsonObject histograms;
+    for(const auto & item : registry.histograms){
+        const Histogram & h = *item.second;
+        QJsonObject stats;
+        stats.insert("count", h.Count());
+        stats.insert("mean_us", qRound64(h.Mean()));
+        stats.insert("p50_us", h.Percentile(0.50));
+        stats.insert("p90_us", h.Percentile(0.90));
+        stats.insert("p99_us", h.Percentile(0.99));
+        stats.insert("max_us", h.Max());
+        histograms.insert(item.first, stats);
+    }
+
+    QJsonObject snapshot;
+    snapshot.insert("time", QDateTime::currentDateTime().toString(Qt::ISODateWithMs));
+    snapshot.insert("counters", counters);
+    snapshot.insert("gauges", gauges);
+    snapshot.insert("histograms", histograms);
+    return snapshot;
+}
+
+bool Metrics::Dump(const QString &path)
+{
+    QJsonObject snapshot = Snapshot();
+    QFile file(path);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)){
+        return false;
+    }
+    if(path.endsWith(".json", Qt::CaseInsensitive)){
+        file.write(QJsonDocument(snapshot).toJson(QJsonDocument::Indented));
+        return file.error() == QFileDevice::NoError;
+    }
+
+    QTextStream out(&file);
+    out << "# " << snapshot.value("time").toString() << "\n";
+    for(const char * group : {"counters", "gauges"}){
+        QJsonObject values = snapshot.value(group).toObject();
+        for(auto iter = values.begin(); iter != values.end(); ++iter){
+            out << iter.key() << " " << qint64(iter.value().toDouble()) << "\n";
+        }
+    }
+    QJsonObject histograms = snapshot.value("histograms").toObject();
+    for(auto iter = histograms.begin(); iter != histograms.end(); ++iter){
+        QJsonObject stats = iter.value().toObject();
+        out << iter.key();
+        for(const char * field : {"count", "mean_us", "p50_us", "p90_us", "p99_us", "max_us"}){
+            out << " " << field << "=" << qint64(stats.value(field).toDouble());
+        }
+        out << "\n";
+    }
+    out.flush();
+    return file.error() == QFileDevice::NoError;
+}
@@ -0,0 +1,87 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QString>
+#include <array>
+#include <atomic>
+
+/*
+ * 性能计数器注册表，用来在用户机器上观察性能，不需要挂分析器。
+ * 三类指标，更新都只是原子操作，不加锁：
+ *   Counter   只增的计数（扫描的条目数、复制的字节数、缓存命中数），面板据两次采样算出速率；
+ *   Gauge     当前值（队列深度、工作线程数）；
+ *   Histogram 延迟分布（微秒），对数-线性分桶（HDR 风格）：每个 2 的幂区间再分 16 格，相对误差约 6%。
+ * 指标按名称注册一次后永不释放，调用方可以用函数内静态引用缓存，热路径上不查表。
+ * Snapshot 导出全部指标，面板显示和保存快照文件都用它。
+ */
+class Metrics
+{
+public:
+    class Counter
+    {
+    public:
+        void Add(qint64 n = 1) { _value.fetch_add(n, std::memory_order_relaxed); }
+        qint64 Value() const { return _value.load(std::memory_order_relaxed); }
+    private:
+        std::atomic<qint64> _value{0};
+    };
+
+    class Gauge
+    {
+    public:
+        void Set(qint64 value) { _value.store(value, std::memory_order_relaxed); }
+        void Add(qint64 n) { _value.fetch_add(n, std::memory_order_relaxed); }
+        qint64 Value() const { return _value.load(std::memory_order_relaxed); }
+    private:
+        std::atomic<qint64> _value{0};
+    };
+
+    class Histogram
+    {
+    public:
+        static const int SUB_BITS = 4;
+        static const int SUB_COUNT = 1 << SUB_BITS;
+        static const int BUCKETS = SUB_COUNT * 48;  // 覆盖到 2^47 微秒
+
+        void Record(qint64 micros);
+        qint64 Count() const;
+        qint64 Max() const;
+        double Mean() const;
+        // q 在 0 到 1 之间，返回所在桶的上界
+        qint64 Percentile(double q) const;
+
+    private:
+        static int BucketOf(qint64 value);
+        static qint64 BucketUpper(int index);
+
+        std::array<std::atomic<quint32>, BUCKETS> _buckets{};
+        std::atomic<qint64> _count{0};
+        std::atomic<qint64> _sum{0};
+        std::atomic<qint64> _max{0};
+    };
+
+    // 作用域计时，析构时把经过的微秒数记入直方图
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(Histogram & histogram);
+        ~ScopedTimer();
+    private:
+        Histogram & _histogram;
+        QElapsedTimer _timer;
+        Q_DISABLE_COPY(ScopedTimer)
+    };
+
+    static Counter & GetCounter(const QString & name);
+    static Gauge & GetGauge(const QString & name);
+    static Histogram & GetHistogram(const QString & name);
+
+    // 全部指标：counters / gauges 为名称到数值，histograms 为名称到 count、mean、p50、p90、p99、max
+    static QJsonObject Snapshot();
+    // 保存快照，后缀为 .json 时写 JSON，否则写便于阅读的文本
+    static bool Dump(const QString & path);
+};
+
+#endif // METRICS_H
@@ -2,21 +2,42 @@
 #include <QDir>
 #include "protreeitem.h"
 #include "const.h"
+#include "dirscanner.h"
+#include <algorithm>
 
 OpenTreeThread::OpenTreeThread(const QString &src_path, int file_count,
                                QTreeWidget *self, QObject *parent)
     :QThread(parent), _bstop(false), _src_path(src_path), _file_count(file_count),
-    _self(self), _root(nullptr)
+    _self(self), _root(nullptr), _holder(nullptr)
 {
 
 }
 
+void OpenTreeThread::SetRestoreRoot(QTreeWidgetItem *root, QTreeWidgetItem *holder)
+{
+    _root = root;
+    _holder = holder;
+}
+
 void OpenTreeThread::OpenProTree(
     const QString &src_path,   // 项目根目录路径
     int &file_count,           // 文件计数引用，用于统计文件和目录数量
     QTreeWidget *self          // 树控件指针，用于添加节点
     )
 {
+    // 清单里只有引用的图片不在项目目录中，需要按清单补到对应目录下
+    ProManifest manifest(src_path);
+    if(manifest.Load()){
+        _refs = manifest.References();
+    }
+
+    // 会话恢复时根节点已经在树上，子树先挂在不属于任何视图的 holder 下，
+    // 线程结束后由界面线程一次性移到根节点下，避免后台线程修改正在显示的树
+    if(_root && _holder){
+        RecursiveProTree(src_path, file_count, self, _root, _holder, nullptr);
+        return;
+    }
+
     QDir src_dir(src_path);               // 创建 QDir 对象，用于操作目录
     auto name = src_dir.dirName();        // 获取目录名称，作为项目名
 
@@ -45,14 +66,13 @@ void OpenTreeThread::run()
     OpenProTree(_src_path, _file_count, _self);
     // 如果线程在中途被取消
     if(_bstop){
-        // 获取根节点的路径
-        auto path = dynamic_cast<ProTreeItem*>(_root)->GetPath();
-        // 从树控件中删除对应的顶层节点
+        // 会话恢复的根节点由界面线程负责清理
+        if(_holder){
+            return;
+        }
+        // 从树控件中删除对应的顶层节点；打开项目只是读取，不能删除磁盘上的目录
         auto index = _self->indexOfTopLevelItem(_root);
         delete _self->takeTopLevelItem(index);
-        // 删除目标目录（递归删除所有子文件/文件夹）
-        QDir dir(path);
-        dir.removeRecursively();
         return;
     }
 
@@ -70,10 +90,33 @@ void OpenTreeThread::RecursiveProTree(
     QTreeWidgetItem *preitem       // 前一个节点指针，用于链表式管理节点关系
     )
 {
-    QDir src_dir(src_path);                         // 创建目录对象
-    src_dir.setFilter(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot); // 过滤目录和文件，但排除 "." 和 ".."
-    src_dir.setSorting(QDir::Name);                // 按名称排序
-    QFileInfoList list = src_dir.entryInfoList();  // 获取当前目录下的文件和子目录信息列表
+    // 获取当前目录下的文件和子目录列表（已排除 "." 和 ".."，按名称排序），
+    // 类型直接取自目录项，不再逐条目 stat
+    QVector<DirEntry> list;
+    DirScanner::List(src_path, list);
+
+    // 合并该目录下只有引用的图片，节点路径就是原图路径
+    if(!_refs.isEmpty()){
+        QString rel_dir = QDir(_src_path).relativeFilePath(src_path);
+        if(rel_dir == "."){
+            rel_dir.clear();
+        }
+        auto iter = _refs.constFind(rel_dir);
+        if(iter != _refs.constEnd()){
+            for(const ProManifest::Entry & ref : iter.value()){
+                DirEntry entry;
+                entry.name = ref.rel_path.mid(ref.rel_path.lastIndexOf('/') + 1);
+                entry.path = ref.source;
+                entry.is_dir = false;
+                entry.size = -1;
+                entry.mtime = -1;
+                list.append(entry);
+            }
+            std::sort(list.begin(), list.end(), [](const DirEntry & a, const DirEntry & b){
+                return a.name < b.name;
+            });
+        }
+    }
 
     // 遍历目录下所有条目
     for(int i = 0; i < list.size(); ++i){
@@ -81,8 +124,8 @@ void OpenTreeThread::RecursiveProTree(
             return;
         }
 
-        QFileInfo fileInfo = list.at(i);          // 当前文件或目录信息
-        bool bIsDir = fileInfo.isDir();           // 判断是否是目录
+        const DirEntry & entry = list.at(i);      // 当前文件或目录信息
+        bool bIsDir = entry.is_dir;               // 判断是否是目录
 
         if(bIsDir){  // 如果是目录
             if(_bstop){
@@ -93,19 +136,19 @@ void OpenTreeThread::RecursiveProTree(
 
             // 创建一个树节点表示目录
             auto * item = new ProTreeItem(
-                _root,
-                fileInfo.fileName(),
-                fileInfo.absoluteFilePath(),
+                parent,
+                entry.name,
+                entry.path,
                 _root,
                 TreeItemDir
                 );
-            item->setData(0, Qt::DisplayRole, fileInfo.fileName());        // 显示名称
+            item->setData(0, Qt::DisplayRole, entry.name);        // 显示名称
             item->setData(0, Qt::DecorationRole, QIcon(":/icon/dir/png")); // 设置目录图标
-            item->setData(0, Qt::ToolTipRole, fileInfo.absoluteFilePath());// 提示显示完整路径
+            item->setData(0, Qt::ToolTipRole, entry.path);// 提示显示完整路径
 
             // 递归遍历子目录
             RecursiveProTree(
-                fileInfo.absoluteFilePath(),
+                entry.path,
                 file_count,
                 self,
                 _root,
@@ -117,8 +160,7 @@ void OpenTreeThread::RecursiveProTree(
                 return;
             }
 
-            const QString& suffix = fileInfo.completeSuffix(); // 获取文件后缀
-            if(suffix != "png" && suffix != "jpeg" && suffix != "jpg"){
+            if(!DirScanner::IsPicFile(entry.name)){
                 continue;   // 只处理图片文件，其他文件忽略
             }
 
@@ -127,15 +169,15 @@ void OpenTreeThread::RecursiveProTree(
 
             // 创建树节点表示图片文件
             auto * item = new ProTreeItem(
-                _root,
-                fileInfo.fileName(),
-                fileInfo.absoluteFilePath(),
+                parent,
+                entry.name,
+                entry.path,
                 _root,
                 TreeItemPic
                 );
-            item->setData(0, Qt::DisplayRole, fileInfo.fileName());        // 显示名称
+            item->setData(0, Qt::DisplayRole, entry.name);        // 显示名称
             item->setData(0, Qt::DecorationRole, QIcon(":/icon/pic/png")); // 设置图片图标
-            item->setData(0, Qt::ToolTipRole, fileInfo.absoluteFilePath());// 提示显示完整路径
+            item->setData(0, Qt::ToolTipRole, entry.path);// 提示显示完整路径
 
             // 将节点与前一个节点连接，形成链表关系
             if(preitem){
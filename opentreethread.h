@@ -3,6 +3,8 @@
 
 #include <QThread>
 #include <QTreeWidget>
+#include <atomic>
+#include "promanifest.h"
 
 class OpenTreeThread : public QThread
 {
@@ -11,6 +13,8 @@ public:
     explicit OpenTreeThread(const QString& src_path, int file_count,
                             QTreeWidget * self, QObject *parent = nullptr);
     void OpenProTree(const QString& src_path, int &file_count, QTreeWidget* self);
+    // 会话恢复：根节点已由界面线程创建，线程只在游离的 holder 节点下构建子树
+    void SetRestoreRoot(QTreeWidgetItem* root, QTreeWidgetItem* holder);
 protected:
     virtual void run();
 private:
@@ -19,8 +23,10 @@ private:
     QString _src_path;
     int _file_count;
     QTreeWidget* _self;
-    bool _bstop;
+    std::atomic<bool> _bstop;   // 界面线程写，加载线程读
     QTreeWidgetItem* _root;
+    QTreeWidgetItem* _holder;
+    QHash<QString, QVector<ProManifest::Entry>> _refs;  // 链接导入中只有引用的图片，按目录分组
 signals:
     void SigFinishProgress(int);
     void SigUpdateProgress(int);
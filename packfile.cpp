@@ -0,0 +1,415 @@
+#include "packfile.h"
+#include "dirscanner.h"
+#include "mappedfile.h"
+#include "metrics.h"
+#include "previewextractor.h"
+#include <QBuffer>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QVector>
+#include <cstring>
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
+// 磁盘上的结构按小端原样存放，映射后直接使用
+static_assert(Q_BYTE_ORDER == Q_LITTLE_ENDIAN, "pack file layout assumes little endian");
+
+namespace {
+const char kMagic[8] = {'A', 'L', 'B', 'M', 'P', 'A', 'K', '1'};
+const quint32 kVersion = 1;
+// 每张图片的数据按 64 字节对齐，索引按 8 字节对齐
+const qint64 kDataAlign = 64;
+const quint32 kFlagDir = 1;
+
+struct PackHeader {
+    char magic[8];
+    quint32 version;
+    quint32 count;          // 索引记录数
+    quint64 index_offset;   // 索引记录起始偏移
+    quint64 names_offset;   // 名称表起始偏移
+    quint64 names_size;
+    quint64 reserved[3];
+};
+static_assert(sizeof(PackHeader) == 64, "PackHeader must be 64 bytes");
+
+qint64 AlignUp(qint64 value, qint64 align)
+{
+    return (value + align - 1) / align * align;
+}
+
+// 已打开的包文件，按绝对路径索引
+QMutex g_packs_mutex;
+QHash<QString, std::shared_ptr<PackFile>> g_packs;
+}
+
+// 一个节点的索引记录
+struct PackRecord {
+    qint32 parent;
+    quint32 flags;
+    quint32 name_offset;
+    quint32 name_size;
+    quint64 data_offset;
+    quint64 data_size;
+};
+static_assert(sizeof(PackRecord) == 32, "PackRecord must be 32 bytes");
+
+PackFile::PackFile()
+    :_map(nullptr), _map_size(0), _records(nullptr), _names(nullptr), _count(0)
+{
+
+}
+
+PackFile::~PackFile()
+{
+    if(_map){
+        _file.unmap(const_cast<uchar*>(_map));
+    }
+}
+
+const QString &PackFile::Suffix()
+{
+    static const QString suffix(".album");
+    return suffix;
+}
+
+bool PackFile::Build(const QString &src_dir, const QString &pack_path,
+                     const std::function<bool(int)> &progress)
+{
+    QSaveFile out(pack_path);
+    if(!out.open(QIODevice::WriteOnly)){
+        return false;
+    }
+
+    // 先占位写文件头，索引写完后再回填
+    PackHeader header;
+    std::memset(&header, 0, sizeof(header));
+    if(out.write(reinterpret_cast<const char*>(&header), sizeof(header)) != sizeof(header)){
+        return false;
+    }
+
+    QVector<PackRecord> records;
+    QByteArray names;
+    qint64 pos = sizeof(header);
+    int item_count = 0;
+    QByteArray buffer(1 << 20, Qt::Uninitialized);
+    const QByteArray padding(kDataAlign, '\0');
+
+    // 先序遍历：目录记录在它的子节点之前，和树控件的显示顺序一致
+    std::function<bool(const QString&, int)> walk = [&](const QString & dir_path, int parent) -> bool {
+        QVector<DirEntry> list;
+        DirScanner::List(dir_path, list);
+        for(const DirEntry & entry : list){
+            if(!entry.is_dir && !DirScanner::IsPicFile(entry.name)){
+                continue;
+            }
+            // 打不开的文件整条记录跳过，名称也不写入
+            QFile in(entry.path);
+            if(!entry.is_dir && !in.open(QIODevice::ReadOnly)){
+                continue;
+            }
+            QByteArray name = entry.name.toUtf8();
+            PackRecord record;
+            record.parent = parent;
+            record.flags = entry.is_dir ? kFlagDir : 0;
+            record.name_offset = quint32(names.size());
+            record.name_size = quint32(name.size());
+            record.data_offset = 0;
+            record.data_size = 0;
+            names.append(name);
+
+            if(!entry.is_dir){
+                qint64 aligned = AlignUp(pos, kDataAlign);
+                if(aligned > pos){
+                    out.write(padding.constData(), aligned - pos);
+                    pos = aligned;
+                }
+                record.data_offset = quint64(pos);
+                qint64 len;
+                while((len = in.read(buffer.data(), buffer.size())) > 0){
+                    if(out.write(buffer.constData(), len) != len){
+                        return false;
+                    }
+                    pos += len;
+                }
+                // 读到一半出错（坏道、文件被截断）时不打出残缺的图片
+                if(len < 0){
+                    return false;
+                }
+                record.data_size = quint64(pos) - record.data_offset;
+            }
+
+            int index = records.size();
+            records.append(record);
+            if(!progress(++item_count)){
+                return false;
+            }
+            if(entry.is_dir && !walk(entry.path, index)){
+                return false;
+            }
+        }
+        return true;
+    };
+
+    if(!walk(src_dir, -1)){
+        out.cancelWriting();
+        return false;
+    }
+
+    qint64 index_offset = AlignUp(pos, 8);
+    out.write(padding.constData(), index_offset - pos);
+    qint64 index_size = qint64(records.size()) * qint64(sizeof(PackRecord));
+    out.write(reinterpret_cast<const char*>(records.constData()), index_size);
+    out.write(names);
+
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.count = quint32(records.size());
+    header.index_offset = quint64(index_offset);
+    header.names_offset = quint64(index_offset + index_size);
+    header.names_size = quint64(names.size());
+    if(!out.seek(0) || out.write(reinterpret_cast<const char*>(&header), sizeof(header)) != sizeof(header)){
+        out.cancelWriting();
+        return false;
+    }
+    return out.commit();
+}
+
+std::shared_ptr<PackFile> PackFile::Get(const QString &pack_path)
+{
+    QString key = QFileInfo(pack_path).absoluteFilePath();
+    QMutexLocker locker(&g_packs_mutex);
+    auto iter = g_packs.find(key);
+    if(iter != g_packs.end()){
+        return iter.value();
+    }
+
+    std::shared_ptr<PackFile> pack(new PackFile());
+    if(!pack->Open(key)){
+        return nullptr;
+    }
+    g_packs.insert(key, pack);
+    return pack;
+}
+
+void PackFile::Release(const QString &pack_path)
+{
+    QMutexLocker locker(&g_packs_mutex);
+    g_packs.remove(QFileInfo(pack_path).absoluteFilePath());
+}
+
+bool PackFile::IsPackPath(const QString &path)
+{
+    if(!path.endsWith(Suffix(), Qt::CaseInsensitive)){
+        return false;
+    }
+    return QFileInfo(path).isFile();
+}
+
+// 路径中带包后缀的那一段必须是普通文件，恰好以包后缀命名的目录按普通路径处理
+bool PackFile::SplitPath(const QString &path, QString &pack_path, QString &rel_path)
+{
+    const QString marker = Suffix() + "/";
+    for(int pos = path.indexOf(marker, 0, Qt::CaseInsensitive); pos >= 0;
+        pos = path.indexOf(marker, pos + 1, Qt::CaseInsensitive)){
+        QString prefix = path.left(pos + Suffix().size());
+        if(IsPackPath(prefix)){
+            pack_path = prefix;
+            rel_path = path.mid(pos + marker.size());
+            return true;
+        }
+    }
+    return false;
+}
+
+std::shared_ptr<PackFile> PackFile::Resolve(const QString &path, int &index)
+{
+    QString pack_path, rel_path;
+    if(!SplitPath(path, pack_path, rel_path)){
+        return nullptr;
+    }
+    std::shared_ptr<PackFile> pack = Get(pack_path);
+    if(!pack){
+        return nullptr;
+    }
+    index = pack->Find(rel_path);
+    if(index < 0){
+        return nullptr;
+    }
+    return pack;
+}
+
+QImage PackFile::ReadImage(const QString &path, int max_side)
+{
+    static Metrics::Histogram & decode_time = Metrics::GetHistogram("decode.full_us");
+    Metrics::ScopedTimer timer(decode_time);
+
+    // 普通文件和包内数据都从映射区解码，不先读进堆内存
+    MappedFile mapped(path);
+    QByteArray data = mapped.Data();
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer);
+
+    reader.setAutoTransform(true);
+    if(max_side > 0){
+        QSize src_size = reader.size();
+        if(src_size.isValid() && qMax(src_size.width(), src_size.height()) > max_side){
+            reader.setScaledSize(src_size.scaled(max_side, max_side, Qt::KeepAspectRatio));
+        }
+    }
+    QImage image = reader.read();
+    // 没有 RAW 显影器，RAW 文件用最大的内嵌预览代替
+    if(image.isNull() && DirScanner::IsRawFile(path)){
+        image = PreviewExtractor::Extract(&buffer, PreviewExtractor::Largest, max_side);
+    }
+    return image;
+}
+
+qint64 PackFile::ModifiedTime(const QString &path)
+{
+    QString pack_path, rel_path;
+    QFileInfo info(SplitPath(path, pack_path, rel_path) ? pack_path : path);
+    if(!info.exists()){
+        return -1;
+    }
+    return info.lastModified().toMSecsSinceEpoch();
+}
+
+bool PackFile::Open(const QString &pack_path)
+{
+    _path = pack_path;
+    _file.setFileName(pack_path);
+    if(!_file.open(QIODevice::ReadOnly)){
+        return false;
+    }
+    _map_size = _file.size();
+    if(_map_size < qint64(sizeof(PackHeader))){
+        return false;
+    }
+    _map = _file.map(0, _map_size);
+    if(!_map){
+        return false;
+    }
+
+    const auto * header = reinterpret_cast<const PackHeader*>(_map);
+    if(std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 || header->version != kVersion){
+        return false;
+    }
+    // 各段都写成减法比较，损坏的文件头里再大的数也不会让加法溢出绕过检查
+    const quint64 map_size = quint64(_map_size);
+    quint64 index_size = quint64(header->count) * sizeof(PackRecord);
+    if(header->index_offset % 8 != 0 || header->index_offset < sizeof(PackHeader)
+        || header->index_offset > map_size || index_size > map_size - header->index_offset
+        || header->names_offset != header->index_offset + index_size
+        || header->names_size > map_size - header->names_offset){
+        return false;
+    }
+
+    _records = reinterpret_cast<const PackRecord*>(_map + header->index_offset);
+    _names = reinterpret_cast<const char*>(_map + header->names_offset);
+    _count = int(header->count);
+
+#ifdef Q_OS_LINUX
+    // 索引马上要整体读一遍，提前让内核读入
+    quintptr page = quintptr(_map + header->index_offset) & ~quintptr(4095);
+    madvise(reinterpret_cast<void*>(page), quintptr(_map + _map_size) - page, MADV_WILLNEED);
+#endif
+
+    // 校验记录，之后的访问不再做边界检查
+    for(int i = 0; i < _count; ++i){
+        const PackRecord & record = _records[i];
+        if(record.parent >= i || record.parent < -1
+            || quint64(record.name_offset) + record.name_size > header->names_size
+            || record.data_offset > header->index_offset
+            || record.data_size > header->index_offset - record.data_offset){
+            return false;
+        }
+    }
+    return true;
+}
+
+const QString &PackFile::GetPath() const
+{
+    return _path;
+}
+
+int PackFile::Count() const
+{
+    return _count;
+}
+
+PackFile::Entry PackFile::GetEntry(int index) const
+{
+    const PackRecord & record = _records[index];
+    Entry entry;
+    entry.parent = record.parent;
+    entry.is_dir = record.flags & kFlagDir;
+    entry.name = QString::fromUtf8(_names + record.name_offset, int(record.name_size));
+    entry.offset = qint64(record.data_offset);
+    entry.size = qint64(record.data_size);
+    return entry;
+}
+
+QString PackFile::RelPath(int index) const
+{
+    QStringList parts;
+    for(int i = index; i >= 0; i = _records[i].parent){
+        parts.prepend(QString::fromUtf8(_names + _records[i].name_offset, int(_records[i].name_size)));
+    }
+    return parts.join('/');
+}
+
+QString PackFile::EntryPath(int index) const
+{
+    return _path + "/" + RelPath(index);
+}
+
+int PackFile::Find(const QString &rel_path) const
+{
+    QMutexLocker locker(&_lookup_mutex);
+    if(_lookup.isEmpty() && _count > 0){
+        // 先序排列保证父节点先于子节点，父路径可以直接复用
+        QVector<QString> paths(_count);
+        _lookup.reserve(_count);
+        for(int i = 0; i < _count; ++i){
+            const PackRecord & record = _records[i];
+            QString name = QString::fromUtf8(_names + record.name_offset, int(record.name_size));
+            paths[i] = record.parent < 0 ? name : paths[record.parent] + "/" + name;
+            _lookup.insert(paths[i], i);
+        }
+    }
+    return _lookup.value(rel_path, -1);
+}
+
+QByteArray PackFile::Data(int index) const
+{
+    const PackRecord & record = _records[index];
+    return QByteArray::fromRawData(reinterpret_cast<const char*>(_map + record.data_offset),
+                                   int(record.data_size));
+}
+
+void PackFile::Advise(int index, bool will_need) const
+{
+#ifdef Q_OS_LINUX
+    const PackRecord & record = _records[index];
+    if(record.data_size == 0){
+        return;
+    }
+    quintptr page = quintptr(_map + record.data_offset) & ~quintptr(4095);
+    size_t length = size_t(quintptr(_map + record.data_offset + record.data_size) - page);
+    if(will_need){
+        madvise(reinterpret_cast<void*>(page), length, MADV_WILLNEED);
+    } else {
+        // 先解除本进程对这些页的映射，页缓存才能真正丢弃
+        madvise(reinterpret_cast<void*>(page), length, MADV_DONTNEED);
+        posix_fadvise(_file.handle(), off_t(record.data_offset), off_t(record.data_size), POSIX_FADV_DONTNEED);
+    }
+#else
+    Q_UNUSED(index);
+    Q_UNUSED(will_need);
+#endif
+}
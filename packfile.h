@@ -0,0 +1,86 @@
+#ifndef PACKFILE_H
+#define PACKFILE_H
+
+#include <QFile>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+#include <functional>
+#include <memory>
+
+struct PackRecord;
+
+/*
+ * 单文件打包项目（*.album）。
+ * 文件布局：文件头 | 图片数据（原样存放，不压缩）| 索引记录 | 名称表。
+ * 索引记录定长，按目录树先序排列，记录父节点下标，整个文件映射到内存后
+ * 直接按下标访问，打开项目只读索引，不需要逐个 stat 文件；
+ * 图片数据从映射区直接交给解码器，不经过额外的读拷贝。
+ *
+ * 打包项目中的节点用虚拟路径表示：<包文件路径>/<项目内相对路径>，
+ * 读图时经 ReadImage 解析，普通路径原样走文件系统。
+ */
+class PackFile
+{
+public:
+    struct Entry {
+        int parent;         // 父节点下标，-1 表示项目根
+        bool is_dir;
+        QString name;
+        qint64 offset;      // 图片数据在包文件中的偏移
+        qint64 size;
+    };
+
+    ~PackFile();
+
+    // 包文件后缀
+    static const QString & Suffix();
+    // 把 src_dir 下的目录和图片打包到 pack_path；
+    // progress 每处理一项调用一次，返回 false 时取消并删除未完成的文件
+    static bool Build(const QString & src_dir, const QString & pack_path,
+                      const std::function<bool(int)> & progress);
+    // 打开（已打开则复用）包文件，失败返回空
+    static std::shared_ptr<PackFile> Get(const QString & pack_path);
+    // 项目关闭后释放映射；正在解码的调用方持有引用，结束后才真正解除映射
+    static void Release(const QString & pack_path);
+    // path 本身是否是包文件
+    static bool IsPackPath(const QString & path);
+    // 把虚拟路径拆成包文件路径和包内相对路径，不是虚拟路径返回 false
+    static bool SplitPath(const QString & path, QString & pack_path, QString & rel_path);
+    // 解析虚拟路径，返回包和节点下标；不是虚拟路径或找不到返回空
+    static std::shared_ptr<PackFile> Resolve(const QString & path, int & index);
+    // 读取并解码图片，普通路径和虚拟路径都可以；max_side > 0 时让解码器直接缩小解码
+    static QImage ReadImage(const QString & path, int max_side = 0);
+    // 包文件的修改时间，用作虚拟路径的缓存键
+    static qint64 ModifiedTime(const QString & path);
+
+    const QString & GetPath() const;
+    int Count() const;
+    Entry GetEntry(int index) const;
+    // 节点的虚拟路径
+    QString EntryPath(int index) const;
+    // 按相对路径查找节点，找不到返回 -1
+    int Find(const QString & rel_path) const;
+    // 图片数据，直接引用映射区，不拷贝；PackFile 释放前有效
+    QByteArray Data(int index) const;
+    // 预读提示：will_need 为 true 时提前读入节点数据，否则从页缓存丢弃
+    void Advise(int index, bool will_need) const;
+
+private:
+    PackFile();
+    bool Open(const QString & pack_path);
+    QString RelPath(int index) const;
+
+    QString _path;
+    QFile _file;
+    const uchar * _map;
+    qint64 _map_size;
+    const PackRecord * _records;
+    const char * _names;
+    int _count;
+    mutable QMutex _lookup_mutex;
+    mutable QHash<QString, int> _lookup;    // 相对路径到下标，首次 Find 时建立
+};
+
+#endif // PACKFILE_H
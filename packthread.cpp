@@ -0,0 +1,31 @@
+#include "packthread.h"
+#include "packfile.h"
+#include <QDebug>
+
+PackThread::PackThread(const QString &src_path, const QString &pack_path, QObject *parent)
+    :QThread(parent), _src_path(src_path), _pack_path(pack_path), _bstop(false)
+{
+
+}
+
+void PackThread::run()
+{
+    int count = 0;
+    bool ok = PackFile::Build(_src_path, _pack_path, [this, &count](int done){
+        count = done;
+        emit SigUpdateProgress(done);
+        return !_bstop;
+    });
+    if(_bstop){
+        return;
+    }
+    if(!ok){
+        qDebug() << "pack failed" << _pack_path;
+    }
+    emit SigFinishProgress(count);
+}
+
+void PackThread::SlotCancelProgress()
+{
+    _bstop = true;
+}
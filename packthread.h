@@ -0,0 +1,30 @@
+#ifndef PACKTHREAD_H
+#define PACKTHREAD_H
+
+#include <QThread>
+#include <atomic>
+
+/*
+ * 把项目目录打包为单文件项目（*.album）的后台线程。
+ * 打包写到临时文件，全部成功后才替换目标文件，取消或失败不会留下半个包。
+ */
+class PackThread : public QThread
+{
+    Q_OBJECT
+public:
+    explicit PackThread(const QString & src_path, const QString & pack_path, QObject * parent = nullptr);
+protected:
+    virtual void run();
+private:
+    QString _src_path;
+    QString _pack_path;
+    std::atomic<bool> _bstop;
+signals:
+    void SigUpdateProgress(int);
+    void SigFinishProgress(int);
+
+public slots:
+    void SlotCancelProgress();
+};
+
+#endif // PACKTHREAD_H
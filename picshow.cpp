@@ -0,0 +1,242 @@
+#include "picshow.h"
+#include "ui_picshow.h"
+#include "backgroundtask.h"
+#include "decodepool.h"
+#include "packfile.h"
+#include "previewextractor.h"
+#include "thumbcache.h"
+#include <QFutureWatcher>
+#include <QKeyEvent>
+#include <QScreen>
+#include <QSettings>
+#include <QTimer>
+#include <QtConcurrent>
+#include <cmath>
+
+namespace {
+// 翻看时显示的缩略图尺寸（长边像素）
+const int SKIM_THUMB_SIZE = 320;
+}
+
+PicShow::PicShow(QWidget *parent)
+    : QDialog(parent)
+    , ui(new Ui::PicShow)
+    , _full_loaded(false)
+    , _adjust_timer(new QTimer(this))
+    , _settle_timer(new QTimer(this))
+    , _generation(std::make_shared<std::atomic<quint64>>(0))
+    , _preview_busy(false)
+{
+    ui->setupUi(this);
+    ui->previousBtn->setIcon(QIcon(":/icon/previous.png"));
+    ui->nextBtn->setIcon(QIcon(":/icon/next.png"));
+
+    connect(ui->previousBtn, &QPushButton::clicked, this, &PicShow::SigPreClicked);
+    connect(ui->nextBtn, &QPushButton::clicked, this, &PicShow::SigNextClicked);
+
+    // 约 60 帧每秒
+    _adjust_timer->setSingleShot(true);
+    _adjust_timer->setInterval(16);
+    connect(_adjust_timer, &QTimer::timeout, this, &PicShow::ApplyAdjust);
+    for(QSlider * slider : {ui->exposureSlider, ui->contrastSlider, ui->saturationSlider,
+                            ui->blackSlider, ui->gammaSlider, ui->whiteSlider}){
+        connect(slider, &QSlider::valueChanged, this, &PicShow::SlotAdjustChanged);
+    }
+    connect(ui->resetBtn, &QPushButton::clicked, this, &PicShow::SlotResetAdjust);
+
+    // 连续切换的间隔小于这个时间视为快速翻看，停下来这么久之后才完整解码
+    QSettings settings;
+    _settle_timer->setSingleShot(true);
+    _settle_timer->setInterval(qBound(30, settings.value("view/settle_ms", 150).toInt(), 2000));
+    connect(_settle_timer, &QTimer::timeout, this, &PicShow::SlotStartFullDecode);
+    // 方向键翻看需要显示区域能拿到键盘焦点
+    setFocusPolicy(Qt::StrongFocus);
+}
+
+PicShow::~PicShow()
+{
+    delete ui;
+}
+
+// 选中一张图片：先显示缩略图或内嵌预览，停留下来之后才完整解码。
+// 按住方向键快速翻看时，中间的图片只显示预览，不做完整解码
+void PicShow::SlotSelectItem(const QString &path)
+{
+    _selected_path = path;
+    _full_loaded = false;
+    ++*_generation;
+    RequestPreview(path);
+
+    // 距上次切换已经超过等待时间，说明不是在快速翻看，直接解码
+    bool skimming = _select_timer.isValid() && _select_timer.elapsed() < _settle_timer->interval();
+    _select_timer.restart();
+    if(skimming){
+        _settle_timer->start();
+    } else {
+        _settle_timer->stop();
+        SlotStartFullDecode();
+    }
+}
+
+// 预览同一时间只有一个在进行；进行中又来了新的请求只记下最新的一个，完成后接着做
+void PicShow::RequestPreview(const QString &path)
+{
+    if(_preview_busy){
+        _preview_pending = path;
+        return;
+    }
+    _preview_busy = true;
+    _preview_pending.clear();
+
+    auto * watcher = new QFutureWatcher<QImage>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, path](){
+        QImage image = watcher->result();
+        watcher->deleteLater();
+        _preview_busy = false;
+        // 已经切换到别的图片，或者完整解码已经显示
+        if(path == _selected_path && !_full_loaded && !image.isNull()){
+            ShowImage(image);
+        }
+        if(!_preview_pending.isEmpty() && _preview_pending == _selected_path){
+            RequestPreview(_preview_pending);
+        }
+    });
+    // 前台解码期间后台任务暂停，不和它争抢磁盘和 CPU
+    watcher->setFuture(QtConcurrent::run([path](){
+        BackgroundTask::ForegroundScope foreground;
+        // 优先用缓存的缩略图，没有再读内嵌预览，并存一份给下次翻看。
+        // 预览长边够 SKIM_THUMB_SIZE 才能当缩略图存，EXIF 里 160 像素的小图只进预览缓存，
+        // 否则别的功能按这个尺寸取到的会是一张偏小的图
+        QImage thumb = ThumbCache::Find(path, SKIM_THUMB_SIZE);
+        if(!thumb.isNull()){
+            return thumb;
+        }
+        QImage preview = ThumbCache::FindPreview(path);
+        if(!preview.isNull()){
+            return preview;
+        }
+        preview = PreviewExtractor::Extract(path, PreviewExtractor::Smallest);
+        if(preview.isNull()){
+            return preview;
+        }
+        if(qMax(preview.width(), preview.height()) >= SKIM_THUMB_SIZE){
+            ThumbCache::Store(path, SKIM_THUMB_SIZE, ThumbCache::MakeThumb(preview, SKIM_THUMB_SIZE));
+        } else {
+            ThumbCache::StorePreview(path, preview);
+        }
+        return preview;
+    }));
+}
+
+// 完整解码当前图片；任务开始前检查代数，排队期间已经切走的直接放弃
+void PicShow::SlotStartFullDecode()
+{
+    const QString path = _selected_path;
+    const quint64 generation = *_generation;
+    auto latest = _generation;
+
+    // 完整解码只需要屏幕分辨率，解码器可以直接缩小解码
+    QSize screen_size = screen() ? screen()->size() * screen()->devicePixelRatio() : QSize(2560, 2560);
+    int max_side = qMax(screen_size.width(), screen_size.height());
+
+    auto * full_watcher = new QFutureWatcher<QImage>(this);
+    connect(full_watcher, &QFutureWatcherBase::finished, this, [this, full_watcher, generation](){
+        QImage image = full_watcher->result();
+        full_watcher->deleteLater();
+        if(generation != *_generation || image.isNull()){
+            return;
+        }
+        _full_loaded = true;
+        ShowImage(image);
+    });
+    // RAW 文件完整解码失败时 ReadImage 会退回最大的内嵌预览
+    full_watcher->setFuture(QtConcurrent::run([path, max_side, generation, latest](){
+        if(generation != *latest){
+            return QImage();
+        }
+        // 曾让解码子进程崩溃或卡死的文件不在界面进程里解码
+        if(DecodePool::IsQuarantined(path)){
+            return QImage();
+        }
+        BackgroundTask::ForegroundScope foreground;
+        return PackFile::ReadImage(path, max_side);
+    }));
+}
+
+void PicShow::ShowImage(const QImage &image)
+{
+    _image = image;
+    UpdateDisplay();
+}
+
+// 缩放到显示区域的大小，之后拖动滑块只处理这个缓冲区
+void PicShow::UpdateDisplay()
+{
+    if(_image.isNull()){
+        return;
+    }
+    _display = _image.scaled(ui->label->size(), Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    ApplyAdjust();
+}
+
+void PicShow::ApplyAdjust()
+{
+    if(_display.isNull()){
+        return;
+    }
+    ImageAdjuster::Histogram hist;
+    QImage adjusted = ImageAdjuster::Apply(_display, _params, &hist);
+    ui->label->setPixmap(QPixmap::fromImage(adjusted));
+    ui->histLabel->setPixmap(QPixmap::fromImage(
+        ImageAdjuster::RenderHistogram(hist, ui->histLabel->width(), ui->histLabel->height())));
+}
+
+// 滑块变化只记录参数，由定时器合并刷新
+void PicShow::SlotAdjustChanged()
+{
+    _params.exposure = ui->exposureSlider->value() / 100.0;
+    _params.contrast = ui->contrastSlider->value() / 100.0;
+    _params.saturation = ui->saturationSlider->value() / 100.0;
+    _params.black = ui->blackSlider->value();
+    _params.white = qMax(ui->whiteSlider->value(), _params.black + 1);
+    _params.gamma = std::pow(2.0, ui->gammaSlider->value() / 100.0);
+    if(!_adjust_timer->isActive()){
+        _adjust_timer->start();
+    }
+}
+
+void PicShow::SlotResetAdjust()
+{
+    ui->exposureSlider->setValue(0);
+    ui->contrastSlider->setValue(0);
+    ui->saturationSlider->setValue(100);
+    ui->blackSlider->setValue(0);
+    ui->gammaSlider->setValue(0);
+    ui->whiteSlider->setValue(255);
+}
+
+// 方向键切换上一张、下一张，按住时随键盘重复连续翻看
+void PicShow::keyPressEvent(QKeyEvent *event)
+{
+    switch(event->key()){
+    case Qt::Key_Left:
+    case Qt::Key_Up:
+    case Qt::Key_PageUp:
+        emit SigPreClicked();
+        break;
+    case Qt::Key_Right:
+    case Qt::Key_Down:
+    case Qt::Key_PageDown:
+    case Qt::Key_Space:
+        emit SigNextClicked();
+        break;
+    default:
+        QDialog::keyPressEvent(event);
+    }
+}
+
+void PicShow::resizeEvent(QResizeEvent *event)
+{
+    QDialog::resizeEvent(event);
+    UpdateDisplay();
+}
@@ -0,0 +1,65 @@
+#ifndef PICSHOW_H
+#define PICSHOW_H
+
+#include <QDialog>
+#include <QElapsedTimer>
+#include <QImage>
+#include <atomic>
+#include <memory>
+#include "imageadjuster.h"
+
+class QTimer;
+
+namespace Ui {
+class PicShow;
+}
+
+/*
+ * 图片显示区域。
+ * 选中图片后先显示内嵌预览（EXIF 缩略图或 RAW 预览，只读几十 KB），
+ * 停留下来之后在后台完整解码，解码完成后替换预览；快速翻看时只显示预览。
+ * 下方的滑块对显示分辨率的图片做非破坏性的曝光、对比度、色阶调整，并显示直方图。
+ */
+class PicShow : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit PicShow(QWidget *parent = nullptr);
+    ~PicShow();
+
+protected:
+    void resizeEvent(QResizeEvent * event) override;
+    void keyPressEvent(QKeyEvent * event) override;
+
+private:
+    void ShowImage(const QImage & image);
+    void RequestPreview(const QString & path);
+    void UpdateDisplay();
+    void ApplyAdjust();
+
+    Ui::PicShow *ui;
+    QString _selected_path;     // 当前选中的图片
+    QImage _image;              // 当前显示的图片（预览或完整解码结果）
+    bool _full_loaded;          // 完整解码已完成，迟到的预览不再覆盖
+    QImage _display;            // 缩放到显示区域大小的图片，调整在它上面进行
+    ImageAdjuster::Params _params;
+    QTimer * _adjust_timer;     // 合并拖动滑块产生的多次更新，最多每帧刷新一次
+    QTimer * _settle_timer;     // 快速翻看时，停下来一段时间后才完整解码
+    QElapsedTimer _select_timer;    // 距上次切换图片的时间
+    std::shared_ptr<std::atomic<quint64>> _generation;  // 每次切换加一，过期的解码任务据此放弃
+    bool _preview_busy;         // 有预览任务在进行
+    QString _preview_pending;   // 预览进行中到来的最新请求
+
+private slots:
+    void SlotStartFullDecode();
+    void SlotAdjustChanged();
+    void SlotResetAdjust();
+public slots:
+    void SlotSelectItem(const QString & path);
+signals:
+    void SigPreClicked();
+    void SigNextClicked();
+};
+
+#endif // PICSHOW_H
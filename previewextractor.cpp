@@ -0,0 +1,350 @@
+#include "previewextractor.h"
+#include "packfile.h"
+#include "metrics.h"
+#include <QBuffer>
+#include <QDateTime>
+#include <QFile>
+#include <QImageReader>
+#include <QTransform>
+#include <algorithm>
+
+namespace {
+// 防止损坏文件导致死循环或读取过多
+const int kMaxIfds = 32;
+const int kMaxIfdEntries = 512;
+
+// TIFF 里的整数按文件头声明的字节序存放
+class TiffReader
+{
+public:
+    TiffReader(QIODevice * device, qint64 base, bool little)
+        :_device(device), _base(base), _little(little) {}
+
+    bool Read(qint64 offset, char * out, qint64 len)
+    {
+        return _device->seek(_base + offset) && _device->read(out, len) == len;
+    }
+
+    quint16 U16(const uchar * p) const
+    {
+        return _little ? quint16(p[0] | p[1] << 8) : quint16(p[0] << 8 | p[1]);
+    }
+
+    quint32 U32(const uchar * p) const
+    {
+        return _little ? quint32(p[0]) | quint32(p[1]) << 8 | quint32(p[2]) << 16 | quint32(p[3]) << 24
+                       : quint32(p[0]) << 24 | quint32(p[1]) << 16 | quint32(p[2]) << 8 | quint32(p[3]);
+    }
+
+    // 取只有一个值的 SHORT/LONG 条目
+    quint32 Value(const uchar * entry) const
+    {
+        quint16 type = U16(entry + 2);
+        return type == 3 ? U16(entry + 8) : U32(entry + 8);
+    }
+
+private:
+    QIODevice * _device;
+    qint64 _base;
+    bool _little;
+};
+}
+
+QImage PreviewExtractor::Extract(const QString &path, Which which, int max_side)
+{
+    static Metrics::Histogram & extract_time = Metrics::GetHistogram("decode.preview_us");
+    Metrics::ScopedTimer timer(extract_time);
+
+    // 打包项目直接在映射区上解析
+    int index = -1;
+    std::shared_ptr<PackFile> pack = PackFile::Resolve(path, index);
+    if(pack){
+        QByteArray data = pack->Data(index);
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::ReadOnly);
+        return Extract(&buffer, which, max_side);
+    }
+
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)){
+        return QImage();
+    }
+    return Extract(&file, which, max_side);
+}
+
+QImage PreviewExtractor::Extract(QIODevice *device, Which which, int max_side)
+{
+    QVector<Candidate> candidates;
+    int orientation = 1;
+    FindCandidates(device, candidates, orientation);
+
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate & a, const Candidate & b){
+        return a.length < b.length;
+    });
+    if(which == Largest){
+        std::reverse(candidates.begin(), candidates.end());
+    }
+
+    // 按顺序尝试，跳过无损 JPEG 等解码器不支持的数据
+    for(const Candidate & candidate : candidates){
+        if(!IsBaselineJpeg(device, candidate.offset, candidate.length)){
+            continue;
+        }
+        if(!device->seek(candidate.offset)){
+            continue;
+        }
+        QByteArray data = device->read(candidate.length);
+        if(data.size() != candidate.length){
+            continue;
+        }
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::ReadOnly);
+        QImageReader reader(&buffer, "jpeg");
+        if(max_side > 0){
+            QSize size = reader.size();
+            if(size.isValid() && qMax(size.width(), size.height()) > max_side){
+                reader.setScaledSize(size.scaled(max_side, max_side, Qt::KeepAspectRatio));
+            }
+        }
+        QImage image = reader.read();
+        if(!image.isNull()){
+            // 预览本身不带 EXIF，方向取自原图的 IFD0
+            return ApplyOrientation(image, orientation);
+        }
+    }
+    return QImage();
+}
+
+void PreviewExtractor::FindCandidates(QIODevice *device, QVector<Candidate> &candidates, int &orientation,
+                                      QByteArray *capture)
+{
+    const qint64 size = device->size();
+    QByteArray head = device->peek(4);
+    if(head.size() < 4){
+        return;
+    }
+
+    // TIFF 结构的 RAW：文件头就是 TIFF 头
+    if(head.startsWith(QByteArray("II*\0", 4)) || head.startsWith(QByteArray("MM\0*", 4))){
+        ParseTiff(device, 0, size, candidates, orientation, capture);
+        return;
+    }
+
+    if(uchar(head[0]) != 0xFF || uchar(head[1]) != 0xD8){
+        return;
+    }
+
+    // JPEG：在 SOS 之前的段里找 APP1 Exif
+    qint64 pos = 2;
+    for(int i = 0; i < 64 && pos + 4 <= size; ++i){
+        uchar marker[4];
+        if(!device->seek(pos) || device->read(reinterpret_cast<char*>(marker), 4) != 4 || marker[0] != 0xFF){
+            return;
+        }
+        if(marker[1] == 0xDA || marker[1] == 0xD9){
+            return;
+        }
+        qint64 seg_len = marker[2] << 8 | marker[3];
+        if(marker[1] == 0xE1 && seg_len > 8){
+            QByteArray exif = device->read(6);
+            if(exif == QByteArray("Exif\0\0", 6)){
+                // 缩略图偏移相对于 TIFF 头，且必须落在本段之内
+                ParseTiff(device, pos + 10, pos + 2 + seg_len, candidates, orientation, capture);
+                return;
+            }
+        }
+        pos += 2 + seg_len;
+    }
+}
+
+void PreviewExtractor::ParseTiff(QIODevice *device, qint64 base, qint64 limit,
+                                 QVector<Candidate> &candidates, int &orientation, QByteArray *capture)
+{
+    uchar header[8];
+    if(!device->seek(base) || device->read(reinterpret_cast<char*>(header), 8) != 8){
+        return;
+    }
+    TiffReader tiff(device, base, header[0] == 'I');
+
+    QVector<quint32> queue;
+    QVector<quint32> visited;
+    queue.append(tiff.U32(header + 4));
+    bool first_ifd = true;
+
+    while(!queue.isEmpty() && visited.size() < kMaxIfds){
+        quint32 ifd = queue.takeFirst();
+        if(ifd == 0 || visited.contains(ifd) || base + ifd + 2 > limit){
+            continue;
+        }
+        visited.append(ifd);
+
+        uchar count_buf[2];
+        if(!tiff.Read(ifd, reinterpret_cast<char*>(count_buf), 2)){
+            continue;
+        }
+        int count = tiff.U16(count_buf);
+        if(count <= 0 || count > kMaxIfdEntries){
+            continue;
+        }
+        // 条目和下一个 IFD 的偏移一次读完
+        QByteArray entries(count * 12 + 4, Qt::Uninitialized);
+        if(!tiff.Read(ifd + 2, entries.data(), entries.size())){
+            continue;
+        }
+
+        quint32 jpeg_offset = 0, jpeg_length = 0;
+        quint32 compression = 0, strip_offset = 0, strip_count = 0;
+        bool single_strip = false;
+        for(int i = 0; i < count; ++i){
+            const uchar * entry = reinterpret_cast<const uchar*>(entries.constData()) + i * 12;
+            quint16 tag = tiff.U16(entry);
+            quint32 n = tiff.U32(entry + 4);
+            switch(tag){
+            case 0x0103:    // Compression
+                compression = tiff.Value(entry);
+                break;
+            case 0x0111:    // StripOffsets
+                single_strip = n == 1;
+                strip_offset = tiff.Value(entry);
+                break;
+            case 0x0117:    // StripByteCounts
+                strip_count = n == 1 ? tiff.Value(entry) : 0;
+                break;
+            case 0x0112:    // Orientation，只认 IFD0 的
+                if(first_ifd){
+                    orientation = int(tiff.Value(entry));
+                }
+                break;
+            case 0x0132:    // DateTime，没有 DateTimeOriginal 时使用
+            case 0x9003:    // DateTimeOriginal，在 Exif IFD 中
+                if(capture && n >= 19 && (tag == 0x9003 || capture->isEmpty())){
+                    QByteArray date(19, Qt::Uninitialized);
+                    if(tiff.Read(tiff.U32(entry + 8), date.data(), date.size())){
+                        *capture = date;
+                    }
+                }
+                break;
+            case 0x8769:    // Exif IFD，只在需要拍摄时间时进入
+                if(capture){
+                    queue.append(tiff.Value(entry));
+                }
+                break;
+            case 0x0201:    // JPEGInterchangeFormat
+                jpeg_offset = tiff.Value(entry);
+                break;
+            case 0x0202:    // JPEGInterchangeFormatLength
+                jpeg_length = tiff.Value(entry);
+                break;
+            case 0x014A: {  // SubIFDs，NEF/DNG 的预览在这里
+                if(n == 1){
+                    queue.append(tiff.U32(entry + 8));
+                } else if(n > 1 && n <= 16){
+                    QByteArray offsets(n * 4, Qt::Uninitialized);
+                    if(tiff.Read(tiff.U32(entry + 8), offsets.data(), offsets.size())){
+                        for(quint32 k = 0; k < n; ++k){
+                            queue.append(tiff.U32(reinterpret_cast<const uchar*>(offsets.constData()) + k * 4));
+                        }
+                    }
+                }
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        auto add = [&](quint32 offset, quint32 length){
+            if(offset > 0 && length > 0 && base + qint64(offset) + qint64(length) <= limit){
+                candidates.append({base + offset, qint64(length)});
+            }
+        };
+        if(jpeg_offset && jpeg_length){
+            add(jpeg_offset, jpeg_length);
+        } else if((compression == 6 || compression == 7) && single_strip){
+            // 单条带的 JPEG 压缩图像，CR2 的 IFD0、DNG 的预览 IFD
+            add(strip_offset, strip_count);
+        }
+
+        first_ifd = false;
+        queue.append(tiff.U32(reinterpret_cast<const uchar*>(entries.constData()) + count * 12));
+    }
+}
+
+qint64 PreviewExtractor::CaptureTime(const QString &path)
+{
+    QBuffer buffer;
+    QFile file;
+    QIODevice * device = &file;
+    int index = -1;
+    std::shared_ptr<PackFile> pack = PackFile::Resolve(path, index);
+    if(pack){
+        buffer.setData(pack->Data(index));
+        device = &buffer;
+    } else {
+        file.setFileName(path);
+    }
+    if(!device->open(QIODevice::ReadOnly)){
+        return -1;
+    }
+
+    QVector<Candidate> candidates;
+    int orientation = 1;
+    QByteArray capture;
+    FindCandidates(device, candidates, orientation, &capture);
+    // 没有记录时相机写全零或空格
+    QDateTime time = QDateTime::fromString(QString::fromLatin1(capture), "yyyy:MM:dd HH:mm:ss");
+    return time.isValid() ? time.toMSecsSinceEpoch() : -1;
+}
+
+// 只读开头几 KB 找到帧头，确认是解码器支持的基线/渐进 JPEG，
+// 避免把 RAW 的无损 JPEG 数据（SOF3）整段读进内存再失败
+bool PreviewExtractor::IsBaselineJpeg(QIODevice *device, qint64 offset, qint64 length)
+{
+    if(!device->seek(offset)){
+        return false;
+    }
+    QByteArray head = device->read(qMin<qint64>(length, 64 * 1024));
+    const uchar * p = reinterpret_cast<const uchar*>(head.constData());
+    const int size = head.size();
+    if(size < 4 || p[0] != 0xFF || p[1] != 0xD8){
+        return false;
+    }
+    int pos = 2;
+    while(pos + 4 <= size){
+        if(p[pos] != 0xFF){
+            return false;
+        }
+        uchar marker = p[pos + 1];
+        if(marker == 0xFF){
+            ++pos;
+            continue;
+        }
+        if(marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC){
+            return marker <= 0xC2;
+        }
+        pos += 2 + (p[pos + 2] << 8 | p[pos + 3]);
+    }
+    return false;
+}
+
+QImage PreviewExtractor::ApplyOrientation(const QImage &image, int orientation)
+{
+    switch(orientation){
+    case 2:
+        return image.mirrored(true, false);
+    case 3:
+        return image.transformed(QTransform().rotate(180));
+    case 4:
+        return image.mirrored(false, true);
+    case 5:
+        return image.mirrored(true, false).transformed(QTransform().rotate(270));
+    case 6:
+        return image.transformed(QTransform().rotate(90));
+    case 7:
+        return image.mirrored(true, false).transformed(QTransform().rotate(90));
+    case 8:
+        return image.transformed(QTransform().rotate(270));
+    default:
+        return image;
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef PREVIEWEXTRACTOR_H
+#define PREVIEWEXTRACTOR_H
+
+#include <QImage>
+#include <QIODevice>
+#include <QString>
+#include <QVector>
+
+/*
+ * 内嵌预览提取。
+ * 相机 JPEG 的 EXIF（APP1 段）里带一张缩略图，RAW 文件（CR2/NEF/ARW/DNG 都是 TIFF 结构）
+ * 在各级 IFD 里带一张或几张 JPEG 预览。这里只解析 TIFF/IFD 结构找到预览的偏移和长度，
+ * 只读这几段字节并解码，不读整张原图；RAW 文件也就不需要 RAW 显影器就能显示。
+ */
+class PreviewExtractor
+{
+public:
+    enum Which {
+        Smallest,   // 最小的预览，用于立刻显示
+        Largest     // 最大的预览，RAW 文件用它代替完整解码
+    };
+
+    // path 可以是普通路径或打包项目的虚拟路径；max_side > 0 时缩小解码；没有预览返回空图片
+    static QImage Extract(const QString & path, Which which, int max_side = 0);
+    static QImage Extract(QIODevice * device, Which which, int max_side = 0);
+    // EXIF 拍摄时间（DateTimeOriginal，没有则取 IFD0 的 DateTime），按本地时间解释，
+    // 返回自 1970 年起的毫秒数；没有 EXIF 返回 -1
+    static qint64 CaptureTime(const QString & path);
+
+private:
+    struct Candidate {
+        qint64 offset;
+        qint64 length;
+    };
+
+    // capture 不为空时还要进入 Exif IFD 读取拍摄时间（"YYYY:MM:DD HH:MM:SS"）
+    static void FindCandidates(QIODevice * device, QVector<Candidate> & candidates, int & orientation,
+                               QByteArray * capture = nullptr);
+    static void ParseTiff(QIODevice * device, qint64 base, qint64 limit,
+                          QVector<Candidate> & candidates, int & orientation, QByteArray * capture = nullptr);
+    static bool IsBaselineJpeg(QIODevice * device, qint64 offset, qint64 length);
+    static QImage ApplyOrientation(const QImage & image, int orientation);
+};
+
+#endif // PREVIEWEXTRACTOR_H
@@ -0,0 +1,195 @@
+#include "promanifest.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QObject>
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+const char kHeader[] = "album-manifest 1";
+
+// 路径中的制表符、换行和反斜杠需要转义，保证一行一条记录
+QString Escape(const QString & text)
+{
+    QString out;
+    out.reserve(text.size());
+    for(QChar ch : text){
+        if(ch == '\\'){
+            out += "\\\\";
+        } else if(ch == '\t'){
+            out += "\\t";
+        } else if(ch == '\n'){
+            out += "\\n";
+        } else {
+            out += ch;
+        }
+    }
+    return out;
+}
+
+QString Unescape(const QString & text)
+{
+    QString out;
+    out.reserve(text.size());
+    for(int i = 0; i < text.size(); ++i){
+        QChar ch = text.at(i);
+        if(ch == '\\' && i + 1 < text.size()){
+            QChar next = text.at(++i);
+            out += next == 't' ? QChar('\t') : next == 'n' ? QChar('\n') : next;
+        } else {
+            out += ch;
+        }
+    }
+    return out;
+}
+}
+
+ProManifest::ProManifest(const QString &pro_path)
+    :_pro_path(pro_path)
+{
+
+}
+
+QString ProManifest::ManifestPath() const
+{
+    return QDir(_pro_path).absoluteFilePath(".album_manifest");
+}
+
+bool ProManifest::Load()
+{
+    _entries.clear();
+    _index.clear();
+
+    QFile file(ManifestPath());
+    if(!file.exists()){
+        return true;
+    }
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text)){
+        return false;
+    }
+
+    if(file.readLine().trimmed() != kHeader){
+        return false;
+    }
+    // 每行：模式 大小 修改时间 相对路径 原图路径
+    while(!file.atEnd()){
+        QString line = QString::fromUtf8(file.readLine());
+        line.chop(line.endsWith('\n') ? 1 : 0);
+        QStringList fields = line.split('\t');
+        if(fields.size() != 5){
+            continue;
+        }
+        Entry entry;
+        entry.mode = fields.at(0) == "hard" ? LinkHard
+                     : fields.at(0) == "symbolic" ? LinkSymbolic : LinkReference;
+        entry.size = fields.at(1).toLongLong();
+        entry.mtime = fields.at(2).toLongLong();
+        entry.rel_path = Unescape(fields.at(3));
+        entry.source = Unescape(fields.at(4));
+        Add(entry);
+    }
+    return true;
+}
+
+bool ProManifest::Save() const
+{
+    QSaveFile file(ManifestPath());
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text)){
+        return false;
+    }
+    QByteArray data(kHeader);
+    data += '\n';
+    for(const Entry & entry : _entries){
+        QString line = QString("%1\t%2\t%3\t%4\t%5\n")
+            .arg(entry.mode == LinkHard ? "hard" : entry.mode == LinkSymbolic ? "symbolic" : "reference")
+            .arg(entry.size).arg(entry.mtime)
+            .arg(Escape(entry.rel_path), Escape(entry.source));
+        data += line.toUtf8();
+    }
+    if(file.write(data) != data.size()){
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+void ProManifest::Add(const Entry &entry)
+{
+    auto iter = _index.find(entry.rel_path);
+    if(iter != _index.end()){
+        _entries[iter.value()] = entry;
+        return;
+    }
+    _index.insert(entry.rel_path, _entries.size());
+    _entries.append(entry);
+}
+
+const QVector<ProManifest::Entry> &ProManifest::Entries() const
+{
+    return _entries;
+}
+
+QHash<QString, QVector<ProManifest::Entry>> ProManifest::References() const
+{
+    QHash<QString, QVector<Entry>> refs;
+    for(const Entry & entry : _entries){
+        if(entry.mode != LinkReference){
+            continue;
+        }
+        int slash = entry.rel_path.lastIndexOf('/');
+        refs[slash < 0 ? QString() : entry.rel_path.left(slash)].append(entry);
+    }
+    return refs;
+}
+
+QVector<ProManifest::Problem> ProManifest::Check() const
+{
+    QVector<Problem> problems;
+    for(const Entry & entry : _entries){
+        QFileInfo info(entry.source);
+        if(!info.exists()){
+            problems.append({entry, SourceMissing});
+        } else if(info.size() != entry.size || info.lastModified().toMSecsSinceEpoch() != entry.mtime){
+            problems.append({entry, SourceChanged});
+        }
+    }
+    return problems;
+}
+
+ProManifest::LinkMode ProManifest::LinkFile(const QString &src, const QString &dst)
+{
+#ifdef Q_OS_WIN
+    // Windows 上 QFile::link 创建的是 .lnk 快捷方式，不能当图片读，只尝试硬链接
+    if(CreateHardLinkW(reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(dst).utf16()),
+                       reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(src).utf16()), nullptr)){
+        return LinkHard;
+    }
+#else
+    // 跨文件系统时 link 返回 EXDEV，退回符号链接
+    if(::link(QFile::encodeName(src).constData(), QFile::encodeName(dst).constData()) == 0){
+        return LinkHard;
+    }
+    if(QFile::link(QFileInfo(src).absoluteFilePath(), dst)){
+        return LinkSymbolic;
+    }
+#endif
+    return LinkReference;
+}
+
+QString ProManifest::ModeName(LinkMode mode)
+{
+    switch(mode){
+    case LinkHard:
+        return QObject::tr("硬链接");
+    case LinkSymbolic:
+        return QObject::tr("符号链接");
+    default:
+        return QObject::tr("引用");
+    }
+}
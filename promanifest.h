@@ -0,0 +1,69 @@
+#ifndef PROMANIFEST_H
+#define PROMANIFEST_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+/*
+ * 项目清单，记录链接导入的图片来自哪里。
+ * 链接导入不复制像素：同一文件系统上建硬链接，不行就建符号链接，
+ * 再不行只在清单里记下原图路径（引用）。清单保存在项目根目录的隐藏文件里，
+ * 每行一条，制表符分隔，同时记下导入时原图的大小和修改时间，
+ * 之后可以据此检查原图是否被移动、删除或修改。
+ */
+class ProManifest
+{
+public:
+    enum LinkMode {
+        LinkHard,       // 硬链接，原图移动后项目里的图片仍然可用
+        LinkSymbolic,   // 符号链接，原图移动后失效
+        LinkReference   // 只记录路径，项目目录里没有文件
+    };
+
+    struct Entry {
+        QString rel_path;   // 在项目中的相对路径
+        QString source;     // 原图绝对路径
+        LinkMode mode;
+        qint64 size;        // 导入时原图大小
+        qint64 mtime;       // 导入时原图修改时间（毫秒）
+    };
+
+    // 原图检查结果
+    enum SourceState {
+        SourceOk,
+        SourceMissing,      // 原图不在了（被移动或删除）
+        SourceChanged       // 原图大小或修改时间变了
+    };
+
+    struct Problem {
+        Entry entry;
+        SourceState state;
+    };
+
+    explicit ProManifest(const QString & pro_path);
+
+    // 读取清单，文件不存在视为空清单
+    bool Load();
+    // 原子地写回清单
+    bool Save() const;
+    void Add(const Entry & entry);
+    const QVector<Entry> & Entries() const;
+    // 只有引用、项目目录里没有实际文件的图片，按所在目录（项目内相对路径，根目录为空）分组
+    QHash<QString, QVector<Entry>> References() const;
+    // 逐个检查原图，返回有问题的条目
+    QVector<Problem> Check() const;
+
+    // 把 src 链接到 dst，依次尝试硬链接、符号链接，都失败返回 LinkReference
+    static LinkMode LinkFile(const QString & src, const QString & dst);
+    static QString ModeName(LinkMode mode);
+
+private:
+    QString ManifestPath() const;
+
+    QString _pro_path;
+    QVector<Entry> _entries;
+    QHash<QString, int> _index;     // 相对路径到 _entries 下标，重复导入时覆盖旧记录
+};
+
+#endif // PROMANIFEST_H
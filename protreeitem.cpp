@@ -1,4 +1,5 @@
 #include "protreeitem.h"
+#include "const.h"
 
 // 构造函数1：用于创建顶层节点
 // 参数 view：树控件 QTreeWidget 的指针
@@ -13,7 +14,8 @@ ProTreeItem::ProTreeItem(QTreeWidget * view, const QString & name,
     _name(name),       // 保存项目名称
     _root(this),       // 顶层节点的 root 指向自己
     _pre_item(nullptr),// 前一个兄弟节点（初始化为空）
-    _next_item(nullptr)// 下一个兄弟节点（初始化为空）
+    _next_item(nullptr),// 下一个兄弟节点（初始化为空）
+    _need_load(false)  // 默认子节点已加载
 {
 }
 
@@ -31,7 +33,8 @@ ProTreeItem::ProTreeItem(QTreeWidgetItem * parent, const QString & name, const Q
     _name(name),       // 项目名称
     _path(path),       // 项目路径
     _pre_item(nullptr),// 前一个兄弟节点（初始化为空）
-    _next_item(nullptr)// 下一个兄弟节点（初始化为空）
+    _next_item(nullptr),// 下一个兄弟节点（初始化为空）
+    _need_load(false)  // 默认子节点已加载
 {
 }
 
@@ -47,6 +50,17 @@ QTreeWidgetItem *ProTreeItem::GetRoot()
     return _root;
 }
 
+void ProTreeItem::SetPath(const QString &path, const QString &name)
+{
+    _path = path;
+    _name = name;
+}
+
+void ProTreeItem::SetRoot(QTreeWidgetItem *root)
+{
+    _root = root;
+}
+
 // 设置前一个兄弟节点
 void ProTreeItem::SetPreItem(QTreeWidgetItem *item)
 {
@@ -71,3 +85,51 @@ ProTreeItem *ProTreeItem::GetNextItem()
 {
     return dynamic_cast<ProTreeItem*>(_next_item);
 }
+
+// 获取子树中按显示顺序的最后一个图片节点，没有返回 nullptr
+ProTreeItem *ProTreeItem::GetLastPicChild()
+{
+    for(int i = childCount() - 1; i >= 0; --i){
+        auto * item = dynamic_cast<ProTreeItem*>(child(i));
+        if(!item){
+            continue;
+        }
+        if(item->type() == TreeItemPic){
+            return item;
+        }
+        auto * last = item->GetLastPicChild();
+        if(last){
+            return last;
+        }
+    }
+    return nullptr;
+}
+
+// 获取子树中按显示顺序的第一个图片节点，没有返回 nullptr
+ProTreeItem *ProTreeItem::GetFirstPicChild()
+{
+    for(int i = 0; i < childCount(); ++i){
+        auto * item = dynamic_cast<ProTreeItem*>(child(i));
+        if(!item){
+            continue;
+        }
+        if(item->type() == TreeItemPic){
+            return item;
+        }
+        auto * first = item->GetFirstPicChild();
+        if(first){
+            return first;
+        }
+    }
+    return nullptr;
+}
+
+void ProTreeItem::SetNeedLoad(bool need_load)
+{
+    _need_load = need_load;
+}
+
+bool ProTreeItem::NeedLoad()
+{
+    return _need_load;
+}
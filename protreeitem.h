@@ -13,12 +13,18 @@ public:
 
     const QString & GetPath();
     QTreeWidgetItem * GetRoot();
+    // 批量移动、重命名后更新节点对应的磁盘位置
+    void SetPath(const QString & path, const QString & name);
+    void SetRoot(QTreeWidgetItem * root);
     void SetPreItem(QTreeWidgetItem * item);
     void SetNextItem(QTreeWidgetItem * item);
     ProTreeItem * GetPreItem();
     ProTreeItem * GetNextItem();
     ProTreeItem * GetLastPicChild();
     ProTreeItem * GetFirstPicChild();
+    // 按需加载：子节点尚未从磁盘读取
+    void SetNeedLoad(bool need_load);
+    bool NeedLoad();
 
 private:
     QString _path;
@@ -26,6 +32,7 @@ private:
     QTreeWidgetItem * _root;
     QTreeWidgetItem * _pre_item;
     QTreeWidgetItem * _next_item;
+    bool _need_load;
 };
 
 #endif // PROTREEITEM_H
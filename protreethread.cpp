@@ -1,7 +1,14 @@
 #include "protreethread.h"
 #include <QDir>
+#include <QFileInfo>
 #include "protreeitem.h"
 #include "const.h"
+#include "dateindex.h"
+#include "dirscanner.h"
+#include "ioscheduler.h"
+#include "recompressor.h"
+#include <QSettings>
+#include <QTreeWidgetItemIterator>
 
 // 构造函数：初始化线程任务参数
 ProTreeThread::ProTreeThread(const QString &src_path,
@@ -16,21 +23,48 @@ ProTreeThread::ProTreeThread(const QString &src_path,
     _parent_item(parentItem),    // 父节点（ProTreeItem）
     _self(self),                 // 树控件 QTreeWidget
     _root(root),                 // 根节点（顶层 ProTreeItem）
-    _bstop(false)                // 停止标记，默认为 false
+    _bstop(false),               // 停止标记，默认为 false
+    _import_mode(ImportCopy),    // 默认复制导入
+    _manifest(dist_path),        // 项目清单，位于项目根目录
+    _encoding(0),
+    _saved_bytes(0),
+    _io(nullptr),
+    _progress(file_count)
 {
-
+    // 留一个核给读目录和复制的导入线程
+    _encode_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+    // 压缩导入默认保留 JPEG 的注释和 IPTC，设置后才去掉
+    QSettings settings;
+    _strip_metadata = settings.value("import/strip_jpeg_metadata", false).toBool();
 }
 
 ProTreeThread::~ProTreeThread()
 {
+    delete _io;
+}
 
+void ProTreeThread::SetImportMode(ImportMode mode)
+{
+    _import_mode = mode;
 }
 
 // 线程执行函数
 void ProTreeThread::run()
 {
+    // 链接导入追加到已有清单中
+    if(_import_mode == ImportLink){
+        _manifest.Load();
+    }
+
+    // 链接导入不读写像素数据，不需要调度
+    if(_import_mode != ImportLink && _src_path != _dist_path){
+        _io = new IoScheduler(_src_path, _dist_path);
+    }
+
     // 创建项目树（递归扫描目录并填充节点）
     CreateProTree(_src_path, _dist_path, _parent_item, _file_count, _self, _root);
+    // 等待还在编码的文件写完，取消时也要等，之后才能删除目录
+    _encode_pool.waitForDone();
 
     // 如果线程在中途被取消
     if(_bstop){
@@ -45,8 +79,18 @@ void ProTreeThread::run()
         return;
     }
 
+    if(_import_mode == ImportLink){
+        _manifest.Save();
+    }
+    int failed = RemoveFailed();
+    // 时间线索引只补上这次导入的目录，不用等打开时间线时扫描整个项目
+    DateIndex::Patch(dynamic_cast<ProTreeItem*>(_root)->GetPath(), QStringList{_dist_path}, QStringList());
+
     // 如果成功完成，发送完成信号
     emit SigFinishProgress(_file_count);
+    if(_import_mode == ImportCompact){
+        emit SigCompactDone(_saved_bytes.load(), failed);
+    }
 }
 
 // 核心递归函数：遍历目录并构建项目树
@@ -69,12 +113,23 @@ void ProTreeThread::CreateProTree(const QString &src_path,
         needcopy = false;
     }
 
-    // 打开源目录，准备遍历
-    QDir import_dir(src_path);
-    // QStringList nameFilters;
-    import_dir.setFilter(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot); // 过滤掉 "." 和 ".."
-    import_dir.setSorting(QDir::Name);  // 按名称排序
-    QFileInfoList list = import_dir.entryInfoList();
+    // 列出源目录（过滤掉 "." 和 ".."，按名称排序），类型直接取自目录项；
+    // 链接导入要记录原图的大小和修改时间，复制时按大小统计吞吐量
+    QVector<DirEntry> list;
+    DirScanner::List(src_path, list, true);
+
+    // 先把本目录的图片交给调度器复制，节点仍按名称顺序创建
+    QVector<DirEntry> files;
+    for(const DirEntry & entry : list){
+        if(!entry.is_dir && DirScanner::IsPicFile(entry.name)){
+            files.append(entry);
+        }
+    }
+    QVector<char> copied(files.size(), 0);
+    if(needcopy && _io){
+        CopyFiles(files, dist_path, copied);
+    }
+    int file_index = 0;
 
     // 遍历目录内容
     for(int i = 0; i < list.size(); ++i){
@@ -82,8 +137,8 @@ void ProTreeThread::CreateProTree(const QString &src_path,
             return;
         }
 
-        QFileInfo fileInfo = list.at(i);
-        bool bIsDir = fileInfo.isDir();
+        const DirEntry & entry = list.at(i);
+        bool bIsDir = entry.is_dir;
 
         if(bIsDir){ // 如果是目录
             if(_bstop){
@@ -92,11 +147,11 @@ void ProTreeThread::CreateProTree(const QString &src_path,
 
             // 更新进度
             file_count ++;
-            emit SigUpdateProgress(file_count);
+            emit SigUpdateProgress(++_progress);
 
-            // 构建目标目录路径
-            QDir dist_dir(_dist_path);
-            QString sub_dist_path = dist_dir.absoluteFilePath(fileInfo.fileName());
+            // 构建目标目录路径（相对于当前层的目标目录，保持源目录的层级）
+            QDir dist_dir(dist_path);
+            QString sub_dist_path = dist_dir.absoluteFilePath(entry.name);
             QDir sub_dist_dir(sub_dist_path);
             if(!sub_dist_dir.exists()){
                 bool ok = sub_dist_dir.mkpath(sub_dist_path); // 创建目录
@@ -106,14 +161,14 @@ void ProTreeThread::CreateProTree(const QString &src_path,
             }
 
             // 创建一个 ProTreeItem 节点（目录类型）
-            auto *item = new ProTreeItem(parent_item, fileInfo.fileName(), sub_dist_path,
+            auto *item = new ProTreeItem(parent_item, entry.name, sub_dist_path,
                                          root, TreeItemDir);
-            item->setData(0, Qt::DisplayRole, fileInfo.fileName());  // 显示名称
+            item->setData(0, Qt::DisplayRole, entry.name);  // 显示名称
             item->setData(0, Qt::DecorationRole, QIcon(":/icon/dir.png")); // 设置图标
             item->setData(0, Qt::ToolTipRole, sub_dist_path); // 提示信息
 
             // 递归处理子目录
-            CreateProTree(fileInfo.absoluteFilePath(), sub_dist_path,
+            CreateProTree(entry.path, sub_dist_path,
                           item, file_count, self, root, preItem);
 
         } else { // 如果是文件
@@ -122,30 +177,50 @@ void ProTreeThread::CreateProTree(const QString &src_path,
             }
 
             // 只处理图片文件
-            const QString& suffix = fileInfo.completeSuffix();
-            if(suffix != "png" && suffix != "jpeg" && suffix != "jpg"){
+            if(!DirScanner::IsPicFile(entry.name)){
                 continue;
             }
 
             file_count ++;
-            emit SigUpdateProgress(file_count);
+            const bool done = copied.at(file_index++);
 
             // 如果不需要复制（源目录=目标目录），就直接跳过复制操作
             if(!needcopy){
+                emit SigUpdateProgress(++_progress);
                 continue;
             }
 
             // 构造目标文件路径，并复制文件
             QDir dist_dir(dist_path);
-            QString dist_file_path = dist_dir.absoluteFilePath(fileInfo.fileName());
-            if(!QFile::copy(fileInfo.absoluteFilePath(), dist_file_path)){
-                continue; // 如果复制失败则跳过
+            QString dist_file_path = dist_dir.absoluteFilePath(entry.name);
+            if(_io){
+                // 已由调度器复制，失败的文件跳过
+                if(!done){
+                    continue;
+                }
+            } else if(_import_mode == ImportLink){
+                emit SigUpdateProgress(++_progress);
+                // 目标已存在时和复制一样跳过，避免退化成引用
+                if(QFileInfo::exists(dist_file_path)){
+                    continue;
+                }
+                ProManifest::Entry record;
+                record.rel_path = QDir(_dist_path).relativeFilePath(dist_file_path);
+                record.source = entry.path;
+                record.mode = ProManifest::LinkFile(entry.path, dist_file_path);
+                record.size = entry.size;
+                record.mtime = entry.mtime;
+                _manifest.Add(record);
+                // 只有引用时项目里没有文件，节点直接指向原图
+                if(record.mode == ProManifest::LinkReference){
+                    dist_file_path = entry.path;
+                }
             }
 
             // 创建一个 ProTreeItem 节点（图片类型）
-            auto * item = new ProTreeItem(parent_item, fileInfo.fileName(),
+            auto * item = new ProTreeItem(parent_item, entry.name,
                                          dist_file_path, root, TreeItemPic);
-            item->setData(0, Qt::DisplayRole, fileInfo.fileName());
+            item->setData(0, Qt::DisplayRole, entry.name);
             item->setData(0, Qt::DecorationRole, QIcon(":/icon/pic.png"));
             item->setData(0, Qt::ToolTipRole, dist_file_path);
 
@@ -160,6 +235,106 @@ void ProTreeThread::CreateProTree(const QString &src_path,
     }
 }
 
+// 复制一个目录中的图片：机械盘上按物理位置排序后提交，等本目录全部完成再返回，
+// copied 按 files 的原顺序记录每个文件是否复制成功
+void ProTreeThread::CopyFiles(const QVector<DirEntry> &files, const QString &dist_path, QVector<char> &copied)
+{
+    QVector<DirEntry> order = files;
+    QHash<QString, int> index_of;
+    for(int i = 0; i < files.size(); ++i){
+        index_of.insert(files.at(i).path, i);
+    }
+    _io->Order(order);
+
+    QDir dist_dir(dist_path);
+    char * results = copied.data();
+    for(const DirEntry & entry : order){
+        if(_bstop){
+            break;
+        }
+        const int index = index_of.value(entry.path);
+        const QString dst = dist_dir.absoluteFilePath(entry.name);
+        const QString src = entry.path;
+        const qint64 size = entry.size;
+        _io->Submit([this, src, dst, size, index, results]() -> qint64 {
+            if(_bstop){
+                return 0;
+            }
+            // 交给编码线程的文件还没写出，不计入调度器的吞吐量
+            qint64 written = size;
+            bool ok = _import_mode == ImportCompact ? CompactCopy(src, dst, size, written)
+                                                    : QFile::copy(src, dst);
+            results[index] = ok;
+            emit SigUpdateProgress(++_progress);
+            return ok ? written : 0;
+        });
+    }
+    _io->WaitForDone();
+}
+
+// 压缩导入一个文件：交给编码线程池，和后续文件的读取、目录遍历重叠进行。
+// 编码线程都忙时直接复制，导入速度不低于普通复制。
+// 交给编码线程时先返回 true、written 置 0，节点照常创建；写入最终失败的文件记入 _failed，导入结束前删掉对应节点
+bool ProTreeThread::CompactCopy(const QString &src, const QString &dst, qint64 size, qint64 &written)
+{
+    if(!Recompressor::IsCandidate(src, size)
+        || _encoding >= _encode_pool.maxThreadCount() * 2){
+        return QFile::copy(src, dst);
+    }
+    if(QFileInfo::exists(dst)){
+        return false;   // 和 QFile::copy 一样不覆盖已有文件
+    }
+
+    ++_encoding;
+    written = 0;
+    _encode_pool.start([this, src, dst](){
+        if(!_bstop){
+            qint64 saved = 0;
+            bool ok = true;
+            if(Recompressor::CompactFile(src, dst, saved, _strip_metadata) == Recompressor::Failed){
+                ok = QFile::copy(src, dst);
+            }
+            if(ok){
+                _saved_bytes += saved;
+            } else {
+                QMutexLocker locker(&_failed_mutex);
+                _failed.insert(dst);
+            }
+        }
+        --_encoding;
+    });
+    return true;
+}
+
+// 删除编码线程没能写出的文件对应的节点，并把前后两张图片重新连起来；返回删除的节点数
+int ProTreeThread::RemoveFailed()
+{
+    QMutexLocker locker(&_failed_mutex);
+    if(_failed.isEmpty()){
+        return 0;
+    }
+    QList<ProTreeItem*> doomed;
+    for(QTreeWidgetItemIterator it(_root); *it; ++it){
+        auto * item = dynamic_cast<ProTreeItem*>(*it);
+        if(item && item->type() == TreeItemPic && _failed.contains(item->GetPath())){
+            doomed.append(item);
+        }
+    }
+    for(ProTreeItem * item : doomed){
+        ProTreeItem * pre = item->GetPreItem();
+        ProTreeItem * next = item->GetNextItem();
+        if(pre){
+            pre->SetNextItem(next);
+        }
+        if(next){
+            next->SetPreItem(pre);
+        }
+        delete item;
+    }
+    _failed.clear();
+    return doomed.size();
+}
+
 // 槽函数：外部调用时设置停止标记
 void ProTreeThread::SlotCancelProgress()
 {
@@ -3,20 +3,39 @@
 
 #include <QThread>
 #include <QTreeWidget>
+#include <QThreadPool>
+#include <QMutex>
+#include <QSet>
+#include <atomic>
+#include "promanifest.h"
+
+class IoScheduler;
+struct DirEntry;
 
 class ProTreeThread : public QThread
 {
     Q_OBJECT
 public:
+    // 导入方式：复制文件，链接到原图（不复制像素），或复制时无损压缩
+    enum ImportMode {
+        ImportCopy,
+        ImportLink,
+        ImportCompact
+    };
+
     ProTreeThread(const QString & src_path, const QString& dist_path, QTreeWidgetItem* parentItem,
                     int file_count, QTreeWidget* self, QTreeWidgetItem* root, QObject * parent = nullptr);
     ~ProTreeThread();
+    void SetImportMode(ImportMode mode);
 protected:
     virtual void run();
 
 private:
     void CreateProTree(const QString& src_path, const QString& dist_path, QTreeWidgetItem* parent_item,
                        int &file_count, QTreeWidget * self, QTreeWidgetItem* root, QTreeWidgetItem* preItem = nullptr);
+    bool CompactCopy(const QString & src, const QString & dst, qint64 size, qint64 & written);
+    int RemoveFailed();
+    void CopyFiles(const QVector<DirEntry> & files, const QString & dist_path, QVector<char> & copied);
 
     QString _src_path;
     QString _dist_path;
@@ -24,7 +43,17 @@ private:
     QTreeWidgetItem* _parent_item;
     QTreeWidget* _self;
     QTreeWidgetItem * _root;
-    bool _bstop;
+    std::atomic<bool> _bstop;   // 界面线程写，导入线程和编码线程读
+    ImportMode _import_mode;
+    ProManifest _manifest;      // 链接导入时记录原图来源
+    QThreadPool _encode_pool;   // 压缩导入的编码线程
+    bool _strip_metadata;       // 压缩导入时是否去掉 JPEG 的注释和 IPTC（import/strip_jpeg_metadata）
+    std::atomic<int> _encoding;         // 已提交还没写完的文件数
+    std::atomic<qint64> _saved_bytes;   // 压缩导入节省的字节数
+    QMutex _failed_mutex;
+    QSet<QString> _failed;              // 编码线程没能写出的目标文件
+    IoScheduler * _io;                  // 按源和目标设备调整复制的顺序和并发数
+    std::atomic<int> _progress;         // 已处理的条目数，复制线程完成一个文件就更新进度
 
 public slots:
     void SlotCancelProgress();
@@ -32,6 +61,8 @@ public slots:
 signals:
     void SigUpdateProgress(int);
     void SigFinishProgress(int);
+    // 压缩导入完成：节省的字节数，以及没能写入而跳过的文件数
+    void SigCompactDone(qint64 saved, int failed);
 };
 
 #endif // PROTREETHREAD_H
@@ -1,15 +1,86 @@
 #include "protreewidget.h"
 #include <QDir>
+#include <QFileInfo>
 #include "protreeitem.h"
 #include "const.h"
 #include <QGuiApplication>
 #include <QMenu>
 #include <QFileDialog>
 #include "removeprodialog.h"
+#include "timelinedialog.h"
+#include "dateindex.h"
+#include <QSettings>
+#include <QTreeWidgetItemIterator>
+#include "packfile.h"
+#include "checksumindex.h"
+#include "mappedfile.h"
+#include "aviwriter.h"
+#include <QDateTime>
+#include <QFutureWatcher>
+#include <QInputDialog>
+#include <QMessageBox>
+#include <QPointer>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <climits>
+#include <functional>
+
+namespace {
+// 按显示顺序，在 item 之前最近的图片节点（限于同一项目内）
+ProTreeItem * PrevPicBefore(QTreeWidgetItem * item)
+{
+    QTreeWidgetItem * node = item;
+    while(node->parent()){
+        QTreeWidgetItem * parent = node->parent();
+        for(int i = parent->indexOfChild(node) - 1; i >= 0; --i){
+            auto * sibling = dynamic_cast<ProTreeItem*>(parent->child(i));
+            if(!sibling){
+                continue;
+            }
+            if(sibling->type() == TreeItemPic){
+                return sibling;
+            }
+            auto * last = sibling->GetLastPicChild();
+            if(last){
+                return last;
+            }
+        }
+        node = parent;
+    }
+    return nullptr;
+}
+
+// 按显示顺序，在 item 之后最近的图片节点（限于同一项目内）
+ProTreeItem * NextPicAfter(QTreeWidgetItem * item)
+{
+    QTreeWidgetItem * node = item;
+    while(node->parent()){
+        QTreeWidgetItem * parent = node->parent();
+        for(int i = parent->indexOfChild(node) + 1; i < parent->childCount(); ++i){
+            auto * sibling = dynamic_cast<ProTreeItem*>(parent->child(i));
+            if(!sibling){
+                continue;
+            }
+            if(sibling->type() == TreeItemPic){
+                return sibling;
+            }
+            auto * first = sibling->GetFirstPicChild();
+            if(first){
+                return first;
+            }
+        }
+        node = parent;
+    }
+    return nullptr;
+}
+}
 
 ProTreeWidget::ProTreeWidget(QWidget *parent):QTreeWidget(parent),
     _right_btn_item(nullptr), _active_item(nullptr), _dialog_progress(nullptr),_selected_item(nullptr),
-    _thread_create_pro(nullptr), _thread_open_pro(nullptr),_open_progressdlg(nullptr)
+    _thread_create_pro(nullptr), _thread_open_pro(nullptr),_open_progressdlg(nullptr),
+    _thread_restore_pro(nullptr), _restore_item(nullptr), _restore_holder(nullptr),
+    _export_progressdlg(nullptr), _thread_export(nullptr), _thread_pack(nullptr),
+    _thread_scrub(nullptr), _thread_video(nullptr), _thread_contact(nullptr), _thread_sync(nullptr)
 
 {
     // 隐藏树控件的表头（不显示列标题），更像一个文件浏览树
@@ -17,25 +88,127 @@ ProTreeWidget::ProTreeWidget(QWidget *parent):QTreeWidget(parent),
 
     // 连接信号槽：当用户点击树节点时，触发 SlotItemPressed 函数
     connect(this, &ProTreeWidget::itemPressed, this, &ProTreeWidget::SlotItemPressed);
+    // 按需加载模式下，展开节点时才读取目录内容
+    connect(this, &ProTreeWidget::itemExpanded, this, &ProTreeWidget::SlotItemExpanded);
+    // Ctrl/Shift 多选图片和目录，右键批量移动、重命名、删除
+    this->setSelectionMode(QAbstractItemView::ExtendedSelection);
 
     // 创建右键菜单的动作（Action）
     _action_import = new QAction(QIcon("/icon/import.png"), tr("导入文件"), this);
     // 图标：import.png，显示文本：导入文件
+    _action_import_link = new QAction(QIcon(":/icon/import.png"), tr("链接导入"), this);
+    // 图标：import.png，显示文本：链接导入（不复制图片）
+    _action_import_compact = new QAction(QIcon(":/icon/import.png"), tr("无损压缩导入"), this);
+    // 图标：import.png，显示文本：无损压缩导入（PNG/JPEG 无损重压缩后保存）
+    _action_import_sync = new QAction(QIcon(":/icon/import.png"), tr("同步文件夹"), this);
+    // 图标：import.png，显示文本：同步文件夹（只复制新增和改动的图片）
+    _action_check_source = new QAction(tr("检查原图"), this);
+    // 显示文本：检查原图（链接导入的原图是否被移动或修改）
     _action_setstart = new QAction(QIcon(":/icon/core.png"), tr("设置活动项目"), this);
     // 图标：core.png，显示文本：设置活动项目
     _action_closepro = new QAction(QIcon(":/icon/close.png"), tr("关闭项目"), this);
     // 图标：close.png，显示文本：关闭项目
     _action_slideshow = new QAction(QIcon(":/icon/slideshow.png"), tr("轮播图播放"), this);
     // 图标：slideshow.png，显示文本：轮播图播放
+    _action_export = new QAction(QIcon(":/icon/pic.png"), tr("导出网页相册"), this);
+    // 图标：pic.png，显示文本：导出网页相册
+    _action_video = new QAction(QIcon(":/icon/slideshow.png"), tr("导出幻灯片视频"), this);
+    // 图标：slideshow.png，显示文本：导出幻灯片视频
+    _action_contact = new QAction(QIcon(":/icon/pic.png"), tr("生成联系表"), this);
+    // 图标：pic.png，显示文本：生成联系表（打印小样）
+    _action_pack = new QAction(QIcon(":/icon/dir.png"), tr("打包为单文件"), this);
+    // 图标：dir.png，显示文本：打包为单文件
+    _action_scrub = new QAction(tr("校验项目文件"), this);
+    // 显示文本：校验项目文件（检查图片是否在磁盘上损坏）
+    _action_timeline = new QAction(QIcon(":/icon/pic.png"), tr("时间线"), this);
+    // 图标：pic.png，显示文本：时间线（按拍摄日期分组浏览）
+    _action_batch_move = new QAction(QIcon(":/icon/dir.png"), tr("移动到文件夹..."), this);
+    // 图标：dir.png，显示文本：移动到文件夹（作用于所有选中的图片和目录）
+    _action_batch_rename = new QAction(tr("批量重命名..."), this);
+    // 显示文本：批量重命名（按模板和序号）
+    _action_batch_delete = new QAction(QIcon(":/icon/close.png"), tr("删除"), this);
+    // 图标：close.png，显示文本：删除（从磁盘上删除选中的图片和目录）
 
     // 连接动作触发信号与槽函数
     // 当用户点击“导入文件”菜单项时，触发 SlotImport() 槽函数
     connect(_action_import, &QAction::triggered, this, &ProTreeWidget::SlotImport);
+    connect(_action_import_link, &QAction::triggered, this, &ProTreeWidget::SlotImportLink);
+    connect(_action_import_compact, &QAction::triggered, this, &ProTreeWidget::SlotImportCompact);
+    connect(_action_import_sync, &QAction::triggered, this, &ProTreeWidget::SlotImportSync);
+    connect(_action_check_source, &QAction::triggered, this, &ProTreeWidget::SlotCheckSources);
 
     connect(_action_setstart, &QAction::triggered, this, &ProTreeWidget::SlotSetActive);
 
     connect(_action_closepro, &QAction::triggered, this, &ProTreeWidget::SlotClosePro);
 
+    connect(_action_export, &QAction::triggered, this, &ProTreeWidget::SlotExportGallery);
+    connect(_action_video, &QAction::triggered, this, &ProTreeWidget::SlotExportVideo);
+    connect(_action_contact, &QAction::triggered, this, &ProTreeWidget::SlotContactSheet);
+
+    connect(_action_pack, &QAction::triggered, this, &ProTreeWidget::SlotPackPro);
+
+    connect(_action_scrub, &QAction::triggered, this, &ProTreeWidget::SlotScrubPro);
+    connect(_action_timeline, &QAction::triggered, this, &ProTreeWidget::SlotTimeline);
+
+    connect(_action_batch_move, &QAction::triggered, this, &ProTreeWidget::SlotBatchMove);
+    connect(_action_batch_rename, &QAction::triggered, this, &ProTreeWidget::SlotBatchRename);
+    connect(_action_batch_delete, &QAction::triggered, this, &ProTreeWidget::SlotBatchDelete);
+
+    // 每 10 分钟检查一次有没有项目超过了完整校验的间隔
+    _scrub_timer = new QTimer(this);
+    _scrub_timer->setInterval(10 * 60 * 1000);
+    connect(_scrub_timer, &QTimer::timeout, this, &ProTreeWidget::SlotScheduleScrub);
+    _scrub_timer->start();
+
+    // 摘下的节点在界面线程分批释放，每批之间处理界面事件
+    _release_timer = new QTimer(this);
+    _release_timer->setInterval(0);
+    connect(_release_timer, &QTimer::timeout, this, &ProTreeWidget::SlotReleaseStep);
+}
+
+ProTreeWidget::~ProTreeWidget()
+{
+    // 退出前记录会话，再停止后台加载
+    SaveSession();
+    StopRestore();
+    if(_thread_export){
+        _thread_export->SlotCancelProgress();
+        _thread_export->wait();
+    }
+    if(_thread_pack){
+        _thread_pack->SlotCancelProgress();
+        _thread_pack->wait();
+    }
+    if(_thread_video){
+        _thread_video->SlotCancelProgress();
+        _thread_video->wait();
+    }
+    if(_thread_contact){
+        _thread_contact->SlotCancelProgress();
+        _thread_contact->wait();
+    }
+    if(_thread_sync){
+        _thread_sync->SlotCancelProgress();
+        _thread_sync->wait();
+    }
+    // 取消时已经完成的 rename 保留，两步 rename 的临时名会改回原名
+    if(_thread_batch){
+        _thread_batch->SlotCancelProgress();
+        _thread_batch->wait();
+    }
+    // 校验进度已写回索引，下次启动从中断处继续
+    if(_thread_scrub){
+        _thread_scrub->SlotCancelProgress();
+        _thread_scrub->wait();
+    }
+    qDeleteAll(_release_queue);
+    _release_queue.clear();
+    // 未删完的回收目录已记录在设置中，下次启动继续删除
+    for(RemoveProThread * thread : _remove_threads){
+        thread->SlotCancelProgress();
+        thread->wait();
+        delete thread;
+    }
 }
 
 void ProTreeWidget::AddProTree(const QString &name, const QString &path)
@@ -69,6 +242,198 @@ void ProTreeWidget::AddProTree(const QString &name, const QString &path)
     item->setData(0, Qt::ToolTipRole, file_path);
     // 将新节点添加为顶层节点
     this->addTopLevelItem(item);
+    SaveSession();
+}
+
+// 保存会话：打开的项目列表、活动项目、展开的节点
+void ProTreeWidget::SaveSession()
+{
+    QStringList projects;
+    for(int i = 0; i < this->topLevelItemCount(); ++i){
+        auto * item = dynamic_cast<ProTreeItem*>(this->topLevelItem(i));
+        if(item){
+            projects.append(item->GetPath());
+        }
+    }
+
+    // 当前树上处于展开状态的节点
+    QStringList expanded;
+    QTreeWidgetItemIterator iter(this);
+    while(*iter){
+        auto * item = dynamic_cast<ProTreeItem*>(*iter);
+        if(item && item->isExpanded()){
+            expanded.append(item->GetPath());
+        }
+        ++iter;
+    }
+
+    // 还没加载完的项目，沿用上次记录的展开状态
+    QStringList pending = _restore_queue;
+    if(_restore_item){
+        pending.append(dynamic_cast<ProTreeItem*>(_restore_item)->GetPath());
+    }
+    for(const QString & path : _restore_expanded){
+        for(const QString & root : pending){
+            if(path == root || path.startsWith(root + "/")){
+                expanded.append(path);
+                break;
+            }
+        }
+    }
+    expanded.removeDuplicates();
+
+    QString active;
+    if(_active_item){
+        active = dynamic_cast<ProTreeItem*>(_active_item)->GetPath();
+    }
+
+    QSettings settings;
+    settings.setValue("session/projects", projects);
+    settings.setValue("session/active", active);
+    settings.setValue("session/expanded", expanded);
+}
+
+// 恢复会话：顶层节点立即显示，内容交给后台线程逐个加载，不弹模态进度框
+void ProTreeWidget::RestoreSession()
+{
+    QSettings settings;
+    const QStringList projects = settings.value("session/projects").toStringList();
+    const QString active = settings.value("session/active").toString();
+    const QStringList expanded = settings.value("session/expanded").toStringList();
+    for(const QString & path : expanded){
+        _restore_expanded.insert(path);
+    }
+
+    for(const QString & path : projects){
+        // 打包项目只读索引就能建树，直接打开
+        if(PackFile::IsPackPath(path)){
+            if(_set_path.contains(path)){
+                continue;
+            }
+            QTreeWidgetItem * item = AddPackTree(path);
+            if(item && path == active){
+                QFont font;
+                font.setBold(true);
+                item->setFont(0, font);
+                _active_item = item;
+            }
+            continue;
+        }
+        QDir pro_dir(path);
+        // 目录已不存在或者已经打开的项目跳过
+        if(!pro_dir.exists() || _set_path.contains(path)){
+            continue;
+        }
+        _set_path.insert(path);
+
+        QString name = pro_dir.dirName();
+        auto * item = new ProTreeItem(this, name, path, TreeItemPro);
+        item->setData(0, Qt::DisplayRole, name);
+        item->setData(0, Qt::DecorationRole, QIcon(":/icon/dir.png"));
+        item->setData(0, Qt::ToolTipRole, path);
+        // 内容还没加载，先显示展开箭头
+        item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+
+        if(path == active){
+            QFont font;
+            font.setBold(true);
+            item->setFont(0, font);
+            _active_item = item;
+            // 活动项目优先加载
+            _restore_queue.prepend(path);
+        } else {
+            _restore_queue.append(path);
+        }
+    }
+
+    StartNextRestore();
+    ResumePendingTrash();
+}
+
+// 启动队列中下一个项目的后台加载，同一时间只加载一个
+void ProTreeWidget::StartNextRestore()
+{
+    if(_thread_restore_pro){
+        return;
+    }
+
+    while(!_restore_queue.isEmpty()){
+        QString path = _restore_queue.takeFirst();
+        QTreeWidgetItem * root = nullptr;
+        for(int i = 0; i < this->topLevelItemCount(); ++i){
+            auto * item = dynamic_cast<ProTreeItem*>(this->topLevelItem(i));
+            if(item && item->GetPath() == path){
+                root = item;
+                break;
+            }
+        }
+        // 项目在等待期间已被关闭
+        if(!root){
+            continue;
+        }
+
+        _restore_item = root;
+        _restore_holder = new ProTreeItem(static_cast<QTreeWidgetItem*>(nullptr), root->text(0),
+                                          path, root, TreeItemPro);
+        _thread_restore_pro = std::make_shared<OpenTreeThread>(path, 0, this, nullptr);
+        _thread_restore_pro->SetRestoreRoot(root, _restore_holder);
+
+        OpenTreeThread * thread = _thread_restore_pro.get();
+        connect(thread, &QThread::finished, this, [this, thread](){
+            FinishRestore(thread);
+        });
+        // 后台加载不和界面抢 CPU
+        _thread_restore_pro->start(QThread::LowPriority);
+        return;
+    }
+}
+
+// 后台加载完成：把子树移到根节点下并恢复展开状态，然后加载下一个项目
+void ProTreeWidget::FinishRestore(OpenTreeThread *thread)
+{
+    // 项目在加载过程中被关闭时线程已经回收，忽略迟到的信号
+    if(_thread_restore_pro.get() != thread){
+        return;
+    }
+    thread->wait();
+
+    _restore_item->addChildren(_restore_holder->takeChildren());
+    _restore_item->setChildIndicatorPolicy(QTreeWidgetItem::DontShowIndicatorWhenChildless);
+    delete _restore_holder;
+    _restore_holder = nullptr;
+
+    QList<QTreeWidgetItem*> stack;
+    stack.append(_restore_item);
+    while(!stack.isEmpty()){
+        auto * item = stack.takeLast();
+        auto * pro_item = dynamic_cast<ProTreeItem*>(item);
+        if(pro_item && _restore_expanded.contains(pro_item->GetPath())){
+            item->setExpanded(true);
+        }
+        for(int i = 0; i < item->childCount(); ++i){
+            stack.append(item->child(i));
+        }
+    }
+
+    CheckSources(dynamic_cast<ProTreeItem*>(_restore_item)->GetPath(), true);
+    MarkScrubFailures(dynamic_cast<ProTreeItem*>(_restore_item)->GetPath());
+    _restore_item = nullptr;
+    _thread_restore_pro.reset();
+    StartNextRestore();
+}
+
+// 停止正在进行的后台加载，丢弃已构建的部分子树
+void ProTreeWidget::StopRestore()
+{
+    if(!_thread_restore_pro){
+        return;
+    }
+    _thread_restore_pro->SlotCancelProgress();
+    _thread_restore_pro->wait();
+    _thread_restore_pro.reset();
+    delete _restore_holder;
+    _restore_holder = nullptr;
+    _restore_item = nullptr;
 }
 
 // 当用户点击树节点时触发
@@ -80,18 +445,144 @@ void ProTreeWidget::SlotItemPressed(QTreeWidgetItem *pressedItem, int column)
         int itemtype = pressedItem->type();  // 获取节点类型
         if(itemtype == TreeItemPro){  // 如果是项目类型节点
             _right_btn_item = pressedItem; // 记录当前右键点击的节点，用于后续操作
+            // 打包项目是只读的单个文件，不能导入、导出或再次打包
+            bool is_pack = PackFile::IsPackPath(dynamic_cast<ProTreeItem*>(pressedItem)->GetPath());
             // 添加菜单操作项
-            menu.addAction(_action_import);     // 导入文件夹
+            if(!is_pack){
+                menu.addAction(_action_import);     // 导入文件夹
+                menu.addAction(_action_import_link);    // 链接导入
+                menu.addAction(_action_import_compact); // 无损压缩导入
+                menu.addAction(_action_import_sync);    // 同步文件夹
+                menu.addAction(_action_check_source);   // 检查原图
+                menu.addAction(_action_export);     // 导出网页相册
+                menu.addAction(_action_pack);       // 打包为单文件
+                menu.addAction(_action_scrub);      // 校验项目文件
+                menu.addAction(_action_timeline);   // 时间线
+            }
             menu.addAction(_action_setstart);   // 设置起始项
             menu.addAction(_action_closepro);   // 关闭项目
             menu.addAction(_action_slideshow);  // 幻灯片浏览
+            menu.addAction(_action_video);      // 导出幻灯片视频
+            menu.addAction(_action_contact);    // 生成联系表
             menu.exec(QCursor::pos());          // 在鼠标当前位置显示菜单
+        } else if(itemtype == TreeItemDir || itemtype == TreeItemPic){     // 目录和图片节点
+            _right_btn_item = pressedItem;
+            if(itemtype == TreeItemDir){
+                menu.addAction(_action_contact);    // 生成联系表
+            }
+            // 打包项目只读，不提供文件操作
+            if(!PackFile::IsPackPath(dynamic_cast<ProTreeItem*>(pressedItem)->GetPath())){
+                int count = BatchSelection().size();
+                _action_batch_delete->setText(count > 1 ? tr("删除 %1 项").arg(count) : tr("删除"));
+                menu.addSeparator();
+                menu.addAction(_action_batch_move);     // 移动到文件夹
+                menu.addAction(_action_batch_rename);   // 批量重命名
+                menu.addAction(_action_batch_delete);   // 删除
+            }
+            menu.exec(QCursor::pos());
+        }
+        return;
+    }
+
+    // 左键点击图片：显示该图片
+    if(pressedItem->type() == TreeItemPic){
+        _selected_item = pressedItem;
+        emit SigUpdateSelected(dynamic_cast<ProTreeItem*>(pressedItem)->GetPath());
+        AdviseReadahead(_selected_item);
+        return;
+    }
+
+    // 左键点进尚未加载的目录时也开始加载
+    RequestLazyLoad(pressedItem);
+}
+
+// 显示区域点击“上一张”：沿图片序列向前移动
+void ProTreeWidget::SlotPreShow()
+{
+    auto * cur = dynamic_cast<ProTreeItem*>(_selected_item);
+    if(!cur || !cur->GetPreItem()){
+        return;
+    }
+    _selected_item = cur->GetPreItem();
+    this->setCurrentItem(_selected_item);
+    emit SigUpdateSelected(cur->GetPreItem()->GetPath());
+    AdviseReadahead(_selected_item);
+}
+
+// 显示区域点击“下一张”：沿图片序列向后移动
+void ProTreeWidget::SlotNextShow()
+{
+    auto * cur = dynamic_cast<ProTreeItem*>(_selected_item);
+    if(!cur || !cur->GetNextItem()){
+        return;
+    }
+    _selected_item = cur->GetNextItem();
+    this->setCurrentItem(_selected_item);
+    emit SigUpdateSelected(cur->GetNextItem()->GetPath());
+    AdviseReadahead(_selected_item);
+}
+
+// 维护当前图片前 1 张、后 3 张的预读窗口：新进入窗口的提前读入，移出窗口的从页缓存丢弃
+void ProTreeWidget::AdviseReadahead(QTreeWidgetItem *item)
+{
+    auto * cur = dynamic_cast<ProTreeItem*>(item);
+    if(!cur){
+        return;
+    }
+    QStringList window;
+    if(cur->GetPreItem()){
+        window.append(cur->GetPreItem()->GetPath());
+    }
+    window.append(cur->GetPath());
+    ProTreeItem * next = cur->GetNextItem();
+    for(int i = 0; i < 3 && next; ++i){
+        window.append(next->GetPath());
+        next = next->GetNextItem();
+    }
+
+    QStringList will_need, dont_need;
+    for(const QString & path : window){
+        if(!_readahead_paths.contains(path)){
+            will_need.append(path);
         }
     }
+    for(const QString & path : _readahead_paths){
+        if(!window.contains(path)){
+            dont_need.append(path);
+        }
+    }
+    _readahead_paths = window;
+
+    // 打开文件在网络文件系统上可能阻塞，放到后台
+    QThreadPool::globalInstance()->start([will_need, dont_need](){
+        for(const QString & path : will_need){
+            MappedFile::WillNeed(path);
+        }
+        for(const QString & path : dont_need){
+            MappedFile::DontNeed(path);
+        }
+    });
 }
 
 // 导入文件夹操作的槽函数
 void ProTreeWidget::SlotImport()
+{
+    StartImport(ProTreeThread::ImportCopy);
+}
+
+// 链接导入：不复制图片，建硬链接/符号链接或只记录原图路径
+void ProTreeWidget::SlotImportLink()
+{
+    StartImport(ProTreeThread::ImportLink);
+}
+
+// 无损压缩导入：PNG 重新压缩、JPEG 去掉冗余段，像素不变
+void ProTreeWidget::SlotImportCompact()
+{
+    StartImport(ProTreeThread::ImportCompact);
+}
+
+void ProTreeWidget::StartImport(ProTreeThread::ImportMode mode)
 {
     QFileDialog file_dialog;                      // 文件夹选择对话框
     file_dialog.setFileMode(QFileDialog::Directory); // 只能选择文件夹
@@ -131,12 +622,20 @@ void ProTreeWidget::SlotImport()
         _right_btn_item,        // 根节点
         nullptr                 // QThread 父对象
         );
+    _thread_create_pro->SetImportMode(mode);
 
     // 连接线程信号与槽函数，用于更新 UI
     connect(_thread_create_pro.get(), &ProTreeThread::SigUpdateProgress,
             this, &ProTreeWidget::SlotUpdateProgress);
     connect(_thread_create_pro.get(), &ProTreeThread::SigFinishProgress,
             this, &ProTreeWidget::SlotFinishProgress);
+    connect(_thread_create_pro.get(), &ProTreeThread::SigCompactDone, this, [this](qint64 saved, int failed){
+        QString text = tr("无损压缩共节省 %1 MB。").arg(saved / 1048576.0, 0, 'f', 1);
+        if(failed > 0){
+            text += tr("\n%1 个文件无法写入，已跳过。").arg(failed);
+        }
+        QMessageBox::information(this, tr("压缩导入"), text);
+    });
     connect(_dialog_progress, &QProgressDialog::canceled,
             this, &ProTreeWidget::SlotCancelProgress);
     connect(this, &ProTreeWidget::SigCancelProgress,
@@ -152,126 +651,1498 @@ void ProTreeWidget::SlotImport()
     _dialog_progress->exec();                         // 显示对话框并阻塞等待线程完成
 }
 
-void ProTreeWidget::SlotSetActive()
+// 同步文件夹：再次导入同一个文件夹时只复制新增和改动的图片，就地更新目录树
+void ProTreeWidget::SlotImportSync()
 {
-    if(!_right_btn_item){
+    if(!_right_btn_item || _thread_sync || _thread_batch){
+        return;
+    }
+    // 后台还在构建这个项目的目录树，同步结果无处可放
+    if(dynamic_cast<ProTreeItem*>(_right_btn_item)->GetRoot() == _restore_item){
+        QMessageBox::information(this, tr("同步文件夹"), tr("项目还在加载，请稍后再试。"));
         return;
     }
+    QTreeWidgetItem * root = _right_btn_item;
+    QString pro_path = dynamic_cast<ProTreeItem*>(root)->GetPath();
 
-    QFont nullFont;
-    nullFont.setBold(false);
-    if(_active_item){
-        _active_item->setFont(0, nullFont);
+    // 每个项目记住上次同步的文件夹，通常就是同一张存储卡
+    QSettings settings;
+    QString key = "sync/source/" + QString::fromLatin1(pro_path.toUtf8().toBase64(QByteArray::Base64UrlEncoding));
+    QString src_path = QFileDialog::getExistingDirectory(this, tr("选择同步的文件夹"),
+                                                         settings.value(key, pro_path).toString());
+    if(src_path.isEmpty() || QDir(src_path) == QDir(pro_path)){
+        return;
     }
+    settings.setValue(key, src_path);
 
-    _active_item = _right_btn_item;
-    nullFont.setBold(true);
-    _active_item->setFont(0, nullFont);
+    auto answer = QMessageBox::question(this, tr("同步文件夹"),
+                                        tr("以前从这个文件夹同步进项目、但源文件夹中已经删除的图片，"
+                                           "是否也从项目中删除？\n其他方式导入和自己添加的文件不受影响。"),
+                                        QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel,
+                                        QMessageBox::No);
+    if(answer == QMessageBox::Cancel){
+        return;
+    }
+
+    _thread_sync = std::make_shared<FolderSyncThread>(src_path, pro_path, answer == QMessageBox::Yes);
+    FolderSyncThread * thread = _thread_sync.get();
+
+    QPointer<QProgressDialog> dialog = new QProgressDialog(this);
+    dialog->setWindowTitle(tr("正在同步文件夹"));
+    dialog->setLabelText(src_path);
+    dialog->setWindowModality(Qt::ApplicationModal);
+    dialog->setFixedWidth(PROGRESS_WIDTH);
+    dialog->setRange(0, 0);
+    dialog->setMinimumDuration(300);
+
+    connect(thread, &FolderSyncThread::SigTotalCount, this, [dialog](int total){
+        if(dialog){
+            dialog->setRange(0, qMax(1, total));
+        }
+    });
+    connect(thread, &FolderSyncThread::SigUpdateProgress, this, [dialog](int count){
+        if(dialog){
+            dialog->setValue(count);
+        }
+    });
+    // 取消时已完成的部分保留，目录树照样按实际结果更新
+    connect(dialog, &QProgressDialog::canceled, thread, &FolderSyncThread::SlotCancelProgress, Qt::DirectConnection);
+    connect(thread, &FolderSyncThread::SigFinishSync, this,
+            [this, root](const QStringList & added_dirs, const QStringList & added_pics,
+                         const QStringList & removed, int changed){
+        // 同步期间项目可能已经关闭
+        if(indexOfTopLevelItem(root) < 0){
+            return;
+        }
+        ApplySync(root, added_dirs, added_pics, removed);
+        QMessageBox::information(this, tr("同步文件夹"),
+                                 tr("新增 %1 张图片，更新 %2 张，删除 %3 项。")
+                                     .arg(added_pics.size()).arg(changed).arg(removed.size()));
+    });
+    connect(thread, &QThread::finished, this, [this, thread, dialog](){
+        if(dialog){
+            dialog->deleteLater();
+        }
+        if(_thread_sync.get() == thread){
+            _thread_sync.reset();
+        }
+    });
+    _thread_sync->start();
 }
 
-void ProTreeWidget::SlotClosePro()
+// 按同步结果增删节点：新节点按名称插到已有兄弟节点之间，尚未加载的目录留给按需加载
+void ProTreeWidget::ApplySync(QTreeWidgetItem *root, const QStringList &added_dirs,
+                              const QStringList &added_pics, const QStringList &removed)
 {
-    RemoveProDialog remove_pro_dialog;
-    auto res = remove_pro_dialog.exec();
-    if(res != QDialog::Accepted){
-        return;
+    QHash<QString, QTreeWidgetItem*> items;
+    std::function<void(QTreeWidgetItem*)> collect = [&](QTreeWidgetItem * node){
+        items.insert(dynamic_cast<ProTreeItem*>(node)->GetPath(), node);
+        for(int i = 0; i < node->childCount(); ++i){
+            collect(node->child(i));
+        }
+    };
+    collect(root);
+
+    // 要摘下的节点；已经随上层目录一起摘下的不再单独处理
+    QSet<QTreeWidgetItem*> removed_set;
+    auto under = [&removed_set](QTreeWidgetItem * node){
+        for(; node; node = node->parent()){
+            if(removed_set.contains(node)){
+                return true;
+            }
+        }
+        return false;
+    };
+    QList<QTreeWidgetItem*> taken;
+    for(const QString & path : removed){
+        QTreeWidgetItem * item = items.value(path);
+        if(!item || item == root || under(item)){
+            continue;
+        }
+        removed_set.insert(item);
+        taken.append(item);
     }
-    bool b_remove = remove_pro_dialog.IsRemoved();
-    auto index_right_btn = this->indexOfTopLevelItem(_right_btn_item);
-    auto * protreeitem = dynamic_cast<ProTreeItem*>(_right_btn_item);
-    // auto * selecteditem = dynamic_cast<ProTreeItem>(_selected_item);
-    auto delete_path = protreeitem->GetPath();
-    _set_path.remove(delete_path);
-    if(b_remove){
-        QDir delete_dir(delete_path);
-        delete_dir.removeRecursively();
+    if(!taken.isEmpty()){
+        // 子树里的节点不再接收按需加载的结果，也不能再被当作选中项或右键项
+        for(auto iter = items.begin(); iter != items.end();){
+            if(under(iter.value())){
+                iter = items.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+        for(auto iter = _lazy_pending.begin(); iter != _lazy_pending.end();){
+            if(under(iter.value())){
+                iter = _lazy_pending.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+        if(_selected_item && under(_selected_item)){
+            _selected_item = nullptr;
+            _readahead_paths.clear();
+        }
+        if(_right_btn_item && under(_right_btn_item)){
+            _right_btn_item = nullptr;
+        }
+        for(QTreeWidgetItem * item : taken){
+            item->parent()->removeChild(item);
+            ReleaseItems(item);
+        }
     }
 
-    if(protreeitem == _active_item){
-        _active_item = nullptr;
+    auto add = [&](const QString & path, int type){
+        QFileInfo info(path);
+        auto * parent = dynamic_cast<ProTreeItem*>(items.value(info.path()));
+        if(!parent || parent->NeedLoad() || items.contains(path)){
+            return;
+        }
+        QString name = info.fileName();
+        auto * item = new ProTreeItem(parent, name, path, root, type);
+        item->setData(0, Qt::DisplayRole, name);
+        item->setData(0, Qt::DecorationRole, QIcon(type == TreeItemDir ? ":/icon/dir.png" : ":/icon/pic.png"));
+        item->setData(0, Qt::ToolTipRole, path);
+        // 构造时追加在最后，移到按名称排序的位置
+        parent->takeChild(parent->indexOfChild(item));
+        int index = 0;
+        while(index < parent->childCount() && parent->child(index)->text(0) < name){
+            ++index;
+        }
+        parent->insertChild(index, item);
+        items.insert(path, item);
+    };
+    for(const QString & path : added_dirs){
+        add(path, TreeItemDir);
+    }
+    for(const QString & path : added_pics){
+        add(path, TreeItemPic);
     }
 
-    delete this->takeTopLevelItem(index_right_btn);
-    _right_btn_item = nullptr;
+    RelinkSequence(root);
 }
 
-// 线程每处理一个文件/文件夹，会发出的进度更新信号
-void ProTreeWidget::SlotUpdateProgress(int count)
+// 按显示顺序重新串起项目中已加载的所有图片节点
+void ProTreeWidget::RelinkSequence(QTreeWidgetItem *root)
 {
-    if(!_dialog_progress){  // 如果进度条不存在，直接返回
-        return;
-    }
-
-    // 防止超过最大值，使用取模处理
-    if(count >= PROGRESS_MAX){
-        _dialog_progress->setValue(count % PROGRESS_MAX);
-    } else {
-        _dialog_progress->setValue(count);
+    ProTreeItem * pre_item = nullptr;
+    std::function<void(QTreeWidgetItem*)> link = [&](QTreeWidgetItem * node){
+        for(int i = 0; i < node->childCount(); ++i){
+            auto * item = dynamic_cast<ProTreeItem*>(node->child(i));
+            if(!item){
+                continue;
+            }
+            if(item->type() != TreeItemPic){
+                link(item);
+                continue;
+            }
+            item->SetPreItem(pre_item);
+            if(pre_item){
+                pre_item->SetNextItem(item);
+            }
+            pre_item = item;
+        }
+    };
+    link(root);
+    if(pre_item){
+        pre_item->SetNextItem(nullptr);
     }
 }
 
-// 线程完成任务时，更新进度条并删除对话框
-void ProTreeWidget::SlotFinishProgress()
+// 批量操作的对象：选中的图片和目录节点，已经随上层目录一起选中的不重复计入；
+// 右键点到未选中的节点时只操作这一个
+QList<ProTreeItem*> ProTreeWidget::BatchSelection() const
 {
-    _dialog_progress->setValue(PROGRESS_MAX);  // 设置为最大值
-    _dialog_progress->deleteLater();           // 延迟删除对话框（安全删除）
+    QList<QTreeWidgetItem*> selected = this->selectedItems();
+    if(_right_btn_item && !_right_btn_item->isSelected()){
+        selected = {_right_btn_item};
+    }
+    QSet<QTreeWidgetItem*> selected_set(selected.begin(), selected.end());
+
+    QList<ProTreeItem*> items;
+    for(QTreeWidgetItem * node : selected){
+        auto * item = dynamic_cast<ProTreeItem*>(node);
+        if(!item || (item->type() != TreeItemPic && item->type() != TreeItemDir)){
+            continue;
+        }
+        if(item->GetRoot() == _restore_item || PackFile::IsPackPath(item->GetPath())){
+            continue;
+        }
+        // 引用方式链接导入的图片节点指向项目外的原图，批量操作绝不能动到原图
+        const QString & root_path = dynamic_cast<ProTreeItem*>(item->GetRoot())->GetPath();
+        if(!item->GetPath().startsWith(root_path + "/")){
+            continue;
+        }
+        bool nested = false;
+        for(QTreeWidgetItem * up = node->parent(); up && !nested; up = up->parent()){
+            nested = selected_set.contains(up);
+        }
+        if(!nested){
+            items.append(item);
+        }
+    }
+    return items;
 }
 
-// 用户点击进度条取消按钮时调用
-void ProTreeWidget::SlotCancelProgress()
+// 批量操作会移动和删除文件，和正在读这些文件的导出、导入线程冲突时不开始；
+// 后台校验只是暂停，已校验的部分保存在索引里，下次定期校验接着做
+bool ProTreeWidget::CanStartBatch()
 {
-    emit SigCancelProgress();                  // 发信号通知线程停止
-    delete _dialog_progress;                   // 删除对话框
-    _dialog_progress = nullptr;                // 防止悬空指针
+    if(_thread_batch || _thread_sync || (_thread_create_pro && _thread_create_pro->isRunning())){
+        QMessageBox::information(this, tr("文件操作"), tr("有文件操作正在进行，请稍后再试。"));
+        return false;
+    }
+    if((_thread_export && _thread_export->isRunning()) || (_thread_video && _thread_video->isRunning())
+        || (_thread_contact && _thread_contact->isRunning())){
+        QMessageBox::information(this, tr("文件操作"), tr("正在导出，请等导出完成后再试。"));
+        return false;
+    }
+    if(_thread_scrub){
+        _thread_scrub->SlotCancelProgress();
+    }
+    return true;
 }
 
-void ProTreeWidget::SlotUpOpenProgress(int count)
+// 把选中的图片和目录移动到另一个文件夹
+void ProTreeWidget::SlotBatchMove()
 {
-    if(!_open_progressdlg){  // 如果进度条不存在，直接返回
+    QList<ProTreeItem*> selected = BatchSelection();
+    if(selected.isEmpty() || !CanStartBatch()){
+        return;
+    }
+    auto * root = dynamic_cast<ProTreeItem*>(selected.first()->GetRoot());
+    QString target = QFileDialog::getExistingDirectory(this, tr("移动到文件夹"), root->GetPath());
+    if(target.isEmpty()){
         return;
     }
+    target = QDir::cleanPath(target);
+    QDir target_dir(target);
 
-    // 防止超过最大值，使用取模处理
-    if(count >= PROGRESS_MAX){
-        _open_progressdlg->setValue(count % PROGRESS_MAX);
-    } else {
-        _open_progressdlg->setValue(count);
+    QVector<BatchFileThread::Op> ops;
+    QList<ProTreeItem*> items;
+    for(ProTreeItem * item : selected){
+        const QString & src = item->GetPath();
+        // 不能移到自己或自己的子目录里，已经在目标文件夹中的跳过
+        if(target == src || target.startsWith(src + "/") || QFileInfo(src).path() == target){
+            continue;
+        }
+        BatchFileThread::Op op;
+        op.src = src;
+        op.dst = target_dir.absoluteFilePath(QFileInfo(src).fileName());
+        ops.append(op);
+        items.append(item);
     }
+    StartBatch(BatchFileThread::BatchMove, ops, items, QStringList());
 }
 
-void ProTreeWidget::SlotFinishOpenProgress()
+// 按模板批量重命名：模板中连续的 # 替换为补零的序号，扩展名保持不变
+void ProTreeWidget::SlotBatchRename()
 {
-    if(!_open_progressdlg){  // 如果进度条不存在，直接返回
+    QList<ProTreeItem*> selected = BatchSelection();
+    if(selected.isEmpty() || !CanStartBatch()){
         return;
     }
-    _open_progressdlg->setValue(PROGRESS_MAX);
-    delete _open_progressdlg;
-    _open_progressdlg = nullptr;
+    bool ok = false;
+    QString pattern = QInputDialog::getText(this, tr("批量重命名"),
+                                            tr("新名称（连续的 # 替换为序号，扩展名不变）："),
+                                            QLineEdit::Normal, selected.size() > 1 ? "IMG_####" : selected.first()->text(0),
+                                            &ok).trimmed();
+    if(!ok || pattern.isEmpty()){
+        return;
+    }
+    if(pattern.contains('/') || pattern == "." || pattern == ".."){
+        QMessageBox::warning(this, tr("批量重命名"), tr("名称中不能包含 /"));
+        return;
+    }
+
+    // 序号按目录树中的显示顺序分配
+    QHash<QTreeWidgetItem*, qint64> order;
+    QSet<QTreeWidgetItem*> ranked;
+    for(ProTreeItem * item : selected){
+        QTreeWidgetItem * parent = item->parent();
+        if(!ranked.contains(parent)){
+            qint64 base = qint64(ranked.size()) << 32;
+            ranked.insert(parent);
+            for(int i = 0; i < parent->childCount(); ++i){
+                order.insert(parent->child(i), base + i);
+            }
+        }
+    }
+    std::sort(selected.begin(), selected.end(), [&order](ProTreeItem * a, ProTreeItem * b){
+        return order.value(a) < order.value(b);
+    });
+
+    int hash_pos = pattern.indexOf('#');
+    int hash_len = 0;
+    while(hash_pos >= 0 && hash_pos + hash_len < pattern.size() && pattern.at(hash_pos + hash_len) == '#'){
+        ++hash_len;
+    }
+    QVector<BatchFileThread::Op> ops;
+    QList<ProTreeItem*> items;
+    for(int i = 0; i < selected.size(); ++i){
+        ProTreeItem * item = selected.at(i);
+        QString number = QString("%1").arg(i + 1, hash_len, 10, QChar('0'));
+        QString name;
+        if(hash_len > 0){
+            name = QString(pattern).replace(hash_pos, hash_len, number);
+        } else {
+            // 没有 # 时，多个文件在名称后追加序号
+            name = selected.size() > 1 ? QString("%1_%2").arg(pattern).arg(i + 1) : pattern;
+        }
+        QFileInfo info(item->GetPath());
+        if(item->type() == TreeItemPic && !name.endsWith("." + info.suffix(), Qt::CaseInsensitive)){
+            name += "." + info.suffix();
+        }
+        QString dst = info.dir().absoluteFilePath(name);
+        if(dst == item->GetPath()){
+            continue;
+        }
+        BatchFileThread::Op op;
+        op.src = item->GetPath();
+        op.dst = dst;
+        ops.append(op);
+        items.append(item);
+    }
+    StartBatch(BatchFileThread::BatchRename, ops, items, QStringList());
 }
 
-void ProTreeWidget::SlotCancelOpenProgress()
+// 删除选中的图片和目录：先 rename 进项目旁边的回收目录，再由后台线程清空
+void ProTreeWidget::SlotBatchDelete()
 {
-    emit SigCancelOpenProgress();                  // 发信号通知线程停止
-    delete _open_progressdlg;                   // 删除对话框
-    _open_progressdlg = nullptr;                // 防止悬空指针
+    QList<ProTreeItem*> selected = BatchSelection();
+    if(selected.isEmpty() || !CanStartBatch()){
+        return;
+    }
+    auto answer = QMessageBox::question(this, tr("删除"),
+                                        tr("从磁盘上删除选中的 %1 项？此操作无法撤销。").arg(selected.size()));
+    if(answer != QMessageBox::Yes){
+        return;
+    }
+
+    // 每个项目一个回收目录，放在项目内部的隐藏目录 .album_trash 下：目录扫描、导入和校验都跳过隐藏项，
+    // 项目目录本身是挂载点时也和要删的文件在同一文件系统上，rename 不需要拷贝
+    QHash<QTreeWidgetItem*, QString> trash_dirs;
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QVector<BatchFileThread::Op> ops;
+    QList<ProTreeItem*> items;
+    for(int i = 0; i < selected.size(); ++i){
+        ProTreeItem * item = selected.at(i);
+        QTreeWidgetItem * root = item->GetRoot();
+        if(!trash_dirs.contains(root)){
+            QString trash = QDir(dynamic_cast<ProTreeItem*>(root)->GetPath()).absoluteFilePath(
+                QString(".album_trash/batch_%1").arg(now));
+            if(!QDir().mkpath(trash)){
+                continue;
+            }
+            trash_dirs.insert(root, trash);
+        }
+        // 不同目录中的同名文件放进同一个回收目录，名称前加序号区分
+        BatchFileThread::Op op;
+        op.src = item->GetPath();
+        op.dst = QDir(trash_dirs.value(root)).absoluteFilePath(QString("%1_%2").arg(i).arg(item->text(0)));
+        ops.append(op);
+        items.append(item);
+    }
+    StartBatch(BatchFileThread::BatchDelete, ops, items, trash_dirs.values());
 }
 
-// 打开项目
-void ProTreeWidget::SlotOpenPro(const QString &path)
+// 在后台执行批量 rename，结束后一次性更新目录树
+void ProTreeWidget::StartBatch(BatchFileThread::Kind kind, const QVector<BatchFileThread::Op> &ops,
+                               const QList<ProTreeItem*> &items, const QStringList &trash_dirs)
 {
-    // 如果路径已经在集合中，说明项目已经打开过，直接返回，不再重复打开
-    if(_set_path.find(path) != _set_path.end()){
+    if(ops.isEmpty()){
+        for(const QString & trash : trash_dirs){
+            QDir().rmdir(trash);
+        }
         return;
     }
+    _batch_items = items;
+    _batch_trash = trash_dirs;
+    _thread_batch = std::make_shared<BatchFileThread>(kind, ops);
+    BatchFileThread * thread = _thread_batch.get();
 
-    // 将路径插入集合，防止重复打开
-    _set_path.insert(path);
-
-    int file_count = 0;               // 用于统计打开项目中的文件数量
-    QDir pro_dir(path);               // 创建一个 QDir 对象，用于操作目录
-    QString proname = pro_dir.dirName(); // 获取目录名称，即项目名称
+    static const char * titles[] = {QT_TR_NOOP("正在移动"), QT_TR_NOOP("正在重命名"), QT_TR_NOOP("正在删除")};
+    QPointer<QProgressDialog> dialog = new QProgressDialog(this);
+    dialog->setWindowTitle(tr(titles[kind]));
+    dialog->setLabelText(tr("%1 项").arg(ops.size()));
+    dialog->setCancelButtonText(tr("取消"));
+    dialog->setWindowModality(Qt::WindowModal);
+    dialog->setFixedWidth(PROGRESS_WIDTH);
+    dialog->setRange(0, 0);
+    dialog->setMinimumDuration(500);    // 很快完成的操作不弹框
 
-    // 创建一个线程对象，用于递归遍历目录，加载项目树
+    connect(thread, &BatchFileThread::SigTotalCount, this, [dialog](int total){
+        if(dialog){
+            dialog->setRange(0, qMax(1, total));
+        }
+    });
+    connect(thread, &BatchFileThread::SigUpdateProgress, this, [dialog](int count){
+        if(dialog){
+            dialog->setValue(count);
+        }
+    });
+    // 取消后已经完成的项照常更新到目录树
+    connect(dialog, &QProgressDialog::canceled, thread, &BatchFileThread::SlotCancelProgress, Qt::DirectConnection);
+    connect(thread, &QThread::finished, this, [this, thread, dialog](){
+        if(dialog){
+            dialog->deleteLater();
+        }
+        ApplyBatch(*thread);
+        if(_thread_batch.get() == thread){
+            _thread_batch.reset();
+        }
+    });
+    _thread_batch->start();
+}
+
+// 按批量操作的结果更新目录树：每个受影响的目录只摘下、装回子节点各一次，
+// 每个受影响的项目只重新串一遍图片序列，不逐项发出模型信号
+void ProTreeWidget::ApplyBatch(const BatchFileThread &thread)
+{
+    const QVector<BatchFileThread::Op> & ops = thread.Ops();
+    const BatchFileThread::Kind kind = thread.GetKind();
+
+    // 移动的目标目录已加载时节点挂过去，否则从树上摘下，展开目标目录时再从磁盘读出
+    ProTreeItem * target_item = nullptr;
+    if(kind == BatchFileThread::BatchMove && !ops.isEmpty()){
+        target_item = FindItem(QFileInfo(ops.first().dst).path());
+        if(target_item && target_item->NeedLoad()){
+            target_item = nullptr;
+        }
+    }
+
+    QSet<QTreeWidgetItem*> done;        // 成功的项
+    QSet<QTreeWidgetItem*> leaving;     // 要离开原目录的项
+    QSet<QTreeWidgetItem*> parents;     // 子节点有变化的目录
+    QSet<QTreeWidgetItem*> roots;       // 图片序列要重新串的项目
+    QList<QTreeWidgetItem*> incoming;   // 移入目标目录的项
+    QList<QTreeWidgetItem*> removed;    // 从树上摘下、稍后分批释放的项
+    int failed = 0;
+    for(int i = 0; i < ops.size(); ++i){
+        ProTreeItem * item = _batch_items.at(i);
+        if(!ops.at(i).ok){
+            ++failed;
+            continue;
+        }
+        done.insert(item);
+        parents.insert(item->parent());
+        roots.insert(item->GetRoot());
+        if(kind == BatchFileThread::BatchRename){
+            continue;
+        }
+        leaving.insert(item);
+        if(target_item){
+            incoming.append(item);
+        } else {
+            removed.append(item);
+        }
+    }
+    if(target_item && !incoming.isEmpty()){
+        parents.insert(target_item);
+        roots.insert(target_item->GetRoot());
+    }
+
+    auto under = [](QTreeWidgetItem * node, const QSet<QTreeWidgetItem*> & set){
+        for(; node; node = node->parent()){
+            if(set.contains(node)){
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // 路径变了或节点要释放的目录不再等待原路径的按需加载结果；仍然展开着的目录换新路径重新加载
+    const QSet<QTreeWidgetItem*> removed_set(removed.begin(), removed.end());
+    QList<QTreeWidgetItem*> reload;
+    for(auto iter = _lazy_pending.begin(); iter != _lazy_pending.end();){
+        if(under(iter.value(), done)){
+            if(!under(iter.value(), removed_set)){
+                reload.append(iter.value());
+            }
+            iter = _lazy_pending.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    bool selected_gone = _selected_item && under(_selected_item, removed_set);
+    if(_right_btn_item && under(_right_btn_item, removed_set)){
+        _right_btn_item = nullptr;
+    }
+    bool selected_moved = _selected_item && !selected_gone && under(_selected_item, done);
+
+    this->setUpdatesEnabled(false);
+    // 摘下子节点会丢失整棵子树的展开状态，逐层记下
+    QSet<QTreeWidgetItem*> expanded;
+    std::function<void(QTreeWidgetItem*)> remember = [&](QTreeWidgetItem * node){
+        for(int i = 0; i < node->childCount(); ++i){
+            QTreeWidgetItem * child = node->child(i);
+            if(child->isExpanded()){
+                expanded.insert(child);
+            }
+            remember(child);
+        }
+    };
+    for(QTreeWidgetItem * parent : parents){
+        remember(parent);
+    }
+
+    // 新路径：重命名和移动的节点连同子树一起更新
+    std::function<void(QTreeWidgetItem*, const QString &, QTreeWidgetItem*)> retarget =
+        [&](QTreeWidgetItem * node, const QString & path, QTreeWidgetItem * root){
+        auto * item = dynamic_cast<ProTreeItem*>(node);
+        const QString old_path = item->GetPath();
+        QString name = QFileInfo(path).fileName();
+        item->SetPath(path, name);
+        item->SetRoot(root);
+        item->setData(0, Qt::DisplayRole, name);
+        item->setData(0, Qt::ToolTipRole, path);
+        for(int i = 0; i < node->childCount(); ++i){
+            auto * child = dynamic_cast<ProTreeItem*>(node->child(i));
+            if(child->GetPath().startsWith(old_path + "/")){
+                retarget(child, path + "/" + QFileInfo(child->GetPath()).fileName(), root);
+            } else {
+                // 引用原图的节点不在目录里，原图没有移动，只换所属项目
+                child->SetRoot(root);
+            }
+        }
+    };
+    for(int i = 0; i < ops.size(); ++i){
+        ProTreeItem * item = _batch_items.at(i);
+        if(!ops.at(i).ok || (kind != BatchFileThread::BatchRename && !target_item)){
+            continue;
+        }
+        retarget(item, ops.at(i).dst, kind == BatchFileThread::BatchRename ? item->GetRoot() : target_item->GetRoot());
+    }
+
+    for(QTreeWidgetItem * parent : parents){
+        QList<QTreeWidgetItem*> children = parent->takeChildren();
+        QList<QTreeWidgetItem*> kept;
+        kept.reserve(children.size() + incoming.size());
+        for(QTreeWidgetItem * child : children){
+            if(!leaving.contains(child)){
+                kept.append(child);
+            }
+        }
+        if(parent == target_item){
+            kept.append(incoming);
+        }
+        // 和同步导入一致，按名称排序
+        if(parent == target_item || kind == BatchFileThread::BatchRename){
+            std::stable_sort(kept.begin(), kept.end(), [](QTreeWidgetItem * a, QTreeWidgetItem * b){
+                return a->text(0) < b->text(0);
+            });
+        }
+        parent->addChildren(kept);
+    }
+    for(QTreeWidgetItem * item : expanded){
+        if(item->treeWidget()){
+            item->setExpanded(true);
+        }
+    }
+    for(QTreeWidgetItem * root : roots){
+        RelinkSequence(root);
+    }
+    this->clearSelection();
+    this->setUpdatesEnabled(true);
+
+    if(selected_gone){
+        _selected_item = nullptr;
+        _readahead_paths.clear();
+    } else if(selected_moved){
+        emit SigUpdateSelected(dynamic_cast<ProTreeItem*>(_selected_item)->GetPath());
+    }
+    for(QTreeWidgetItem * item : reload){
+        if(item->isExpanded()){
+            RequestLazyLoad(item);
+        }
+    }
+
+    // 摘下的节点分批释放，回收目录交给后台线程删除，都不会卡住界面
+    auto * holder = new QTreeWidgetItem();
+    holder->addChildren(removed);
+    if(kind == BatchFileThread::BatchDelete && !_batch_trash.isEmpty()){
+        StartRemove(holder, _batch_trash.first());
+        for(int i = 1; i < _batch_trash.size(); ++i){
+            StartRemove(nullptr, _batch_trash.at(i));
+        }
+    } else {
+        StartRemove(holder, QString());
+    }
+    _batch_items.clear();
+    _batch_trash.clear();
+
+    // 时间线索引按成功的操作就地更新：项目内的重命名和移动沿用拍摄时间，
+    // 跨项目的移动在原项目删除、在目标项目新增。读写索引文件放到线程池里做
+    auto project_of = [this](const QString & path){
+        for(int i = 0; i < this->topLevelItemCount(); ++i){
+            const QString & pro_path = dynamic_cast<ProTreeItem*>(this->topLevelItem(i))->GetPath();
+            if(path.startsWith(pro_path + "/")){
+                return pro_path;
+            }
+        }
+        return QString();
+    };
+    QHash<QString, QStringList> index_added;
+    QHash<QString, QStringList> index_removed;
+    QHash<QString, QHash<QString, QString>> index_moved;
+    QSet<QString> index_projects;
+    for(const BatchFileThread::Op & op : ops){
+        const QString src_project = project_of(op.src);
+        if(!op.ok || src_project.isEmpty()){
+            continue;
+        }
+        index_projects.insert(src_project);
+        if(kind == BatchFileThread::BatchDelete){
+            index_removed[src_project] << op.src;
+            continue;
+        }
+        const QString dst_project = project_of(op.dst);
+        if(dst_project == src_project){
+            index_moved[src_project].insert(op.src, op.dst);
+            continue;
+        }
+        index_removed[src_project] << op.src;
+        if(!dst_project.isEmpty()){
+            index_added[dst_project] << op.dst;
+            index_projects.insert(dst_project);
+        }
+    }
+    for(const QString & pro_path : index_projects){
+        QStringList added = index_added.value(pro_path);
+        QStringList removed_paths = index_removed.value(pro_path);
+        QHash<QString, QString> moved = index_moved.value(pro_path);
+        QThreadPool::globalInstance()->start([pro_path, added, removed_paths, moved](){
+            DateIndex::Patch(pro_path, added, removed_paths, moved);
+        });
+    }
+
+    if(failed > 0){
+        QMessageBox::warning(this, tr("文件操作"),
+                             tr("%1 项未能完成（目标已存在、没有权限或操作被取消）。").arg(failed));
+    }
+}
+
+// 按路径在已加载的目录树中查找节点，逐级按名称匹配
+ProTreeItem *ProTreeWidget::FindItem(const QString &path) const
+{
+    for(int i = 0; i < this->topLevelItemCount(); ++i){
+        auto * node = dynamic_cast<ProTreeItem*>(this->topLevelItem(i));
+        if(!node || (path != node->GetPath() && !path.startsWith(node->GetPath() + "/"))){
+            continue;
+        }
+        const QStringList parts = path.mid(node->GetPath().size()).split('/', Qt::SkipEmptyParts);
+        for(const QString & part : parts){
+            ProTreeItem * next = nullptr;
+            for(int k = 0; k < node->childCount() && !next; ++k){
+                auto * child = dynamic_cast<ProTreeItem*>(node->child(k));
+                if(child && child->type() == TreeItemDir && child->text(0) == part){
+                    next = child;
+                }
+            }
+            node = next;
+            if(!node){
+                break;
+            }
+        }
+        if(node){
+            return node;
+        }
+    }
+    return nullptr;
+}
+
+// 检查右键选中项目中链接导入的原图
+void ProTreeWidget::SlotCheckSources()
+{
+    if(!_right_btn_item){
+        return;
+    }
+    CheckSources(dynamic_cast<ProTreeItem*>(_right_btn_item)->GetPath(), false);
+}
+
+// 在后台逐个 stat 清单中的原图，有问题时提示；quiet 为 true 时没有问题就不提示
+void ProTreeWidget::CheckSources(const QString &pro_path, bool quiet)
+{
+    auto * watcher = new QFutureWatcher<QVector<ProManifest::Problem>>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, pro_path, quiet](){
+        const QVector<ProManifest::Problem> problems = watcher->result();
+        watcher->deleteLater();
+        if(problems.isEmpty()){
+            if(!quiet){
+                QMessageBox::information(this, tr("检查原图"), tr("所有原图都在原来的位置。"));
+            }
+            return;
+        }
+
+        // 只列出前 20 条，其余给出数量
+        QStringList lines;
+        for(int i = 0; i < problems.size() && i < 20; ++i){
+            const ProManifest::Problem & problem = problems.at(i);
+            lines << QString("[%1] %2 %3 %4")
+                         .arg(ProManifest::ModeName(problem.entry.mode))
+                         .arg(problem.state == ProManifest::SourceMissing ? tr("已移动或删除") : tr("已修改"))
+                         .arg(problem.entry.rel_path, problem.entry.source);
+        }
+        if(problems.size() > lines.size()){
+            lines << tr("……另有 %1 项").arg(problems.size() - lines.size());
+        }
+        QMessageBox::warning(this, tr("检查原图"),
+                             tr("项目 %1 中有 %2 张链接导入的图片原图异常：\n%3")
+                                 .arg(pro_path).arg(problems.size()).arg(lines.join('\n')));
+    });
+    watcher->setFuture(QtConcurrent::run([pro_path](){
+        ProManifest manifest(pro_path);
+        manifest.Load();
+        return manifest.Check();
+    }));
+}
+
+void ProTreeWidget::SlotSetActive()
+{
+    if(!_right_btn_item){
+        return;
+    }
+
+    QFont nullFont;
+    nullFont.setBold(false);
+    if(_active_item){
+        _active_item->setFont(0, nullFont);
+    }
+
+    _active_item = _right_btn_item;
+    nullFont.setBold(true);
+    _active_item->setFont(0, nullFont);
+    SaveSession();
+}
+
+void ProTreeWidget::SlotClosePro()
+{
+    // 批量操作结束时要更新的节点可能属于这个项目
+    if(_thread_batch){
+        QMessageBox::information(this, tr("关闭项目"), tr("文件操作正在进行，请稍后再试。"));
+        return;
+    }
+    RemoveProDialog remove_pro_dialog;
+    auto res = remove_pro_dialog.exec();
+    if(res != QDialog::Accepted){
+        return;
+    }
+    bool b_remove = remove_pro_dialog.IsRemoved();
+    // 正在后台加载的项目先停止加载
+    if(_right_btn_item == _restore_item){
+        StopRestore();
+    }
+    auto index_right_btn = this->indexOfTopLevelItem(_right_btn_item);
+    auto * protreeitem = dynamic_cast<ProTreeItem*>(_right_btn_item);
+    // auto * selecteditem = dynamic_cast<ProTreeItem>(_selected_item);
+    auto delete_path = protreeitem->GetPath();
+    _set_path.remove(delete_path);
+    _restore_queue.removeAll(delete_path);
+    // 丢弃该项目还在等待的按需加载结果
+    for(auto iter = _lazy_pending.begin(); iter != _lazy_pending.end();){
+        if(dynamic_cast<ProTreeItem*>(iter.value())->GetRoot() == protreeitem){
+            iter = _lazy_pending.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    if(protreeitem == _active_item){
+        _active_item = nullptr;
+    }
+    if(_selected_item && dynamic_cast<ProTreeItem*>(_selected_item)->GetRoot() == protreeitem){
+        _selected_item = nullptr;
+        _readahead_paths.clear();
+    }
+
+    // 节点先从视图摘下，界面立即更新；节点分批释放，删除文件交给后台线程
+    QTreeWidgetItem * taken = this->takeTopLevelItem(index_right_btn);
+    _right_btn_item = nullptr;
+
+    QString trash_path;
+    if(PackFile::IsPackPath(delete_path)){
+        // 打包项目：解除映射，删除时只删一个文件
+        PackFile::Release(delete_path);
+        if(b_remove){
+            QFile::remove(delete_path);
+        }
+    } else if(b_remove){
+        // rename 到回收目录是瞬间完成的，之后项目目录就不存在了
+        trash_path = RemoveProThread::MoveToTrash(delete_path);
+    }
+    StartRemove(taken, trash_path);
+
+    SaveSession();
+    StartNextRestore();
+}
+
+// 释放摘下的节点（在界面线程分批进行）；trash_path 不为空时启动后台线程删除该目录，并显示非模态进度
+void ProTreeWidget::StartRemove(QTreeWidgetItem *item, const QString &trash_path)
+{
+    if(item){
+        ReleaseItems(item);
+    }
+    if(trash_path.isEmpty()){
+        return;
+    }
+
+    auto * thread = new RemoveProThread(trash_path);
+    _remove_threads.append(thread);
+
+    // 记录待删除的目录，程序中途退出后下次启动继续删除
+    QSettings settings;
+    QStringList pending = settings.value("trash/pending").toStringList();
+    pending.append(trash_path);
+    settings.setValue("trash/pending", pending);
+
+    // 非模态进度框，不阻塞界面；删除无法撤销，所以不提供取消按钮
+    QPointer<QProgressDialog> dialog = new QProgressDialog(this);
+    dialog->setWindowTitle(tr("正在删除项目"));
+    dialog->setLabelText(QFileInfo(trash_path).fileName());
+    dialog->setWindowModality(Qt::NonModal);
+    dialog->setCancelButton(nullptr);
+    dialog->setFixedWidth(PROGRESS_WIDTH);
+    dialog->setRange(0, 0);
+    dialog->setMinimumDuration(500);    // 很快删完的项目不弹框
+
+    connect(thread, &RemoveProThread::SigTotalCount, this, [dialog](int total){
+        if(dialog){
+            dialog->setRange(0, qMax(1, total));
+        }
+    });
+    connect(thread, &RemoveProThread::SigUpdateProgress, this, [dialog](int count){
+        if(dialog){
+            dialog->setValue(count);
+        }
+    });
+    connect(thread, &QThread::finished, this, [dialog](){
+        if(dialog){
+            dialog->deleteLater();
+        }
+    });
+
+    connect(thread, &RemoveProThread::SigFinishProgress, this, [trash_path](int){
+        QSettings settings;
+        QStringList pending = settings.value("trash/pending").toStringList();
+        pending.removeAll(trash_path);
+        settings.setValue("trash/pending", pending);
+    });
+    connect(thread, &QThread::finished, this, [this, thread](){
+        _remove_threads.removeAll(thread);
+        thread->deleteLater();
+    });
+    thread->start(QThread::LowPriority);
+}
+
+// QTreeWidgetItem 不是线程安全的，只能在界面线程释放；十万级节点一次析构会卡住窗口，
+// 所以排队后每个事件循环周期只释放一批
+void ProTreeWidget::ReleaseItems(QTreeWidgetItem *item)
+{
+    _release_queue.append(item);
+    if(!_release_timer->isActive()){
+        _release_timer->start();
+    }
+}
+
+// 每次释放不超过 RELEASE_BATCH 个节点：有子节点的先把子节点摘下排到队尾，自身就是叶子，析构很快
+void ProTreeWidget::SlotReleaseStep()
+{
+    static const int RELEASE_BATCH = 2000;
+    for(int i = 0; i < RELEASE_BATCH && !_release_queue.isEmpty(); ++i){
+        QTreeWidgetItem * node = _release_queue.takeLast();
+        if(node->childCount() > 0){
+            _release_queue.append(node->takeChildren());
+        }
+        delete node;
+    }
+    if(_release_queue.isEmpty()){
+        _release_timer->stop();
+    }
+}
+
+// 继续删除上次退出时没删完的回收目录
+void ProTreeWidget::ResumePendingTrash()
+{
+    QSettings settings;
+    const QStringList pending = settings.value("trash/pending").toStringList();
+    QStringList remaining;
+    for(const QString & path : pending){
+        if(QFileInfo::exists(path) && !remaining.contains(path)){
+            remaining.append(path);
+        }
+    }
+    // StartRemove 会重新登记，先清空
+    settings.setValue("trash/pending", QStringList());
+    for(const QString & path : remaining){
+        StartRemove(nullptr, path);
+    }
+}
+
+// 线程每处理一个文件/文件夹，会发出的进度更新信号
+void ProTreeWidget::SlotUpdateProgress(int count)
+{
+    if(!_dialog_progress){  // 如果进度条不存在，直接返回
+        return;
+    }
+
+    // 防止超过最大值，使用取模处理
+    if(count >= PROGRESS_MAX){
+        _dialog_progress->setValue(count % PROGRESS_MAX);
+    } else {
+        _dialog_progress->setValue(count);
+    }
+}
+
+// 线程完成任务时，更新进度条并删除对话框
+void ProTreeWidget::SlotFinishProgress()
+{
+    _dialog_progress->setValue(PROGRESS_MAX);  // 设置为最大值
+    _dialog_progress->deleteLater();           // 延迟删除对话框（安全删除）
+}
+
+// 用户点击进度条取消按钮时调用
+void ProTreeWidget::SlotCancelProgress()
+{
+    emit SigCancelProgress();                  // 发信号通知线程停止
+    delete _dialog_progress;                   // 删除对话框
+    _dialog_progress = nullptr;                // 防止悬空指针
+}
+
+void ProTreeWidget::SlotUpOpenProgress(int count)
+{
+    if(!_open_progressdlg){  // 如果进度条不存在，直接返回
+        return;
+    }
+
+    // 防止超过最大值，使用取模处理
+    if(count >= PROGRESS_MAX){
+        _open_progressdlg->setValue(count % PROGRESS_MAX);
+    } else {
+        _open_progressdlg->setValue(count);
+    }
+}
+
+void ProTreeWidget::SlotFinishOpenProgress()
+{
+    if(!_open_progressdlg){  // 如果进度条不存在，直接返回
+        return;
+    }
+    _open_progressdlg->setValue(PROGRESS_MAX);
+    delete _open_progressdlg;
+    _open_progressdlg = nullptr;
+}
+
+void ProTreeWidget::SlotCancelOpenProgress()
+{
+    emit SigCancelOpenProgress();                  // 发信号通知线程停止
+    delete _open_progressdlg;                   // 删除对话框
+    _open_progressdlg = nullptr;                // 防止悬空指针
+}
+
+// 导出网页相册：选择输出目录后在后台线程中导出右键所选的项目
+void ProTreeWidget::SlotExportGallery()
+{
+    if(!_right_btn_item){
+        return;
+    }
+    if(_thread_export && _thread_export->isRunning()){
+        return;
+    }
+
+    QString src_path = dynamic_cast<ProTreeItem*>(_right_btn_item)->GetPath();
+    QString out_path = QFileDialog::getExistingDirectory(this, tr("选择导出目录"), QDir::homePath());
+    if(out_path.isEmpty()){
+        return;
+    }
+    // 不能导出到项目目录内部，否则下次导出会把导出结果当作图片
+    if(QDir::cleanPath(out_path + "/").startsWith(QDir::cleanPath(src_path) + "/")
+        || QDir::cleanPath(out_path) == QDir::cleanPath(src_path)){
+        qDebug() << "export path is inside project" << Qt::endl;
+        return;
+    }
+
+    _export_progressdlg = new QProgressDialog(this);
+    _thread_export = std::make_shared<GalleryExportThread>(src_path, out_path);
+
+    connect(_thread_export.get(), &GalleryExportThread::SigTotalCount,
+            this, &ProTreeWidget::SlotExportTotal);
+    connect(_thread_export.get(), &GalleryExportThread::SigUpdateProgress,
+            this, &ProTreeWidget::SlotUpExportProgress);
+    connect(_thread_export.get(), &GalleryExportThread::SigFinishProgress,
+            this, &ProTreeWidget::SlotFinishExportProgress);
+    connect(_export_progressdlg, &QProgressDialog::canceled,
+            this, &ProTreeWidget::SlotCancelExportProgress);
+    connect(this, &ProTreeWidget::SigCancelExportProgress,
+            _thread_export.get(), &GalleryExportThread::SlotCancelProgress, Qt::DirectConnection);
+
+    _thread_export->start();
+
+    _export_progressdlg->setWindowTitle(tr("正在导出网页相册..."));
+    _export_progressdlg->setFixedWidth(PROGRESS_WIDTH);
+    _export_progressdlg->setRange(0, 0);    // 收集完图片前显示忙碌状态
+    _export_progressdlg->exec();
+}
+
+// 把右键所选项目的幻灯片序列导出为视频，图片顺序与浏览时的上一张/下一张一致
+void ProTreeWidget::SlotExportVideo()
+{
+    if(!_right_btn_item){
+        return;
+    }
+    if(_thread_video && _thread_video->isRunning()){
+        return;
+    }
+
+    auto * root = dynamic_cast<ProTreeItem*>(_right_btn_item);
+    QStringList pics = CollectPics(root);
+    if(pics.isEmpty()){
+        QMessageBox::information(this, tr("导出幻灯片视频"), tr("项目中没有已加载的图片。"));
+        return;
+    }
+
+    QString out_path = QFileDialog::getSaveFileName(this, tr("导出幻灯片视频"),
+                                                    QDir::home().absoluteFilePath(root->text(0) + ".avi"),
+                                                    tr("AVI 视频 (*.avi)"));
+    if(out_path.isEmpty()){
+        return;
+    }
+
+    _thread_video = std::make_shared<VideoExportThread>(pics, out_path);
+    // AVI 1.0 文件不能超过 2GB，估算超出时不开始渲染，免得几十分钟后才失败
+    const qint64 estimated = _thread_video->EstimatedSize();
+    if(estimated > AviWriter::MaxFileSize()){
+        _thread_video.reset();
+        QMessageBox::warning(this, tr("导出幻灯片视频"),
+                             tr("预计视频约 %1 MB，超过 AVI 文件 %2 MB 的上限。\n"
+                                "请减少图片数量，或在配置中调低 slideshow/width、slideshow/height、slideshow/fade_ms。")
+                                 .arg(estimated / (1024 * 1024))
+                                 .arg(AviWriter::MaxFileSize() / (1024 * 1024)));
+        return;
+    }
+
+    _export_progressdlg = new QProgressDialog(this);
+
+    connect(_thread_video.get(), &VideoExportThread::SigTotalCount,
+            this, &ProTreeWidget::SlotExportTotal);
+    connect(_thread_video.get(), &VideoExportThread::SigUpdateProgress,
+            this, &ProTreeWidget::SlotUpExportProgress);
+    connect(_thread_video.get(), &VideoExportThread::SigFinishProgress,
+            this, [this, out_path](int frames){
+        SlotFinishExportProgress();
+        if(frames < 0){
+            QMessageBox::warning(this, tr("导出幻灯片视频"),
+                                 tr("视频超过 AVI 文件 %1 MB 的上限，已停止导出。\n"
+                                    "请减少图片数量，或在配置中调低 slideshow/width、slideshow/height、slideshow/fade_ms。")
+                                     .arg(AviWriter::MaxFileSize() / (1024 * 1024)));
+        } else if(frames == 0){
+            QMessageBox::warning(this, tr("导出幻灯片视频"), tr("写入 %1 失败。").arg(out_path));
+        }
+    });
+    connect(_export_progressdlg, &QProgressDialog::canceled,
+            this, &ProTreeWidget::SlotCancelExportProgress);
+    connect(this, &ProTreeWidget::SigCancelExportProgress,
+            _thread_video.get(), &VideoExportThread::SlotCancelProgress, Qt::DirectConnection);
+
+    _thread_video->start();
+
+    _export_progressdlg->setWindowTitle(tr("正在导出幻灯片视频..."));
+    _export_progressdlg->setFixedWidth(PROGRESS_WIDTH);
+    _export_progressdlg->setRange(0, 0);
+    _export_progressdlg->exec();
+}
+
+// 节点下已加载的图片，按显示顺序深度优先遍历，和 RelinkSequence 串起的浏览顺序一致；
+// 不沿上一张/下一张链走，逐级打开或导入的项目里那条链在子目录处是断开的
+QStringList ProTreeWidget::CollectPics(QTreeWidgetItem *item) const
+{
+    QStringList pics;
+    std::function<void(QTreeWidgetItem*)> walk = [&](QTreeWidgetItem * node){
+        for(int i = 0; i < node->childCount(); ++i){
+            auto * child = dynamic_cast<ProTreeItem*>(node->child(i));
+            if(!child){
+                continue;
+            }
+            if(child->type() == TreeItemPic){
+                pics.append(child->GetPath());
+            } else {
+                walk(child);
+            }
+        }
+    };
+    if(item){
+        walk(item);
+    }
+    return pics;
+}
+
+// 为右键所选的项目或目录生成联系表，输出为条带压缩的 TIFF
+void ProTreeWidget::SlotContactSheet()
+{
+    if(!_right_btn_item){
+        return;
+    }
+    if(_thread_contact && _thread_contact->isRunning()){
+        return;
+    }
+
+    QStringList pics = CollectPics(_right_btn_item);
+    if(pics.isEmpty()){
+        QMessageBox::information(this, tr("生成联系表"), tr("目录中没有已加载的图片。"));
+        return;
+    }
+    QString out_path = QFileDialog::getSaveFileName(this, tr("生成联系表"),
+                                                    QDir::home().absoluteFilePath(_right_btn_item->text(0) + ".tif"),
+                                                    tr("TIFF 图片 (*.tif *.tiff)"));
+    if(out_path.isEmpty()){
+        return;
+    }
+
+    _export_progressdlg = new QProgressDialog(this);
+    _thread_contact = std::make_shared<ContactSheetThread>(pics, out_path);
+
+    connect(_thread_contact.get(), &ContactSheetThread::SigTotalCount,
+            this, &ProTreeWidget::SlotExportTotal);
+    connect(_thread_contact.get(), &ContactSheetThread::SigUpdateProgress,
+            this, &ProTreeWidget::SlotUpExportProgress);
+    connect(_thread_contact.get(), &ContactSheetThread::SigFinishProgress,
+            this, [this, out_path](int rows){
+        SlotFinishExportProgress();
+        if(rows <= 0){
+            QMessageBox::warning(this, tr("生成联系表"), tr("写入 %1 失败。").arg(out_path));
+        }
+    });
+    connect(_export_progressdlg, &QProgressDialog::canceled,
+            this, &ProTreeWidget::SlotCancelExportProgress);
+    connect(this, &ProTreeWidget::SigCancelExportProgress,
+            _thread_contact.get(), &ContactSheetThread::SlotCancelProgress, Qt::DirectConnection);
+
+    _thread_contact->start();
+
+    _export_progressdlg->setWindowTitle(tr("正在生成联系表..."));
+    _export_progressdlg->setFixedWidth(PROGRESS_WIDTH);
+    _export_progressdlg->setRange(0, 0);
+    _export_progressdlg->exec();
+}
+
+// 导出的图片总数确定后，进度条按实际数量显示
+void ProTreeWidget::SlotExportTotal(int total)
+{
+    if(!_export_progressdlg){
+        return;
+    }
+    _export_progressdlg->setRange(0, qMax(1, total));
+}
+
+void ProTreeWidget::SlotUpExportProgress(int count)
+{
+    if(!_export_progressdlg){
+        return;
+    }
+    _export_progressdlg->setValue(count);
+}
+
+void ProTreeWidget::SlotFinishExportProgress()
+{
+    if(!_export_progressdlg){
+        return;
+    }
+    _export_progressdlg->setValue(_export_progressdlg->maximum());
+    _export_progressdlg->deleteLater();
+    _export_progressdlg = nullptr;
+}
+
+void ProTreeWidget::SlotCancelExportProgress()
+{
+    emit SigCancelExportProgress();
+    delete _export_progressdlg;
+    _export_progressdlg = nullptr;
+}
+
+// 把右键选中的项目打包为同级目录下的 <项目名>.album
+void ProTreeWidget::SlotPackPro()
+{
+    if(!_right_btn_item){
+        return;
+    }
+    if(_thread_pack && _thread_pack->isRunning()){
+        return;
+    }
+
+    QString src_path = dynamic_cast<ProTreeItem*>(_right_btn_item)->GetPath();
+    QString pack_path = QDir::cleanPath(src_path) + PackFile::Suffix();
+    // 同名的包已经打开时先解除映射，打包完成后再打开看到的是新内容
+    PackFile::Release(pack_path);
+
+    _dialog_progress = new QProgressDialog(this);
+    _thread_pack = std::make_shared<PackThread>(src_path, pack_path);
+
+    connect(_thread_pack.get(), &PackThread::SigUpdateProgress,
+            this, &ProTreeWidget::SlotUpdateProgress);
+    connect(_thread_pack.get(), &PackThread::SigFinishProgress,
+            this, &ProTreeWidget::SlotFinishProgress);
+    connect(_dialog_progress, &QProgressDialog::canceled,
+            this, &ProTreeWidget::SlotCancelProgress);
+    connect(this, &ProTreeWidget::SigCancelProgress,
+            _thread_pack.get(), &PackThread::SlotCancelProgress, Qt::DirectConnection);
+
+    _thread_pack->start();
+
+    _dialog_progress->setWindowTitle(tr("正在打包项目..."));
+    _dialog_progress->setFixedWidth(PROGRESS_WIDTH);
+    _dialog_progress->setRange(0, PROGRESS_WIDTH);
+    _dialog_progress->exec();
+}
+
+// 立即校验右键选中的项目
+void ProTreeWidget::SlotScrubPro()
+{
+    if(!_right_btn_item){
+        return;
+    }
+    StartScrub(dynamic_cast<ProTreeItem*>(_right_btn_item)->GetPath(), true);
+}
+
+// 打开右键选中项目的时间线，点击其中的缩略图和在目录树中点击图片一样显示
+void ProTreeWidget::SlotTimeline()
+{
+    if(!_right_btn_item){
+        return;
+    }
+    auto * dialog = new TimelineDialog(dynamic_cast<ProTreeItem*>(_right_btn_item)->GetPath(), this);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    connect(dialog, &TimelineDialog::SigSelectPic, this, &ProTreeWidget::SlotTimelineSelect);
+    dialog->show();
+}
+
+// 时间线里点击缩略图：在目录树中定位对应的图片节点，之后的上一张、下一张和预读都从这里接着走
+void ProTreeWidget::SlotTimelineSelect(const QString &path)
+{
+    ProTreeItem * pic_item = nullptr;
+    ProTreeItem * dir_item = FindItem(QFileInfo(path).path());
+    for(int i = 0; dir_item && i < dir_item->childCount() && !pic_item; ++i){
+        auto * child = dynamic_cast<ProTreeItem*>(dir_item->child(i));
+        if(child && child->type() == TreeItemPic && child->GetPath() == path){
+            pic_item = child;
+        }
+    }
+
+    // 所在目录还没有加载时树里没有这个节点，只显示图片，不再沿用之前选中的节点
+    _selected_item = pic_item;
+    if(pic_item){
+        this->setCurrentItem(pic_item);
+        this->scrollToItem(pic_item);
+    }
+    emit SigUpdateSelected(path);
+    AdviseReadahead(_selected_item);
+}
+
+// 启动后台校验，显示非模态进度；interactive 为 false 时是定期校验，只在发现损坏时提示
+void ProTreeWidget::StartScrub(const QString &pro_path, bool interactive)
+{
+    if(_thread_batch){
+        if(interactive){
+            QMessageBox::information(this, tr("校验项目文件"), tr("有文件操作正在进行，请稍后再试。"));
+        }
+        return;
+    }
+    if(_thread_scrub){
+        if(interactive){
+            QMessageBox::information(this, tr("校验项目文件"),
+                                     tr("正在校验项目 %1，请稍后再试。").arg(_thread_scrub->GetProPath()));
+        }
+        return;
+    }
+
+    _thread_scrub = std::make_shared<ScrubThread>(pro_path);
+    ScrubThread * thread = _thread_scrub.get();
+
+    QPointer<QProgressDialog> dialog = new QProgressDialog(this);
+    dialog->setWindowTitle(tr("正在校验项目文件"));
+    dialog->setLabelText(pro_path);
+    dialog->setCancelButtonText(tr("暂停"));
+    dialog->setWindowModality(Qt::NonModal);
+    dialog->setFixedWidth(PROGRESS_WIDTH);
+    dialog->setRange(0, 0);
+    // 定期校验在后台安静进行，不弹进度框
+    dialog->setMinimumDuration(interactive ? 500 : INT_MAX);
+
+    connect(thread, &ScrubThread::SigTotalCount, this, [dialog](int total){
+        if(dialog){
+            dialog->setRange(0, qMax(1, total));
+        }
+    });
+    connect(thread, &ScrubThread::SigUpdateProgress, this, [dialog](int count){
+        if(dialog){
+            dialog->setValue(count);
+        }
+    });
+    connect(thread, &ScrubThread::SigFileFailed, this, &ProTreeWidget::MarkBadFile);
+    // 暂停只是停止线程，已校验的部分保存在索引里
+    connect(dialog, &QProgressDialog::canceled, thread, &ScrubThread::SlotCancelProgress, Qt::DirectConnection);
+    connect(thread, &ScrubThread::SigFinishProgress, this, [this, pro_path, interactive](int bad_count){
+        if(bad_count > 0){
+            QMessageBox::warning(this, tr("校验项目文件"),
+                                 tr("项目 %1 中有 %2 个文件校验失败，已在目录树中标红。")
+                                     .arg(pro_path).arg(bad_count));
+        } else if(interactive){
+            QMessageBox::information(this, tr("校验项目文件"), tr("项目 %1 中的文件全部完好。").arg(pro_path));
+        }
+    });
+    connect(thread, &QThread::finished, this, [this, thread, dialog](){
+        if(dialog){
+            dialog->deleteLater();
+        }
+        if(_thread_scrub.get() == thread){
+            _thread_scrub.reset();
+        }
+    });
+    _thread_scrub->start(QThread::LowPriority);
+}
+
+// 在目录树中标出校验失败的图片
+void ProTreeWidget::MarkBadFile(const QString &path)
+{
+    for(int i = 0; i < this->topLevelItemCount(); ++i){
+        auto * root = dynamic_cast<ProTreeItem*>(this->topLevelItem(i));
+        if(!root || !path.startsWith(root->GetPath() + "/")){
+            continue;
+        }
+        QTreeWidgetItemIterator iter(root);
+        while(*iter){
+            auto * item = dynamic_cast<ProTreeItem*>(*iter);
+            if(item && item->GetRoot() != root){
+                break;    // 已经走出这个项目
+            }
+            if(item && item->GetPath() == path){
+                item->setForeground(0, QBrush(Qt::red));
+                item->setData(0, Qt::ToolTipRole, tr("校验失败：%1").arg(path));
+                return;
+            }
+            ++iter;
+        }
+        return;
+    }
+}
+
+// 打开项目后，在后台读取上次校验的结果并标出损坏的文件
+void ProTreeWidget::MarkScrubFailures(const QString &pro_path)
+{
+    auto * watcher = new QFutureWatcher<QStringList>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher](){
+        const QStringList bad_files = watcher->result();
+        watcher->deleteLater();
+        for(const QString & path : bad_files){
+            MarkBadFile(path);
+        }
+    });
+    watcher->setFuture(QtConcurrent::run([pro_path](){
+        ChecksumIndex index(pro_path);
+        index.Load();
+        return index.BadFiles();
+    }));
+}
+
+// 定期校验：找出距上次完整校验超过设定天数的项目，一次启动一个
+void ProTreeWidget::SlotScheduleScrub()
+{
+    QSettings settings;
+    int interval_days = settings.value("scrub/interval_days", 0).toInt();
+    // 批量文件操作期间不开始，等下一次定时
+    if(interval_days <= 0 || _thread_scrub || _thread_batch){
+        return;
+    }
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const qint64 interval = qint64(interval_days) * 24 * 3600 * 1000;
+    for(int i = 0; i < this->topLevelItemCount(); ++i){
+        auto * item = dynamic_cast<ProTreeItem*>(this->topLevelItem(i));
+        // 打包项目是只读的整体文件，不在这里校验；还在后台加载的项目稍后再说
+        if(!item || PackFile::IsPackPath(item->GetPath()) || item == _restore_item){
+            continue;
+        }
+        if(now - ChecksumIndex::ReadLastFullScrub(item->GetPath()) >= interval){
+            StartScrub(item->GetPath(), false);
+            return;
+        }
+    }
+}
+
+// 打开打包项目
+void ProTreeWidget::SlotOpenPack(const QString &path)
+{
+    if(_set_path.find(path) != _set_path.end()){
+        return;
+    }
+    if(AddPackTree(path)){
+        SaveSession();
+    }
+}
+
+// 根据包文件的索引建树，不读取任何图片数据；节点路径是包内的虚拟路径
+QTreeWidgetItem *ProTreeWidget::AddPackTree(const QString &path)
+{
+    std::shared_ptr<PackFile> pack = PackFile::Get(path);
+    if(!pack){
+        qDebug() << "open pack failed" << path << Qt::endl;
+        return nullptr;
+    }
+    _set_path.insert(path);
+
+    QString proname = QFileInfo(path).completeBaseName();
+    auto * root = new ProTreeItem(this, proname, path, TreeItemPro);
+    root->setData(0, Qt::DisplayRole, proname);
+    root->setData(0, Qt::DecorationRole, QIcon(":/icon/dir.png"));
+    root->setData(0, Qt::ToolTipRole, path);
+
+    // 索引按先序排列，父节点总在子节点之前，记录顺序就是图片的浏览顺序
+    QVector<ProTreeItem*> items(pack->Count(), nullptr);
+    QVector<QString> paths(pack->Count());
+    ProTreeItem * preitem = nullptr;
+    for(int i = 0; i < pack->Count(); ++i){
+        PackFile::Entry entry = pack->GetEntry(i);
+        ProTreeItem * parent = entry.parent < 0 ? root : items.at(entry.parent);
+        paths[i] = (entry.parent < 0 ? path : paths.at(entry.parent)) + "/" + entry.name;
+
+        auto * item = new ProTreeItem(parent, entry.name, paths.at(i), root,
+                                      entry.is_dir ? TreeItemDir : TreeItemPic);
+        item->setData(0, Qt::DisplayRole, entry.name);
+        item->setData(0, Qt::DecorationRole, QIcon(entry.is_dir ? ":/icon/dir.png" : ":/icon/pic.png"));
+        item->setData(0, Qt::ToolTipRole, paths.at(i));
+        items[i] = item;
+
+        if(!entry.is_dir){
+            if(preitem){
+                preitem->SetNextItem(item);
+            }
+            item->SetPreItem(preitem);
+            preitem = item;
+        }
+    }
+
+    for(int i = 0; i < items.size(); ++i){
+        if(_restore_expanded.contains(paths.at(i))){
+            items.at(i)->setExpanded(true);
+        }
+    }
+    if(_restore_expanded.contains(path)){
+        root->setExpanded(true);
+    }
+    return root;
+}
+
+// 打开项目
+void ProTreeWidget::SlotOpenPro(const QString &path)
+{
+    // 如果路径已经在集合中，说明项目已经打开过，直接返回，不再重复打开
+    if(_set_path.find(path) != _set_path.end()){
+        return;
+    }
+
+    // 将路径插入集合，防止重复打开
+    _set_path.insert(path);
+
+    int file_count = 0;               // 用于统计打开项目中的文件数量
+    QDir pro_dir(path);               // 创建一个 QDir 对象，用于操作目录
+    QString proname = pro_dir.dirName(); // 获取目录名称，即项目名称
+
+    // 创建一个线程对象，用于递归遍历目录，加载项目树
     // std::make_shared 创建一个 shared_ptr，确保线程对象在使用过程中不会被释放
     _thread_open_pro = std::make_shared<OpenTreeThread>(path, file_count, this, nullptr);
 
@@ -301,6 +2172,124 @@ void ProTreeWidget::SlotOpenPro(const QString &path)
     _open_progressdlg->setFixedWidth(PROGRESS_WIDTH);    // 固定宽度，防止被拉伸
     _open_progressdlg->setRange(0, PROGRESS_WIDTH);      // 设置进度条范围
     _open_progressdlg->exec();                           // 显示对话框并阻塞当前线程，直到对话框关闭
+    SaveSession();
+    // 链接导入的原图被移动时提示用户
+    CheckSources(path, true);
+    MarkScrubFailures(path);
+}
+
+// 按需打开项目：只创建根节点，第一层内容由后台线程读取
+void ProTreeWidget::SlotOpenProLazy(const QString &path)
+{
+    if(_set_path.find(path) != _set_path.end()){
+        return;
+    }
+    _set_path.insert(path);
+
+    QDir pro_dir(path);
+    QString proname = pro_dir.dirName();
+    auto * item = new ProTreeItem(this, proname, path, TreeItemPro);
+    item->setData(0, Qt::DisplayRole, proname);
+    item->setData(0, Qt::DecorationRole, QIcon(":/icon/dir.png"));
+    item->setData(0, Qt::ToolTipRole, path);
+    item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+    item->SetNeedLoad(true);
+
+    // 展开根节点会触发 itemExpanded，从而请求加载第一层
+    item->setExpanded(true);
+    SaveSession();
+}
+
+void ProTreeWidget::SlotItemExpanded(QTreeWidgetItem *item)
+{
+    RequestLazyLoad(item);
+}
+
+// 对还没加载子节点的目录发起后台加载
+void ProTreeWidget::RequestLazyLoad(QTreeWidgetItem *item)
+{
+    auto * pro_item = dynamic_cast<ProTreeItem*>(item);
+    if(!pro_item || !pro_item->NeedLoad()){
+        return;
+    }
+    const QString & path = pro_item->GetPath();
+    if(_lazy_pending.contains(path)){
+        return;
+    }
+    _lazy_pending.insert(path, item);
+
+    if(!_thread_lazy_dir){
+        _thread_lazy_dir = std::make_shared<LazyDirThread>();
+        connect(_thread_lazy_dir.get(), &LazyDirThread::SigDirLoaded,
+                this, &ProTreeWidget::SlotDirLoaded);
+        _thread_lazy_dir->start();
+    }
+    _thread_lazy_dir->RequestDir(path);
+}
+
+// 后台线程读完一个目录：在界面线程创建子节点并接入图片序列
+void ProTreeWidget::SlotDirLoaded(const QString &path, const QStringList &dirs, const QStringList &pics)
+{
+    auto iter = _lazy_pending.find(path);
+    if(iter == _lazy_pending.end()){
+        return;   // 目录所在项目已经关闭
+    }
+    QTreeWidgetItem * parent_item = iter.value();
+    _lazy_pending.erase(iter);
+
+    auto * parent_pro_item = dynamic_cast<ProTreeItem*>(parent_item);
+    QTreeWidgetItem * root = parent_pro_item->GetRoot();
+    QDir dir(path);
+
+    // 子目录先标记为有子节点，展开时再加载
+    for(const QString & name : dirs){
+        QString sub_path = dir.absoluteFilePath(name);
+        auto * item = new ProTreeItem(parent_item, name, sub_path, root, TreeItemDir);
+        item->setData(0, Qt::DisplayRole, name);
+        item->setData(0, Qt::DecorationRole, QIcon(":/icon/dir.png"));
+        item->setData(0, Qt::ToolTipRole, sub_path);
+        item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+        item->SetNeedLoad(true);
+    }
+
+    // 同一目录内的图片依次链接
+    ProTreeItem * pre_item = nullptr;
+    for(const QString & name : pics){
+        QString pic_path = dir.absoluteFilePath(name);
+        auto * item = new ProTreeItem(parent_item, name, pic_path, root, TreeItemPic);
+        item->setData(0, Qt::DisplayRole, name);
+        item->setData(0, Qt::DecorationRole, QIcon(":/icon/pic.png"));
+        item->setData(0, Qt::ToolTipRole, pic_path);
+        if(pre_item){
+            pre_item->SetNextItem(item);
+        }
+        item->SetPreItem(pre_item);
+        pre_item = item;
+    }
+
+    parent_pro_item->SetNeedLoad(false);
+    parent_item->setChildIndicatorPolicy(QTreeWidgetItem::DontShowIndicatorWhenChildless);
+    StitchPicSequence(parent_item);
 }
 
+// 把刚加载目录中的图片接到前后已加载区域的图片序列中间
+void ProTreeWidget::StitchPicSequence(QTreeWidgetItem *dir)
+{
+    auto * dir_item = dynamic_cast<ProTreeItem*>(dir);
+    ProTreeItem * first = dir_item->GetFirstPicChild();
+    if(!first){
+        return;
+    }
+    ProTreeItem * last = dir_item->GetLastPicChild();
+    ProTreeItem * prev = PrevPicBefore(dir);
+    ProTreeItem * next = NextPicAfter(dir);
 
+    first->SetPreItem(prev);
+    if(prev){
+        prev->SetNextItem(first);
+    }
+    last->SetNextItem(next);
+    if(next){
+        next->SetPreItem(last);
+    }
+}
@@ -6,29 +6,111 @@
 #include <QProgressDialog>
 #include "protreethread.h"
 #include "opentreethread.h"
+#include "lazydirthread.h"
+#include "galleryexportthread.h"
+#include "packthread.h"
+#include "removeprothread.h"
+#include "scrubthread.h"
+#include "videoexportthread.h"
+#include "contactsheetthread.h"
+#include "foldersyncthread.h"
+#include "batchfilethread.h"
+#include <QTimer>
+
+class ProTreeItem;
 
 class ProTreeWidget : public QTreeWidget
 {
     Q_OBJECT
 public:
     ProTreeWidget(QWidget * parent = nullptr);
+    ~ProTreeWidget();
     void AddProTree(const QString & name, const QString & path);
+    // 恢复上次打开的项目：先显示顶层节点，再在后台依次加载内容
+    void RestoreSession();
+    // 保存打开的项目、活动项目和展开状态
+    void SaveSession();
 private:
+    void StartNextRestore();
+    void FinishRestore(OpenTreeThread * thread);
+    void StopRestore();
+    void RequestLazyLoad(QTreeWidgetItem * item);
+    void StitchPicSequence(QTreeWidgetItem * dir);
+    QTreeWidgetItem * AddPackTree(const QString & path);
+    void StartImport(ProTreeThread::ImportMode mode);
+    void CheckSources(const QString & pro_path, bool quiet);
+    void StartRemove(QTreeWidgetItem * item, const QString & trash_path);
+    void ReleaseItems(QTreeWidgetItem * item);
+    void ResumePendingTrash();
+    void StartScrub(const QString & pro_path, bool interactive);
+    void MarkBadFile(const QString & path);
+    void MarkScrubFailures(const QString & pro_path);
+    void AdviseReadahead(QTreeWidgetItem * item);
+    QStringList CollectPics(QTreeWidgetItem * item) const;
+    void ApplySync(QTreeWidgetItem * root, const QStringList & added_dirs,
+                   const QStringList & added_pics, const QStringList & removed);
+    void RelinkSequence(QTreeWidgetItem * root);
+    QList<ProTreeItem*> BatchSelection() const;
+    bool CanStartBatch();
+    void StartBatch(BatchFileThread::Kind kind, const QVector<BatchFileThread::Op> & ops,
+                    const QList<ProTreeItem*> & items, const QStringList & trash_dirs);
+    void ApplyBatch(const BatchFileThread & thread);
+    ProTreeItem * FindItem(const QString & path) const;
+
     QSet<QString> _set_path;
     QTreeWidgetItem * _right_btn_item;
     QTreeWidgetItem * _active_item;
     QTreeWidgetItem * _selected_item;
     QAction * _action_import;
+    QAction * _action_import_link;
+    QAction * _action_import_compact;
+    QAction * _action_import_sync;
+    QAction * _action_check_source;
     QAction * _action_setstart;
     QAction * _action_closepro;
     QAction * _action_slideshow;
+    QAction * _action_export;
+    QAction * _action_video;
+    QAction * _action_contact;
+    QAction * _action_pack;
+    QAction * _action_scrub;
+    QAction * _action_timeline;
+    QAction * _action_batch_move;
+    QAction * _action_batch_rename;
+    QAction * _action_batch_delete;
     QProgressDialog * _dialog_progress;
     QProgressDialog * _open_progressdlg;
+    QProgressDialog * _export_progressdlg;
     std::shared_ptr<ProTreeThread> _thread_create_pro;
     std::shared_ptr<OpenTreeThread> _thread_open_pro;
+    std::shared_ptr<OpenTreeThread> _thread_restore_pro;
+    std::shared_ptr<GalleryExportThread> _thread_export;
+    std::shared_ptr<VideoExportThread> _thread_video;
+    std::shared_ptr<ContactSheetThread> _thread_contact;
+    std::shared_ptr<PackThread> _thread_pack;
+    std::shared_ptr<FolderSyncThread> _thread_sync;
+    std::shared_ptr<ScrubThread> _thread_scrub;    // 同一时间只校验一个项目
+    std::shared_ptr<BatchFileThread> _thread_batch;
+    QList<ProTreeItem*> _batch_items;   // 和批量操作的各项一一对应的节点
+    QStringList _batch_trash;           // 批量删除用到的回收目录
+    QTimer * _scrub_timer;              // 定期检查是否有项目该做完整校验
+    QList<RemoveProThread*> _remove_threads;        // 正在后台删除回收目录的线程
+    QList<QTreeWidgetItem*> _release_queue;         // 已从视图摘下、等待分批释放的节点
+    QTimer * _release_timer;            // 零间隔定时器，每次释放一批节点
+    QStringList _restore_queue;         // 等待后台加载的项目路径
+    QSet<QString> _restore_expanded;    // 上次退出时展开的节点路径
+    QTreeWidgetItem * _restore_item;    // 正在后台加载的项目根节点
+    QTreeWidgetItem * _restore_holder;  // 后台线程构建子树用的游离节点
+    std::shared_ptr<LazyDirThread> _thread_lazy_dir;
+    QHash<QString, QTreeWidgetItem*> _lazy_pending;  // 已提交、等待加载结果的目录
+    QStringList _readahead_paths;       // 当前预读窗口内的图片
 private slots:
     void SlotItemPressed(QTreeWidgetItem * item, int column);
     void SlotImport();
+    void SlotImportLink();
+    void SlotImportCompact();
+    void SlotImportSync();
+    void SlotCheckSources();
     void SlotSetActive();
     void SlotClosePro();
     void SlotUpdateProgress(int count);
@@ -38,11 +120,39 @@ private slots:
     void SlotUpOpenProgress(int count);
     void SlotFinishOpenProgress();
     void SlotCancelOpenProgress();
+
+    void SlotExportGallery();
+    void SlotExportVideo();
+    void SlotContactSheet();
+    void SlotExportTotal(int total);
+    void SlotUpExportProgress(int count);
+    void SlotFinishExportProgress();
+    void SlotCancelExportProgress();
+
+    void SlotPackPro();
+    void SlotScrubPro();
+    void SlotTimeline();
+    void SlotTimelineSelect(const QString & path);
+    void SlotBatchMove();
+    void SlotBatchRename();
+    void SlotBatchDelete();
+    void SlotScheduleScrub();
+    void SlotReleaseStep();
+
+    void SlotItemExpanded(QTreeWidgetItem * item);
+    void SlotDirLoaded(const QString & path, const QStringList & dirs, const QStringList & pics);
 public slots:
     void SlotOpenPro(const QString&  path);
+    void SlotOpenProLazy(const QString& path);
+    void SlotOpenPack(const QString& path);
+    void SlotPreShow();
+    void SlotNextShow();
 signals:
     void SigCancelProgress();
     void SigCancelOpenProgress();
+    void SigCancelExportProgress();
+    // 选中的图片改变，通知显示区域
+    void SigUpdateSelected(const QString & path);
 };
 
 #endif // PROTREEWIDGET_H
@@ -0,0 +1,218 @@
+#include "recompressor.h"
+#include <QBuffer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageWriter>
+#include <QSaveFile>
+#include <QVector>
+
+namespace {
+// 太小的文件压缩收益不抵解码开销，直接复制
+const qint64 kMinSize = 16 * 1024;
+
+// 每个通道超过 8 位的格式。16 位灰度只占 16 位深度，不能按 depth() 判断
+bool IsDeep(const QImage & image)
+{
+    switch(image.format()){
+    case QImage::Format_Grayscale16:
+    case QImage::Format_BGR30:
+    case QImage::Format_A2BGR30_Premultiplied:
+    case QImage::Format_RGB30:
+    case QImage::Format_A2RGB30_Premultiplied:
+    case QImage::Format_RGBX64:
+    case QImage::Format_RGBA64:
+    case QImage::Format_RGBA64_Premultiplied:
+        return true;
+    default:
+        return image.depth() > 32;
+    }
+}
+
+// 像素比较用的统一格式，参考图每通道超过 8 位时两边都按 16 位比较
+QImage Canonical(const QImage & image, bool deep)
+{
+    if(deep){
+        return image.convertToFormat(QImage::Format_RGBA64);
+    }
+    return image.convertToFormat(QImage::Format_ARGB32);
+}
+
+bool IsOpaque(const QImage & image)
+{
+    if(!image.hasAlphaChannel()){
+        return true;
+    }
+    const QImage argb = image.convertToFormat(QImage::Format_ARGB32);
+    for(int y = 0; y < argb.height(); ++y){
+        const QRgb * line = reinterpret_cast<const QRgb*>(argb.constScanLine(y));
+        for(int x = 0; x < argb.width(); ++x){
+            if(qAlpha(line[x]) != 255){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+QByteArray EncodePng(const QImage & image)
+{
+    QByteArray out;
+    QBuffer buffer(&out);
+    buffer.open(QIODevice::WriteOnly);
+    QImageWriter writer(&buffer, "png");
+    // PNG 的 quality 映射为 zlib 压缩级别，0 对应最高级别 9
+    writer.setQuality(0);
+    if(!writer.write(image)){
+        return QByteArray();
+    }
+    return out;
+}
+}
+
+bool Recompressor::IsCandidate(const QString &path, qint64 size)
+{
+    if(size >= 0 && size < kMinSize){
+        return false;
+    }
+    const QString suffix = QFileInfo(path).suffix().toLower();
+    return suffix == "png" || suffix == "jpg" || suffix == "jpeg";
+}
+
+Recompressor::Result Recompressor::CompactFile(const QString &src, const QString &dst, qint64 &saved,
+                                               bool strip_metadata)
+{
+    saved = 0;
+    QFile in(src);
+    if(!in.open(QIODevice::ReadOnly)){
+        return Failed;
+    }
+    const QByteArray data = in.readAll();
+    in.close();
+
+    // 按内容判断格式，不信任后缀
+    QByteArray best;
+    if(data.startsWith("\x89PNG\r\n\x1a\n")){
+        QImage image = QImage::fromData(data, "png");
+        if(!image.isNull()){
+            best = CompactPng(data, image);
+        }
+    } else if(data.startsWith("\xff\xd8")){
+        QImage image = QImage::fromData(data, "jpeg");
+        if(!image.isNull()){
+            best = CompactJpeg(data, image, strip_metadata);
+        }
+    }
+
+    const bool shrunk = !best.isEmpty() && best.size() < data.size();
+    const QByteArray & out_data = shrunk ? best : data;
+    QSaveFile out(dst);
+    if(!out.open(QIODevice::WriteOnly) || out.write(out_data) != out_data.size()){
+        out.cancelWriting();
+        return Failed;
+    }
+    if(!out.commit()){
+        return Failed;
+    }
+    if(!shrunk){
+        return Copied;
+    }
+    saved = data.size() - best.size();
+    return Shrunk;
+}
+
+// 依次尝试原格式和更紧凑的像素格式，返回通过校验的最小编码；没有更小的返回空
+QByteArray Recompressor::CompactPng(const QByteArray &data, const QImage &image)
+{
+    // APNG 的动画帧 Qt 读不出来，重新编码会丢帧
+    int idat = data.indexOf("IDAT");
+    int actl = data.indexOf("acTL");
+    if(actl >= 0 && (idat < 0 || actl < idat)){
+        return QByteArray();
+    }
+
+    // 高位深图片只用原格式重新编码，任何缩减位数的候选都是有损的
+    QVector<QImage> candidates;
+    candidates.append(image);
+    if(!IsDeep(image)){
+        bool opaque = IsOpaque(image);
+        if(opaque && image.hasAlphaChannel()){
+            candidates.append(image.convertToFormat(QImage::Format_RGB32));
+        }
+        if(opaque && image.format() != QImage::Format_Grayscale8 && image.allGray()){
+            candidates.append(image.convertToFormat(QImage::Format_Grayscale8));
+        }
+        // 不超过 256 种颜色时 Qt 会生成精确的调色板，否则有损，由下面的校验排除
+        if(image.format() != QImage::Format_Indexed8 && image.format() != QImage::Format_Mono){
+            candidates.append(image.convertToFormat(QImage::Format_Indexed8, Qt::ThresholdDither | Qt::AvoidDither));
+        }
+    }
+
+    QByteArray best;
+    for(const QImage & candidate : candidates){
+        QByteArray encoded = EncodePng(candidate);
+        if(encoded.isEmpty() || encoded.size() >= data.size()
+            || (!best.isEmpty() && encoded.size() >= best.size())){
+            continue;
+        }
+        if(SamePixels(image, encoded, "png")){
+            best = encoded;
+        }
+    }
+    return best;
+}
+
+// 去掉 SOS 之前的 Ducky（APP12）段；strip_metadata 时连注释（COM）和 Photoshop（APP13，含 IPTC 标题、
+// 关键字、版权）一起去掉。其余字节原样保留
+QByteArray Recompressor::CompactJpeg(const QByteArray &data, const QImage &image, bool strip_metadata)
+{
+    const uchar * p = reinterpret_cast<const uchar*>(data.constData());
+    const int size = data.size();
+    QByteArray out;
+    out.reserve(size);
+    out.append(data.constData(), 2);
+
+    int pos = 2;
+    bool dropped = false;
+    while(true){
+        if(pos + 4 > size || p[pos] != 0xFF){
+            return QByteArray();     // 结构异常，不动它
+        }
+        uchar marker = p[pos + 1];
+        if(marker == 0xFF){
+            out.append(char(0xFF));
+            ++pos;
+            continue;
+        }
+        if(marker == 0xDA){
+            // 扫描数据及之后的内容（包括 EOI 后附加的数据）全部保留
+            out.append(data.constData() + pos, size - pos);
+            break;
+        }
+        int seg_len = p[pos + 2] << 8 | p[pos + 3];
+        if(seg_len < 2 || pos + 2 + seg_len > size){
+            return QByteArray();
+        }
+        if(marker == 0xEC || (strip_metadata && (marker == 0xFE || marker == 0xED))){
+            dropped = true;
+        } else {
+            out.append(data.constData() + pos, 2 + seg_len);
+        }
+        pos += 2 + seg_len;
+    }
+
+    if(!dropped || !SamePixels(image, out, "jpeg")){
+        return QByteArray();
+    }
+    return out;
+}
+
+// 重新解码后逐像素比较
+bool Recompressor::SamePixels(const QImage &reference, const QByteArray &data, const char *format)
+{
+    QImage decoded = QImage::fromData(data, format);
+    if(decoded.isNull() || decoded.size() != reference.size()){
+        return false;
+    }
+    const bool deep = IsDeep(reference) || IsDeep(decoded);
+    return Canonical(decoded, deep) == Canonical(reference, deep);
+}
@@ -0,0 +1,37 @@
+#ifndef RECOMPRESSOR_H
+#define RECOMPRESSOR_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QString>
+
+/*
+ * 导入时的无损重压缩。
+ * PNG：用 zlib 最高压缩级别重新编码，并尝试更紧凑的像素格式
+ * （全不透明去掉 alpha、灰度图、不超过 256 色的调色板图）；
+ * JPEG：熵编码数据原样保留，只去掉 Ducky 这类编码器留下的冗余段；注释和 Photoshop 段里有
+ * IPTC 标题、关键字和版权，只有明确要求时才去掉。EXIF、ICC 等段始终保留。
+ * 结果必须重新解码、和原图逐像素相同并且更小才会采用，否则写入原文件内容。
+ */
+class Recompressor
+{
+public:
+    enum Result {
+        Copied,         // 按原样写入
+        Shrunk,         // 写入了更小的无损版本
+        Failed          // 读或写失败
+    };
+
+    // 是否值得尝试（PNG/JPEG 且不太小）
+    static bool IsCandidate(const QString & path, qint64 size);
+    // 把 src 无损压缩后写到 dst；saved 返回节省的字节数，strip_metadata 为 true 时去掉 JPEG 的注释和 IPTC
+    static Result CompactFile(const QString & src, const QString & dst, qint64 & saved,
+                              bool strip_metadata = false);
+
+private:
+    static QByteArray CompactPng(const QByteArray & data, const QImage & image);
+    static QByteArray CompactJpeg(const QByteArray & data, const QImage & image, bool strip_metadata);
+    static bool SamePixels(const QImage & reference, const QByteArray & data, const char * format);
+};
+
+#endif // RECOMPRESSOR_H
@@ -0,0 +1,92 @@
+#include "removeprothread.h"
+#include "dirscanner.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QtConcurrent>
+
+RemoveProThread::RemoveProThread(const QString &trash_path, QObject *parent)
+    :QThread(parent), _trash_path(trash_path), _bstop(false)
+{
+
+}
+
+const QString &RemoveProThread::GetTrashPath() const
+{
+    return _trash_path;
+}
+
+QString RemoveProThread::MoveToTrash(const QString &pro_path)
+{
+    QFileInfo info(pro_path);
+    // 回收目录放在项目所在目录下，保证和项目在同一文件系统上，rename 不需要拷贝
+    QDir parent_dir = info.absoluteDir();
+    QString trash_dir = parent_dir.absoluteFilePath(".album_trash");
+    if(!QDir().mkpath(trash_dir)){
+        return pro_path;
+    }
+    QString trash_path = QDir(trash_dir).absoluteFilePath(
+        QString("%1_%2").arg(info.fileName()).arg(QDateTime::currentMSecsSinceEpoch()));
+    if(!QDir().rename(info.absoluteFilePath(), trash_path)){
+        return pro_path;
+    }
+    return trash_path;
+}
+
+void RemoveProThread::run()
+{
+    QStringList files;
+    CollectFiles(_trash_path, files);
+    if(_bstop){
+        return;
+    }
+    emit SigTotalCount(files.size());
+
+    // 并行 unlink，进度每 256 个文件通知一次，避免信号过多
+    std::atomic<int> done(0);
+    QtConcurrent::blockingMap(files, [this, &done](const QString & file){
+        if(_bstop){
+            return;
+        }
+        QFile::remove(file);
+        int count = ++done;
+        if(count % 256 == 0){
+            emit SigUpdateProgress(count);
+        }
+    });
+    if(_bstop){
+        return;
+    }
+
+    // 剩下的是目录和扫描时跳过的隐藏文件，数量很少
+    QDir(_trash_path).removeRecursively();
+    QDir trash_dir = QFileInfo(_trash_path).absoluteDir();
+    if(trash_dir.dirName() == ".album_trash"){
+        trash_dir.rmdir(trash_dir.absolutePath());  // 回收目录空了就一并删除
+    }
+    emit SigFinishProgress(files.size());
+}
+
+void RemoveProThread::CollectFiles(const QString &path, QStringList &files)
+{
+    QVector<DirEntry> list;
+    DirScanner::List(path, list);
+    for(const DirEntry & entry : list){
+        if(_bstop){
+            return;
+        }
+        // 指向目录的符号链接只删链接本身，绝不能进到链接目标里删原图
+        if(entry.is_dir && !QFileInfo(entry.path).isSymLink()){
+            CollectFiles(entry.path, files);
+        } else {
+            files.append(entry.path);
+        }
+    }
+}
+
+// 程序退出时停止删除，未删完的回收目录下次启动后继续删除
+void RemoveProThread::SlotCancelProgress()
+{
+    _bstop = true;
+}
@@ -0,0 +1,38 @@
+#ifndef REMOVEPROTHREAD_H
+#define REMOVEPROTHREAD_H
+
+#include <QThread>
+#include <atomic>
+
+/*
+ * 删除项目的后台线程。
+ * 界面线程先把项目目录 rename 到同一文件系统上的回收目录（瞬间完成），
+ * 这里再并行 unlink 其中的文件，最后删除空目录。
+ * 摘下的树节点不在这里释放：QTreeWidgetItem 只能在界面线程析构，由 ProTreeWidget 分批释放。
+ */
+class RemoveProThread : public QThread
+{
+    Q_OBJECT
+public:
+    explicit RemoveProThread(const QString & trash_path, QObject * parent = nullptr);
+    const QString & GetTrashPath() const;
+
+    // 把项目目录移到回收目录，返回回收目录中的路径；rename 失败返回原路径，原地删除
+    static QString MoveToTrash(const QString & pro_path);
+protected:
+    virtual void run();
+private:
+    void CollectFiles(const QString & path, QStringList & files);
+
+    QString _trash_path;
+    std::atomic<bool> _bstop;
+signals:
+    void SigTotalCount(int);
+    void SigUpdateProgress(int);
+    void SigFinishProgress(int);
+
+public slots:
+    void SlotCancelProgress();
+};
+
+#endif // REMOVEPROTHREAD_H
@@ -0,0 +1,78 @@
+#ifndef REORDERBUFFER_H
+#define REORDERBUFFER_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <map>
+
+/*
+ * 有界重排序缓冲区：多个线程乱序产出带序号的结果，消费者按序号依次取出。
+ * 只接受序号在 [下一个待取序号, 下一个待取序号 + window) 内的结果，
+ * 跑得太靠前的生产者在 Reserve 中阻塞，缓冲区中最多同时存在 window 项。
+ * Cancel 让两端立即返回，用于取消任务。
+ */
+template <typename T>
+class ReorderBuffer
+{
+public:
+    explicit ReorderBuffer(int window)
+        : _window(window > 0 ? window : 1), _next(0), _cancelled(false)
+    {
+    }
+
+    // 等到序号 seq 落入窗口；已取消返回 false
+    bool Reserve(int seq)
+    {
+        QMutexLocker locker(&_mutex);
+        while(seq >= _next + _window && !_cancelled){
+            _moved.wait(&_mutex);
+        }
+        return !_cancelled;
+    }
+
+    // 放入序号 seq 的结果，调用前须 Reserve 成功
+    void Put(int seq, const T & item)
+    {
+        QMutexLocker locker(&_mutex);
+        _items.emplace(seq, item);
+        if(seq == _next){
+            _ready.wakeAll();
+        }
+    }
+
+    // 按序号取出下一项，还没产出时阻塞；已取消返回 false
+    bool Take(T & item)
+    {
+        QMutexLocker locker(&_mutex);
+        while(!_cancelled && (_items.empty() || _items.begin()->first != _next)){
+            _ready.wait(&_mutex);
+        }
+        if(_cancelled){
+            return false;
+        }
+        item = _items.begin()->second;
+        _items.erase(_items.begin());
+        ++_next;
+        _moved.wakeAll();
+        return true;
+    }
+
+    void Cancel()
+    {
+        QMutexLocker locker(&_mutex);
+        _cancelled = true;
+        _ready.wakeAll();
+        _moved.wakeAll();
+    }
+
+private:
+    QMutex _mutex;
+    QWaitCondition _ready;
+    QWaitCondition _moved;
+    std::map<int, T> _items;
+    int _window;
+    int _next;
+    bool _cancelled;
+};
+
+#endif // REORDERBUFFER_H
@@ -0,0 +1,244 @@
+#include "scrubthread.h"
+#include "checksumindex.h"
+#include "dirscanner.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QSettings>
+#include <QSet>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <algorithm>
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+const qint64 kChunk = 1 << 20;
+
+// 令牌桶：所有读线程共享一个带宽上限，rate 为 0 表示不限速
+class Throttle
+{
+public:
+    explicit Throttle(qint64 bytes_per_sec)
+        :_rate(bytes_per_sec), _next(0)
+    {
+        _timer.start();
+    }
+
+    void Acquire(qint64 bytes)
+    {
+        if(_rate <= 0){
+            return;
+        }
+        qint64 wait = 0;
+        {
+            QMutexLocker locker(&_mutex);
+            qint64 now = _timer.elapsed();
+            qint64 start = qMax(now, _next);
+            _next = start + bytes * 1000 / _rate;
+            wait = start - now;
+        }
+        if(wait > 0){
+            QThread::msleep(wait);
+        }
+    }
+
+private:
+    QMutex _mutex;
+    QElapsedTimer _timer;
+    qint64 _rate;
+    qint64 _next;       // 下一次读取最早可以开始的时间
+};
+
+enum HashResult {
+    HashOk,
+    HashGone,       // 收集之后文件被移动或删除，不算损坏
+    HashFailed      // 读失败（坏道、权限等）
+};
+
+// 计算文件摘要，每读一块之前让出给前台
+HashResult HashFile(const QString & path, Throttle & throttle, const BackgroundTask & task, QByteArray & hash)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)){
+        return QFileInfo::exists(path) ? HashFailed : HashGone;
+    }
+#ifdef Q_OS_LINUX
+    posix_fadvise(file.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    // 只做完整性校验，不需要抗碰撞，用较快的 MD5
+    QCryptographicHash hasher(QCryptographicHash::Md5);
+    QByteArray buffer(kChunk, Qt::Uninitialized);
+    bool ok = true;
+    while(task.Yield()){
+        throttle.Acquire(kChunk);
+        qint64 len = file.read(buffer.data(), kChunk);
+        if(len < 0){
+            ok = false;
+            break;
+        }
+        if(len == 0){
+            break;
+        }
+        hasher.addData(buffer.constData(), int(len));
+    }
+#ifdef Q_OS_LINUX
+    // 校验读过的数据不留在页缓存，避免挤掉前台浏览用到的缓存
+    posix_fadvise(file.handle(), 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    hash = hasher.result().toHex();
+    return ok ? HashOk : HashFailed;
+}
+}
+
+ScrubThread::ScrubThread(const QString &pro_path, QObject *parent)
+    :BackgroundTask(parent), _pro_path(pro_path)
+{
+
+}
+
+const QString &ScrubThread::GetProPath() const
+{
+    return _pro_path;
+}
+
+void ScrubThread::Work()
+{
+    ChecksumIndex index(_pro_path);
+    index.Load();
+    auto & records = index.Records();
+
+    QVector<Task> tasks;
+    CollectFiles(_pro_path, tasks);
+    if(_bstop){
+        return;
+    }
+
+    // 已经不存在的文件从索引中去掉
+    QSet<QString> present;
+    for(const Task & task : tasks){
+        present.insert(task.rel_path);
+    }
+    for(auto iter = records.begin(); iter != records.end();){
+        if(present.contains(iter.key())){
+            ++iter;
+        } else {
+            iter = records.erase(iter);
+        }
+    }
+
+    // 最久没有校验的优先，从未校验的排在最前；上次中断的校验因此自然接着做
+    std::stable_sort(tasks.begin(), tasks.end(), [&records](const Task & a, const Task & b){
+        auto ia = records.constFind(a.rel_path);
+        auto ib = records.constFind(b.rel_path);
+        qint64 va = ia == records.constEnd() ? 0 : ia.value().verified;
+        qint64 vb = ib == records.constEnd() ? 0 : ib.value().verified;
+        return va < vb;
+    });
+    emit SigTotalCount(tasks.size());
+
+    QSettings settings;
+    int threads = qBound(1, settings.value("scrub/threads", 2).toInt(), 16);
+    Throttle throttle(settings.value("scrub/mb_per_sec", 64).toLongLong() << 20);
+
+    QMutex mutex;
+    std::atomic<int> next(0);
+    int done = 0;
+    int bad_count = 0;
+    QElapsedTimer save_timer;
+    save_timer.start();
+
+    auto worker = [&](){
+        EnterIdle();
+        while(!_bstop){
+            int i = next++;
+            if(i >= tasks.size()){
+                break;
+            }
+            const Task & task = tasks.at(i);
+            QByteArray hash;
+            HashResult result = HashFile(task.path, throttle, *this, hash);
+            if(_bstop){
+                break;
+            }
+
+            QMutexLocker locker(&mutex);
+            if(result == HashGone){
+                records.remove(task.rel_path);
+                emit SigUpdateProgress(++done);
+                continue;
+            }
+            qint64 now = QDateTime::currentMSecsSinceEpoch();
+            bool failed = result == HashFailed;
+            // 读失败时算出的摘要不完整，不能作为基准；记录保持没有摘要，下次读成功再补上
+            const QByteArray baseline = failed ? QByteArray() : hash;
+            auto iter = records.find(task.rel_path);
+            if(iter == records.end() || iter->size != task.size || iter->mtime != task.mtime){
+                // 新文件或被正常修改过：记录新的摘要
+                records.insert(task.rel_path, {task.size, task.mtime, baseline, now, failed});
+            } else if(iter->hash.isEmpty()){
+                // 之前没有读成功过，这次的结果就是基准
+                iter->hash = baseline;
+                iter->verified = now;
+                iter->bad = failed;
+            } else {
+                // 大小和修改时间都没变，摘要却不同，是静默损坏；读失败时保留原来的基准
+                failed = failed || iter->hash != hash;
+                iter->verified = now;
+                iter->bad = failed;
+            }
+            if(failed){
+                ++bad_count;
+                emit SigFileFailed(task.path);
+            }
+            emit SigUpdateProgress(++done);
+
+            // 定期写回，中途退出也不丢失已完成的校验
+            if(save_timer.elapsed() > 30000){
+                index.Save();
+                save_timer.restart();
+            }
+        }
+    };
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    QList<QFuture<void>> futures;
+    for(int i = 0; i < threads; ++i){
+        futures << QtConcurrent::run(&pool, worker);
+    }
+    for(QFuture<void> & future : futures){
+        future.waitForFinished();
+    }
+
+    if(!_bstop){
+        index.SetLastFullScrub(QDateTime::currentMSecsSinceEpoch());
+    }
+    index.Save();
+    if(!_bstop){
+        emit SigFinishProgress(bad_count);
+    }
+}
+
+void ScrubThread::CollectFiles(const QString &dir_path, QVector<Task> &tasks)
+{
+    QVector<DirEntry> list;
+    DirScanner::List(dir_path, list, true);
+    QDir root(_pro_path);
+    for(const DirEntry & entry : list){
+        if(_bstop){
+            return;
+        }
+        if(entry.is_dir){
+            CollectFiles(entry.path, tasks);
+        } else if(DirScanner::IsPicFile(entry.name)){
+            tasks.append({root.relativeFilePath(entry.path), entry.path, entry.size, entry.mtime});
+        }
+    }
+}
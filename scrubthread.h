@@ -0,0 +1,40 @@
+#ifndef SCRUBTHREAD_H
+#define SCRUBTHREAD_H
+
+#include <QVector>
+#include "backgroundtask.h"
+
+/*
+ * 项目文件完整性校验（scrub）。
+ * 逐个读取项目中的图片计算摘要，和校验和索引比对，发现静默损坏的文件。
+ * 最久没有校验过的文件优先；进度定期写回索引，中途退出下次接着校验。
+ * 多线程读取，但总读取带宽受限，线程和 I/O 都是最低优先级，用户操作或前台解码时暂停，
+ * 读过的数据不留在页缓存里，不影响前台浏览。
+ */
+class ScrubThread : public BackgroundTask
+{
+    Q_OBJECT
+public:
+    explicit ScrubThread(const QString & pro_path, QObject * parent = nullptr);
+    const QString & GetProPath() const;
+protected:
+    void Work() override;
+private:
+    struct Task {
+        QString rel_path;
+        QString path;
+        qint64 size;
+        qint64 mtime;
+    };
+
+    void CollectFiles(const QString & dir_path, QVector<Task> & tasks);
+
+    QString _pro_path;
+signals:
+    void SigTotalCount(int);
+    void SigUpdateProgress(int);
+    void SigFileFailed(const QString & path);
+    void SigFinishProgress(int bad_count);
+};
+
+#endif // SCRUBTHREAD_H
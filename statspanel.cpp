@@ -0,0 +1,121 @@
+#include "statspanel.h"
+#include "metrics.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFileDialog>
+#include <QHeaderView>
+#include <QLocale>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+StatsPanel::StatsPanel(QWidget *parent)
+    :QDockWidget(tr("性能统计"), parent), _timer(new QTimer(this))
+{
+    setObjectName("StatsPanel");
+    auto * body = new QWidget(this);
+    auto * layout = new QVBoxLayout(body);
+    layout->setContentsMargins(4, 4, 4, 4);
+
+    _tree = new QTreeWidget(body);
+    _tree->setColumnCount(3);
+    _tree->setHeaderLabels({tr("指标"), tr("数值"), tr("每秒 / 分位数")});
+    _tree->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    _counters = new QTreeWidgetItem(_tree, {tr("计数")});
+    _gauges = new QTreeWidgetItem(_tree, {tr("当前值")});
+    _histograms = new QTreeWidgetItem(_tree, {tr("延迟（微秒）")});
+    _tree->expandAll();
+    layout->addWidget(_tree);
+
+    auto * save_btn = new QPushButton(tr("保存快照"), body);
+    layout->addWidget(save_btn);
+    setWidget(body);
+
+    _timer->setInterval(1000);
+    connect(_timer, &QTimer::timeout, this, &StatsPanel::SlotRefresh);
+    connect(save_btn, &QPushButton::clicked, this, &StatsPanel::SlotSaveSnapshot);
+}
+
+StatsPanel::~StatsPanel()
+{
+
+}
+
+void StatsPanel::showEvent(QShowEvent *event)
+{
+    QDockWidget::showEvent(event);
+    SlotRefresh();
+    _timer->start();
+}
+
+void StatsPanel::hideEvent(QHideEvent *event)
+{
+    QDockWidget::hideEvent(event);
+    _timer->stop();
+}
+
+// 指标是运行中陆续注册的，第一次出现时添加一行
+QTreeWidgetItem *StatsPanel::Row(QTreeWidgetItem *group, const QString &name)
+{
+    QString key = group->text(0) + "/" + name;
+    QTreeWidgetItem * row = _rows.value(key);
+    if(!row){
+        row = new QTreeWidgetItem(group, {name});
+        row->setTextAlignment(1, Qt::AlignRight);
+        _rows.insert(key, row);
+    }
+    return row;
+}
+
+void StatsPanel::SlotRefresh()
+{
+    QJsonObject snapshot = Metrics::Snapshot();
+    double seconds = _last_refresh.isValid() ? _last_refresh.restart() / 1000.0 : 0.0;
+    if(!_last_refresh.isValid()){
+        _last_refresh.start();
+    }
+
+    QJsonObject counters = snapshot.value("counters").toObject();
+    for(auto iter = counters.begin(); iter != counters.end(); ++iter){
+        qint64 value = qint64(iter.value().toDouble());
+        QTreeWidgetItem * row = Row(_counters, iter.key());
+        row->setText(1, QLocale().toString(value));
+        if(seconds > 0 && _last_values.contains(iter.key())){
+            double rate = (value - _last_values.value(iter.key())) / seconds;
+            row->setText(2, QLocale().toString(rate, 'f', 1));
+        }
+        _last_values.insert(iter.key(), value);
+    }
+
+    QJsonObject gauges = snapshot.value("gauges").toObject();
+    for(auto iter = gauges.begin(); iter != gauges.end(); ++iter){
+        Row(_gauges, iter.key())->setText(1, QLocale().toString(qint64(iter.value().toDouble())));
+    }
+
+    QJsonObject histograms = snapshot.value("histograms").toObject();
+    for(auto iter = histograms.begin(); iter != histograms.end(); ++iter){
+        QJsonObject stats = iter.value().toObject();
+        QTreeWidgetItem * row = Row(_histograms, iter.key());
+        row->setText(1, QLocale().toString(qint64(stats.value("count").toDouble())));
+        row->setText(2, QString("p50 %1  p90 %2  p99 %3  max %4")
+                            .arg(qint64(stats.value("p50_us").toDouble()))
+                            .arg(qint64(stats.value("p90_us").toDouble()))
+                            .arg(qint64(stats.value("p99_us").toDouble()))
+                            .arg(qint64(stats.value("max_us").toDouble())));
+    }
+}
+
+void StatsPanel::SlotSaveSnapshot()
+{
+    QString name = QString("album-stats-%1.json").arg(QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss"));
+    QString path = QFileDialog::getSaveFileName(this, tr("保存性能快照"), QDir::home().absoluteFilePath(name),
+                                                tr("JSON (*.json);;文本 (*.txt)"));
+    if(path.isEmpty()){
+        return;
+    }
+    if(!Metrics::Dump(path)){
+        QMessageBox::warning(this, tr("保存性能快照"), tr("无法写入 %1").arg(path));
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef STATSPANEL_H
+#define STATSPANEL_H
+
+#include <QDockWidget>
+#include <QElapsedTimer>
+#include <QHash>
+
+class QTimer;
+class QTreeWidget;
+class QTreeWidgetItem;
+
+/*
+ * 可停靠的性能统计面板：每秒从 Metrics 取一次快照，
+ * 计数显示累计值和每秒速率，直方图显示次数和 p50/p90/p99/最大延迟。
+ * 面板隐藏时停止刷新；“保存快照”把当前全部指标写成文本或 JSON 文件。
+ */
+class StatsPanel : public QDockWidget
+{
+    Q_OBJECT
+public:
+    explicit StatsPanel(QWidget * parent = nullptr);
+    ~StatsPanel();
+
+protected:
+    void showEvent(QShowEvent * event) override;
+    void hideEvent(QHideEvent * event) override;
+
+private:
+    QTreeWidgetItem * Row(QTreeWidgetItem * group, const QString & name);
+
+    QTreeWidget * _tree;
+    QTimer * _timer;
+    QTreeWidgetItem * _counters;
+    QTreeWidgetItem * _gauges;
+    QTreeWidgetItem * _histograms;
+    QHash<QString, QTreeWidgetItem*> _rows;
+    QHash<QString, qint64> _last_values;    // 上次刷新时的计数，用于算速率
+    QElapsedTimer _last_refresh;
+
+private slots:
+    void SlotRefresh();
+    void SlotSaveSnapshot();
+};
+
+#endif // STATSPANEL_H
@@ -0,0 +1,224 @@
+#include "stressrunner.h"
+#include "const.h"
+#include "dirscanner.h"
+#include "opentreethread.h"
+#include "protreeitem.h"
+#include "protreethread.h"
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QThreadPool>
+#include <QTreeWidget>
+#include <atomic>
+
+namespace {
+
+// 生成一个文件；内容只是占位，扫描和复制不校验图片格式
+bool Touch(const QString & path, int bytes)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::WriteOnly)){
+        return false;
+    }
+    if(bytes > 0){
+        file.write(QByteArray(bytes, '\xff'));
+    }
+    return true;
+}
+
+QString Option(const QStringList & args, const QString & name, const QString & fallback)
+{
+    int index = args.indexOf(name);
+    return index >= 0 && index + 1 < args.size() ? args.at(index + 1) : fallback;
+}
+
+void CollectDirs(const QString & path, QStringList & dirs)
+{
+    dirs.append(path);
+    QVector<DirEntry> list;
+    DirScanner::List(path, list);
+    for(const DirEntry & entry : list){
+        if(entry.is_dir){
+            CollectDirs(entry.path, dirs);
+        }
+    }
+}
+
+} // namespace
+
+int StressRunner::Run(const QStringList &args)
+{
+    if(args.isEmpty()){
+        qDebug() << "usage: Album --stress <work dir> [--entries N] [--threads N] [--cycles N]";
+        return 1;
+    }
+    QString work = QDir(args.at(0)).absolutePath();
+    int entries = qMax(1000, Option(args, "--entries", "1000000").toInt());
+    int threads = qMax(1, Option(args, "--threads", QString::number(QThread::idealThreadCount())).toInt());
+    int cycles = qMax(1, Option(args, "--cycles", "200").toInt());
+
+    QString root = QDir(work).absoluteFilePath("stress-src");
+    if(!Generate(root, entries)){
+        qDebug() << "generate stress tree failed" << root;
+        return 1;
+    }
+    ScanScaling(root, threads);
+    CancelCycles(root, work, cycles);
+    return 0;
+}
+
+bool StressRunner::Generate(const QString &root, int entries)
+{
+    // 已经生成过同样规模的树就直接复用
+    QString marker = QDir(root).absoluteFilePath(".stress-done");
+    QFile done(marker);
+    if(done.open(QIODevice::ReadOnly) && done.readAll().toInt() == entries){
+        return true;
+    }
+    done.close();
+
+    QElapsedTimer timer;
+    timer.start();
+    QDir dir(root);
+    if(!dir.mkpath(".")){
+        return false;
+    }
+
+    // 宽目录树：每个目录 1000 个空文件，只占 inode
+    for(int d = 0; d * 1000 < entries; ++d){
+        QString sub = dir.absoluteFilePath(QString("wide/%1").arg(d, 4, 10, QChar('0')));
+        QDir().mkpath(sub);
+        for(int f = 0; f < 1000 && d * 1000 + f < entries; ++f){
+            Touch(QString("%1/%2.jpg").arg(sub).arg(f, 4, 10, QChar('0')), 0);
+        }
+    }
+
+    // 1 万个文件的扁平目录
+    dir.mkpath("flat");
+    for(int f = 0; f < 10000; ++f){
+        Touch(dir.absoluteFilePath(QString("flat/IMG_%1.JPG").arg(f, 5, 10, QChar('0'))), 4096);
+    }
+
+    // 200 层嵌套，每层一张图片
+    QString deep = dir.absoluteFilePath("deep");
+    for(int level = 0; level < 200; ++level){
+        deep += QString("/d%1").arg(level, 3, 10, QChar('0'));
+        QDir().mkpath(deep);
+        Touch(deep + "/a.jpg", 4096);
+    }
+
+    // Unicode 文件名：中日俄文、emoji、组合字符、从右到左文字、前导减号和空格
+    dir.mkpath("unicode");
+    const QStringList names = {
+        QString::fromUtf8("照片_%1.jpg"), QString::fromUtf8("фото %1.JPG"),
+        QString::fromUtf8("写真 🌸 %1.jpeg"), QString::fromUtf8("café %1.png"),
+        QString::fromUtf8("שלום %1.jpg"), QString::fromUtf8("- leading %1.jpg"),
+    };
+    for(int i = 0; i < 50; ++i){
+        for(const QString & name : names){
+            Touch(dir.absoluteFilePath("unicode/" + name.arg(i)), 4096);
+        }
+    }
+
+    // 没有权限的目录和文件（以 root 运行时权限不起作用）
+    QString locked = dir.absoluteFilePath("denied/locked");
+    QDir().mkpath(locked);
+    for(int i = 0; i < 10; ++i){
+        Touch(QString("%1/%2.jpg").arg(locked).arg(i), 4096);
+    }
+    QString unreadable = dir.absoluteFilePath("denied/unreadable.jpg");
+    Touch(unreadable, 4096);
+    Touch(dir.absoluteFilePath("denied/readable.jpg"), 4096);
+    QFile::setPermissions(unreadable, QFileDevice::Permissions());
+    QFile::setPermissions(locked, QFileDevice::Permissions());
+
+    if(!done.open(QIODevice::WriteOnly)){
+        return false;
+    }
+    done.write(QByteArray::number(entries));
+    qDebug().noquote() << QString("generated %1 in %2 s").arg(root).arg(timer.elapsed() / 1000.0, 0, 'f', 1);
+    return true;
+}
+
+// 所有目录放进一个共享的下标，1、2、4 ... 个线程并行列目录并读取元数据
+void StressRunner::ScanScaling(const QString &root, int max_threads)
+{
+    QStringList dirs;
+    CollectDirs(root, dirs);    // 顺便把目录项读进缓存，下面各轮条件相同
+    qDebug().noquote() << QString("scan scaling over %1 directories").arg(dirs.size());
+
+    double base_rate = 0;
+    for(int threads = 1; ; threads = qMin(threads * 2, max_threads)){
+        std::atomic<int> next(0);
+        std::atomic<qint64> entries(0);
+        QThreadPool pool;
+        pool.setMaxThreadCount(threads);
+        QElapsedTimer timer;
+        timer.start();
+        for(int t = 0; t < threads; ++t){
+            pool.start([&](){
+                QVector<DirEntry> list;
+                for(int i = next++; i < dirs.size(); i = next++){
+                    DirScanner::List(dirs.at(i), list, true);
+                    entries += list.size();
+                }
+            });
+        }
+        pool.waitForDone();
+        double seconds = qMax<qint64>(1, timer.nsecsElapsed() / 1000) / 1e6;
+        double rate = entries / seconds;
+        if(threads == 1){
+            base_rate = rate;
+        }
+        qDebug().noquote() << QString("  threads %1: %2 entries/s, speedup %3")
+                                  .arg(threads, 3).arg(qint64(rate), 10).arg(rate / base_rate, 0, 'f', 2);
+        if(threads >= max_threads){
+            break;
+        }
+    }
+}
+
+// 每轮同时打开项目和导入，在随机时刻从主线程取消，走和界面相同的取消路径
+void StressRunner::CancelCycles(const QString &root, const QString &work, int cycles)
+{
+    const QStringList sources = {"unicode", "deep", "denied", "flat"};
+    QRandomGenerator * random = QRandomGenerator::global();
+    int cancelled = 0;
+    QElapsedTimer timer;
+    timer.start();
+
+    for(int cycle = 0; cycle < cycles; ++cycle){
+        QTreeWidget open_tree;
+        QTreeWidget import_tree;
+
+        OpenTreeThread open_thread(root, 0, &open_tree);
+        QString src = QDir(root).absoluteFilePath(sources.at(cycle % sources.size()));
+        QString dst = QDir(work).absoluteFilePath(QString("stress-import-%1").arg(cycle));
+        QDir().mkpath(dst);
+        auto * pro_item = new ProTreeItem(&import_tree, "import", dst, TreeItemPro);
+        ProTreeThread import_thread(src, dst, pro_item, 0, &import_tree, pro_item);
+        import_thread.SetImportMode(ProTreeThread::ImportMode(cycle % 3));
+
+        open_thread.start();
+        import_thread.start();
+        QThread::msleep(random->bounded(50));
+        // 打开整棵大树总是取消；导入一半取消，一半等它完成
+        open_thread.SlotCancelProgress();
+        if(random->bounded(2) == 0){
+            import_thread.SlotCancelProgress();
+            ++cancelled;
+        }
+        open_thread.wait();
+        import_thread.wait();
+        QDir(dst).removeRecursively();
+
+        if((cycle + 1) % 50 == 0){
+            qDebug().noquote() << QString("  cycle %1/%2").arg(cycle + 1).arg(cycles);
+        }
+    }
+    qDebug().noquote() << QString("open/import/cancel: %1 cycles (%2 imports cancelled) in %3 s, %4 cycles/s")
+                              .arg(cycles).arg(cancelled).arg(timer.elapsed() / 1000.0, 0, 'f', 1)
+                              .arg(cycles * 1000.0 / qMax<qint64>(1, timer.elapsed()), 0, 'f', 2);
+}
@@ -0,0 +1,26 @@
+#ifndef STRESSRUNNER_H
+#define STRESSRUNNER_H
+
+#include <QStringList>
+
+/*
+ * 扫描和导入的并发压力测试，命令行运行：
+ *   Album --stress <工作目录> [--entries N] [--threads N] [--cycles N]
+ * 1. 在工作目录下生成病态的目录树（只生成一次）：N 个条目的宽目录树（默认 100 万）、
+ *    1 万个文件的扁平目录、200 层嵌套、各种 Unicode 文件名、没有权限的目录和文件；
+ * 2. 用 1 到 N 个线程并行列目录，报告吞吐量随线程数的扩展情况；
+ * 3. 反复并发地打开项目、导入并在随机时刻取消，检查取消路径。
+ * 配合 qmake CONFIG+=tsan / CONFIG+=asan 的检查构建使用，发布前验证并发相关的改动。
+ */
+class StressRunner
+{
+public:
+    static int Run(const QStringList & args);
+
+private:
+    static bool Generate(const QString & root, int entries);
+    static void ScanScaling(const QString & root, int max_threads);
+    static void CancelCycles(const QString & root, const QString & work, int cycles);
+};
+
+#endif // STRESSRUNNER_H
@@ -0,0 +1,152 @@
+#include "thumbcache.h"
+#include "decodepool.h"
+#include "imagecache.h"
+#include "imagescaler.h"
+#include "metrics.h"
+#include "packfile.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImageWriter>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+ImageCache &ThumbCache::MemoryCache()
+{
+    static ImageCache cache("thumbnail");
+    return cache;
+}
+
+// 缓存键包含修改时间，原图被修改后旧缩略图不会再命中；打包项目中的图片取包文件的修改时间
+QString ThumbCache::CacheKey(const QString &pic_path, int size)
+{
+    qint64 mtime = PackFile::ModifiedTime(pic_path);
+    if(mtime < 0){
+        return QString();
+    }
+    return QString("%1|%2|%3").arg(QFileInfo(pic_path).absoluteFilePath()).arg(mtime).arg(size);
+}
+
+// 内嵌预览的键和缩略图的键分开，尺寸位置换成固定标记
+QString ThumbCache::PreviewKey(const QString &pic_path)
+{
+    qint64 mtime = PackFile::ModifiedTime(pic_path);
+    if(mtime < 0){
+        return QString();
+    }
+    return QString("%1|%2|preview").arg(QFileInfo(pic_path).absoluteFilePath()).arg(mtime);
+}
+
+// 磁盘缓存文件路径（不含扩展名）
+QString ThumbCache::DiskPath(const QString &key)
+{
+    static const QString dir = [](){
+        QString path = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/thumbs";
+        QDir().mkpath(path);
+        return path;
+    }();
+    QByteArray hash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return dir + "/" + QString::fromLatin1(hash);
+}
+
+QImage ThumbCache::Find(const QString &pic_path, int size)
+{
+    return FindKey(CacheKey(pic_path, size));
+}
+
+void ThumbCache::Store(const QString &pic_path, int size, const QImage &thumb, double cost)
+{
+    StoreKey(CacheKey(pic_path, size), thumb, cost);
+}
+
+QImage ThumbCache::FindPreview(const QString &pic_path)
+{
+    return FindKey(PreviewKey(pic_path));
+}
+
+void ThumbCache::StorePreview(const QString &pic_path, const QImage &preview)
+{
+    StoreKey(PreviewKey(pic_path), preview, 1.0);
+}
+
+QImage ThumbCache::FindKey(const QString &key)
+{
+    if(key.isEmpty()){
+        return QImage();
+    }
+
+    QImage thumb = MemoryCache().Find(key);
+    if(!thumb.isNull()){
+        return thumb;
+    }
+
+    // 不透明的缩略图存为 jpg，带透明通道的存为 png
+    QString base = DiskPath(key);
+    const char * suffixes[] = {".jpg", ".png"};
+    for(const char * suffix : suffixes){
+        QString path = base + suffix;
+        if(!QFile::exists(path)){
+            continue;
+        }
+        QElapsedTimer timer;
+        timer.start();
+        if(thumb.load(path)){
+            static Metrics::Counter & disk_hits = Metrics::GetCounter("thumb.disk.hit");
+            disk_hits.Add();
+            MemoryCache().Insert(key, thumb, double(timer.elapsed() + 1));
+            return thumb;
+        }
+    }
+    return QImage();
+}
+
+void ThumbCache::StoreKey(const QString &key, const QImage &thumb, double cost)
+{
+    if(key.isEmpty() || thumb.isNull()){
+        return;
+    }
+    MemoryCache().Insert(key, thumb, cost);
+
+    bool alpha = thumb.hasAlphaChannel();
+    QSaveFile file(DiskPath(key) + (alpha ? ".png" : ".jpg"));
+    if(!file.open(QIODevice::WriteOnly)){
+        return;
+    }
+    QImageWriter writer(&file, alpha ? "png" : "jpg");
+    writer.setQuality(90);
+    if(writer.write(thumb)){
+        file.commit();
+    } else {
+        file.cancelWriting();
+    }
+}
+
+QImage ThumbCache::GetOrCreate(const QString &pic_path, int size)
+{
+    QImage thumb = Find(pic_path, size);
+    if(!thumb.isNull()){
+        return thumb;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    // 在解码子进程里按比例解码（JPEG 可在 DCT 阶段缩小）并高质量缩放，
+    // 损坏的图片只会拖垮子进程；打包项目中的图片直接从映射区解码
+    thumb = DecodePool::Decode(pic_path, size);
+    if(thumb.isNull()){
+        return QImage();
+    }
+
+    // 以生成耗时作为重建代价，供内存预算淘汰时参考
+    Store(pic_path, size, thumb, double(timer.elapsed() + 1));
+    return thumb;
+}
+
+QImage ThumbCache::MakeThumb(const QImage &image, int size)
+{
+    if(image.width() <= size && image.height() <= size){
+        return image;
+    }
+    return ImageScaler::Scale(image, QSize(size, size), Qt::KeepAspectRatio);
+}
@@ -0,0 +1,41 @@
+#ifndef THUMBCACHE_H
+#define THUMBCACHE_H
+
+#include <QImage>
+#include <QString>
+
+class ImageCache;
+
+/*
+ * 缩略图缓存，分内存和磁盘两级。
+ * 内存级是注册到 MemoryBudget 的 ImageCache；磁盘级放在系统缓存目录下，
+ * 文件名由图片路径、修改时间和尺寸哈希而来，原图修改后自然失效。
+ * 联系表、浏览、网页相册导出等功能先查这里，避免重复解码原图。
+ * 某个尺寸下存的图片长边不会小于该尺寸（原图本身更小时除外），
+ * 尺寸不够的内嵌预览单独存在预览缓存里，不会被当成缩略图取走。
+ */
+class ThumbCache
+{
+public:
+    // 查找 size（长边像素）对应的缩略图，依次查内存和磁盘，没有返回空图片
+    static QImage Find(const QString & pic_path, int size);
+    // 保存缩略图到内存和磁盘；cost 是重新生成的代价，供内存预算淘汰时参考
+    static void Store(const QString & pic_path, int size, const QImage & thumb, double cost = 1.0);
+    // 查找，没有则解码原图生成并保存
+    static QImage GetOrCreate(const QString & pic_path, int size);
+    // 把图片缩放到长边不超过 size
+    static QImage MakeThumb(const QImage & image, int size);
+    // 图片文件内嵌的预览，尺寸不定，和按尺寸存放的缩略图分开
+    static QImage FindPreview(const QString & pic_path);
+    static void StorePreview(const QString & pic_path, const QImage & preview);
+
+private:
+    static QImage FindKey(const QString & key);
+    static void StoreKey(const QString & key, const QImage & thumb, double cost);
+    static ImageCache & MemoryCache();
+    static QString CacheKey(const QString & pic_path, int size);
+    static QString PreviewKey(const QString & pic_path);
+    static QString DiskPath(const QString & key);
+};
+
+#endif // THUMBCACHE_H
@@ -0,0 +1,163 @@
+#include "tiffwriter.h"
+
+namespace {
+const quint16 kShort = 3;
+const quint16 kLong = 4;
+const quint16 kRational = 5;
+const qint64 kMaxFileSize = Q_INT64_C(0xFFFFFFFF) - 64 * 1024 * 1024;
+}
+
+TiffWriter::TiffWriter()
+    :_width(0), _height(0), _rows_per_strip(0), _dpi(0)
+{
+
+}
+
+TiffWriter::~TiffWriter()
+{
+    if(_file.isOpen()){
+        Abort();
+    }
+}
+
+bool TiffWriter::Open(const QString &path, int width, int height, int rows_per_strip, int dpi)
+{
+    _width = width;
+    _height = height;
+    _rows_per_strip = rows_per_strip;
+    _dpi = dpi;
+    _strip_offsets.clear();
+    _strip_sizes.clear();
+    _file.setFileName(path);
+    if(!_file.open(QIODevice::WriteOnly | QIODevice::Truncate)){
+        return false;
+    }
+    // 小端文件头，IFD 偏移先写 0
+    QByteArray header("II*\0", 4);
+    PutU32(header, 0);
+    return _file.write(header) == header.size();
+}
+
+void TiffWriter::PutU16(QByteArray &out, quint16 value)
+{
+    char bytes[2] = {char(value), char(value >> 8)};
+    out.append(bytes, 2);
+}
+
+void TiffWriter::PutU32(QByteArray &out, quint32 value)
+{
+    char bytes[4] = {char(value), char(value >> 8), char(value >> 16), char(value >> 24)};
+    out.append(bytes, 4);
+}
+
+// 一个 IFD 条目；不超过 4 字节的值直接放在条目里（小端下左对齐）
+void TiffWriter::PutEntry(QByteArray &out, quint16 tag, quint16 type, quint32 count, quint32 value)
+{
+    PutU16(out, tag);
+    PutU16(out, type);
+    PutU32(out, count);
+    PutU32(out, value);
+}
+
+bool TiffWriter::WriteStrip(const QByteArray &compressed)
+{
+    if(compressed.isEmpty() || _file.pos() + compressed.size() > kMaxFileSize){
+        return false;
+    }
+    _strip_offsets.append(quint32(_file.pos()));
+    _strip_sizes.append(quint32(compressed.size()));
+    if(_file.write(compressed) != compressed.size()){
+        return false;
+    }
+    // 下一项保持 2 字节对齐
+    if(_file.pos() % 2 && _file.write("\0", 1) != 1){
+        return false;
+    }
+    return true;
+}
+
+bool TiffWriter::Close()
+{
+    const int strips = _strip_offsets.size();
+    const int expected = (_height + _rows_per_strip - 1) / _rows_per_strip;
+    if(!_file.isOpen() || strips != expected){
+        Abort();
+        return false;
+    }
+
+    const int entries = 13;
+    const quint32 ifd_pos = quint32(_file.pos());
+    // IFD 之后依次存放：BitsPerSample、两个分辨率、条带偏移表、条带长度表
+    quint32 extra = ifd_pos + 2 + entries * 12 + 4;
+    const quint32 bits_pos = extra;
+    const quint32 xres_pos = bits_pos + 8;
+    const quint32 yres_pos = xres_pos + 8;
+    const quint32 offsets_pos = yres_pos + 8;
+    const quint32 sizes_pos = offsets_pos + strips * 4;
+
+    QByteArray out;
+    PutU16(out, entries);
+    PutEntry(out, 256, kLong, 1, quint32(_width));          // ImageWidth
+    PutEntry(out, 257, kLong, 1, quint32(_height));         // ImageLength
+    PutEntry(out, 258, kShort, 3, bits_pos);                // BitsPerSample 8,8,8
+    PutEntry(out, 259, kShort, 1, 8);                       // Compression: Deflate
+    PutEntry(out, 262, kShort, 1, 2);                       // PhotometricInterpretation: RGB
+    PutEntry(out, 273, kLong, quint32(strips), strips == 1 ? _strip_offsets.first() : offsets_pos);
+    PutEntry(out, 277, kShort, 1, 3);                       // SamplesPerPixel
+    PutEntry(out, 278, kLong, 1, quint32(_rows_per_strip)); // RowsPerStrip
+    PutEntry(out, 279, kLong, quint32(strips), strips == 1 ? _strip_sizes.first() : sizes_pos);
+    PutEntry(out, 282, kRational, 1, xres_pos);             // XResolution
+    PutEntry(out, 283, kRational, 1, yres_pos);             // YResolution
+    PutEntry(out, 284, kShort, 1, 1);                       // PlanarConfiguration: 交错
+    PutEntry(out, 296, kShort, 1, 2);                       // ResolutionUnit: 英寸
+    PutU32(out, 0);                                         // 没有下一个 IFD
+
+    PutU16(out, 8);
+    PutU16(out, 8);
+    PutU16(out, 8);
+    PutU16(out, 0);
+    PutU32(out, quint32(_dpi));
+    PutU32(out, 1);
+    PutU32(out, quint32(_dpi));
+    PutU32(out, 1);
+    if(strips > 1){
+        for(quint32 offset : _strip_offsets){
+            PutU32(out, offset);
+        }
+        for(quint32 size : _strip_sizes){
+            PutU32(out, size);
+        }
+    }
+
+    QByteArray ifd_offset;
+    PutU32(ifd_offset, ifd_pos);
+    bool ok = _file.write(out) == out.size()
+              && _file.seek(4) && _file.write(ifd_offset) == 4;
+    _file.close();
+    if(!ok){
+        _file.remove();
+    }
+    return ok;
+}
+
+void TiffWriter::Abort()
+{
+    if(_file.isOpen()){
+        _file.close();
+    }
+    _file.remove();
+}
+
+QByteArray TiffWriter::CompressStrip(const QImage &strip)
+{
+    const QImage rgb = strip.convertToFormat(QImage::Format_RGB888);
+    const int row_bytes = rgb.width() * 3;
+    QByteArray raw;
+    raw.reserve(row_bytes * rgb.height());
+    // QImage 每行按 4 字节对齐，TIFF 的行是紧密排列的
+    for(int y = 0; y < rgb.height(); ++y){
+        raw.append(reinterpret_cast<const char*>(rgb.constScanLine(y)), row_bytes);
+    }
+    // qCompress 的结果是 4 字节原始长度加上 zlib 数据流，TIFF 只要后者
+    return qCompress(raw, 6).mid(4);
+}
@@ -0,0 +1,48 @@
+#ifndef TIFFWRITER_H
+#define TIFFWRITER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QImage>
+#include <QString>
+#include <QVector>
+
+/*
+ * 按条带顺序写出的 RGB TIFF，用于超大画布的流式输出。
+ * 每个条带单独用 Deflate（zlib）压缩，可以在不同线程里并行压缩，
+ * 写完一个条带就可以释放它的像素，整张画布不必同时在内存中。
+ * 索引（IFD）和条带偏移表在最后写入，文件头中的偏移结束时回填。
+ * 经典 TIFF 的偏移是 32 位，文件不能超过 4GB。
+ */
+class TiffWriter
+{
+public:
+    TiffWriter();
+    ~TiffWriter();
+
+    // rows_per_strip：除最后一个条带外，每个条带的行数
+    bool Open(const QString & path, int width, int height, int rows_per_strip, int dpi);
+    // 按顺序写入一个由 CompressStrip 得到的条带
+    bool WriteStrip(const QByteArray & compressed);
+    bool Close();
+    // 放弃写入并删除文件
+    void Abort();
+
+    // 把一段 RGB32 图片转成 8 位 RGB 并压缩，可以在任意线程调用
+    static QByteArray CompressStrip(const QImage & strip);
+
+private:
+    void PutU16(QByteArray & out, quint16 value);
+    void PutU32(QByteArray & out, quint32 value);
+    void PutEntry(QByteArray & out, quint16 tag, quint16 type, quint32 count, quint32 value);
+
+    QFile _file;
+    int _width;
+    int _height;
+    int _rows_per_strip;
+    int _dpi;
+    QVector<quint32> _strip_offsets;
+    QVector<quint32> _strip_sizes;
+};
+
+#endif // TIFFWRITER_H
@@ -0,0 +1,267 @@
+#include "timelinedialog.h"
+#include "thumbcache.h"
+#include <QDateEdit>
+#include <QDir>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QListWidget>
+#include <QPushButton>
+#include <QSet>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+#include <QtConcurrent>
+#include <functional>
+
+namespace {
+const int kThumbSize = 120;
+
+// 节点上保存的日期键：年 yyyy、月 yyyymm、日 yyyymmdd；缩略图条为 0
+int ItemKey(QTreeWidgetItem * item)
+{
+    return item->data(0, Qt::UserRole).toInt();
+}
+
+bool IsDayKey(int key)
+{
+    return key >= 10000000;
+}
+}
+
+TimelineDialog::TimelineDialog(const QString &pro_path, QWidget *parent)
+    :QDialog(parent), _pro_path(pro_path), _count(0)
+{
+    setWindowTitle(tr("时间线 - %1").arg(QFileInfo(pro_path).fileName()));
+    resize(720, 640);
+
+    auto * layout = new QVBoxLayout(this);
+    auto * jump_layout = new QHBoxLayout();
+    _jump_edit = new QDateEdit(this);
+    _jump_edit->setDisplayFormat("yyyy-MM");
+    _jump_edit->setCalendarPopup(true);
+    auto * jump_btn = new QPushButton(tr("跳转"), this);
+    _refresh_btn = new QPushButton(tr("刷新"), this);
+    _refresh_btn->setToolTip(tr("对照磁盘重新核对，找出在相册之外新增、改动或删除的图片"));
+    _status = new QLabel(tr("正在载入..."), this);
+    jump_layout->addWidget(new QLabel(tr("跳转到月份"), this));
+    jump_layout->addWidget(_jump_edit);
+    jump_layout->addWidget(jump_btn);
+    jump_layout->addStretch();
+    jump_layout->addWidget(_status);
+    jump_layout->addWidget(_refresh_btn);
+    layout->addLayout(jump_layout);
+
+    _tree = new QTreeWidget(this);
+    _tree->setHeaderHidden(true);
+    _tree->setUniformRowHeights(false);
+    layout->addWidget(_tree);
+
+    connect(_tree, &QTreeWidget::itemExpanded, this, &TimelineDialog::SlotItemExpanded);
+    connect(jump_btn, &QPushButton::clicked, this, &TimelineDialog::SlotJump);
+    connect(_jump_edit, &QDateEdit::editingFinished, this, &TimelineDialog::SlotJump);
+    connect(_refresh_btn, &QPushButton::clicked, this, &TimelineDialog::SlotRefresh);
+
+    StartIndex(false);
+}
+
+TimelineDialog::~TimelineDialog()
+{
+    _thread->SlotCancelProgress();
+    _thread->wait();
+}
+
+void TimelineDialog::StartIndex(bool refresh)
+{
+    _thread = std::make_shared<DateIndexThread>(_pro_path, refresh);
+    connect(_thread.get(), &DateIndexThread::SigIndexReady, this, &TimelineDialog::SlotIndexReady);
+    connect(_thread.get(), &DateIndexThread::SigUpToDate, this, &TimelineDialog::SlotUpToDate);
+    DateIndexThread * thread = _thread.get();
+    connect(thread, &QThread::finished, this, [this, thread](){
+        if(_thread.get() == thread){
+            _refresh_btn->setEnabled(true);
+        }
+    });
+    _refresh_btn->setEnabled(false);
+    _thread->start();
+}
+
+// 文件在相册之外被改动过时，由用户触发完整核对
+void TimelineDialog::SlotRefresh()
+{
+    if(_thread->isRunning()){
+        return;
+    }
+    _status->setText(tr("共 %1 张，正在刷新...").arg(_count));
+    StartIndex(true);
+}
+
+void TimelineDialog::SlotIndexReady(const DateIndex::DayMap &days, int count, bool final)
+{
+    _days = days;
+    _count = count;
+    Rebuild();
+    if(final){
+        _status->setText(tr("共 %1 张").arg(_count));
+    } else {
+        // 旧索引先显示出来，后台核对磁盘上的新增和改动
+        _status->setText(tr("共 %1 张，正在更新...").arg(_count));
+    }
+}
+
+void TimelineDialog::SlotUpToDate()
+{
+    _status->setText(tr("共 %1 张").arg(_count));
+}
+
+// 按日期键从新到旧建立年、月、日三级节点，保留原来的展开状态和当前位置
+void TimelineDialog::Rebuild()
+{
+    QSet<int> expanded;
+    for(auto iter = _month_items.constBegin(); iter != _month_items.constEnd(); ++iter){
+        QTreeWidgetItem * month = iter.value();
+        if(month->parent()->isExpanded()){
+            expanded.insert(ItemKey(month->parent()));
+        }
+        if(month->isExpanded()){
+            expanded.insert(iter.key());
+        }
+        for(int i = 0; i < month->childCount(); ++i){
+            if(month->child(i)->isExpanded()){
+                expanded.insert(ItemKey(month->child(i)));
+            }
+        }
+    }
+    int current = _tree->currentItem() ? ItemKey(_tree->currentItem()) : 0;
+
+    _tree->clear();
+    _month_items.clear();
+    QTreeWidgetItem * year_item = nullptr;
+    QTreeWidgetItem * month_item = nullptr;
+    int year_count = 0, month_count = 0;
+    QList<QTreeWidgetItem*> restore;
+    QTreeWidgetItem * current_item = nullptr;
+
+    auto remember = [&](QTreeWidgetItem * item, int key){
+        item->setData(0, Qt::UserRole, key);
+        if(expanded.contains(key)){
+            restore.append(item);
+        }
+        if(key == current){
+            current_item = item;
+        }
+    };
+
+    for(auto iter = _days.constEnd(); iter != _days.constBegin();){
+        --iter;
+        int day = iter.key();
+        int year = day / 10000, month = day / 100;
+        if(!year_item || ItemKey(year_item) != year){
+            year_item = new QTreeWidgetItem(_tree);
+            remember(year_item, year);
+            year_count = 0;
+            month_item = nullptr;
+        }
+        if(!month_item || ItemKey(month_item) != month){
+            month_item = new QTreeWidgetItem(year_item);
+            remember(month_item, month);
+            _month_items.insert(month, month_item);
+            month_count = 0;
+        }
+        auto * day_item = new QTreeWidgetItem(month_item);
+        remember(day_item, day);
+        day_item->setText(0, tr("%1 月 %2 日（%3 张）").arg(month % 100).arg(day % 100).arg(iter->size()));
+        // 缩略图条在展开时才创建
+        day_item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+
+        year_count += iter->size();
+        month_count += iter->size();
+        year_item->setText(0, tr("%1 年（%2 张）").arg(year).arg(year_count));
+        month_item->setText(0, tr("%1 月（%2 张）").arg(month % 100).arg(month_count));
+    }
+
+    if(!_days.isEmpty()){
+        int first = _days.firstKey(), last = _days.lastKey();
+        _jump_edit->setDateRange(QDate(first / 10000, first / 100 % 100, 1),
+                                 QDate(last / 10000, last / 100 % 100, 1));
+    }
+    for(QTreeWidgetItem * item : restore){
+        item->setExpanded(true);
+    }
+    if(current_item){
+        _tree->setCurrentItem(current_item);
+    }
+}
+
+void TimelineDialog::SlotItemExpanded(QTreeWidgetItem *item)
+{
+    if(IsDayKey(ItemKey(item)) && item->childCount() == 0){
+        FillDay(item);
+    }
+}
+
+void TimelineDialog::FillDay(QTreeWidgetItem *day_item)
+{
+    QStringList paths;
+    QDir root(_pro_path);
+    for(const QString & rel_path : _days.value(ItemKey(day_item))){
+        paths.append(root.absoluteFilePath(rel_path));
+    }
+
+    auto * strip = new QListWidget();
+    strip->setViewMode(QListView::IconMode);
+    strip->setFlow(QListView::LeftToRight);
+    strip->setWrapping(false);
+    strip->setMovement(QListView::Static);
+    strip->setUniformItemSizes(true);
+    strip->setIconSize(QSize(kThumbSize, kThumbSize));
+    strip->setFixedHeight(kThumbSize + 48);
+    QIcon placeholder(":/icon/pic.png");
+    for(const QString & path : paths){
+        auto * item = new QListWidgetItem(placeholder, QFileInfo(path).fileName(), strip);
+        item->setData(Qt::UserRole, path);
+        item->setToolTip(path);
+    }
+    connect(strip, &QListWidget::itemClicked, this, [this](QListWidgetItem * item){
+        emit SigSelectPic(item->data(Qt::UserRole).toString());
+    });
+
+    auto * strip_item = new QTreeWidgetItem(day_item);
+    strip_item->setFlags(Qt::ItemIsEnabled);
+    _tree->setItemWidget(strip_item, 0, strip);
+
+    // 缩略图按显示顺序在线程池里生成，生成一张显示一张；缩略图条销毁时取消剩下的
+    std::function<QImage(const QString &)> make = [](const QString & path){
+        return ThumbCache::GetOrCreate(path, kThumbSize);
+    };
+    QFuture<QImage> future = QtConcurrent::mapped(paths, make);
+    auto * watcher = new QFutureWatcher<QImage>(strip);
+    connect(watcher, &QFutureWatcher<QImage>::resultReadyAt, strip, [strip, watcher](int index){
+        QImage thumb = watcher->resultAt(index);
+        if(!thumb.isNull() && index < strip->count()){
+            strip->item(index)->setIcon(QIcon(QPixmap::fromImage(thumb)));
+        }
+    });
+    connect(strip, &QObject::destroyed, [future]() mutable {
+        future.cancel();
+    });
+    watcher->setFuture(future);
+}
+
+// 跳到指定的月份；这个月没有照片时跳到之后最近有照片的月份
+void TimelineDialog::SlotJump()
+{
+    if(_month_items.isEmpty()){
+        return;
+    }
+    QDate date = _jump_edit->date();
+    auto iter = _month_items.lowerBound(date.year() * 100 + date.month());
+    if(iter == _month_items.end()){
+        --iter;
+    }
+    QTreeWidgetItem * month_item = iter.value();
+    month_item->parent()->setExpanded(true);
+    month_item->setExpanded(true);
+    _tree->setCurrentItem(month_item);
+    _tree->scrollToItem(month_item, QAbstractItemView::PositionAtTop);
+}
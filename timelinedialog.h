@@ -0,0 +1,55 @@
+#ifndef TIMELINEDIALOG_H
+#define TIMELINEDIALOG_H
+
+#include <QDialog>
+#include <QMap>
+#include <memory>
+#include "dateindexthread.h"
+
+class QDateEdit;
+class QLabel;
+class QPushButton;
+class QTreeWidget;
+class QTreeWidgetItem;
+
+/*
+ * 项目的时间线浏览：按年、月、日分组显示图片数量。
+ * 分组直接来自日期索引，打开和跳转到某个月都不需要扫描目录，点“刷新”才对照磁盘核对一遍；
+ * 展开某一天时才创建这一天的缩略图条，缩略图在线程池里异步生成。
+ * 点击缩略图发出 SigSelectPic，由目录树转给显示区域。
+ */
+class TimelineDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    explicit TimelineDialog(const QString & pro_path, QWidget * parent = nullptr);
+    ~TimelineDialog();
+
+private:
+    // 启动索引线程，refresh 为 true 时对照磁盘核对
+    void StartIndex(bool refresh);
+    void Rebuild();
+    // 为展开的某一天创建缩略图条
+    void FillDay(QTreeWidgetItem * day_item);
+
+    QString _pro_path;
+    DateIndex::DayMap _days;
+    int _count;
+    QTreeWidget * _tree;
+    QDateEdit * _jump_edit;
+    QLabel * _status;
+    QPushButton * _refresh_btn;
+    QMap<int, QTreeWidgetItem*> _month_items;   // 键为 yyyymm
+    std::shared_ptr<DateIndexThread> _thread;
+
+private slots:
+    void SlotIndexReady(const DateIndex::DayMap & days, int count, bool final);
+    void SlotUpToDate();
+    void SlotRefresh();
+    void SlotItemExpanded(QTreeWidgetItem * item);
+    void SlotJump();
+signals:
+    void SigSelectPic(const QString & path);
+};
+
+#endif // TIMELINEDIALOG_H
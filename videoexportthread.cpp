@@ -0,0 +1,238 @@
+#include "videoexportthread.h"
+#include "aviwriter.h"
+#include "imagescaler.h"
+#include "packfile.h"
+#include "reorderbuffer.h"
+#include <QBuffer>
+#include <QImageWriter>
+#include <QPainter>
+#include <QSettings>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+namespace {
+const int kJpegQuality = 90;
+// 质量 90 的照片 JPEG 大约每像素 2.5 位，用来估算文件大小
+const int kEstimateBitsPerPixelX2 = 5;
+
+// 两张同尺寸 RGB32 图片按 weight/256 混合，两个通道一起算
+QImage Blend(const QImage & a, const QImage & b, int weight)
+{
+    QImage out(a.size(), QImage::Format_RGB32);
+    const int inv = 256 - weight;
+    for(int y = 0; y < a.height(); ++y){
+        const quint32 * pa = reinterpret_cast<const quint32*>(a.constScanLine(y));
+        const quint32 * pb = reinterpret_cast<const quint32*>(b.constScanLine(y));
+        quint32 * po = reinterpret_cast<quint32*>(out.scanLine(y));
+        for(int x = 0; x < a.width(); ++x){
+            quint32 rb = ((pa[x] & 0x00FF00FF) * inv + (pb[x] & 0x00FF00FF) * weight) >> 8;
+            quint32 g = ((pa[x] & 0x0000FF00) * inv + (pb[x] & 0x0000FF00) * weight) >> 8;
+            po[x] = 0xFF000000 | (rb & 0x00FF00FF) | (g & 0x0000FF00);
+        }
+    }
+    return out;
+}
+}
+
+VideoExportThread::VideoExportThread(const QStringList &pics, const QString &out_path, QObject *parent)
+    :QThread(parent), _pics(pics), _out_path(out_path), _bstop(false)
+{
+    QSettings settings;
+    _size = QSize(qBound(64, settings.value("slideshow/width", 1280).toInt(), 4096) & ~1,
+                  qBound(64, settings.value("slideshow/height", 720).toInt(), 4096) & ~1);
+    _fps = qBound(1, settings.value("slideshow/fps", 25).toInt(), 60);
+    int hold_ms = qMax(40, settings.value("slideshow/hold_ms", 3000).toInt());
+    int fade_ms = qMax(0, settings.value("slideshow/fade_ms", 1000).toInt());
+    _hold_frames = qMax(1, hold_ms * _fps / 1000);
+    _fade_frames = fade_ms * _fps / 1000;
+}
+
+VideoExportThread::~VideoExportThread()
+{
+
+}
+
+// 需要编码的帧是每张幻灯片的第一帧和淡入淡出的帧，重复帧只占块头和索引
+qint64 VideoExportThread::EstimatedSize() const
+{
+    const qint64 count = _pics.size();
+    if(count == 0){
+        return 0;
+    }
+    const qint64 total = (count - 1) * (_hold_frames + _fade_frames) + _hold_frames;
+    const qint64 encoded = count + (count - 1) * _fade_frames;
+    const qint64 frame_bytes = qint64(_size.width()) * _size.height() * kEstimateBitsPerPixelX2 / 16;
+    return encoded * frame_bytes + total * AviWriter::kFrameOverhead;
+}
+
+void VideoExportThread::run()
+{
+    const int count = _pics.size();
+    if(count == 0){
+        emit SigTotalCount(0);
+        emit SigFinishProgress(0);
+        return;
+    }
+    const int period = _hold_frames + _fade_frames;
+    const int total = (count - 1) * period + _hold_frames;
+    emit SigTotalCount(total);
+
+    AviWriter writer;
+    if(!writer.Open(_out_path, _size.width(), _size.height(), _fps)){
+        emit SigFinishProgress(0);
+        return;
+    }
+
+    const int workers = qMax(1, QThread::idealThreadCount());
+    // 最多缓存约两秒的帧
+    ReorderBuffer<QByteArray> reorder(qMax(_fps * 2, workers * 2));
+    std::atomic<int> next_frame(0);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(workers);
+    QList<QFuture<void>> futures;
+    for(int w = 0; w < workers; ++w){
+        futures << QtConcurrent::run(&pool, [&](){
+            while(true){
+                if(_bstop){
+                    // 写帧线程可能正等着这一帧
+                    reorder.Cancel();
+                    break;
+                }
+                int frame = next_frame++;
+                if(frame >= total || !reorder.Reserve(frame)){
+                    break;
+                }
+                reorder.Put(frame, RenderFrame(frame));
+            }
+        });
+    }
+
+    // 当前线程按顺序写帧
+    bool ok = true;
+    bool full = false;
+    for(int frame = 0; frame < total; ++frame){
+        QByteArray data;
+        if(_bstop || !reorder.Take(data)){
+            ok = false;
+            break;
+        }
+        if(!writer.AddFrame(data)){
+            qDebug() << "write video frame failed" << frame << Qt::endl;
+            full = writer.IsFull();
+            ok = false;
+            break;
+        }
+        // 写过的幻灯片不会再用到
+        ReleaseSlidesBefore(qMin(frame / period, count - 1));
+        if(frame % _fps == 0){
+            emit SigUpdateProgress(frame);
+        }
+    }
+
+    reorder.Cancel();
+    for(QFuture<void> & future : futures){
+        future.waitForFinished();
+    }
+    _slides.clear();
+
+    if(!ok){
+        writer.Abort();
+        if(!_bstop){
+            emit SigFinishProgress(full ? -1 : 0);
+        }
+        return;
+    }
+    ok = writer.Close();
+    emit SigFinishProgress(ok ? writer.FrameCount() : 0);
+}
+
+// 帧号换算成第几张幻灯片的第几帧：前 hold 帧停留，之后 fade 帧淡入下一张
+QByteArray VideoExportThread::RenderFrame(int frame)
+{
+    const int period = _hold_frames + _fade_frames;
+    const int last = _pics.size() - 1;
+    int index = frame / period;
+    int offset = frame % period;
+    if(index >= last){
+        offset = frame - last * period;
+        index = last;
+    }
+
+    if(offset < _hold_frames){
+        // 停留期间只有第一帧需要数据，其余写成重复帧
+        if(offset > 0){
+            return QByteArray();
+        }
+        return GetSlide(index)->jpeg;
+    }
+
+    int step = offset - _hold_frames + 1;
+    SlidePtr from = GetSlide(index);
+    SlidePtr to = GetSlide(index + 1);
+    return EncodeFrame(Blend(from->image, to->image, step * 256 / (_fade_frames + 1)));
+}
+
+// 取幻灯片，没有时由当前线程解码，同时请求的线程等待同一份结果
+VideoExportThread::SlidePtr VideoExportThread::GetSlide(int index)
+{
+    std::promise<SlidePtr> promise;
+    std::shared_future<SlidePtr> future;
+    bool owner = false;
+    {
+        QMutexLocker locker(&_slide_mutex);
+        auto iter = _slides.find(index);
+        if(iter == _slides.end()){
+            future = promise.get_future().share();
+            _slides.emplace(index, future);
+            owner = true;
+        } else {
+            future = iter->second;
+        }
+    }
+    if(owner){
+        promise.set_value(MakeSlide(index));
+    }
+    return future.get();
+}
+
+VideoExportThread::SlidePtr VideoExportThread::MakeSlide(int index) const
+{
+    auto slide = std::make_shared<Slide>();
+    slide->image = QImage(_size, QImage::Format_RGB32);
+    slide->image.fill(Qt::black);
+
+    // 解码器直接缩小到输出尺寸附近，再高质量缩放后居中
+    QImage source = PackFile::ReadImage(_pics.at(index), qMax(_size.width(), _size.height()) * 2);
+    if(!source.isNull()){
+        QImage fitted = ImageScaler::Scale(source, _size, Qt::KeepAspectRatio);
+        QPainter painter(&slide->image);
+        painter.drawImage((_size.width() - fitted.width()) / 2, (_size.height() - fitted.height()) / 2, fitted);
+    } else {
+        qDebug() << "slideshow decode failed" << _pics.at(index) << Qt::endl;
+    }
+    slide->jpeg = EncodeFrame(slide->image);
+    return slide;
+}
+
+void VideoExportThread::ReleaseSlidesBefore(int index)
+{
+    QMutexLocker locker(&_slide_mutex);
+    _slides.erase(_slides.begin(), _slides.lower_bound(index));
+}
+
+QByteArray VideoExportThread::EncodeFrame(const QImage &image) const
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    QImageWriter writer(&buffer, "jpg");
+    writer.setQuality(kJpegQuality);
+    writer.write(image);
+    return data;
+}
+
+void VideoExportThread::SlotCancelProgress()
+{
+    _bstop = true;
+}
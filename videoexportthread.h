@@ -0,0 +1,67 @@
+#ifndef VIDEOEXPORTTHREAD_H
+#define VIDEOEXPORTTHREAD_H
+
+#include <QImage>
+#include <QMutex>
+#include <QSize>
+#include <QStringList>
+#include <QThread>
+#include <atomic>
+#include <future>
+#include <map>
+#include <memory>
+
+/*
+ * 把项目的幻灯片序列渲染成 MJPEG 编码的 AVI 视频。
+ * 每张图片停留 hold_ms，再用 fade_ms 淡入下一张；帧率、分辨率和时长取自设置。
+ * 逐帧在线程池中并行渲染和编码，经有界重排序缓冲区按顺序写入文件，
+ * 缓冲区只容纳约两秒的帧，幻灯片图片也只在用到的几帧期间保留在内存中。
+ * 停留期间除第一帧外都写成重复帧，只有淡入淡出需要逐帧编码。
+ * 文件超过 AVI 上限时 SigFinishProgress 发出 -1，其他失败发出 0。
+ */
+class VideoExportThread : public QThread
+{
+    Q_OBJECT
+public:
+    VideoExportThread(const QStringList & pics, const QString & out_path, QObject * parent = nullptr);
+    ~VideoExportThread();
+    // 按当前设置估算输出文件大小，用来在渲染前判断是否超过 AVI 的上限
+    qint64 EstimatedSize() const;
+
+protected:
+    virtual void run();
+
+private:
+    // 缩放到输出分辨率、四周补黑边的幻灯片，以及它单独成帧时的 JPEG
+    struct Slide {
+        QImage image;
+        QByteArray jpeg;
+    };
+    using SlidePtr = std::shared_ptr<const Slide>;
+
+    SlidePtr GetSlide(int index);
+    SlidePtr MakeSlide(int index) const;
+    void ReleaseSlidesBefore(int index);
+    QByteArray RenderFrame(int frame);
+    QByteArray EncodeFrame(const QImage & image) const;
+
+    QStringList _pics;
+    QString _out_path;
+    QSize _size;
+    int _fps;
+    int _hold_frames;       // 每张停留的帧数
+    int _fade_frames;       // 淡入淡出的帧数
+    QMutex _slide_mutex;
+    std::map<int, std::shared_future<SlidePtr>> _slides;   // 正在使用的幻灯片，第一个请求者负责解码
+    std::atomic<bool> _bstop;
+
+signals:
+    void SigTotalCount(int);
+    void SigUpdateProgress(int);
+    void SigFinishProgress(int);
+
+public slots:
+    void SlotCancelProgress();
+};
+
+#endif // VIDEOEXPORTTHREAD_H